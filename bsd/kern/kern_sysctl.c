@@ -113,6 +113,8 @@
 #include <kern/mach_param.h>
 #include <kern/task.h>
 #include <kern/thread.h>
+#include <kern/thread_call.h>
+#include <kern/wait_queue.h>
 #include <kern/lock.h>
 #include <kern/processor.h>
 #include <kern/debug.h>
@@ -3196,6 +3198,138 @@ SYSCTL_INT (_kern, OID_AUTO, stack_size,
 SYSCTL_INT (_kern, OID_AUTO, stack_depth_max,
 	    CTLFLAG_RD | CTLFLAG_LOCKED, (int *) &kernel_stack_depth_max, 0, "Max kernel stack depth at interrupt or context switch");
 
+/*
+ * kalloc per size class histogram; see osfmk/kern/kalloc.c
+ */
+SYSCTL_INT(_kern, OID_AUTO, kalloc_histogram_enable,
+		CTLFLAG_RW | CTLFLAG_LOCKED,
+		&kalloc_histogram_enabled, 0, "Collect kalloc size class statistics");
+
+STATIC int
+sysctl_kalloc_histogram
+(__unused struct sysctl_oid *oidp, __unused void *arg1, __unused int arg2, struct sysctl_req *req)
+{
+	struct kalloc_class_stat *stats;
+	unsigned int count;
+	int error;
+
+	count = kalloc_histogram(NULL, 0);
+	if (req->oldptr == USER_ADDR_NULL)
+		return SYSCTL_OUT(req, NULL, count * sizeof(*stats));
+
+	stats = (struct kalloc_class_stat *)kalloc(count * sizeof(*stats));
+	if (stats == NULL)
+		return ENOMEM;
+	(void) kalloc_histogram(stats, count);
+
+	error = SYSCTL_OUT(req, stats, count * sizeof(*stats));
+
+	kfree(stats, count * sizeof(*stats));
+	return error;
+}
+
+SYSCTL_PROC(_kern, OID_AUTO, kalloc_histogram,
+		CTLTYPE_STRUCT | CTLFLAG_RD | CTLFLAG_LOCKED,
+		0, 0, sysctl_kalloc_histogram, "S,kalloc_class_stat", "");
+
+/*
+ * thread_call group latency histograms; see osfmk/kern/thread_call.c
+ */
+STATIC int
+sysctl_thread_call_stats
+(__unused struct sysctl_oid *oidp, __unused void *arg1, __unused int arg2, struct sysctl_req *req)
+{
+	struct thread_call_group_stat *stats;
+	unsigned int count;
+	int error;
+
+	count = thread_call_group_stats(NULL, 0);
+	if (req->oldptr == USER_ADDR_NULL)
+		return SYSCTL_OUT(req, NULL, count * sizeof(*stats));
+
+	stats = (struct thread_call_group_stat *)kalloc(count * sizeof(*stats));
+	if (stats == NULL)
+		return ENOMEM;
+	(void) thread_call_group_stats(stats, count);
+
+	error = SYSCTL_OUT(req, stats, count * sizeof(*stats));
+
+	kfree(stats, count * sizeof(*stats));
+	return error;
+}
+
+SYSCTL_PROC(_kern, OID_AUTO, thread_call_stats,
+		CTLTYPE_STRUCT | CTLFLAG_RD | CTLFLAG_LOCKED,
+		0, 0, sysctl_thread_call_stats, "S,thread_call_group_stat", "");
+
+/*
+ * Global event hash bucket statistics; see osfmk/kern/wait_queue.c
+ */
+STATIC int
+sysctl_wait_hash_stats
+(__unused struct sysctl_oid *oidp, __unused void *arg1, __unused int arg2, struct sysctl_req *req)
+{
+	struct wait_hash_stat *stats;
+	unsigned int count;
+	int error;
+
+	count = wait_hash_stats(NULL, 0);
+	if (req->oldptr == USER_ADDR_NULL)
+		return SYSCTL_OUT(req, NULL, count * sizeof(*stats));
+
+	stats = (struct wait_hash_stat *)kalloc(count * sizeof(*stats));
+	if (stats == NULL)
+		return ENOMEM;
+	(void) wait_hash_stats(stats, count);
+
+	error = SYSCTL_OUT(req, stats, count * sizeof(*stats));
+
+	kfree(stats, count * sizeof(*stats));
+	return error;
+}
+
+SYSCTL_PROC(_kern, OID_AUTO, wait_hash_stats,
+		CTLTYPE_STRUCT | CTLFLAG_RD | CTLFLAG_LOCKED,
+		0, 0, sysctl_wait_hash_stats, "S,wait_hash_stat", "");
+
+/*
+ * Per-processor kmsg cache statistics; see osfmk/ipc/ipc_kmsg.c
+ */
+extern void ipc_kmsg_cache_stats(uint64_t *hits, uint64_t *misses);
+
+STATIC int
+sysctl_ikm_cache_stats
+(__unused struct sysctl_oid *oidp, __unused void *arg1, int arg2, struct sysctl_req *req)
+{
+	uint64_t hits, misses;
+
+	ipc_kmsg_cache_stats(&hits, &misses);
+	return sysctl_io_number(req, arg2 ? misses : hits, sizeof(uint64_t), NULL, NULL);
+}
+
+SYSCTL_PROC(_kern, OID_AUTO, ikm_cache_hits,
+		CTLTYPE_QUAD | CTLFLAG_RD | CTLFLAG_LOCKED,
+		0, 0, sysctl_ikm_cache_stats, "Q", "");
+SYSCTL_PROC(_kern, OID_AUTO, ikm_cache_misses,
+		CTLTYPE_QUAD | CTLFLAG_RD | CTLFLAG_LOCKED,
+		0, 1, sysctl_ikm_cache_stats, "Q", "");
+
+/*
+ * mach_msg send/receive direct handoffs; see osfmk/ipc/ipc_mqueue.c
+ */
+extern unsigned int ipc_mqueue_handoff_hits, ipc_mqueue_handoff_fallbacks;
+SYSCTL_UINT(_kern, OID_AUTO, ipc_handoff_hits, CTLFLAG_RD | CTLFLAG_LOCKED, &ipc_mqueue_handoff_hits, 0, "");
+SYSCTL_UINT(_kern, OID_AUTO, ipc_handoff_fallbacks, CTLFLAG_RD | CTLFLAG_LOCKED, &ipc_mqueue_handoff_fallbacks, 0, "");
+
+/*
+ * Out-of-line page loaning: default threshold for new tasks, and the
+ * number of regions lent so far.
+ */
+extern unsigned int ipc_kmsg_ool_loan_threshold;
+extern unsigned int ipc_kmsg_ool_loans;
+SYSCTL_UINT(_kern, OID_AUTO, ipc_ool_loan_threshold, CTLFLAG_RW | CTLFLAG_LOCKED, &ipc_kmsg_ool_loan_threshold, 0, "");
+SYSCTL_UINT(_kern, OID_AUTO, ipc_ool_loans, CTLFLAG_RD | CTLFLAG_LOCKED, &ipc_kmsg_ool_loans, 0, "");
+
 /*
  * enable back trace for port allocations
  */
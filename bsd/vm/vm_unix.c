@@ -1631,6 +1631,15 @@ extern unsigned int vm_page_free_count, vm_page_speculative_count;
 SYSCTL_UINT(_vm, OID_AUTO, page_free_count, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_free_count, 0, "");
 SYSCTL_UINT(_vm, OID_AUTO, page_speculative_count, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_speculative_count, 0, "");
 
+extern unsigned int vm_page_zeroed_count, vm_page_zeroed_target, vm_page_zeroed_hits, vm_page_zeroed_misses;
+extern unsigned int vm_page_zeroed_filled, vm_page_zeroed_drained;
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_count, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_count, 0, "Pre-zeroed pages available");
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_target, CTLFLAG_RW | CTLFLAG_LOCKED, &vm_page_zeroed_target, 0, "Pre-zeroed page cache depth");
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_hits, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_hits, 0, "");
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_misses, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_misses, 0, "");
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_filled, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_filled, 0, "");
+SYSCTL_UINT(_vm, OID_AUTO, page_zeroed_drained, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_zeroed_drained, 0, "");
+
 extern unsigned int vm_page_cleaned_count;
 SYSCTL_UINT(_vm, OID_AUTO, page_cleaned_count, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_cleaned_count, 0, "Cleaned queue size");
 
@@ -1665,6 +1674,46 @@ SYSCTL_UINT(_vm, OID_AUTO, pageout_cleaned_commit_reactivated, CTLFLAG_RD | CTLF
 SYSCTL_UINT(_vm, OID_AUTO, pageout_cleaned_busy, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_cleaned_busy, 0, "Cleaned pages busy (deactivated)");
 SYSCTL_UINT(_vm, OID_AUTO, pageout_cleaned_nolock, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_cleaned_nolock, 0, "Cleaned pages no-lock (deactivated)");
 
+/* fault-around: resident neighbours mapped on a soft fault, and whether they got used before aging out */
+extern int vm_fault_around_pages;
+extern unsigned int vm_fault_around_mapped, vm_fault_around_used, vm_fault_around_wasted;
+SYSCTL_INT(_vm, OID_AUTO, fault_around_pages, CTLFLAG_RW | CTLFLAG_LOCKED, &vm_fault_around_pages, 0, "Fault-around window in pages, 0 to disable");
+SYSCTL_UINT(_vm, OID_AUTO, fault_around_mapped, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_fault_around_mapped, 0, "Pages pre-mapped by fault-around");
+SYSCTL_UINT(_vm, OID_AUTO, fault_around_used, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_fault_around_used, 0, "Pre-mapped pages referenced before pageout scan");
+SYSCTL_UINT(_vm, OID_AUTO, fault_around_wasted, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_fault_around_wasted, 0, "Pre-mapped pages unreferenced at pageout scan");
+
+/* per-object resident page index; see vm_resident.c */
+extern unsigned int vm_page_radix_threshold, vm_page_radix_objects, vm_page_radix_nodes, vm_page_radix_fallbacks;
+SYSCTL_UINT(_vm, OID_AUTO, page_radix_threshold, CTLFLAG_RW | CTLFLAG_LOCKED, &vm_page_radix_threshold, 0, "Resident pages before an object is indexed, 0 to disable");
+SYSCTL_UINT(_vm, OID_AUTO, page_radix_objects, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_radix_objects, 0, "Objects with a page index");
+SYSCTL_UINT(_vm, OID_AUTO, page_radix_nodes, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_radix_nodes, 0, "Page index nodes allocated");
+SYSCTL_UINT(_vm, OID_AUTO, page_radix_fallbacks, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_page_radix_fallbacks, 0, "Page indexes abandoned for lack of memory");
+
+/* pageout iothreads and their clustering; see vm_pageout_iothread_continue() */
+extern unsigned int vm_pageout_iothreads, vm_pageout_cluster_pages;
+SYSCTL_UINT(_vm, OID_AUTO, pageout_iothreads, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_iothreads, 0, "I/O threads per pageout queue");
+SYSCTL_UINT(_vm, OID_AUTO, pageout_cluster_pages, CTLFLAG_RW | CTLFLAG_LOCKED, &vm_pageout_cluster_pages, 0, "Most queued pages sent to the pager in one request");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_internal_requests, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_internal.requests, "");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_internal_pages, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_internal.pages, "");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_internal_io_ns, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_internal.io_ns, "Total time in the default pager");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_internal_io_max_ns, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_internal.io_max_ns, "Longest default pager request");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_external_requests, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_external.requests, "");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_external_pages, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_external.pages, "");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_external_io_ns, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_external.io_ns, "Total time in file pagers");
+SYSCTL_QUAD(_vm, OID_AUTO, pageout_external_io_max_ns, CTLFLAG_RD | CTLFLAG_LOCKED, &vm_pageout_stats_external.io_max_ns, "Longest file pager request");
+
+/* default pager compressed pool; see osfmk/default_pager/dp_compressor.c */
+extern unsigned int dpc_pool_max_pages, dpc_pool_pages;
+extern uint64_t dpc_pool_bytes, dpc_compressions, dpc_compress_rejects, dpc_pool_full, dpc_decompressions, dpc_decompress_ns;
+SYSCTL_UINT(_vm, OID_AUTO, dp_compressor_pool_max_pages, CTLFLAG_RW | CTLFLAG_LOCKED, &dpc_pool_max_pages, 0, "Compressed pool limit, in pages of RAM");
+SYSCTL_UINT(_vm, OID_AUTO, dp_compressor_pool_pages, CTLFLAG_RD | CTLFLAG_LOCKED, &dpc_pool_pages, 0, "Pages held compressed");
+SYSCTL_QUAD(_vm, OID_AUTO, dp_compressor_pool_bytes, CTLFLAG_RD | CTLFLAG_LOCKED, &dpc_pool_bytes, "Compressed bytes held");
+SYSCTL_QUAD(_vm, OID_AUTO, dp_compressor_compressions, CTLFLAG_RD | CTLFLAG_LOCKED, &dpc_compressions, "");
+SYSCTL_QUAD(_vm, OID_AUTO, dp_compressor_rejects, CTLFLAG_RD | CTLFLAG_LOCKED, &dpc_compress_rejects, "Pages that did not compress well");
+SYSCTL_QUAD(_vm, OID_AUTO, dp_compressor_pool_full, CTLFLAG_RD | CTLFLAG_LOCKED, &dpc_pool_full, "Pages sent to swap with the pool full");
+SYSCTL_QUAD(_vm, OID_AUTO, dp_compressor_decompressions, CTLFLAG_RD | CTLFLAG_LOCKED, &dpc_decompressions, "");
+SYSCTL_QUAD(_vm, OID_AUTO, dp_compressor_decompress_ns, CTLFLAG_RD | CTLFLAG_LOCKED, &dpc_decompress_ns, "Total decompression time");
+
 #include <kern/thread.h>
 #include <sys/user.h>
 
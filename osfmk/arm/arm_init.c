@@ -36,8 +36,11 @@
 #include <pexpert/arm/boot.h>
 #include <pexpert/arm/protos.h>
 #include <arm/armops.h>
+#include <kern/startup.h>
+#include <kern/thread.h>
 
 extern uint8_t* irqstack;
+extern uint8_t* irqstack_top;
 
 /**
  * arm_init
@@ -79,6 +82,7 @@ void arm_init(boot_args* args) {
     
     bootProcessorData->cpu_number = 0;
     bootProcessorData->cpu_active_stack = &irqstack;
+    bootProcessorData->cpu_int_stack_top = (vm_offset_t) &irqstack_top;
     bootProcessorData->cpu_phys_number = 0;
     bootProcessorData->cpu_preemption_level = 1;
     bootProcessorData->cpu_interrupt_level = 0;
@@ -164,9 +168,12 @@ void arm_init(boot_args* args) {
     timer_start(&thread->system_timer, mach_absolute_time());
     
     /*
-     * VFP/float initialization.
+     * VFP/float initialization. The block copy routines may use NEON from
+     * here on unless told otherwise.
      */
     init_vfp();
+    if(vfp_neon_present() && !PE_parse_boot_argn("-no-neon", tempbuf, sizeof(tempbuf)))
+        arm_neon_enabled = 1;
     
     /*
      * Machine startup.
@@ -180,3 +187,29 @@ void arm_init(boot_args* args) {
     panic("why are we still here, NOO");
     while(1);
 }
+
+/**
+ * arm_slave_init
+ *
+ * Entered from arm_slave_start on a secondary processor, with the MMU on
+ * and running on the processor's interrupt stack. The processor's idle
+ * thread stands in as the current thread until slave_main loads the
+ * first real one.
+ */
+void arm_slave_init(void)
+{
+    cpu_data_t*     cdp = current_cpu_datap();
+    char            tempbuf[16];
+
+    if(!PE_parse_boot_argn("-no-cache", tempbuf, sizeof(tempbuf)))
+        cache_initialize();
+
+    machine_set_current_thread(cdp->cpu_processor->idle_thread);
+    init_vfp();
+
+    cpu_init();
+
+    slave_main(NULL);
+
+    panic("arm_slave_init: slave_main returned");
+}
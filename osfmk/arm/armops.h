@@ -44,5 +44,13 @@ extern void init_vfp(void);
 extern void vfp_context_save(struct arm_vfp_state* state);
 extern void vfp_context_load(struct arm_vfp_state* state);
 extern uint32_t vfp_enable_exception(boolean_t enable);
+extern boolean_t vfp_neon_present(void);
+
+/*
+ * Kernel use of the NEON registers, see thredinit.c.
+ */
+extern uint32_t arm_neon_enabled;
+extern void vfp_kernel_enter(void);
+extern void vfp_kernel_exit(void);
 
 #endif
@@ -144,6 +144,15 @@
 #define LoadThreadRegister(register) \
     mrc     p15, 0, register, c13, c0, 4
 
+/*
+ * Each processor has its own interrupt stack, found through the current
+ * thread's processor data.
+ */
+#define LoadInterruptStack(register)                                  \
+    LoadThreadRegister(register)                                  ;   \
+    ldr     register, [register, MACHINE_THREAD_CPU_DATA]         ;   \
+    ldr     register, [register, CPU_INT_STACK_TOP]
+
 #define IncrementPreemptLevel(register, scratch)                      \
     ldr     scratch, [register, MACHINE_THREAD_PREEMPT_COUNT]     ;   \
     adds    scratch, scratch, #1                                  ;   \
@@ -26,6 +26,14 @@
  *****************************************************************************/
  
 #include <arm/arch.h>
+#include <arm/asm_help.h>
+
+/*
+ * Forward copies at least this long go through NEON when the kernel may use
+ * it (arm_neon_enabled, interrupts on). Below that the cost of claiming
+ * the registers is not worth it.
+ */
+#define NEON_COPY_MIN	256
 
 .text
 .align 2
@@ -45,9 +53,12 @@ _memcpy:		/* void *memcpy(void *dest, const void *src, size_t len); */
 	cmpne	r0, r1
 	bxeq	lr
 
-	/* save r0 (return value), r4 (scratch), and r5 (scratch) */
-	stmfd	sp!, { r0, r4, r5, r7, lr }
-	add	r7, sp, #12
+	/*
+	 * save r0 (return value), r4 (scratch), and r5 (scratch). r6 pads the
+	 * frame to 8 bytes, the NEON path calls out to C.
+	 */
+	stmfd	sp!, { r0, r4, r5, r6, r7, lr }
+	add	r7, sp, #16
 	
 	/* check for overlap. r3 <- distance between src & dest */
 	subhs	r3, r0, r1
@@ -56,6 +67,11 @@ _memcpy:		/* void *memcpy(void *dest, const void *src, size_t len); */
 	blo		Loverlap
 
 Lnormalforwardcopy:
+#ifdef _ARM_ARCH_7
+	cmp		r2, #NEON_COPY_MIN
+	bhs		Lneonforwardcopy
+Lintegerforwardcopy:
+#endif
 	/* are src and dest dissimilarly word aligned? */
 	mov		r12, r0, lsl #30
 	cmp		r12, r1, lsl #30
@@ -398,6 +414,55 @@ Lalign3_forward_loop:
 	beq		Lexit
 	b		Lbytewise2
 
+#ifdef _ARM_ARCH_7
+Lneonforwardcopy:
+	/* NEON has to be usable and we must not be in interrupt context */
+	LoadConstantToReg(_arm_neon_enabled, r3)
+	ldr		r3, [r3]
+	cmp		r3, #0
+	beq		Lintegerforwardcopy
+	mrs		r3, cpsr
+	tst		r3, #0x80
+	bne		Lintegerforwardcopy
+
+	stmfd	sp!, { r0-r3 }
+	blx		_vfp_kernel_enter
+	ldmfd	sp!, { r0-r3 }
+
+	/* bytewise copy until dest is 16 byte aligned, any src alignment goes */
+	ands	r3, r0, #0xf
+	beq		Lneon_aligned
+	rsb		r3, r3, #16
+	sub		r2, r2, r3
+Lneon_alignloop:
+	ldrb	r12, [r1], #1
+	subs	r3, r3, #1
+	strb	r12, [r0], #1
+	bne		Lneon_alignloop
+
+Lneon_aligned:
+	/* pre-subtract 64 from the len counter, at least 192 bytes remain */
+	sub		r2, r2, #64
+Lneon_loop64:
+	vld1.8	{ d0-d3 }, [r1]!
+	vld1.8	{ d4-d7 }, [r1]!
+	pld		[r1, #192]
+	subs	r2, r2, #64
+	vst1.8	{ d0-d3 }, [r0, :128]!
+	vst1.8	{ d4-d7 }, [r0, :128]!
+	bge		Lneon_loop64
+	add		r2, r2, #64
+
+	stmfd	sp!, { r0-r3 }
+	blx		_vfp_kernel_exit
+	ldmfd	sp!, { r0-r3 }
+
+	/* less than 64 bytes left, finish with the integer code */
+	cmp		r2, #0
+	beq		Lexit
+	b		Lintegerforwardcopy
+#endif
+
 Lexit:
-	ldmfd	sp!, {r0, r4, r5, r7, pc}
+	ldmfd	sp!, {r0, r4, r5, r6, r7, pc}
 
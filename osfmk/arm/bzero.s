@@ -22,6 +22,12 @@
  */
 
 #include <arm/arch.h>
+#include <arm/asm_help.h>
+
+/*
+ * Lengths from which NEON is used when the kernel may use it, see bcopy.s.
+ */
+#define NEON_ZERO_MIN	256
 
 /* 
  * A reasonably well-optimized bzero/memset. Should work equally well on arm11 and arm9 based
@@ -61,6 +67,12 @@ Lbzeroengine:
 	cmp		r1, #0
 	bxeq	lr
 
+#ifdef _ARM_ARCH_7
+	cmp		r1, #NEON_ZERO_MIN
+	bhs		L_neon
+L_integer:
+#endif
+
 	/* fall back to a bytewise store for less than 32 bytes */
 	cmp		r1, #32
 	blt		L_bytewise
@@ -157,3 +169,59 @@ L_unaligned:
 	cmp		r1, #64
 	bge		L_64ormorealigned
 	b		L_lessthan64aligned
+
+#ifdef _ARM_ARCH_7
+L_neon:
+	/* NEON has to be usable and we must not be in interrupt context */
+	stmfd	sp!, { r0-r2, r7, r12, lr }
+	add		r7, sp, #12
+	LoadConstantToReg(_arm_neon_enabled, r3)
+	ldr		r3, [r3]
+	cmp		r3, #0
+	beq		L_neon_skip
+	mrs		r3, cpsr
+	tst		r3, #0x80
+	bne		L_neon_skip
+
+	blx		_vfp_kernel_enter
+	ldmia	sp, { r0-r2 }
+	ldr		r12, [sp, #16]
+	vdup.32	q0, r2
+	vmov	q1, q0
+
+	/* bytewise store until 16 byte aligned */
+	ands	r3, r12, #0xf
+	beq		L_neon_aligned
+	rsb		r3, r3, #16
+	sub		r1, r1, r3
+L_neon_alignloop:
+	subs	r3, r3, #1
+	strb	r2, [r12], #1
+	bne		L_neon_alignloop
+
+L_neon_aligned:
+	/* pre-subtract 64 from the len, at least 192 bytes remain */
+	sub		r1, r1, #64
+L_neon_loop64:
+	subs	r1, r1, #64
+	vst1.8	{ d0-d3 }, [r12, :128]!
+	vst1.8	{ d0-d3 }, [r12, :128]!
+	bge		L_neon_loop64
+	add		r1, r1, #64
+
+	stmia	sp, { r0-r2 }
+	str		r12, [sp, #16]
+	blx		_vfp_kernel_exit
+
+	/* less than 64 bytes left, finish with the integer code */
+	ldmfd	sp!, { r0-r2, r7, r12, lr }
+	mov		r3, r2
+	cmp		r1, #0
+	bxeq	lr
+	b		L_integer
+
+L_neon_skip:
+	ldmfd	sp!, { r0-r2, r7, r12, lr }
+	mov		r3, r2
+	b		L_integer
+#endif
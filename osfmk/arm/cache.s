@@ -47,6 +47,23 @@ EnterThumb(flush_dcache)
     nop
     bx      lr
 
+/**
+ * clean_dcache_range
+ *
+ * Write back every data-cache line in [va, va + length) to the point of
+ * coherency, for observers that do not snoop the cache.
+ */
+EnterARM(clean_dcache_range)
+    add     r1, r1, r0
+    bic     r0, r0, #0x1f
+0:
+    mcr     p15, 0, r0, c7, c10, 1
+    add     r0, r0, #0x20
+    cmp     r0, r1
+    blo     0b
+    dsb     sy
+    bx      lr
+
 /**
  * invalidate_icache64/invalidate_icache
  *
@@ -89,9 +106,16 @@ EnterThumb(flush_mmu_tlb)
  * Start and initialize ARM caches.
  */
 EnterARM(cache_initialize)
-    /* Enable L2 cache */
+    /*
+     * On MPCore parts, take part in coherency before the caches go on.
+     * Everything else gets the L2 cache enabled.
+     */
+    mrc     p15, 0, r1, c0, c0, 5
+    and     r1, r1, #(3 << 30)
+    cmp     r1, #(1 << 31)
     mrc     p15, 0, r0, c1, c0, 1
-    orr     r0, r0, #(1 << 1)
+    orreq   r0, r0, #(1 << 6)
+    orrne   r0, r0, #(1 << 1)
     mcr     p15, 0, r0, c1, c0, 1
 
     /* Enable caching. */
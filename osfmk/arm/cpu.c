@@ -27,9 +27,8 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /*
- * CPU bootstrap, used to create core structures for the boot processor.
- *
- * SMP support coming soon.
+ * CPU bootstrap, used to create core structures for the boot processor
+ * and to start the others.
  */
 
 #include <kern/kalloc.h>
@@ -45,9 +44,37 @@
 #include <arm/misc_protos.h>
 #include <mach/machine.h>
 #include <arm/arch.h>
+#include <arm/mp.h>
+#include <arm/machine_cpu.h>
+#include <pexpert/arm/protos.h>
 
 struct processor	BootProcessor;
 cpu_data_t          cpu_data_master;
+cpu_data_t          *cpu_data_ptr[MAX_CPUS];
+
+unsigned int        real_ncpus = 1;
+unsigned int        max_ncpus = MAX_CPUS;
+
+decl_simple_lock_data(static, cpu_lock)
+
+/*
+ * Parameters for a starting processor. arm_slave_start reads them with the
+ * MMU and caches off, so they are cleaned out to memory before the
+ * processor is kicked. Processors are started one at a time.
+ */
+struct {
+    uint32_t    ttb;        /* physical, bootstrap translation table */
+    uint32_t    stack;      /* virtual, top of the initial stack */
+} slave_boot_args;
+
+static vm_offset_t  slave_boot_ttb;
+
+/*
+ * How long a starting processor has to check in, in spins.
+ */
+#define CPU_START_SPINS     100000000
+
+extern void arm_slave_start(void);
 
 /**
  * cpu_bootstrap
@@ -61,12 +88,15 @@ cpu_bootstrap(void)
     
     cpu_data_master.cpu_this = &cpu_data_master;
     cpu_data_master.cpu_processor = &BootProcessor;
+
+    simple_lock_init(&cpu_lock, 0);
 }
 
 /**
  * cpu_init
  *
- * Initialize more core processor data for CPU #0 during initialization.
+ * Initialize more core processor data for the current processor during
+ * its initialization.
  */
 void
 cpu_init(void)
@@ -90,15 +120,12 @@ cpu_init(void)
 /**
  * get_cpu_number
  * 
- * Return the current processor number from the PCB. (Right now since we have
- * no SMP support, we have only 1 processor.
- *
- * When SMP becomes of real importance, we can get the current MPCore number
- * by reading some registers in the CP15 coprocessor.
+ * Return the current processor number. This is the MPCore number read from
+ * the CP15 coprocessor, so it is valid before the PCB is set up.
  */
 int get_cpu_number(void)
 {
-    return 0;
+    return cpu_number();
 }
 
 /**
@@ -131,13 +158,167 @@ cpu_data_t* current_cpu_datap(void)
  */
 processor_t cpu_processor_alloc(boolean_t is_boot_cpu)
 {
+    processor_t proc;
+
 	if (is_boot_cpu) {
 		return &BootProcessor;
     }
 
-    /* Should now kalloc one since we have VM now */
-    
-    return NULL;
+    proc = (processor_t) kalloc(sizeof(*proc));
+    if (proc == NULL)
+        return NULL;
+
+    bzero((void *) proc, sizeof(*proc));
+    return proc;
+}
+
+/**
+ * cpu_data_alloc
+ *
+ * Allocate the processor data, interrupt stack and processor_t for a
+ * secondary processor. Processor data is indexed by MPCore number.
+ */
+cpu_data_t* cpu_data_alloc(int cpu)
+{
+    cpu_data_t* cdp;
+    vm_offset_t stack;
+
+    assert(cpu > 0 && cpu < MAX_CPUS);
+
+    if (cpu_data_ptr[cpu] != NULL)
+        return cpu_data_ptr[cpu];
+
+    cdp = (cpu_data_t *) kalloc(sizeof(cpu_data_t));
+    if (cdp == NULL)
+        panic("cpu_data_alloc: cannot allocate cpu_data for cpu %d\n", cpu);
+    bzero((void *) cdp, sizeof(cpu_data_t));
+
+    if (kmem_alloc(kernel_map, &stack, INTSTACK_SIZE) != KERN_SUCCESS)
+        panic("cpu_data_alloc: cannot allocate interrupt stack for cpu %d\n", cpu);
+
+    cdp->cpu_this = cdp;
+    cdp->cpu_number = cpu;
+    cdp->cpu_phys_number = cpu;
+    cdp->cpu_active_stack = stack;
+    cdp->cpu_int_stack_top = stack + INTSTACK_SIZE;
+    cdp->cpu_preemption_level = 1;
+    cdp->cpu_processor = cpu_processor_alloc(FALSE);
+    if (cdp->cpu_processor == NULL)
+        panic("cpu_data_alloc: cannot allocate processor for cpu %d\n", cpu);
+
+    simple_lock(&cpu_lock);
+    cpu_data_ptr[cpu] = cdp;
+    real_ncpus++;
+    simple_unlock(&cpu_lock);
+
+    return cdp;
+}
+
+/**
+ * cpu_slave_boot_ttb_init
+ *
+ * Build the translation table a processor starts on. It is a copy of the
+ * kernel's with a section identity mapping the startup code, so that the
+ * code keeps running when the MMU comes on.
+ */
+static void cpu_slave_boot_ttb_init(void)
+{
+    uint32_t*   ttb;
+    uint32_t    pa;
+
+    if (slave_boot_ttb)
+        return;
+
+    if (kmem_alloc_contig(kernel_map, &slave_boot_ttb, L1_SIZE, L1_SIZE - 1,
+                          0, 0, KMA_KOBJECT) != KERN_SUCCESS)
+        panic("cpu_slave_boot_ttb_init: cannot allocate translation table\n");
+
+    ttb = (uint32_t *) slave_boot_ttb;
+    bcopy((void *) kernel_pmap->ttb, (void *) ttb, L1_SIZE);
+
+    /* Same section attributes as the boot identity mapping. */
+    pa = (uint32_t) kvtophys((vm_offset_t) arm_slave_start);
+    ttb[pa >> 20] = (pa & L1_SECT_ADDR_MASK) | L1_TYPE_SECT | (3 << 2) |
+                    (1 << L1_SECT_AP_SHIFT);
+
+    clean_dcache_range(slave_boot_ttb, L1_SIZE);
+    slave_boot_args.ttb = (uint32_t) kvtophys(slave_boot_ttb);
+}
+
+/**
+ * cpu_start
+ *
+ * Start a processor. The boot processor only sets up its machine state,
+ * the others are started at arm_slave_start by the platform expert and
+ * waited for.
+ */
+kern_return_t cpu_start(int cpu)
+{
+    cpu_data_t* cdp = cpu_datap(cpu);
+    int i;
+
+    if (cpu == cpu_number()) {
+        cpu_machine_init();
+        return KERN_SUCCESS;
+    }
+
+    assert(cdp != NULL);
+
+    cpu_slave_boot_ttb_init();
+
+    slave_boot_args.stack = cdp->cpu_int_stack_top;
+    clean_dcache_range((vm_offset_t) &slave_boot_args, sizeof(slave_boot_args));
+
+    cdp->cpu_running = FALSE;
+    if (!pe_arm_start_cpu(cpu, (uint32_t) kvtophys((vm_offset_t) arm_slave_start))) {
+        kprintf("cpu_start: platform cannot start cpu %d\n", cpu);
+        return KERN_FAILURE;
+    }
+
+    /*
+     * This may run before interrupts are on, when the timebase does not
+     * advance, so count spins instead of time.
+     */
+    for (i = 0; i < CPU_START_SPINS && !cdp->cpu_running; i++)
+        cpu_pause();
+
+    if (!cdp->cpu_running) {
+        kprintf("cpu_start: cpu %d failed to start\n", cpu);
+        return KERN_FAILURE;
+    }
+
+    return KERN_SUCCESS;
+}
+
+/**
+ * cpu_exit_wait
+ *
+ * Wait for a processor to stop running.
+ */
+void cpu_exit_wait(int cpu)
+{
+    cpu_data_t* cdp = cpu_datap(cpu);
+
+    while (cdp->cpu_running)
+        cpu_pause();
+}
+
+/**
+ * cpu_machine_init
+ *
+ * Machine dependent initialization of the current processor, done from
+ * its first thread. Interrupts are enabled from here on.
+ */
+void cpu_machine_init(void)
+{
+    cpu_data_t* cdp = current_cpu_datap();
+
+    /* The boot processor's interrupt controller is set up with the clock. */
+    if (cdp != &cpu_data_master)
+        pe_arm_init_cpu(NULL);
+
+    cdp->cpu_running = TRUE;
+    ml_init_interrupt();
 }
 
 /**
@@ -62,6 +62,19 @@ typedef enum {
     TASK_MAP_32BIT,            /* 32-bit user, compatibility mode */ 
 } task_map_t;
 
+/*
+ * The TLB shootdown a processor has posted, see mp_tlb_shootdown. The
+ * pmap's ASID and generation are taken when the request is made.
+ */
+typedef struct cpu_tlb_request {
+    struct pmap         *pmap;
+    uint32_t            asid;
+    uint32_t            asid_generation;
+    vm_offset_t         start;
+    vm_offset_t         end;
+    volatile uint32_t   pending;            /* processors yet to flush */
+} cpu_tlb_request_t;
+
 typedef struct rtclock_timer {
     mpqueue_head_t        queue;
     uint64_t        deadline;
@@ -102,8 +115,14 @@ typedef struct cpu_data
     int         cpu_pending_ast;
     uint64_t        interrupt_entry_time;
     uint32_t        interrupt_count[8];
-    uint32_t        rtcPop;
+    uint64_t        rtcPop;                 /* when the decrementer pops for us */
+    uint32_t        rtclock_pops;           /* timer pops taken */
+    uint32_t        rtclock_early;          /* ... before our deadline was due */
+    uint32_t        rtclock_late;           /* ... past the coalescing window */
+    uint32_t        rtclock_coalesced;      /* deadlines that rode an earlier pop */
     struct pmap*    user_pmap;
+    uint32_t        cpu_asid_generation;    /* ASID generation of the TLB */
+    cpu_tlb_request_t   cpu_tlb_request;    /* our shootdown in progress */
     uint64_t        absolute_time;
     rtclock_timer_t rt_timer;
     thread_t        old_thread;
@@ -140,5 +159,6 @@ int get_cpu_number(void);
 int get_cpu_phys_number(void);
 
 cpu_data_t* current_cpu_datap(void);
+cpu_data_t* cpu_data_alloc(int cpu);
 
 #endif
@@ -31,8 +31,20 @@
 	.globl _cpu_number
 _cpu_number:
 #ifdef _ARM_ARCH_7
-	mrc	p15, 0, r0, c13, c0, 3
+	/*
+	 * The MPIDR affinity level 0 field is the core number. Cores
+	 * without the multiprocessing extensions (or uniprocessor ones)
+	 * are always processor 0.
+	 */
+	mrc	p15, 0, r0, c0, c0, 5
+	tst	r0, #(1 << 31)
+	beq	1f
+	tst	r0, #(1 << 30)
+	bne	1f
 	and	r0, r0, #3
+	bx	lr
+1:
+	mov	r0, #0
 #else
 	mov	r0, #0
 #endif
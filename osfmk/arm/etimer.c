@@ -45,6 +45,8 @@
 #include <machine/commpage.h>
 #include <machine/machine_routines.h>
 
+extern uint64_t rtclock_coalesce_window;
+
 #ifndef __LP64__
 /**
  * timer_grab
@@ -102,7 +104,6 @@ etimer_resync_deadlines(void)
 	rtclock_timer_t		*mytimer;
 	spl_t			s = splclock();
 	cpu_data_t		*pp;
-	uint32_t		decr;
 
 	pp = current_cpu_datap();
 	deadline = EndOfAllTime;
@@ -116,23 +117,12 @@ etimer_resync_deadlines(void)
 		deadline = mytimer->deadline;
 
 	/*
-	 * Go and set the "pop" event.
+	 * Go and set the "pop" event. setPop records the pop it
+	 * actually programmed in rtcPop.
 	 */
+	if (deadline > 0 && deadline <= pp->rtcPop)
+		(void) setPop(deadline);
 
-	if (deadline > 0 && deadline <= pp->rtcPop) {
-		int     decr;
-		uint64_t now;
-
-		now = mach_absolute_time();
-		decr = setPop(deadline);
-
-		if (deadline < now) {
-		        pp->rtcPop = now + decr;
-		} else {
-		        pp->rtcPop = deadline;
-        }
-    }
-    
 	splx(s);
 }
 
@@ -158,6 +148,13 @@ etimer_intr(int inuser, uint64_t iaddr)
 
 	/* has a pending clock timer expired? */
 	mytimer = &pp->rt_timer;		/* Point to the event timer */
+
+	pp->rtclock_pops++;
+	if (abstime < mytimer->deadline)
+		pp->rtclock_early++;
+	else if (abstime - mytimer->deadline > rtclock_coalesce_window)
+		pp->rtclock_late++;
+
 	if (mytimer->deadline <= abstime) {
 		mytimer->has_expired = TRUE;	/* Remember that we popped */
 		mytimer->deadline = timer_queue_expire(&mytimer->queue, abstime);
@@ -184,7 +181,9 @@ mpqueue_head_t* timer_queue_assign(uint64_t deadline)
 		queue = &cdp->rt_timer.queue;
 		if (deadline < cdp->rt_timer.deadline) {
 			etimer_set_deadline(deadline);
-        }
+		} else if (deadline - cdp->rt_timer.deadline <= rtclock_coalesce_window) {
+			cdp->rtclock_coalesced++;
+		}
 	}
 	else
 		queue = &cpu_datap(master_cpu)->rt_timer.queue;
@@ -195,14 +194,16 @@ mpqueue_head_t* timer_queue_assign(uint64_t deadline)
 /**
  * timer_call_slop
  *
- * Used for coalescing timer deadlines.
+ * Used for coalescing timer deadlines: the lesser of 12.5% of the
+ * distance to the deadline and the coalescing window.
  */
 uint64_t timer_call_slop(uint64_t deadline)
 {
 	uint64_t now = mach_absolute_time();
 	if (deadline > now) {
-		return MIN((deadline - now) >> 3, NSEC_PER_MSEC); /* Min of 12.5% and 1ms */
+		return MIN((deadline - now) >> 3, rtclock_coalesce_window);
 	}
+	return 0;
 }
 
 /**
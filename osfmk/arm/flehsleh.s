@@ -393,12 +393,12 @@ irqhandler_from_user:
     mrs     r0, spsr
     str     r0, [sp, #0x40]
     mov     r5, sp
-    LoadConstantToReg(_irqstack_top, sp)
+    LoadInterruptStack(sp)
     b       irq_join
 
 irqhandler_from_kernel:
     /* Set up IRQ stack */
-    LoadConstantToReg(_irqstack_top, sp)
+    LoadInterruptStack(sp)
 
     /* Now save the registers */
     sub     sp, sp, #0x50
@@ -181,6 +181,9 @@ main(
     DECLARE("CPU_PREEMPT_COUNT",	offsetof(cpu_data_t*, cpu_preemption_level));
            
     DECLARE("CPU_PMAP",	offsetof(cpu_data_t*, user_pmap));
+    DECLARE("CPU_SIGNALS",	offsetof(cpu_data_t*, cpu_signals));
+    DECLARE("PMAP_TTB_PHYS",	offsetof(struct pmap*, ttb_phys));
+    DECLARE("CPU_SIGNAL_TLB_FLUSH",	(1 << MP_TLB_FLUSH));
     
 	DECLARE("TH_TASK",	offsetof(thread_t, task));
 	DECLARE("TH_AST",	offsetof(thread_t, ast));
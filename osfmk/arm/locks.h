@@ -111,7 +111,10 @@ extern void		hw_lock_byte_init(uint8_t *lock_byte);
 extern void		hw_lock_byte_lock(uint8_t *lock_byte);
 extern void		hw_lock_byte_unlock(uint8_t *lock_byte);
 
-#define     lck_rw_lock_exclusive       lck_rw_lock_exclusive_gen
+/* Contended paths, called from lockshw.s */
+extern void		lck_mtx_lock_gen(lck_mtx_t *lck);
+extern boolean_t	lck_mtx_try_lock_gen(lck_mtx_t *lck);
+extern void		lck_mtx_unlock_gen(lck_mtx_t *lck);
 
 typedef struct {
 	unsigned int		type;
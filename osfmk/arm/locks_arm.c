@@ -75,6 +75,7 @@
 #include <kern/cpu_data.h>
 #include <kern/cpu_number.h>
 #include <kern/sched_prim.h>
+#include <kern/clock.h>
 #include <kern/xpr.h>
 #include <kern/debug.h>
 #include <string.h>
@@ -92,12 +93,19 @@
  * This file works, don't mess with it.
  */
 
-unsigned int lock_wait_time[2] = { (unsigned int)-1, 0 } ;
-
 #define	lck_mtx_data	lck_mtx_sw.lck_mtxd.lck_mtxd_data
 #define	lck_mtx_waiters	lck_mtx_sw.lck_mtxd.lck_mtxd_waiters
 #define	lck_mtx_pri		lck_mtx_sw.lck_mtxd.lck_mtxd_pri
 
+/*
+ * The mutex word holds the owning thread, the interlock in bit 0 and
+ * a flag in bit 1 telling the unlock path that there are waiters. The
+ * uncontended cases are handled in lockshw.s, everything else here.
+ */
+#define LCK_MTX_ILOCKED		0x1
+#define LCK_MTX_WAITERS		0x2
+#define LCK_MTX_OWNER(data)	((thread_t)((data) & ~(LCK_MTX_ILOCKED | LCK_MTX_WAITERS)))
+
 uint32_t LcksOpts;
 
 void lck_rw_ilk_lock(lck_rw_t *lck)
@@ -110,6 +118,23 @@ void lck_rw_ilk_unlock(lck_rw_t *lck)
     lck_spin_unlock(lck);
 }
 
+static inline void
+lck_mtx_ilk_lock(lck_mtx_t *mutex)
+{
+    hw_lock_lock((hw_lock_t)&mutex->lck_mtx_data);
+}
+
+/*
+ * Mutex statistics, kept for extended mutexes in groups that ask for
+ * them. Only the low word of each counter is bumped, as on x86.
+ */
+#define LCK_MTX_STAT_INCR(ext, field)                                           \
+    do {                                                                        \
+        if ((ext) != NULL && ((ext)->lck_mtx_attr & LCK_MTX_ATTR_STAT))         \
+            (void)hw_atomic_add((uint32_t *)&(ext)->lck_mtx_grp->               \
+                lck_grp_stat.lck_grp_mtx_stat.field, 1);                        \
+    } while (0)
+
 static void
 lck_mtx_ext_init(lck_mtx_ext_t *lck,
                  lck_grp_t *grp,
@@ -158,6 +183,19 @@ lck_mtx_init(lck_mtx_t	*lck,
     lck->lck_mtx_waiters = 0;
     lck->lck_mtx_state = 0;
 
+	/*
+	 * Debug and statistics mutexes are indirect, the group is only
+	 * reachable through the extended mutex.
+	 */
+	if ((lck_attr->lck_attr_val & LCK_ATTR_DEBUG) ||
+	    (grp->lck_grp_attr & LCK_GRP_ATTR_STAT)) {
+		if ((lck_ext = (lck_mtx_ext_t *)kalloc(sizeof(lck_mtx_ext_t))) != 0) {
+			lck_mtx_ext_init(lck_ext, grp, lck_attr);
+			lck->lck_mtx_tag = LCK_MTX_TAG_INDIRECT;
+			lck->lck_mtx_ptr = lck_ext;
+		}
+	}
+
 	lck_grp_reference(grp);
 	lck_grp_lckcnt_incr(grp, LCK_TYPE_MTX);
 }
@@ -200,11 +238,185 @@ lck_mtx_init_ext(lck_mtx_t *lck,
     lck->lck_mtx_waiters = 0;
     lck->lck_mtx_state = 0;
 
+	if ((lck_attr->lck_attr_val & LCK_ATTR_DEBUG) ||
+	    (grp->lck_grp_attr & LCK_GRP_ATTR_STAT)) {
+		lck_mtx_ext_init(lck_ext, grp, lck_attr);
+		lck->lck_mtx_tag = LCK_MTX_TAG_INDIRECT;
+		lck->lck_mtx_ptr = lck_ext;
+	}
+
 	lck_grp_reference(grp);
 	lck_grp_lckcnt_incr(grp, LCK_TYPE_MTX);
 
 }
 
+/*
+ * Is the mutex holder running on another processor right now? If so it
+ * is likely to drop the mutex soon and spinning beats a context switch.
+ */
+static inline boolean_t
+lck_mtx_holder_running(thread_t holder)
+{
+	processor_t	processor;
+
+	if (real_ncpus == 1)
+		return (FALSE);
+
+	processor = holder->last_processor;
+	return (processor != PROCESSOR_NULL && processor->active_thread == holder);
+}
+
+/*
+ * Spin for up to MutexSpin while the holder stays on core. Returns TRUE
+ * if we spun at all.
+ */
+static boolean_t
+lck_mtx_lock_spinwait(lck_mtx_t *mutex)
+{
+	thread_t	holder;
+	uint64_t	deadline = 0;
+
+	for (;;) {
+		holder = LCK_MTX_OWNER(mutex->lck_mtx_data);
+		if (holder == THREAD_NULL || !lck_mtx_holder_running(holder))
+			break;
+		if (deadline == 0)
+			deadline = mach_absolute_time() + MutexSpin;
+		else if (mach_absolute_time() >= deadline)
+			break;
+	}
+
+	return (deadline != 0);
+}
+
+/*
+ * Take the mutex as current_thread(), called with the interlock held.
+ * Hands the interlock back.
+ */
+static void
+lck_mtx_lock_acquire_ilk(lck_mtx_t *lck,
+                         lck_mtx_t *mutex)
+{
+	uint32_t	data = (uint32_t)current_thread();
+
+	if (lck_mtx_lock_acquire(lck) > 0)
+		data |= LCK_MTX_WAITERS;
+
+	mutex->lck_mtx_data = data | LCK_MTX_ILOCKED;
+	lck_mtx_ilk_unlock(mutex);
+}
+
+/**
+ * lck_mtx_lock_gen
+ *
+ * Contended (or indirect) path of lck_mtx_lock. Spins while the holder is
+ * running, then blocks.
+ */
+void
+lck_mtx_lock_gen(lck_mtx_t *lck)
+{
+	lck_mtx_t	*mutex;
+	lck_mtx_ext_t	*lck_ext = NULL;
+	thread_t	holder;
+	boolean_t	missed = FALSE;
+
+	if (lck->lck_mtx_tag == LCK_MTX_TAG_INDIRECT) {
+		lck_ext = lck->lck_mtx_ptr;
+		mutex = &lck_ext->lck_mtx;
+	} else
+		mutex = lck;
+
+	for (;;) {
+		if (lck_mtx_lock_spinwait(mutex))
+			missed = TRUE;
+
+		lck_mtx_ilk_lock(mutex);
+
+		holder = LCK_MTX_OWNER(mutex->lck_mtx_data);
+		if (holder == THREAD_NULL)
+			break;
+		if (holder == current_thread())
+			panic("lck_mtx_lock(): mutex (%p, 0x%08x) already owned\n", lck, mutex->lck_mtx_data);
+
+		/*
+		 * The holder is off core, wait for it. lck_mtx_lock_wait drops
+		 * the interlock.
+		 */
+		missed = TRUE;
+		LCK_MTX_STAT_INCR(lck_ext, lck_grp_mtx_wait_cnt);
+		mutex->lck_mtx_data |= LCK_MTX_WAITERS;
+		lck_mtx_lock_wait(lck, holder);
+	}
+
+	lck_mtx_lock_acquire_ilk(lck, mutex);
+
+	LCK_MTX_STAT_INCR(lck_ext, lck_grp_mtx_util_cnt);
+	if (missed)
+		LCK_MTX_STAT_INCR(lck_ext, lck_grp_mtx_miss_cnt);
+}
+
+/**
+ * lck_mtx_try_lock_gen
+ *
+ * Contended (or indirect) path of lck_mtx_try_lock.
+ */
+boolean_t
+lck_mtx_try_lock_gen(lck_mtx_t *lck)
+{
+	lck_mtx_t	*mutex;
+	lck_mtx_ext_t	*lck_ext = NULL;
+
+	if (lck->lck_mtx_tag == LCK_MTX_TAG_INDIRECT) {
+		lck_ext = lck->lck_mtx_ptr;
+		mutex = &lck_ext->lck_mtx;
+	} else
+		mutex = lck;
+
+	lck_mtx_ilk_lock(mutex);
+
+	if (LCK_MTX_OWNER(mutex->lck_mtx_data) != THREAD_NULL) {
+		lck_mtx_ilk_unlock(mutex);
+		LCK_MTX_STAT_INCR(lck_ext, lck_grp_mtx_miss_cnt);
+		return (FALSE);
+	}
+
+	lck_mtx_lock_acquire_ilk(lck, mutex);
+
+	LCK_MTX_STAT_INCR(lck_ext, lck_grp_mtx_util_cnt);
+	return (TRUE);
+}
+
+/**
+ * lck_mtx_unlock_gen
+ *
+ * Slow path of lck_mtx_unlock, wakes up a waiter if there is one. The
+ * waiters flag is left set so that the mutex keeps going through here
+ * until the woken thread has recomputed it.
+ */
+void
+lck_mtx_unlock_gen(lck_mtx_t *lck)
+{
+	lck_mtx_t	*mutex;
+	uint32_t	data;
+
+	if (lck->lck_mtx_tag == LCK_MTX_TAG_INDIRECT)
+		mutex = &lck->lck_mtx_ptr->lck_mtx;
+	else
+		mutex = lck;
+
+	lck_mtx_ilk_lock(mutex);
+
+	data = mutex->lck_mtx_data;
+	if (LCK_MTX_OWNER(data) != current_thread())
+		panic("lck_mtx_unlock(): mutex (%p, 0x%08x) not owned\n", lck, data);
+
+	if (data & LCK_MTX_WAITERS)
+		lck_mtx_unlock_wakeup(lck, current_thread());
+
+	mutex->lck_mtx_data = (data & LCK_MTX_WAITERS) | LCK_MTX_ILOCKED;
+	lck_mtx_ilk_unlock(mutex);
+}
+
 lck_rw_t *
 lck_rw_alloc_init(lck_grp_t *grp,
                   lck_attr_t *attr) {
@@ -423,26 +635,40 @@ lck_rw_unlock_exclusive(lck_rw_t *lck)
 		panic("lck_rw_unlock_exclusive(): lock held in mode: %d\n", ret);
 }
 
+/*
+ * How long to spin on a busy rw lock before blocking. Nobody on another
+ * processor can release it on a uniprocessor, and once someone is asleep
+ * on the lock we queue up behind them.
+ */
+static inline uint64_t
+lck_rw_deadline_for_spin(lck_rw_t *lck)
+{
+	if (real_ncpus == 1 || lck->lck_rw_waiting)
+		return (0);
+
+	return (mach_absolute_time() + MutexSpin);
+}
+
 void
 lck_rw_lock_shared_gen(lck_rw_t	*lck)
 {
-	int		i;
+	uint64_t	deadline;
 	wait_result_t      res;
     
 	lck_rw_ilk_lock(lck);
 
 	while ((lck->lck_rw_want_excl || lck->lck_rw_want_upgrade) &&
            ((lck->lck_rw_shared_count == 0) || (lck->lck_rw_priv_excl))) {
-		i = lock_wait_time[1];
+		deadline = lck_rw_deadline_for_spin(lck);
         
 		KERNEL_DEBUG(MACHDBG_CODE(DBG_MACH_LOCKS, LCK_RW_LCK_SHARED_CODE) | DBG_FUNC_START,
-                     (int)lck, lck->lck_rw_want_excl, lck->lck_rw_want_upgrade, i, 0);
+                     (int)lck, lck->lck_rw_want_excl, lck->lck_rw_want_upgrade, deadline != 0, 0);
         
-		if (i != 0) {
+		if (deadline != 0) {
 			lck_rw_ilk_unlock(lck);
-			while (--i != 0 &&
-			       (lck->lck_rw_want_excl || lck->lck_rw_want_upgrade) &&
-			       ((lck->lck_rw_shared_count == 0) || (lck->lck_rw_priv_excl)))
+			while ((lck->lck_rw_want_excl || lck->lck_rw_want_upgrade) &&
+			       ((lck->lck_rw_shared_count == 0) || (lck->lck_rw_priv_excl)) &&
+			       mach_absolute_time() < deadline)
 				continue;
 			lck_rw_ilk_lock(lck);
 		}
@@ -471,7 +697,7 @@ lck_rw_lock_shared_gen(lck_rw_t	*lck)
 void
 lck_rw_lock_exclusive_gen(lck_rw_t	*lck)
 {
-	int             i;
+	uint64_t        deadline;
 	wait_result_t   res;
     
 	lck_rw_ilk_lock(lck);
@@ -482,10 +708,10 @@ lck_rw_lock_exclusive_gen(lck_rw_t	*lck)
 	while (lck->lck_rw_want_excl) {
 		KERNEL_DEBUG(MACHDBG_CODE(DBG_MACH_LOCKS, LCK_RW_LCK_EXCLUSIVE_CODE) | DBG_FUNC_START, (int)lck, 0, 0, 0, 0);
 
-		i = lock_wait_time[1];
-		if (i != 0) {
+		deadline = lck_rw_deadline_for_spin(lck);
+		if (deadline != 0) {
 			lck_rw_ilk_unlock(lck);
-			while (--i != 0 && lck->lck_rw_want_excl)
+			while (lck->lck_rw_want_excl && mach_absolute_time() < deadline)
 				continue;
 			lck_rw_ilk_lock(lck);
 		}
@@ -507,16 +733,17 @@ lck_rw_lock_exclusive_gen(lck_rw_t	*lck)
     
 	while ((lck->lck_rw_shared_count != 0) || lck->lck_rw_want_upgrade) {
         
-		i = lock_wait_time[1];
+		deadline = lck_rw_deadline_for_spin(lck);
         
 		KERNEL_DEBUG(MACHDBG_CODE(DBG_MACH_LOCKS, LCK_RW_LCK_EXCLUSIVE1_CODE) | DBG_FUNC_START,
-                     (int)lck, lck->lck_rw_shared_count, lck->lck_rw_want_upgrade, i, 0);
+                     (int)lck, lck->lck_rw_shared_count, lck->lck_rw_want_upgrade, deadline != 0, 0);
 
         
-		if (i != 0) {
+		if (deadline != 0) {
 			lck_rw_ilk_unlock(lck);
-			while (--i != 0 && (lck->lck_rw_shared_count != 0 ||
-                                lck->lck_rw_want_upgrade))
+			while ((lck->lck_rw_shared_count != 0 ||
+                    lck->lck_rw_want_upgrade) &&
+			       mach_absolute_time() < deadline)
 				continue;
 			lck_rw_ilk_lock(lck);
 		}
@@ -547,7 +774,7 @@ lck_mtx_lock_mark_destroyed(lck_mtx_t *mutex)
 boolean_t
 lck_rw_lock_shared_to_exclusive_gen(lck_rw_t	*lck)
 {
-	int	    i;
+	uint64_t	    deadline;
 	boolean_t	    do_wakeup = FALSE;
 	wait_result_t      res;
 
@@ -583,13 +810,13 @@ lck_rw_lock_shared_to_exclusive_gen(lck_rw_t	*lck)
 	lck->lck_rw_want_upgrade = TRUE;
     
 	while (lck->lck_rw_shared_count != 0) {
-		i = lock_wait_time[1];
+		deadline = lck_rw_deadline_for_spin(lck);
         
 		KERNEL_DEBUG(MACHDBG_CODE(DBG_MACH_LOCKS, LCK_RW_LCK_SH_TO_EX1_CODE) | DBG_FUNC_START,
-                     (int)lck, lck->lck_rw_shared_count, i, 0, 0);
-		if (i != 0) {
+                     (int)lck, lck->lck_rw_shared_count, deadline != 0, 0, 0);
+		if (deadline != 0) {
 			lck_rw_ilk_unlock(lck);
-			while (--i != 0 && lck->lck_rw_shared_count != 0)
+			while (lck->lck_rw_shared_count != 0 && mach_absolute_time() < deadline)
 				continue;
 			lck_rw_ilk_lock(lck);
 		}
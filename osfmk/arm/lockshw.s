@@ -55,26 +55,40 @@ EnterThumb(hw_lock_held)
 
 /**
  * arm_usimple_lock and friends
+ *
+ * Spin until the interlock bit is ours. The holder may be waiting on a
+ * TLB shootdown aimed at this processor, possibly with interrupts off,
+ * so shootdown requests are serviced while spinning.
  */
 EnterARM(arm_usimple_lock)
 EnterARM(lck_spin_lock)
 EnterARM(hw_lock_lock)
     LoadLockHardwareRegister(r12)
     IncrementPreemptLevel(r12, r2)
-    ldr     r3, [r0]
-    mov     r2, #1
-    orr     r1, r3, #1
-    ands    r2, r2, r3
-    streq   r1, [r0]
-    bxeq    lr
-hw_lock_lock_panic:
-    mov     r1, r0
-    ldr     r2, [r1]
-    adr     r0, _panicString
-    blx     _panic
-    b       .
-_panicString:
-    .asciz "hw_lock_lock(): PANIC: Lock 0x%08x = 0x%08x"
+hw_lock_lock_loop:
+    ldrex   r3, [r0]
+    tst     r3, #1
+    bne     hw_lock_lock_spin
+    orr     r3, r3, #1
+#ifndef BOARD_CONFIG_OMAP3530
+    strex   r2, r3, [r0]
+    movs    r2, r2
+    bne     hw_lock_lock_loop
+#else
+    str     r3, [r0]
+#endif
+    dmb     sy
+    bx      lr
+hw_lock_lock_spin:
+    ldr     r2, [r12, MACHINE_THREAD_CPU_DATA]
+    ldr     r2, [r2, CPU_SIGNALS]
+    tst     r2, #CPU_SIGNAL_TLB_FLUSH
+    beq     hw_lock_lock_loop
+    stmfd   sp!, {r0,r7,r12,lr}
+    add     r7, sp, #4
+    blx     _handle_pending_TLB_flushes
+    ldmfd   sp!, {r0,r7,r12,lr}
+    b       hw_lock_lock_loop
 
 
 /**
@@ -82,6 +96,7 @@ _panicString:
  */
 EnterARM(lck_spin_unlock)
 EnterARM(hw_lock_unlock)
+    dmb     sy
     ldr     r3, [r0]
     bic     r3, r3, #1
     str     r3, [r0]
@@ -95,12 +110,19 @@ EnterARM(lck_spin_try_lock)
 EnterARM(hw_lock_try)
     mrs     r1, cpsr
     cpsid   if
-    ldr     r3, [r0]
-    mov     r2, #1
-    orr     r12, r3, #1
-    ands    r2, r2, r3
-    streq   r12, [r0]
+hw_lock_try_loop:
+    ldrex   r3, [r0]
+    tst     r3, #1
     bne     hw_lock_try_fail
+    orr     r3, r3, #1
+#ifndef BOARD_CONFIG_OMAP3530
+    strex   r2, r3, [r0]
+    movs    r2, r2
+    bne     hw_lock_try_loop
+#else
+    str     r3, [r0]
+#endif
+    dmb     sy
     LoadLockHardwareRegister(r12)
     IncrementPreemptLevel(r12, r2)
     mov     r0, #1
@@ -113,34 +135,59 @@ hw_lock_try_return:
 
 /**
  * hw_lock_to
+ *
+ * Like hw_lock_lock, but give up after the given number of attempts.
  */
 EnterARM(hw_lock_to)
     LoadLockHardwareRegister(r12)
     IncrementPreemptLevel(r12, r2)
-    ldr     r3, [r0]
-    mov     r2, #1
-    orr     r1, r3, #1
-    ands    r2, r2, r3
-    streq   r1, [r0]
-    eors    r0, r2, #1
-    beq     hw_lock_to_enable_preempt
+hw_lock_to_loop:
+    ldrex   r3, [r0]
+    tst     r3, #1
+    bne     hw_lock_to_spin
+    orr     r3, r3, #1
+#ifndef BOARD_CONFIG_OMAP3530
+    strex   r2, r3, [r0]
+    movs    r2, r2
+    bne     hw_lock_to_loop
+#else
+    str     r3, [r0]
+#endif
+    dmb     sy
+    mov     r0, #1
     bx      lr
+hw_lock_to_spin:
+    subs    r1, r1, #1
+    beq     hw_lock_to_enable_preempt
+    ldr     r2, [r12, MACHINE_THREAD_CPU_DATA]
+    ldr     r2, [r2, CPU_SIGNALS]
+    tst     r2, #CPU_SIGNAL_TLB_FLUSH
+    beq     hw_lock_to_loop
+    stmfd   sp!, {r0,r1,r12,lr}
+    blx     _handle_pending_TLB_flushes
+    ldmfd   sp!, {r0,r1,r12,lr}
+    b       hw_lock_to_loop
 hw_lock_to_enable_preempt:
     stmfd   sp!, {r0,r1,r7,lr}
     add     r7, sp, #8
     blx     __enable_preemption
     ldmfd   sp!, {r0,r1,r7,lr}
+    mov     r0, #0
     bx      lr
 
 /**
  * lock_read and friends
+ *
+ * Nobody wanting the lock exclusively means we just bump the reader
+ * count. Readers also join an existing shared hold without the interlock
+ * unless the lock gives writers priority.
  */
 EnterARM(lock_read)
 EnterARM(lck_rw_lock_shared)
 #ifdef NO_EXCLUSIVES
-    mrs         r9, cpsr
-    orr         r3, r9, #0xc0
-    msr         cpsr_cf, r3
+    mrs     r12, cpsr
+    orr     r3, r12, #0xc0
+    msr     cpsr_cf, r3
 #endif
     mov     r3, #0xD
 rwlsloop:
@@ -149,25 +196,27 @@ rwlsloop:
     bne     rwlsopt
 rwlsloopres:
     add     r1, r1, #0x10000
-#ifndef BOARD_CONFIG_OMAP3530
+#ifndef NO_EXCLUSIVES
     strex   r2, r1, [r0]
     movs    r2, r2
-    bxeq    lr
-    b       rwlsloop
+    bne     rwlsloop
+    dmb     sy
 #else
     str     r1, [r0]
-    bx      lr
+    msr     cpsr_cf, r12
 #endif
-    str     r1, [r0]
     bx      lr
 rwlsopt:
-    mov     r2, #0x8001
-    ands    r2, r1, r2
-    LoadConstantToReg(_lck_rw_lock_shared_gen + 1, r12)
-    bx      r12
+    tst     r1, #1
+    bne     rwlsslow
+    tst     r1, #0x8000
+    bne     rwlsslow
     movs    r2, r1, lsr#16
     bne     rwlsloopres
-rwlsloolow:
+rwlsslow:
+#ifdef NO_EXCLUSIVES
+    msr     cpsr_cf, r12
+#endif
     LoadConstantToReg(_lck_rw_lock_shared_gen + 1, r12)
     bx      r12
 
@@ -190,25 +239,34 @@ rwleloop:
 #ifndef NO_EXCLUSIVES
     strex       r2, r1, [r0]
     movs        r2, r2
-    bxeq        lr
-    b           rwleloop
+    bne         rwleloop
+    dmb         sy
+    bx          lr
 #else
     str         r1, [r0]
     msr         cpsr_cf, r12
     bx          lr
 #endif
 rwleslow:
+#ifdef NO_EXCLUSIVES
+    msr         cpsr_cf, r12
+#endif
     LoadConstantToReg(_lck_rw_lock_exclusive_gen + 1, r12)
     bx          r12
 
 /**
  * lock_done and friends
+ *
+ * The interlock is only ever held briefly by the slow paths on another
+ * processor, wait for it to go away.
  */
 EnterARM(lock_done)
 EnterARM(lck_rw_done)
+    dmb         sy
+rwldloop:
     ldrex       r1, [r0]
-    ands        r2, r1, #1
-    bne         rwldpanic
+    tst         r1, #1
+    bne         rwldloop
     LoadConstantToReg(0xFFFF0000, r3)
     ands        r2, r1, r3
     beq         rwldexcl
@@ -234,7 +292,7 @@ rwldstore:
 #ifndef BOARD_CONFIG_OMAP3530
     strex       r2, r1, [r0]
     movs        r2, r2
-    bne         _lock_done
+    bne         rwldloop
 #else
     str         r1, [r0]
 #endif
@@ -242,30 +300,25 @@ rwldstore:
     moveq       r0, r3
     bxeq        lr
     stmfd       sp!,{r0,r3,r7,lr}
+    add         r7, sp, #8
     add         r0, r0, #8
     blx         _thread_wakeup
     ldmfd       sp!,{r0,r3,r7,lr}
     mov         r0, r3
     bx          lr
-rwldpanic:
-    mov         r2, r1
-    mov         r1, r0
-    adr         r0, lckPanicString
-    blx         _panic
-lckPanicString:
-    .asciz "lck_rw_done(): lock (0x%08x: 0x%08x)"
 
 /**
  * lock_read_to_write and friends
  */
 EnterARM(lock_read_to_write)
 EnterARM(lck_rw_lock_shared_to_exclusive)
+rwlseloop:
     ldrex       r1, [r0]
     LoadConstantToReg(0xFFFF0000, r3)
     ands        r2, r1, r3
     beq         rwlsepanic
     bic         r1, r1, r3
-    LoadConstantToReg(_lck_rw_lock_shared_gen + 1, r12)
+    LoadConstantToReg(_lck_rw_lock_shared_to_exclusive_gen + 1, r12)
     subs        r2, r2, #0x10000
     bxne        r12
     ands        r3, r1, #5
@@ -274,14 +327,15 @@ EnterARM(lck_rw_lock_shared_to_exclusive)
 #ifndef BOARD_CONFIG_OMAP3530
     strex       r2, r1, [r0]
     movs        r2, r2
-    bne         _lock_read_to_write
+    bne         rwlseloop
+    dmb         sy
 #else
     str         r1, [r0]
 #endif
     mov         r0, #1
     bx          lr
 rwlsepanic:
-    mov         r1, r2
+    mov         r2, r1
     mov         r1, r0
     adr         r0, lckReadToWritePanicString
     blx         _panic
@@ -297,10 +351,13 @@ EnterARM(lock_write_to_read)
     mrs         r12, cpsr
     orr         r2, r12, #0xc0
     msr         cpsr_cf, r2
+#else
+    dmb         sy
 #endif
+rwlstloop:
     ldrex       r1, [r0]
-    ands        r2, r1, #1
-    bne         rwlstexit
+    tst         r1, #1
+    bne         rwlstloop
     and         r2, r1, #2
     ands        r3, r1, #4
     mov         r3, #6
@@ -310,7 +367,7 @@ EnterARM(lock_write_to_read)
 #ifndef BOARD_CONFIG_OMAP3530
     strex       r3, r1, [r0]
     movs        r3, r3
-    bne         _lock_write_to_read
+    bne         rwlstloop
 #else
     str         r1, [r0]
     msr         cpsr_cf, r12
@@ -319,86 +376,57 @@ EnterARM(lock_write_to_read)
     bxeq        lr
     add         r0, r0, #8
     LoadConstantToReg(_thread_wakeup+1, pc)
-rwlstexit:
-    mov         r2, r1
-    mov         r1, r0
-    adr         r0, rwlstePanicString
-    blx         _panic
-rwlstePanicString:
-    .asciz "lck_rw_lock_exclusive_to_shared(): lock (0x%08x 0x%08x)"
 
 
 /**
  * lck_mtx_unlock
+ *
+ * Only an uncontended mutex owned by us is released here, waiters, a held
+ * interlock or an indirect mutex go through lck_mtx_unlock_gen.
  */
 EnterARM(lck_mtx_unlock)
+    LoadLockHardwareRegister(r12)
 #ifdef NO_EXCLUSIVES
-    mrs     r9, cpsr
-    orr     r2, r9, #0xc0
+    mrs     r3, cpsr
+    orr     r2, r3, #0xc0
     msr     cpsr_cf, r2
+#else
+    dmb     sy
 #endif
     mov     r2, #0
-    LoadLockHardwareRegister(r12)
 mluloop:
     ldrex       r1, [r0]
-    ands        r3, r1, #3
-    bne         lmuslow
-    bic         r3, r1, #3
-    cmp         r3, r12
-    bne         lmupanic
+    cmp         r1, r12
+    bne         mluslow
 #ifndef NO_EXCLUSIVES
     strex       r1, r2, [r0]
     movs        r1, r1
-    bxeq        lr
+    bne         mluloop
 #else
     str         r2, [r0] 
-    msr         cpsr_cf, r9
-    bx          lr
+    msr         cpsr_cf, r3
 #endif
-    
-    b           mluloop
-lmuslow:
+    bx          lr
+mluslow:
 #ifdef NO_EXCLUSIVES
-    msr         cpsr_cf, r9
+    msr         cpsr_cf, r3
 #endif
-    stmfd       sp!,{r0,r1,r7,lr}
-    add         r7, sp, #8
-    LoadLockHardwareRegister(r12)
-    IncrementPreemptLevel(r12, r2)
-    ldr         r1, [r0]
-    ands        r3, r1, #1
-    bne         lmupanic
-    orr         r3, r1, #1
-    str         r3, [r0]
-    bics        r1, r1, #3
-    ands        r2, r3, #2
-    beq         lmupanic
-    blx         _lck_mtx_unlock_wakeup
-    ldmfd       sp!,{r0,r1,r7,lr}
-    ldr         r1, [r0]
-    and         r3, r1, #2
-    str         r3, [r0]
-lmuret:
-    LoadConstantToReg(__enable_preemption, pc)
-lmupanic:
-    mov         r1, r0
-    ldr         r2, [r1]
-    adr         r0, lmuPanicString
-    blx         _panic
-lmuPanicString:
-    .asciz      "lck_mtx_unlock(): mutex (0x%08x, 0x%08x)"
+    LoadConstantToReg(_lck_mtx_unlock_gen + 1, r12)
+    bx          r12
 
 /**
  * lck_mtx_lock
+ *
+ * Take a free mutex in place, anything else is lck_mtx_lock_gen's problem.
  */
 EnterARM(lck_mtx_lock)
     LoadLockHardwareRegister(r12)
-mlckretry:
 #ifdef NO_EXCLUSIVES
     mrs     r2, cpsr
     orr     r3, r2, #0xc0
     msr     cpsr_cf, r3
 #endif
+mlckretry:
     ldrex   r3, [r0]
     movs    r3, r3
     bne     mlckslow
@@ -406,6 +434,7 @@ mlckretry:
     strex   r1, r12, [r0]
     movs    r1, r1
     bne     mlckretry
+    dmb     sy
 #else
     str     r12, [r0]
     msr     cpsr_cf, r2
@@ -415,39 +444,8 @@ mlckslow:
 #ifdef NO_EXCLUSIVES
     msr     cpsr_cf, r2
 #endif
-    stmfd   sp!,{r0,r1,r7,lr}
-    add     r7, sp, #8
-    LoadLockHardwareRegister(r12)
-    IncrementPreemptLevel(r12, r2)
-    ldr     r3, [r0]
-    ands    r2, r3, #1
-    bne     mlckpanic
-    bics    r1, r3, #2
-    bne     mlckwait
-    orr     r3, r3, #1
-    str     r3, [r0]
-    blx     _lck_mtx_lock_acquire
-    ands    r0, r0, r0
-    ldmfd   sp!,{r0,r1,r7,lr}
-    LoadLockHardwareRegister(r12)
-    mov     r3, r12
-    orrne   r3, r3, #2
-    str     r3, [r0]
-    ldr     pc, __enable_preemption
-mlckwait:
-    orr     r3, r3, #0
-    str     r3, [r0]
-    blx     _lck_mtx_lock_wait
-    ldmfd   sp!,{r0,r1,r7,lr}
-    LoadLockHardwareRegister(r12)
-    b       mlckretry
-mlckpanic:
-    mov     r1, r0
-    ldr     r2, [r1]
-    adr     r0, mlckpanicString
-    blx     _panic
-mlckpanicString:
-    .asciz  "lck_mtx_lock(): mutex (0x%08x, 0x%08x)"
+    LoadConstantToReg(_lck_mtx_lock_gen + 1, r12)
+    bx      r12
 
 /**
  * lck_mtx_try_lock
@@ -467,6 +465,7 @@ lmtstart:
     strex       r1, r12, [r0]
     movs        r1, r1
     bne         lmtstart
+    dmb         sy
 #else
     str         r12, [r0]
     msr         cpsr_cf, r2
@@ -477,45 +476,18 @@ lmtslow:
 #ifdef NO_EXCLUSIVES
     msr         cpsr_cf, r2
 #endif
-    mov         r1, #0
-    stmfd       sp!, {r0,r1,r7,lr}
-    add         r7, sp, #8
-    IncrementPreemptLevel(r12, r2)
-    ldr         r3, [r0]
-    ands        r2, r3, #1
-    bne         lmtpanic
-    bics        r2, r3, #2
-    bne         lmtret
-    orr         r3, r3, #1
-    str         r3, [r0]
-    blx         _lck_mtx_lock_acquire
-    ands        r0, r0, r0
-    ldmfd       sp!,{r0,r1,r7,lr}
-    LoadLockHardwareRegister(r12)
-    mov         r3, r12
-    orrne       r3, r3, #2
-    str         r3, [r0]
-    mov         r1, #1
-    stmfd       sp!,{r0,r1,r7,lr}
-    add         r7, sp, #8
-lmtret:
-    bl          __enable_preemption
-    ldmfd       sp!,{r0,r1,r7,lr}
-    mov         r0, r1
-    bx          lr
-lmtpanic:
-    mov         r1, r0
-    ldr         r2, [r1]
-    adr         r0, lmtPanicString
-    blx         _panic
-lmtPanicString:
-    .asciz "lck_mtx_try_lock(): mutex (0x%08x, 0x%08x)"
+    LoadConstantToReg(_lck_mtx_try_lock_gen + 1, r12)
+    bx          r12
 
 /**
  * lck_mtx_assert
  */
 EnterARM(lck_mtx_assert)
     ldr     r12, [r0]
+    LoadConstantToReg(MUTEX_IND, r3)
+    cmp     r12, r3
+    ldreq   r12, [r0, MUTEX_PTR]
+    ldreq   r12, [r12]
     bics    r3, r12, #3
     cmp     r1, #1
     bne     lck_mtx_assert_owned
@@ -553,13 +525,14 @@ panicString_lockBadArgument:
  */
 EnterARM(lck_rw_try_lock_shared)
 #ifdef NO_EXCLUSIVES
-    mrs     r9, cpsr
-    orr     r1, r9, #0xc0
+    mrs     r12, cpsr
+    orr     r1, r12, #0xc0
     msr     cpsr_cf, r1
 #endif
+rwtlsloop:
     ldrex   r1, [r0]
-    ands    r2, r1, #1
-    bne     rwtlspanic
+    tst     r1, #1
+    bne     rwtlsloop
     ands    r2, r1, #0xC
     bne     rwtlsopt
 rwtlsloopres:
@@ -567,10 +540,11 @@ rwtlsloopres:
 #ifndef NO_EXCLUSIVES
     strex   r2, r1, [r0]
     movs    r2, r2
-    bne     _lck_rw_try_lock_shared
+    bne     rwtlsloop
+    dmb     sy
 #else
     str     r1, [r0]
-    msr     cpsr_cf, r9
+    msr     cpsr_cf, r12
 #endif
     mov     r0, #1
     bx      lr
@@ -581,50 +555,44 @@ rwtlsopt:
     ands    r2, r1, r3
     bne     rwtlsloopres
 rwtlsfail:
+#ifdef NO_EXCLUSIVES
+    msr     cpsr_cf, r12
+#endif
     mov     r0, #0
     bx      lr
-rwtlspanic:
-    mov     r2, r1
-    mov     r1, r0
-    adr     r0, rwtlsPanicString
-    blx     _panic
-rwtlsPanicString:
-    .asciz  "lck_rw_try_lock_shared: lock (0x%08x, 0x%08x)"
 
 /**
  * lck_rw_try_lock_exclusive
  */
 EnterARM(lck_rw_try_lock_exclusive)
 #ifdef NO_EXCLUSIVES
-    mrs     r9, cpsr
-    orr     r1, r9, #0xc0
+    mrs     r12, cpsr
+    orr     r1, r12, #0xc0
     msr     cpsr_cf, r1
 #endif
+    LoadConstantToReg(0xFFFF000C, r3)
+rwtleloop:
     ldrex   r1, [r0]
-    ands    r2, r1, #1
-    bne     rwtlepanic
-    LoadConstantToReg(0xFFFF0009, r3)
+    tst     r1, #1
+    bne     rwtleloop
     ands    r2, r1, r3
     bne     rwtlefail
     orr     r1, r1, #8
 #ifndef NO_EXCLUSIVES
     strex   r2, r1, [r0]
     movs    r2, r2
-    bne     _lck_rw_try_lock_exclusive
+    bne     rwtleloop
+    dmb     sy
 #else
     str     r1, [r0]
-    msr     cpsr_cf, r9
+    msr     cpsr_cf, r12
 #endif
     mov     r0, #1
     bx      lr
 rwtlefail:
+#ifdef NO_EXCLUSIVES
+    msr     cpsr_cf, r12
+#endif
     mov     r0, #0
     bx      lr
-rwtlepanic:
-    mov     r2, r1
-    mov     r1, r0
-    adr     r0, rwtlePanicString
-    blx     _panic
-rwtlePanicString:
-    .asciz  "lck_rw_try_lock_exclusive: lock (0x%08x, 0x%08x)"
     
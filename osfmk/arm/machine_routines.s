@@ -42,6 +42,7 @@
  * lck_mtx_ilk_unlock
  */
 EnterARM(lck_mtx_ilk_unlock)
+    dmb     sy
     ldr     r2, [r0]
     bic     r3, r2, #1
     str     r3, [r0]
@@ -199,6 +200,24 @@ EnterARM(set_mmu_ttbcr)
     mcr     p15, 0, r0, c2, c0, 2
     bx      lr
 
+/**
+ * set_mmu_ttb_asid
+ *
+ * Load a new TTBR0 and ASID. The reserved ASID 0 is current while TTBR0
+ * changes so that no walk of the new table is tagged with the old ASID.
+ */
+EnterARM(set_mmu_ttb_asid)
+    mov     r2, #0
+    mcr     p15, 0, r2, c13, c0, 1
+    isb     sy
+    orr     r0, r0, #0x18
+    mcr     p15, 0, r0, c2, c0, 0
+    isb     sy
+    and     r1, r1, #0xff
+    mcr     p15, 0, r1, c13, c0, 1
+    isb     sy
+    bx      lr
+
 /**
  * flush_mmu_single
  *
@@ -214,6 +233,63 @@ EnterARM(set_mmu_ttbcr)
     isb     sy
     bx      lr
 
+/**
+ * flush_mmu_range
+ *
+ * Flush every MVA in [start, end) tagged with the given ASID from the TLB,
+ * with a single barrier at the end instead of one per page. Global
+ * entries match any ASID.
+ */
+EnterARM(flush_mmu_range)
+    mov     r0, r0, lsr #12
+    mov     r0, r0, lsl #12
+    and     r2, r2, #0xff
+    orr     r0, r0, r2
+    cmp     r0, r1
+    bhs     1f
+0:
+    mcr     p15, 0, r0, c8, c7, 1
+    add     r0, r0, #0x1000
+    cmp     r0, r1
+    blo     0b
+1:
+    dsb     sy
+    isb     sy
+    bx      lr
+
+/**
+ * flush_mmu_range_all_asid
+ *
+ * Flush every MVA in [start, end) from the TLB whatever its ASID
+ * (TLBIMVAA). Needs the multiprocessing extensions.
+ */
+EnterARM(flush_mmu_range_all_asid)
+    mov     r0, r0, lsr #12
+    mov     r0, r0, lsl #12
+    cmp     r0, r1
+    bhs     1f
+0:
+    mcr     p15, 0, r0, c8, c7, 3
+    add     r0, r0, #0x1000
+    cmp     r0, r1
+    blo     0b
+1:
+    dsb     sy
+    isb     sy
+    bx      lr
+
+/**
+ * flush_mmu_asid
+ *
+ * Flush every non-global TLB entry tagged with the given ASID.
+ */
+EnterARM(flush_mmu_asid)
+    and     r0, r0, #0xff
+    mcr     p15, 0, r0, c8, c7, 2
+    dsb     sy
+    isb     sy
+    bx      lr
+
 /*
  * Things I put here because I am far too lazy to write them in C.
  */
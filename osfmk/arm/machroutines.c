@@ -74,6 +74,7 @@
 #include <arm/trap.h>
 #include <mach/vm_param.h>
 #include <arm/pmap.h>
+#include <arm/mp.h>
 
 #include <pexpert/arm/boot.h>
 
@@ -219,17 +220,32 @@ void ml_init_lock_timeout(void)
 /**
  * ml_get_max_cpus
  *
- * Since this is a uniprocessor system, we return 0.
+ * Return the maximum number of processors set by ml_init_max_cpus.
  */
 int ml_get_max_cpus(void)
 {
-    return 0;
+    return machine_info.max_cpus;
 }
 
-
+/**
+ * ml_init_max_cpus
+ *
+ * Set the maximum number of processors, capped by the "cpus" boot-arg.
+ */
 void ml_init_max_cpus(unsigned long max_cpus)
 {
-    return;
+    unsigned int cpus;
+
+    if (PE_parse_boot_argn("cpus", &cpus, sizeof(cpus)) && cpus > 0 && cpus < max_cpus)
+        max_cpus = cpus;
+
+    if (max_cpus > MAX_CPUS)
+        max_cpus = MAX_CPUS;
+
+    max_ncpus = (unsigned int) max_cpus;
+    machine_info.max_cpus = (integer_t) max_cpus;
+    machine_info.physical_cpu_max = (integer_t) max_cpus;
+    machine_info.logical_cpu_max = (integer_t) max_cpus;
 }
 
 void ml_install_interrupt_handler(void *nub, int source, void *target, IOInterruptHandler handler, void *refCon)
@@ -247,15 +263,31 @@ void ml_install_interrupt_handler(void *nub, int source, void *target, IOInterru
  * ml_processor_register
  *
  * Register a processor with the system and add it to the master list.
- */
-/*
- * initialize and bring up the CPU.
+ * The cpu_id is the processor's MPCore number. Inter-processor interrupts
+ * go through the platform expert, so there is no IPI handler to hand out.
  */
 kern_return_t ml_processor_register(
     cpu_id_t cpu_id,
     processor_t *processor_out,
 	ipi_handler_t* ipi_handler)
 {
+    cpu_data_t* cdp;
+    int cpu = (int) cpu_id;
+
+    if (cpu < 0 || cpu >= (int) max_ncpus)
+        return KERN_FAILURE;
+
+    cdp = cpu_datap(cpu);
+    if (cdp == NULL) {
+        cdp = cpu_data_alloc(cpu);
+        processor_init(cdp->cpu_processor, cpu, processor_pset(master_processor));
+    }
+
+    cdp->cpu_id = cpu_id;
+
+    *processor_out = cdp->cpu_processor;
+    *ipi_handler = NULL;
+
     return KERN_SUCCESS;
 }
 
@@ -34,6 +34,10 @@
 // If the buffers are not word aligned, or they are shorter than four bytes,
 // we just use a simple byte comparison loop instead.
 //
+// Long buffers are first compared 64 bytes at a time with NEON, when the
+// kernel may use it (see vfp_kernel_enter). The first block that differs
+// is handed to the integer code to find the differing byte.
+//
 // int   bcmp(void *src1, void *src2, size_t length);
 // int memcmp(void *src1, void *src2, size_t length);
 
@@ -55,6 +59,8 @@
 
 #include <arm/arch.h>
 
+#define NEON_CMP_MIN    256
+
 #if defined _ARM_ARCH_6
 	#define BYTE_REVERSE(reg,tmp) \
     rev     reg, reg
@@ -73,8 +79,13 @@
 .align 2
 _bcmp:
 _memcmp:
-    // If both buffers are not word aligned, jump to a byte-comparison loop.
 	ESTABLISH_FRAME
+#if defined _ARM_ARCH_7
+	cmp     r2,         #NEON_CMP_MIN
+	bhs     L_neon
+L_integer:
+#endif
+    // If both buffers are not word aligned, jump to a byte-comparison loop.
 	orr     ip,     r0, r1
 	tst     ip,         #3
 	bne     L_useByteComparisons
@@ -115,3 +126,49 @@ L_useByteComparisons:
 L_buffersAreEqual:
     mov     r0,         #0
 	CLEAR_FRAME_AND_RETURN
+
+#if defined _ARM_ARCH_7
+L_neon:
+    // Only outside of interrupt context, and only if NEON is usable at all.
+	ldr     r3,     L_arm_neon_enabled
+	ldr     r3,    [r3]
+	cmp     r3,         #0
+	beq     L_integer
+	mrs     r3,     cpsr
+	tst     r3,         #0x80
+	bne     L_integer
+	push   {r0-r2,r4}
+	bl      _vfp_kernel_enter
+	pop    {r0-r2,r4}
+
+0:  subs    r2,         #64
+	blo     1f
+	vld1.8 {d0-d3},    [r0]!
+	vld1.8 {d4-d7},    [r0]!
+	vld1.8 {d8-d11},   [r1]!
+	vld1.8 {d12-d15},  [r1]!
+	veor    q0,     q0, q4
+	veor    q1,     q1, q5
+	veor    q2,     q2, q6
+	veor    q3,     q3, q7
+	vorr    q0,     q0, q1
+	vorr    q2,     q2, q3
+	vorr    q0,     q0, q2
+	vorr    d0,     d0, d1
+	vmov    r3, ip,     d0
+	orrs    r3,     ip
+	beq     0b
+
+    // This block differs, back up to its start.
+	sub     r0,         #64
+	sub     r1,         #64
+1:  adds    r2,         #64
+	push   {r0-r2,r4}
+	bl      _vfp_kernel_exit
+	pop    {r0-r2,r4}
+	b       L_integer
+
+.align 2
+L_arm_neon_enabled:
+	.long   _arm_neon_enabled
+#endif
@@ -72,6 +72,8 @@
 
 #include <pexpert/pexpert.h>
 #include <pexpert/arm/boot.h>
+#include <pexpert/arm/protos.h>
+#include <arm/machine_routines.h>
 
 #include <vm/pmap.h>
 #include <vm/vm_map.h>
@@ -551,6 +553,7 @@ out:
 static void machine_conf(void)
 {
 	machine_info.memory_size = (typeof(machine_info.memory_size))mem_size;
+	ml_init_max_cpus(pe_arm_get_cpu_count());
 }
 
 /**
@@ -27,12 +27,30 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /*
- * AST support for ARM
+ * Multiprocessor and AST support for ARM
  */
 
 #include <mach/mach_types.h>
 #include <kern/debug.h>
 #include <kern/processor.h>
+#include <kern/machine.h>
+#include <kern/cpu_number.h>
+#include <kern/misc_protos.h>
+#include <kern/ast.h>
+#include <arm/mp.h>
+#include <arm/cpu_data.h>
+#include <arm/machine_cpu.h>
+#include <arm/machine_routines.h>
+#include <arm/pmap.h>
+#include <pexpert/arm/protos.h>
+
+extern void rtclock_intr(arm_saved_state_t* regs);
+extern kern_return_t processor_start(processor_t processor);
+
+/*
+ * How long a TLB shootdown may go unanswered, in spins.
+ */
+#define MP_TLB_SHOOTDOWN_SPINS  10000000
 
 void
 init_ast_check(processor_t processor)
@@ -40,8 +58,223 @@ init_ast_check(processor_t processor)
 
 }
 
+/**
+ * cpu_signal
+ *
+ * Post an event to another running processor and interrupt it.
+ */
+void
+cpu_signal(int cpu, int event)
+{
+    cpu_data_t* cdp = cpu_datap(cpu);
+
+    if (cdp == NULL || !cdp->cpu_running)
+        return;
+
+    hw_atomic_or_noret((volatile uint32_t *) &cdp->cpu_signals, 1 << event);
+    pe_arm_signal_cpu(cpu);
+}
+
+/**
+ * cpu_signal_test_and_clear
+ *
+ * Consume an event. It is cleared before it is acted upon, so one posted
+ * meanwhile gets its own interrupt.
+ */
+static boolean_t
+cpu_signal_test_and_clear(cpu_data_t* cdp, int event)
+{
+    if (!(cdp->cpu_signals & (1 << event)))
+        return FALSE;
+
+    hw_atomic_and_noret((volatile uint32_t *) &cdp->cpu_signals, ~(1 << event));
+    return TRUE;
+}
+
+/**
+ * cpu_signal_handler
+ *
+ * Handle the events posted to this processor, called from the platform
+ * interrupt handler for the inter-processor interrupt.
+ */
+int
+cpu_signal_handler(arm_saved_state_t* regs)
+{
+    cpu_data_t* cdp = current_cpu_datap();
+
+    cdp->cpu_prior_signals = cdp->cpu_signals;
+
+    handle_pending_TLB_flushes();
+
+    if (cpu_signal_test_and_clear(cdp, MP_CLOCK))
+        rtclock_intr(regs);
+
+    if (cpu_signal_test_and_clear(cdp, MP_AST))
+        ast_check(cdp->cpu_processor);
+
+    return 0;
+}
+
 void
 cause_ast_check(processor_t processor)
 {
+    int cpu = processor->cpu_id;
+
+    if (cpu != cpu_number())
+        cpu_signal(cpu, MP_AST);
+}
+
+/**
+ * machine_signal_idle
+ *
+ * Wake an idle processor up so that it looks at its run queues.
+ */
+void
+machine_signal_idle(processor_t processor)
+{
+    cause_ast_check(processor);
+}
+
+/**
+ * handle_pending_TLB_flushes
+ *
+ * Carry out the shootdowns other processors have posted for us, each by
+ * range or ASID as the request says. Our bit in a request is only
+ * cleared once the flush is done, the requester waits for that. Nothing
+ * here takes a lock, lock spins call it.
+ */
+void
+handle_pending_TLB_flushes(void)
+{
+    cpu_data_t* cdp = current_cpu_datap();
+    uint32_t me = 1 << cdp->cpu_number;
+    cpu_tlb_request_t* req;
+    unsigned int cpu;
+
+    if (!cpu_signal_test_and_clear(cdp, MP_TLB_FLUSH))
+        return;
+
+    for (cpu = 0; cpu < max_ncpus; cpu++) {
+        if (cpu_data_ptr[cpu] == NULL)
+            continue;
+        req = &cpu_data_ptr[cpu]->cpu_tlb_request;
+        if (!(req->pending & me))
+            continue;
+
+        __asm__ volatile("dmb" ::: "memory");
+        pmap_flush_tlb_request(req);
+        hw_atomic_and_noret(&req->pending, ~me);
+    }
+}
+
+/**
+ * mp_tlb_shootdown
+ *
+ * Have the given running processors carry out the request the caller
+ * filled in our cpu_tlb_request, and wait until they have. This is called
+ * with interrupts disabled and possibly pmap locks held, so requests
+ * aimed at us are serviced while we wait; lock spins do the same.
+ */
+void
+mp_tlb_shootdown(uint32_t cpus)
+{
+    cpu_tlb_request_t* req = &current_cpu_datap()->cpu_tlb_request;
+    int         my_cpu = cpu_number();
+    uint32_t    pending = 0;
+    int         cpu;
+    int         spins;
+
+    for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cpu_data_t* cdp;
+
+        if (cpu == my_cpu || !(cpus & (1 << cpu)))
+            continue;
+
+        cdp = cpu_datap(cpu);
+        if (cdp == NULL || !cdp->cpu_running)
+            continue;
+
+        pending |= (1 << cpu);
+    }
+
+    if (pending == 0)
+        return;
+
+    /* The request must be complete before anyone sees its bit */
+    __asm__ volatile("dmb" ::: "memory");
+    req->pending = pending;
+
+    for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (pending & (1 << cpu)) {
+            hw_atomic_or_noret((volatile uint32_t *) &cpu_datap(cpu)->cpu_signals, 1 << MP_TLB_FLUSH);
+            pe_arm_signal_cpu(cpu);
+        }
+    }
+
+    for (spins = 0; req->pending != 0; spins++) {
+        if (spins > MP_TLB_SHOOTDOWN_SPINS)
+            panic("mp_tlb_shootdown: cpus 0x%x did not flush\n", req->pending);
+
+        handle_pending_TLB_flushes();
+        cpu_pause();
+    }
+}
+
+/**
+ * mp_broadcast_clock
+ *
+ * Only the boot processor takes the timebase interrupt. Pass the pop on
+ * to the others whose own pop is due by then, so that their timer queues
+ * and quanta are serviced; idle processors with nothing due stay asleep.
+ */
+void
+mp_broadcast_clock(uint64_t due)
+{
+    int my_cpu = cpu_number();
+    unsigned int cpu;
+    cpu_data_t *cdp;
+
+    for (cpu = 0; cpu < max_ncpus; cpu++) {
+        cdp = cpu_data_ptr[cpu];
+        if (cpu == my_cpu || cdp == NULL || !cdp->cpu_running)
+            continue;
+        if (cdp->rtcPop <= due)
+            cpu_signal(cpu, MP_CLOCK);
+    }
+}
+
+/**
+ * slave_machine_init
+ *
+ * First code run by a started processor in thread context.
+ */
+void
+slave_machine_init(__unused void* param)
+{
+    cpu_machine_init();
+}
+
+/**
+ * mp_cpus_start
+ *
+ * Register and start every processor the platform reports beyond the
+ * boot processor.
+ */
+void
+mp_cpus_start(void)
+{
+    processor_t     processor;
+    ipi_handler_t   ipi_handler;
+    unsigned int    cpu;
+
+    for (cpu = 0; cpu < max_ncpus; cpu++) {
+        if (cpu == (unsigned int) master_cpu)
+            continue;
+
+        if (ml_processor_register((cpu_id_t) cpu, &processor, &ipi_handler) != KERN_SUCCESS)
+            continue;
 
+        if (processor_start(processor) != KERN_SUCCESS)
+            kprintf("mp_cpus_start: cpu %d did not start\n", cpu);
+    }
 }
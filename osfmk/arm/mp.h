@@ -63,6 +63,13 @@
 
 #define MAX_CPUS	32		/* (8*sizeof(long)) */
 
+/*
+ * Inter-processor signals, these are bit numbers in cpu_signals.
+ */
+#define MP_AST		0	/* check for an AST */
+#define MP_TLB_FLUSH	1	/* flush the TLB */
+#define MP_CLOCK	2	/* clock tick from the boot processor */
+
 #ifndef	ASSEMBLER
 #include <stdint.h>
 #include <sys/cdefs.h>
@@ -93,6 +100,11 @@ extern  volatile uint32_t spinlock_owner_cpu;
 extern	uint64_t	LastDebuggerEntryAllowance;
 
 extern	boolean_t	mp_recent_debugger_activity(void);
+
+extern	void	cpu_signal(int cpu, int event);
+extern	void	mp_tlb_shootdown(uint32_t cpus);
+extern	void	mp_broadcast_clock(uint64_t due);
+extern	void	mp_cpus_start(void);
 #endif
 
 #endif
@@ -55,6 +55,7 @@
 #include <vm/vm_object.h>
 #include <vm/vm_page.h>
 #include <arm/cpu_capabilities.h>
+#include <arm/mp.h>
 
 //#ifndef DEBUG_PMAP
 #define kprintf(args...)
@@ -74,6 +75,18 @@ typedef enum {
     ATTR_WIRED  = 0x4,
 } attr_bits_t;
 
+/*
+ * Referenced and modified state of each managed page. The hardware keeps
+ * neither, so they are emulated: a user mapping stays invalid until the
+ * page is referenced and read-only until it is modified, and the fault
+ * on first access sets the bit. ATTR_WRITE in the pv entry of a mapping
+ * says whether the mapping itself may be written.
+ */
+#define PHYS_MODIFIED   VM_MEM_MODIFIED
+#define PHYS_REFERENCED VM_MEM_REFERENCED
+
+char    *pmap_phys_attributes;
+
 #define PV_ENTRY_NULL   ((pv_entry_t) 0)
 
 #define pa_index(pa)    (atop(pa - gPhysBase))
@@ -109,6 +122,76 @@ typedef struct pv_entry {
 } pv_entry, *pv_entry_t;
 
 pv_entry_t    pv_head_table;        /* array of entries, one per page */
+zone_t        pv_entry_zone;        /* zone of pv entries for aliased pages */
+
+/*
+ * pv list locks, hashed by page index. A pv list may be changed by anyone
+ * holding the pmap system lock for read and the pv lock of the page;
+ * holding the system lock for write excludes everyone else.
+ */
+#define PV_LOCK_COUNT   64
+decl_simple_lock_data(static, pv_lock_table[PV_LOCK_COUNT])
+
+#define LOCK_PVH(pai)   simple_lock(&pv_lock_table[(pai) & (PV_LOCK_COUNT - 1)])
+#define UNLOCK_PVH(pai) simple_unlock(&pv_lock_table[(pai) & (PV_LOCK_COUNT - 1)])
+
+/*
+ * Range operations touching more pages than this flush the entire TLB
+ * instead of invalidating each MVA.
+ */
+#define PMAP_TLB_FLUSH_THRESHOLD    64
+
+/*
+ * ASID allocation. ASIDs are handed out in generations: once they run
+ * out the generation is bumped, the TLB is flushed and every pmap picks
+ * up a fresh ASID the next time it is switched to. ASID 0 is reserved
+ * for the kernel pmap, whose mappings are all global.
+ */
+#define PMAP_ASID_MAX   256
+
+static uint32_t pmap_asid_next = 1;
+static uint32_t pmap_asid_generation = 1;
+uint32_t pmap_asid_rollovers = 0;
+decl_simple_lock_data(static, pmap_asid_lock)
+
+/*
+ * Processors with the multiprocessing extensions can invalidate an MVA
+ * under every ASID at once (TLBIMVAA), which nested pmaps need.
+ */
+static boolean_t pmap_tlb_flush_all_asid = FALSE;
+
+/*
+ * L2 tables that pmap_map_bd replaced with a section. Boot tables are
+ * carved out of the bootstrap page table area and can't be given back
+ * to the VM, so they are chained through their first word and reused
+ * to demote kernel sections.
+ */
+static uint32_t pmap_spare_l2 = 0;
+decl_simple_lock_data(static, pmap_spare_l2_lock)
+
+/*
+ * L1 slots of a user pmap that point at the L2 tables of a nested pmap.
+ * These belong to the nested pmap and are never walked through the
+ * grand pmap.
+ */
+#define pmap_l1_nested(pmap, va) \
+    (((va) < PMAP_USER_VA_LIMIT) && \
+     ((pmap)->pm_nested[((va) >> 20) >> 5] & (1U << (((va) >> 20) & 31))))
+#define pmap_l1_set_nested(pmap, va) \
+    ((pmap)->pm_nested[((va) >> 20) >> 5] |= (1U << (((va) >> 20) & 31)))
+#define pmap_l1_clear_nested(pmap, va) \
+    ((pmap)->pm_nested[((va) >> 20) >> 5] &= ~(1U << (((va) >> 20) & 31)))
+
+/*
+ * L2 table pages for demoting a section in pmap_remove and pmap_protect,
+ * which are called with VM map and object locks held and should rather
+ * not wait for a free page. Refilled by pmap_create, which may wait.
+ */
+#define PMAP_L2_RESERVE 4
+
+static vm_page_t pmap_l2_reserve[PMAP_L2_RESERVE];
+static int pmap_l2_reserve_count = 0;
+decl_simple_lock_data(static, pmap_l2_reserve_lock)
 
 boolean_t pmap_initialized = FALSE;
 
@@ -218,6 +301,8 @@ void pmap_bootstrap(__unused uint64_t msize,
      * Initialize kernel pmap.
      */
     pmap_common_init(kernel_pmap);
+    kernel_pmap->asid = 0;
+    kernel_pmap->asid_generation = 0;
     kernel_pmap->stats.resident_count = 0;
     kernel_pmap->stats.wired_count = 0;
     
@@ -231,6 +316,12 @@ void pmap_bootstrap(__unused uint64_t msize,
     first_avail += s;
     pv_head_table = (pv_entry_t)addr;
     bzero(pv_head_table, s);
+
+    s = round_page(mem_size / PAGE_SIZE);
+    addr = phys_to_virt(first_avail);
+    first_avail += s;
+    pmap_phys_attributes = (char*)addr;
+    bzero(pmap_phys_attributes, s);
     
     /*
      * now fill out the addresses
@@ -248,6 +339,18 @@ void pmap_bootstrap(__unused uint64_t msize,
     }
 
     lock_init(&pmap_system_lock, FALSE, 0, 0);
+    simple_lock_init(&pmap_asid_lock, 0);
+    simple_lock_init(&pmap_l2_reserve_lock, 0);
+    simple_lock_init(&pmap_spare_l2_lock, 0);
+
+    {
+        uint32_t mpidr;
+
+        __asm__ __volatile__("mrc p15, 0, %0, c0, c0, 5" : "=r"(mpidr));
+        pmap_tlb_flush_all_asid = ((mpidr & (1U << 31)) != 0);
+    }
+    for (page_number = 0; page_number < PV_LOCK_COUNT; page_number++)
+        simple_lock_init(&pv_lock_table[page_number], 0);
 
     return;
 }
@@ -264,10 +367,110 @@ void pmap_static_init(void)
     return;
 }
 
+/*
+ * Conversion of the attribute bits between small pages, large pages and
+ * sections. The output address is always zero.
+ */
+static uint32_t
+pmap_small_to_large(uint32_t pte)
+{
+    uint32_t lpte = L2_LARGE_PAGE;
+
+    lpte |= pte & (L2_B_BIT | L2_C_BIT | L2_AP_MASK | L2_APX_BIT | L2_S_BIT | L2_NG_BIT);
+    lpte |= ((pte & L2_TEX_MASK) >> 6) << L2_LARGE_TEX_SHIFT;
+    if (pte & L2_NX_BIT)
+        lpte |= L2_LARGE_NX_BIT;
+
+    return lpte;
+}
+
+static uint32_t
+pmap_large_to_small(uint32_t lpte)
+{
+    uint32_t pte = L2_SMALL_PAGE;
+
+    pte |= lpte & (L2_B_BIT | L2_C_BIT | L2_AP_MASK | L2_APX_BIT | L2_S_BIT | L2_NG_BIT);
+    pte |= ((lpte >> L2_LARGE_TEX_SHIFT) & 7) << 6;
+    if (lpte & L2_LARGE_NX_BIT)
+        pte |= L2_NX_BIT;
+
+    return pte;
+}
+
+static uint32_t
+pmap_small_to_section(uint32_t pte)
+{
+    uint32_t tte = L1_TYPE_SECT;
+
+    tte |= pte & (L2_B_BIT | L2_C_BIT);
+    tte |= ((pte & L2_AP_MASK) >> 4) << L1_SECT_AP_SHIFT;
+    tte |= ((pte & L2_TEX_MASK) >> 6) << L1_SECT_TEX_SHIFT;
+    if (pte & L2_NX_BIT)
+        tte |= L1_SECT_NX_BIT;
+    if (pte & L2_APX_BIT)
+        tte |= L1_SECT_APX_BIT;
+    if (pte & L2_S_BIT)
+        tte |= L1_SECT_S_BIT;
+    if (pte & L2_NG_BIT)
+        tte |= L1_SECT_NG_BIT;
+
+    return tte;
+}
+
+static uint32_t
+pmap_section_to_small(uint32_t tte)
+{
+    uint32_t pte = L2_SMALL_PAGE;
+
+    pte |= tte & (L2_B_BIT | L2_C_BIT);
+    pte |= ((tte >> L1_SECT_AP_SHIFT) & 3) << 4;
+    pte |= ((tte >> L1_SECT_TEX_SHIFT) & 7) << 6;
+    if (tte & L1_SECT_NX_BIT)
+        pte |= L2_NX_BIT;
+    if (tte & L1_SECT_APX_BIT)
+        pte |= L2_APX_BIT;
+    if (tte & L1_SECT_S_BIT)
+        pte |= L2_S_BIT;
+    if (tte & L1_SECT_NG_BIT)
+        pte |= L2_NG_BIT;
+
+    return pte;
+}
+
+/**
+ * pmap_spare_l2_put/pmap_spare_l2_get
+ *
+ * Keep an unused L2 table, at physical address l2_pa, for later. It
+ * must no longer be reachable through any L1 table or TLB entry.
+ */
+static void
+pmap_spare_l2_put(uint32_t l2_pa)
+{
+    simple_lock(&pmap_spare_l2_lock);
+    *(uint32_t*)phys_to_virt(l2_pa) = pmap_spare_l2;
+    pmap_spare_l2 = l2_pa;
+    simple_unlock(&pmap_spare_l2_lock);
+}
+
+static uint32_t
+pmap_spare_l2_get(void)
+{
+    uint32_t l2_pa;
+
+    simple_lock(&pmap_spare_l2_lock);
+    l2_pa = pmap_spare_l2;
+    if (l2_pa != 0)
+        pmap_spare_l2 = *(uint32_t*)phys_to_virt(l2_pa);
+    simple_unlock(&pmap_spare_l2_lock);
+
+    return l2_pa;
+}
+
 /**
  * pmap_map_bd
  *
- * Enters a physical mapping.
+ * Enters a physical mapping. Aligned runs are mapped with sections or
+ * large pages, the rest with small pages in the existing L2 tables.
  */
 boolean_t pmap_map_bd(vm_offset_t virt,
                       vm_map_offset_t start,
@@ -275,27 +478,63 @@ boolean_t pmap_map_bd(vm_offset_t virt,
                       vm_prot_t prot,
                       unsigned int flags)
 {
-    uint32_t* tte_ptr = (uint32_t*)addr_to_tte(kernel_pmap->ttb, virt);
-    uint32_t tte = *tte_ptr;
-    uint32_t pte;
+    uint32_t* tte_ptr;
+    uint32_t* pte_ptr;
+    uint32_t tte;
+    uint32_t template_pte = L2_SMALL_PAGE | L2_ACCESS_PRW;
+    int i;
 
-    if (!tte_is_page_table(tte)) {
-        /* Not cached */
-        return FALSE;
-    }
+    while (start < end) {
+        tte_ptr = (uint32_t*)addr_to_tte(kernel_pmap->ttb, virt);
+        tte = *tte_ptr;
 
-    pte = L1_PTE_ADDR(tte); /* l2 base */
-    pte += pte_offset(virt);
-    
-    /*
-     * This should always work when mapping into contigious
-     * cache ranges. If the range is not contigious, shit will
-     * happen.
-     */
-    
-    l2_map_linear_range_no_cache((pte),
-                        start,
-                        end);
+        /*
+         * A whole section goes straight into the L1 table, if nothing
+         * was entered in the boot L2 table behind it. That table is
+         * kept for demoting kernel sections.
+         */
+        if (!((virt | start) & (L1_SECT_SIZE - 1)) && (end - start) >= L1_SECT_SIZE) {
+            if (tte_is_page_table(tte)) {
+                pte_ptr = (uint32_t*)phys_to_virt(L1_PTE_ADDR(tte));
+                for (i = 0; i < L1_SECT_COUNT; i++) {
+                    if (pte_ptr[i] != 0)
+                        break;
+                }
+            } else {
+                i = L1_SECT_COUNT;
+            }
+            if (i == L1_SECT_COUNT) {
+                *tte_ptr = (start & L1_SECT_ADDR_MASK) | pmap_small_to_section(template_pte);
+                if (tte_is_page_table(tte)) {
+                    /* Nothing may still walk it once it is on the list */
+                    flush_mmu_tlb();
+                    pmap_spare_l2_put(L1_PTE_ADDR(tte));
+                }
+                virt += L1_SECT_SIZE;
+                start += L1_SECT_SIZE;
+                continue;
+            }
+        }
+
+        if (!tte_is_page_table(tte)) {
+            /* Not cached */
+            return FALSE;
+        }
+
+        pte_ptr = (uint32_t*)phys_to_virt(L1_PTE_ADDR(tte) + pte_offset(virt));
+
+        if (!((virt | start) & (L2_LARGE_SIZE - 1)) && (end - start) >= L2_LARGE_SIZE) {
+            for (i = 0; i < L2_LARGE_COUNT; i++)
+                pte_ptr[i] = (start & L2_LARGE_ADDR_MASK) | pmap_small_to_large(template_pte);
+            virt += L2_LARGE_SIZE;
+            start += L2_LARGE_SIZE;
+            continue;
+        }
+
+        *pte_ptr = (start & L2_ADDR_MASK) | template_pte;
+        virt += PAGE_SIZE;
+        start += PAGE_SIZE;
+    }
     
     /* Flush TLB after creating entries */
     flush_mmu_tlb();
@@ -334,30 +573,58 @@ boolean_t pmap_next_page(ppnum_t *addrp)
 
 
 /**
- * pmap_get_phys (old)
+ * pmap_ttb_translate
  *
- * Get a physical address for the virtual one.
+ * Walk the translation table at ttb (virtual address) and return the
+ * physical page mapping virt, or 0. Sections and large pages are
+ * resolved to the page inside them. A small page entry that the
+ * referenced/modified emulation left invalid is still a mapping: it
+ * keeps its pv entry and resolves to its page like a valid one, so the
+ * result says what is mapped, not what the MMU would translate now.
  */
-vm_offset_t
-pmap_get_phys(pmap_t pmap, void* virt)
+static vm_offset_t
+pmap_ttb_translate(uint32_t ttb, vm_offset_t virt)
 {
-    uint32_t* tte_ptr = (uint32_t*)addr_to_tte(pmap->ttb, (uint32_t)virt);
+    uint32_t* tte_ptr = (uint32_t*)addr_to_tte(ttb, virt);
     uint32_t tte = *tte_ptr;
     uint32_t pte, *pte_ptr;
-    uint32_t pa;
-    
+
+    if (tte_is_section(tte))
+        return (tte & L1_SECT_ADDR_MASK) | (virt & ~L1_SECT_ADDR_MASK & L2_ADDR_MASK);
+
     if (!tte_is_page_table(tte)) {
         /* Not cached */
         return 0;
     }
 
     pte = L1_PTE_ADDR(tte); /* l2 base */
-    pte += pte_offset((uint32_t)virt);
+    pte += pte_offset(virt);
     if(!pte)
         return 0;
-    pte_ptr = phys_to_virt((uint32_t*)pte);
+    pte_ptr = (uint32_t*)phys_to_virt(pte);
+    pte = *pte_ptr;
+
+    /* Removed entries are cleared, only refmod-invalid ones are kept */
+    if (pte == 0)
+        return 0;
+
+    if (pte_is_large_page(pte))
+        return (pte & L2_LARGE_ADDR_MASK) | (virt & ~L2_LARGE_ADDR_MASK & L2_ADDR_MASK);
+
+    return pte & L2_ADDR_MASK;   // Knock off the type bits, valid or not.
+}
+
+/**
+ * pmap_get_phys (old)
+ *
+ * Get a physical address for the virtual one.
+ */
+vm_offset_t
+pmap_get_phys(pmap_t pmap, void* virt)
+{
+    uint32_t pa;
     
-    pa = *pte_ptr & L2_ADDR_MASK;   // Knock off the last two bits.
+    pa = pmap_ttb_translate(pmap->ttb, (vm_offset_t)virt);
     
     kprintf("pmap_get_phys: va 0x%08x -> pa 0x%08x\n", virt, pa);
     
@@ -367,50 +634,31 @@ pmap_get_phys(pmap_t pmap, void* virt)
 vm_offset_t
 pmap_get_phys_tte(uint32_t tte_va, void* virt)
 {
-    uint32_t* tte_ptr = (uint32_t*)addr_to_tte(tte_va, (uint32_t)virt);
-    uint32_t tte = *tte_ptr;
-    uint32_t pte, *pte_ptr;
     uint32_t pa;
     
-    if (!tte_is_page_table(tte)) {
-        /* Not cached */
-        return 0;
-    }
-
-    pte = L1_PTE_ADDR(tte); /* l2 base */
-    pte += pte_offset((uint32_t)virt);
-    if(!pte)
-        return 0;
-    pte_ptr = phys_to_virt((uint32_t*)pte);
-    
-    pa = *pte_ptr & L2_ADDR_MASK;   // Knock off the last two bits.
+    pa = pmap_ttb_translate(tte_va, (vm_offset_t)virt);
     
     kprintf("pmap_get_phys_tte: va 0x%08x -> pa 0x%08x\n", virt, pa);
     
     return pa;
 }
 
+/**
+ * pmap_extract
+ *
+ * Physical page mapped at virt, including pages whose entry is only
+ * invalid for the referenced/modified emulation (see pmap_ttb_translate).
+ */
 vm_offset_t pmap_extract(pmap_t pmap, vm_offset_t virt) {
-    uint32_t* tte_ptr = (uint32_t*)addr_to_tte(pmap->ttb, (uint32_t)virt);
-    uint32_t tte = *tte_ptr;
-    uint32_t pte, *pte_ptr;
-    uint32_t pa;
-    
-    pte = L1_PTE_ADDR(tte); /* l2 base */
-    pte += pte_offset((uint32_t)virt);
-    if(!pte)
-        return 0;
-    pte_ptr = phys_to_virt((uint32_t*)pte);
-    
-    pa = (*pte_ptr & L2_ADDR_MASK);   //  PTE_SHIFT
-    
-    return pa;
+    return pmap_ttb_translate(pmap->ttb, virt);
 }
 
 /**
- * pmap_find_phys (old)
+ * pmap_find_phys
  *
- * Find the physical frame number of a virtual address.
+ * Find the physical frame mapped at a virtual address, 0 if none. Like
+ * pmap_extract, pages that the refmod emulation invalidated count as
+ * mapped, which is what vm_fault_around and vm_map_pmap_is_empty want.
  */
 ppnum_t pmap_find_phys(pmap_t pmap, addr64_t virt)
 {
@@ -420,6 +668,8 @@ ppnum_t pmap_find_phys(pmap_t pmap, addr64_t virt)
     if (!pmap->ref_count)
         goto pfp_exit;
 
+    ppn = (ppnum_t)trunc_page(pmap_ttb_translate(pmap->ttb, (vm_offset_t)virt));
+
 pfp_exit:
     splx(x);
 
@@ -461,7 +711,7 @@ boolean_t pmap_verify_free(vm_offset_t pa) {
 
     result = (pv_h->pmap == PMAP_NULL);
     
-    return TRUE;    /* result, since pmap_remove is not done yet */
+    return result;
 }
 
 /**
@@ -499,6 +749,10 @@ pt_entry_t pmap_pte(pmap_t pmap, addr64_t virt)
     tte_ptr = (uint32_t*)addr_to_tte(pmap->ttb, (uint32_t)virt);
     tte = *tte_ptr;
     
+    /* Sections have no L2 table */
+    if(!tte_is_page_table(tte))
+        return NULL;
+
     pte = L1_PTE_ADDR(tte); /* l2 base */
     if(pte == 0)
         return NULL;
@@ -507,19 +761,17 @@ pt_entry_t pmap_pte(pmap_t pmap, addr64_t virt)
     return (pt_entry_t)pte;
 }
 
-vm_page_t pmap_alloc_l2(pmap_t map)
+static void pmap_free_l2(vm_page_t m);
+
+/**
+ * pmap_init_l2
+ *
+ * Turn a freshly grabbed page into an empty L2 table page.
+ */
+static void pmap_init_l2(vm_page_t m)
 {
-    vm_page_t m;
     uint32_t ctr;
 
-    /* Verify pmap is up */
-    assert(map != NULL);
-    assert(pmap_initialized);
-    
-    /* Grab pages */
-    while((m = vm_page_grab()) == VM_PAGE_NULL)
-        VM_PAGE_WAIT();
-    
     /* Lock the global object */
     vm_object_lock(pmap_object);
     ctr = (m->phys_page >> PAGE_SHIFT) - (gPhysBase >> PAGE_SHIFT);
@@ -533,36 +785,618 @@ vm_page_t pmap_alloc_l2(pmap_t map)
     /* Done */
     vm_object_unlock(pmap_object);
 
-    /* Increment counts */
-    OSAddAtomic(1, &inuse_ptepages_count);
-    OSAddAtomic64(1, &alloc_ptepages_count);
-    
-    /* Zero page */
-    bzero(phys_to_virt(m->phys_page), PAGE_SIZE);
+    /* Increment counts */
+    OSAddAtomic(1, &inuse_ptepages_count);
+    OSAddAtomic64(1, &alloc_ptepages_count);
+    
+    /* Zero page */
+    bzero(phys_to_virt(m->phys_page), PAGE_SIZE);
+}
+
+vm_page_t pmap_alloc_l2(pmap_t map)
+{
+    vm_page_t m;
+
+    /* Verify pmap is up */
+    assert(map != NULL);
+    assert(pmap_initialized);
+    
+    /* Grab pages */
+    while((m = vm_page_grab()) == VM_PAGE_NULL)
+        VM_PAGE_WAIT();
+
+    pmap_init_l2(m);
+
+    kprintf("pmap_alloc_l2: L2 page at 0x%08x/0x%08x\n",
+            m->phys_page, phys_to_virt(m->phys_page));
+    return m;
+}
+
+/**
+ * pmap_alloc_l2_nowait
+ *
+ * Get an L2 table page without waiting, from the free list or else the
+ * reserve. Returns VM_PAGE_NULL if both are empty.
+ */
+static vm_page_t pmap_alloc_l2_nowait(void)
+{
+    vm_page_t m;
+
+    if ((m = vm_page_grab()) != VM_PAGE_NULL) {
+        pmap_init_l2(m);
+        return m;
+    }
+
+    simple_lock(&pmap_l2_reserve_lock);
+    if (pmap_l2_reserve_count > 0)
+        m = pmap_l2_reserve[--pmap_l2_reserve_count];
+    simple_unlock(&pmap_l2_reserve_lock);
+
+    return m;
+}
+
+/**
+ * pmap_l2_reserve_fill
+ *
+ * Top up the L2 table reserve. May wait for free pages.
+ */
+static void pmap_l2_reserve_fill(void)
+{
+    vm_page_t m;
+
+    while (pmap_l2_reserve_count < PMAP_L2_RESERVE) {
+        m = pmap_alloc_l2(kernel_pmap);
+
+        simple_lock(&pmap_l2_reserve_lock);
+        if (pmap_l2_reserve_count < PMAP_L2_RESERVE) {
+            pmap_l2_reserve[pmap_l2_reserve_count++] = m;
+            m = VM_PAGE_NULL;
+        }
+        simple_unlock(&pmap_l2_reserve_lock);
+
+        if (m != VM_PAGE_NULL) {
+            pmap_free_l2(m);
+            break;
+        }
+    }
+}
+
+void pmap_expand(pmap_t map, vm_offset_t v)
+{
+    vm_offset_t pa;
+    vm_page_t l2_page;
+    uint32_t* tte_ptr;
+
+    /* Should actually verify if TTB is good, meh */
+    l2_page = pmap_alloc_l2(map);
+
+    tte_ptr = pmap_tte(map, v);
+    
+    assert(l2_page);
+    *tte_ptr = ((l2_page->phys_page) & L1_PTE_ADDR_MASK) | L1_TYPE_PTE | (1 << 4);
+    
+    return;
+}
+
+/**
+ * pmap_free_l2
+ *
+ * Give back an L2 table page that was never entered.
+ */
+static void pmap_free_l2(vm_page_t m)
+{
+    vm_object_lock(pmap_object);
+    vm_page_lock_queues();
+    vm_page_free(m);
+    vm_page_unlock_queues();
+    vm_object_unlock(pmap_object);
+
+    OSAddAtomic(-1, &inuse_ptepages_count);
+}
+
+#define valid_page(x) (pmap_initialized && pmap_valid_page(x))
+
+/**
+ * pmap_pv_free
+ *
+ * Release a chain of pv entries unlinked while the pmap was locked.
+ */
+static void
+pmap_pv_free(pv_entry_t pv_e)
+{
+    pv_entry_t next;
+
+    while (pv_e != PV_ENTRY_NULL) {
+        next = pv_e->next;
+        zfree(pv_entry_zone, pv_e);
+        pv_e = next;
+    }
+}
+
+/**
+ * pmap_pv_remove
+ *
+ * Take the mapping (pmap, va) off the pv list of page pai and return its
+ * attributes. An entry that is no longer needed is chained onto pv_free.
+ * The pv list must be locked.
+ */
+static uint32_t
+pmap_pv_remove(pmap_t pmap, vm_offset_t va, int pai, pv_entry_t *pv_free)
+{
+    pv_entry_t pv_h, pv_e, prev;
+    uint32_t attr;
+
+    pv_h = pai_to_pvh(pai);
+    if (pv_h->pmap == PMAP_NULL)
+        return ATTR_NONE;
+
+    if (pv_h->pmap == pmap && pv_h->va == va) {
+        /*
+         * Header is the entry, pull the next one up into it.
+         */
+        attr = pv_h->attr;
+        pv_e = pv_h->next;
+        if (pv_e != PV_ENTRY_NULL) {
+            *pv_h = *pv_e;
+            pv_e->next = *pv_free;
+            *pv_free = pv_e;
+        } else {
+            pv_h->pmap = PMAP_NULL;
+            pv_h->attr = ATTR_NONE;
+        }
+        return attr;
+    }
+
+    prev = pv_h;
+    while ((pv_e = prev->next) != PV_ENTRY_NULL) {
+        if (pv_e->pmap == pmap && pv_e->va == va) {
+            prev->next = pv_e->next;
+            pv_e->next = *pv_free;
+            *pv_free = pv_e;
+            return pv_e->attr;
+        }
+        prev = pv_e;
+    }
+
+    return ATTR_NONE;
+}
+
+/**
+ * pmap_pv_find
+ *
+ * Find the pv entry of the mapping (pmap, va) of page pai. The pv list
+ * must be locked.
+ */
+static pv_entry_t
+pmap_pv_find(pmap_t pmap, vm_offset_t va, int pai)
+{
+    pv_entry_t pv_e;
+
+    for (pv_e = pai_to_pvh(pai); pv_e != PV_ENTRY_NULL; pv_e = pv_e->next) {
+        if (pv_e->pmap == pmap && pv_e->va == va)
+            return pv_e;
+    }
+
+    return PV_ENTRY_NULL;
+}
+
+/**
+ * pmap_refmod_pte
+ *
+ * Return the user entry pte adjusted to the referenced/modified state
+ * phys of its page: invalid if the page is unreferenced, read-only unless
+ * it is modified and the mapping (pv attributes attr) allows writes. An
+ * invalid entry keeps everything but its type bits; the pmap never sets
+ * XN, which shares bit 0 with the type.
+ */
+static uint32_t
+pmap_refmod_pte(uint32_t pte, uint32_t attr, char phys)
+{
+    pte &= ~L2_TYPE_MASK;
+    if (!(phys & PHYS_REFERENCED))
+        return pte;
+
+    pte |= L2_SMALL_PAGE;
+    if ((attr & ATTR_WRITE) && (phys & PHYS_MODIFIED))
+        pte &= ~L2_APX_BIT;
+    else
+        pte |= L2_APX_BIT;
+
+    return pte;
+}
+
+/**
+ * pmap_refmod_enter
+ *
+ * Account for the access (fault_type) that a mapping of page pai is being
+ * entered for, and return the entry to write for it. Kernel mappings are
+ * never emulated and count as referenced, and as modified if writable.
+ * With PMAP_OPTIONS_PREMAP, a mapping entered ahead of any access is
+ * valid and read-only but leaves the page unreferenced; the reference
+ * emulation only picks it up again once the page's reference bit is
+ * next cleared. The pv list must be locked.
+ */
+static uint32_t
+pmap_refmod_enter(pmap_t pmap, int pai, uint32_t template_pte, uint32_t attr, vm_prot_t fault_type,
+                  unsigned int options)
+{
+    if (pmap == kernel_pmap) {
+        pmap_phys_attributes[pai] |= PHYS_REFERENCED;
+        if (attr & ATTR_WRITE)
+            pmap_phys_attributes[pai] |= PHYS_MODIFIED;
+        return template_pte;
+    }
+
+    if (fault_type & VM_PROT_WRITE)
+        pmap_phys_attributes[pai] |= (PHYS_REFERENCED | PHYS_MODIFIED);
+    else if (fault_type != VM_PROT_NONE)
+        pmap_phys_attributes[pai] |= PHYS_REFERENCED;
+    else if (options & PMAP_OPTIONS_PREMAP)
+        return pmap_refmod_pte(template_pte, attr,
+                               pmap_phys_attributes[pai] | PHYS_REFERENCED);
+
+    return pmap_refmod_pte(template_pte, attr, pmap_phys_attributes[pai]);
+}
+
+/**
+ * pmap_template_pte
+ *
+ * Build the small page entry mapping pa with the given protection and
+ * cache attributes. Pages without write permission are entered read-only
+ * so that copy-on-write faults come back to us.
+ */
+static uint32_t
+pmap_template_pte(pmap_t pmap, uint32_t pa, vm_prot_t prot, unsigned int flags, boolean_t wired)
+{
+    uint32_t template_pte;
+
+    template_pte = (pa & L2_ADDR_MASK) | L2_SMALL_PAGE;
+    if(prot & VM_PROT_WRITE)
+        template_pte |= L2_ACCESS_PRW;
+    else
+        template_pte |= L2_ACCESS_PRO;
+    if(!wired)
+        template_pte |= L2_ACCESS_USER;
+    if(pmap != kernel_pmap)
+        template_pte |= L2_NG_BIT;
+    
+    /*
+     * Add caching flags.
+     */
+    if(flags & VM_MEM_NOT_CACHEABLE) {
+        template_pte |= mmu_texcb_small(MMU_DMA);
+    } else if(flags & VM_MEM_COHERENT) {
+        template_pte |= mmu_texcb_small(MMU_CODE);
+    } else {
+        template_pte |= mmu_texcb_small(MMU_DATA);
+    }
+
+    return template_pte;
+}
+
+/**
+ * pmap_demote_large
+ *
+ * Rewrite the 64KB large page containing pte_ptr as 16 small pages with
+ * the same translation. Nothing is allocated, the pmap must be locked and
+ * the caller flushes the TLB for the range it is working on.
+ */
+static void
+pmap_demote_large(uint32_t *pte_ptr)
+{
+    uint32_t *group = (uint32_t*)((uint32_t)pte_ptr & ~(L2_LARGE_COUNT * sizeof(uint32_t) - 1));
+    uint32_t lpte = *group;
+    uint32_t template_pte = pmap_large_to_small(lpte);
+    int i;
+
+    for (i = 0; i < L2_LARGE_COUNT; i++)
+        group[i] = ((lpte & L2_LARGE_ADDR_MASK) + (i << PAGE_SHIFT)) | template_pte;
+}
+
+/**
+ * pmap_remove_range
+ *
+ * Remove the mappings held in the PTEs [spte, epte) of one L2 table, the
+ * first of which maps va. The pmap must be locked, and the TLB is left
+ * for the caller to flush once.
+ *
+ * Returns the number of mappings removed.
+ */
+static int
+pmap_remove_range(pmap_t pmap, vm_offset_t va, pt_entry_t spte, pt_entry_t epte, pv_entry_t *pv_free)
+{
+    pt_entry_t cpte;
+    uint32_t *pte_ptr;
+    uint32_t pa;
+    int pai;
+    int removed = 0, unwired = 0;
+
+    for (cpte = spte; cpte < epte; cpte += sizeof(pt_entry_t), va += PAGE_SIZE) {
+        pte_ptr = (uint32_t*)phys_to_virt(cpte);
+        if (*pte_ptr == 0)
+            continue;
+        if (pte_is_large_page(*pte_ptr))
+            pmap_demote_large(pte_ptr);
+
+        pa = *pte_ptr & L2_ADDR_MASK;
+        *pte_ptr = 0;
+        removed++;
+
+        if (!valid_page(pa))
+            continue;
+
+        pai = pa_index(pa);
+        LOCK_PVH(pai);
+        if (pmap_pv_remove(pmap, va, pai, pv_free) & ATTR_WIRED)
+            unwired++;
+        UNLOCK_PVH(pai);
+    }
+
+    assert(pmap->stats.resident_count >= removed);
+    pmap->stats.resident_count -= removed;
+    assert(pmap->stats.wired_count >= unwired);
+    pmap->stats.wired_count -= unwired;
+
+    return removed;
+}
+
+/**
+ * pmap_flush_tlb_local
+ *
+ * Invalidate this processor's entries of [sva, eva) in pmap, which had
+ * the given ASID and generation when the PTEs were changed. Small ranges
+ * go by MVA, large ones flush everything under the ASID (or the entire
+ * TLB for the kernel). The TLB only holds entries of its own generation:
+ * a pmap whose ASID is from another one has nothing left in it, unless
+ * it is still the loaded one and may be running under an older ASID.
+ */
+static void
+pmap_flush_tlb_local(pmap_t pmap, uint32_t asid, uint32_t generation,
+                     vm_offset_t sva, vm_offset_t eva)
+{
+    cpu_data_t *cdp = current_cpu_datap();
+    boolean_t large = (((eva - sva) >> PAGE_SHIFT) > PMAP_TLB_FLUSH_THRESHOLD);
+
+    if (pmap == kernel_pmap) {
+        if (large)
+            flush_mmu_tlb();
+        else
+            flush_mmu_range(sva, eva, 0);
+        return;
+    }
+
+    /*
+     * A nested pmap is never loaded itself, its entries are cached under
+     * the ASID of every pmap it is nested into. Flush the MVAs for all
+     * ASIDs where the processor can.
+     */
+    if (pmap->pm_shared) {
+        if (pmap_tlb_flush_all_asid && !large)
+            flush_mmu_range_all_asid(sva, eva);
+        else
+            flush_mmu_tlb();
+        return;
+    }
+
+    if (generation != cdp->cpu_asid_generation) {
+        if (cdp->user_pmap == pmap)
+            flush_mmu_tlb();
+        return;
+    }
+
+    if (large)
+        flush_mmu_asid(asid);
+    else
+        flush_mmu_range(sva, eva, asid);
+}
+
+/**
+ * pmap_flush_tlb_request
+ *
+ * Carry out a shootdown posted by another processor, called from
+ * handle_pending_TLB_flushes. The requester waits for us with the pmap
+ * held, so it can't go away.
+ */
+void
+pmap_flush_tlb_request(struct cpu_tlb_request *req)
+{
+    pmap_flush_tlb_local(req->pmap, req->asid, req->asid_generation,
+                         req->start, req->end);
+}
+
+/**
+ * pmap_flush_tlb_remote
+ *
+ * Every processor has its own TLB. Have the other processors that may
+ * hold entries of the pmap flush [sva, eva) the way we do locally.
+ * Called with interrupts disabled.
+ */
+static void
+pmap_flush_tlb_remote(pmap_t pmap, vm_offset_t sva, vm_offset_t eva)
+{
+    cpu_tlb_request_t *req;
+    uint32_t cpus;
+
+    if (real_ncpus == 1)
+        return;
+
+    if (pmap == kernel_pmap || pmap->pm_shared)
+        cpus = ~0;
+    else
+        cpus = pmap->pm_cpus;
+
+    cpus &= ~(1 << cpu_number());
+    if (cpus == 0)
+        return;
+
+    req = &current_cpu_datap()->cpu_tlb_request;
+    req->pmap = pmap;
+    req->asid = pmap->asid;
+    req->asid_generation = pmap->asid_generation;
+    req->start = sva;
+    req->end = eva;
+    mp_tlb_shootdown(cpus);
+}
+
+/**
+ * pmap_flush_tlb_range
+ *
+ * Invalidate the TLB entries of [sva, eva) on every processor after the
+ * PTEs have been changed.
+ */
+static void
+pmap_flush_tlb_range(pmap_t pmap, vm_offset_t sva, vm_offset_t eva)
+{
+    pmap_flush_tlb_remote(pmap, sva, eva);
+    pmap_flush_tlb_local(pmap, pmap->asid, pmap->asid_generation, sva, eva);
+}
+
+/**
+ * pmap_demote_section
+ *
+ * Replace the section mapping va, if there is one, by an L2 table of
+ * small pages with the same translation. The table may have to be
+ * allocated, so this is called with the pmap unlocked. Without canwait
+ * the table comes from the free list or the reserve, and FALSE is
+ * returned if there was none; the section is then left in place.
+ */
+static boolean_t
+pmap_demote_section(pmap_t pmap, vm_offset_t va, boolean_t canwait)
+{
+    uint32_t *tte_ptr, *pte_ptr;
+    uint32_t tte, template_pte;
+    uint32_t l2_pa;
+    vm_page_t l2_page = VM_PAGE_NULL;
+    spl_t spl;
+    int i;
+
+    tte_ptr = (uint32_t*)addr_to_tte(pmap->ttb, va);
+    if (!tte_is_section(*tte_ptr))
+        return TRUE;
+
+    /* Kernel sections first take back the boot tables they replaced */
+    if (pmap != kernel_pmap || (l2_pa = pmap_spare_l2_get()) == 0) {
+        if (canwait)
+            l2_page = pmap_alloc_l2(pmap);
+        else if ((l2_page = pmap_alloc_l2_nowait()) == VM_PAGE_NULL)
+            return FALSE;
+        l2_pa = l2_page->phys_page;
+    }
+
+    PMAP_READ_LOCK(pmap, spl);
+    tte = *tte_ptr;
+    if (tte_is_section(tte)) {
+        pte_ptr = (uint32_t*)phys_to_virt(l2_pa);
+        template_pte = pmap_section_to_small(tte);
+        for (i = 0; i < L1_SECT_COUNT; i++)
+            pte_ptr[i] = ((tte & L1_SECT_ADDR_MASK) + (i << PAGE_SHIFT)) | template_pte;
+
+        *tte_ptr = (l2_pa & L1_PTE_ADDR_MASK) | L1_TYPE_PTE | (1 << 4);
+        va &= L1_SECT_ADDR_MASK;
+        pmap_flush_tlb_range(pmap, va, va + L1_SECT_SIZE);
+        l2_page = VM_PAGE_NULL;
+        l2_pa = 0;
+    }
+    PMAP_READ_UNLOCK(pmap, spl);
+
+    /* Lost the race against another demotion */
+    if (l2_page != VM_PAGE_NULL)
+        pmap_free_l2(l2_page);
+    else if (l2_pa != 0)
+        pmap_spare_l2_put(l2_pa);
+
+    return TRUE;
+}
+
+/**
+ * pmap_demote_edges
+ *
+ * Demote the sections only partially covered by [sva, eva) before a range
+ * operation, which then handles whole sections in the L1 table and the
+ * rest a 4K page at a time. The L2 tables come from the free list or the
+ * reserve; only when both are empty does this wait for a page. Sections
+ * only map unmanaged memory, which the pageout path never unmaps, so
+ * that wait cannot hold up the pageout daemon.
+ */
+static void
+pmap_demote_edges(pmap_t pmap, vm_offset_t sva, vm_offset_t eva)
+{
+    if ((sva & (L1_SECT_SIZE - 1)) && !pmap_demote_section(pmap, sva, FALSE))
+        (void) pmap_demote_section(pmap, sva, TRUE);
+    if ((eva & (L1_SECT_SIZE - 1)) && !pmap_demote_section(pmap, eva, FALSE))
+        (void) pmap_demote_section(pmap, eva, TRUE);
+}
+
+/**
+ * pmap_enter_block
+ *
+ * Map [va, va + size) to [pa, pa + size) with a single 1MB section or
+ * 64KB large page. Block mappings are not put on pv lists, so
+ * pmap_page_protect and the refmod emulation would never see them:
+ * only unmanaged (IO) memory is mapped this way. Fails when the range
+ * is managed or anything is already mapped in it.
+ */
+static kern_return_t
+pmap_enter_block(pmap_t pmap, vm_offset_t va, uint32_t pa, uint32_t size,
+                 vm_prot_t prot, unsigned int flags)
+{
+    uint32_t *tte_ptr, *pte_ptr;
+    uint32_t template_pte;
+    kern_return_t kr = KERN_FAILURE;
+    spl_t spl;
+    int i;
+
+    assert(size == L1_SECT_SIZE || size == L2_LARGE_SIZE);
+    assert(!((va | pa) & (size - 1)));
+
+    if (pmap != kernel_pmap && (va + size) > PMAP_USER_VA_LIMIT)
+        return KERN_INVALID_ARGUMENT;
+
+    if (pa < avail_end && (pa + size) > ram_begin)
+        return KERN_FAILURE;
+
+    template_pte = pmap_template_pte(pmap, 0, prot, flags, pmap == kernel_pmap);
+    tte_ptr = (uint32_t*)addr_to_tte(pmap->ttb, va);
+
+    if (size == L2_LARGE_SIZE) {
+        /* Large pages live in an L2 table */
+        if (pmap_l1_nested(pmap, va))
+            return KERN_FAILURE;
+        if (!tte_is_page_table(*tte_ptr)) {
+            if (*tte_ptr != 0)
+                return KERN_FAILURE;
+            pmap_expand(pmap, va);
+        }
+    }
+
+    PMAP_READ_LOCK(pmap, spl);
 
-    kprintf("pmap_alloc_l2: L2 page at 0x%08x/0x%08x\n",
-            m->phys_page, phys_to_virt(m->phys_page));
-    return m;
-}
+    if (size == L1_SECT_SIZE) {
+        if (*tte_ptr == 0) {
+            *tte_ptr = (pa & L1_SECT_ADDR_MASK) | pmap_small_to_section(template_pte);
+            kr = KERN_SUCCESS;
+        }
+    } else if (tte_is_page_table(*tte_ptr)) {
+        pte_ptr = (uint32_t*)phys_to_virt(L1_PTE_ADDR(*tte_ptr) + pte_offset(va));
+        for (i = 0; i < L2_LARGE_COUNT; i++) {
+            if (pte_ptr[i] != 0)
+                break;
+        }
+        if (i == L2_LARGE_COUNT) {
+            for (i = 0; i < L2_LARGE_COUNT; i++)
+                pte_ptr[i] = (pa & L2_LARGE_ADDR_MASK) | pmap_small_to_large(template_pte);
+            kr = KERN_SUCCESS;
+        }
+    }
 
-void pmap_expand(pmap_t map, vm_offset_t v)
-{
-    vm_offset_t pa;
-    vm_page_t l2_page;
-    uint32_t* tte_ptr;
+    if (kr == KERN_SUCCESS)
+        pmap->stats.resident_count += size >> PAGE_SHIFT;
 
-    /* Should actually verify if TTB is good, meh */
-    l2_page = pmap_alloc_l2(map);
+    PMAP_READ_UNLOCK(pmap, spl);
 
-    tte_ptr = pmap_tte(map, v);
-    
-    assert(l2_page);
-    *tte_ptr = ((l2_page->phys_page) & L1_PTE_ADDR_MASK) | L1_TYPE_PTE | (1 << 4);
-    
-    return;
+    return kr;
 }
 
-#define valid_page(x) (pmap_initialized && pmap_valid_page(x))
 /**
  * pmap_enter
  *
@@ -595,11 +1429,14 @@ pmap_enter_options(
     unsigned int options)
 {
     pt_entry_t  pte;
-    uint32_t    old_addr;
+    uint32_t    old_pte;
     int         pai;
     uint32_t    template_pte;
     pv_entry_t  pv_h;
-    pv_entry_t  pv_e;
+    pv_entry_t  pv_e = PV_ENTRY_NULL;
+    pv_entry_t  pv_free = PV_ENTRY_NULL;
+    uint32_t    attr;
+    spl_t       spl;
     
     /* Verify address */
     assert(pa != vm_page_fictitious_addr);
@@ -610,19 +1447,28 @@ pmap_enter_options(
     if (pa == vm_page_guard_addr)
         return KERN_INVALID_ARGUMENT;
 
+    template_pte = pmap_template_pte(pmap, pa, prot, flags, wired);
+    attr = (wired ? ATTR_WIRED : ATTR_NONE) | ATTR_READ;
+    if(prot & VM_PROT_WRITE)
+        attr |= ATTR_WRITE;
+
+Retry:
     /*
      * Lock the pmap.
      */
-    PMAP_LOCK(pmap);
+    PMAP_READ_LOCK(pmap, spl);
     
     /*
      * Expand the pmap to include this PTE if necessary.
      */
     while((pte = pmap_pte(pmap, va)) == NULL) {
-        PMAP_UNLOCK(pmap);
-        pmap_expand(pmap, va);
-        kprintf("pmap_expand: expanded pmap, va 0x%08x -> 0x%08x\n", va, pa);
-        PMAP_LOCK(pmap);
+        PMAP_READ_UNLOCK(pmap, spl);
+        /* Only a page at a time is changed, break up a section first. */
+        if(tte_is_section(*(uint32_t*)pmap_tte(pmap, va)))
+            (void) pmap_demote_section(pmap, va, TRUE);
+        else
+            pmap_expand(pmap, va);
+        PMAP_READ_LOCK(pmap, spl);
     }
 #if 0
     kprintf("pmap_enter: 0x%08x -> 0x%08x (pmap: 0x%08x, pte: 0x%08x, ttb: 0x%08x, ttb_phys: 0x%08x)\n",
@@ -631,26 +1477,40 @@ pmap_enter_options(
     /*
      * See if it has an old PA.
      */
-    old_addr = (*(uint32_t*)phys_to_virt(pte)) & L2_ADDR_MASK;
-    if(old_addr == pa) {
+    if(pte_is_large_page(*(uint32_t*)phys_to_virt(pte)))
+        pmap_demote_large((uint32_t*)phys_to_virt(pte));
+    old_pte = *(uint32_t*)phys_to_virt(pte);
+    if(old_pte != 0 && (old_pte & L2_ADDR_MASK) == pa) {
         /*
-         * Could be changing protections, implement this.
+         * Same page, only the protection or caching is changing.
          */
-        template_pte = (pa & L2_ADDR_MASK) | L2_SMALL_PAGE | L2_ACCESS_PRW;
-        if(!wired)
-            template_pte |= L2_ACCESS_USER;
-        *(uint32_t*)phys_to_virt(pte) = template_pte;
-        
+        if(valid_page(pa)) {
+            pai = pa_index(pa);
+            LOCK_PVH(pai);
+            pv_h = pmap_pv_find(pmap, va, pai);
+            if(pv_h != PV_ENTRY_NULL)
+                pv_h->attr = (pv_h->attr & ATTR_WIRED) | (attr & ~ATTR_WIRED);
+            template_pte = pmap_refmod_enter(pmap, pai, template_pte, attr, fault_type, options);
+            UNLOCK_PVH(pai);
+        }
+        WRITE_PTE(pte, template_pte);
         goto done;
     }
     
     /*
-     * New mapping. So make one and flush the tlb if necessary.
+     * A different page is mapped here, take it out first.
+     */
+    if(old_pte != 0)
+        pmap_remove_range(pmap, va, pte, pte + sizeof(pt_entry_t), &pv_free);
+    
+    /*
+     * New mapping. Put it on the pv list of the page.
      */
     if(valid_page(pa)) {
         pai = pa_index(pa);
         pv_h = pai_to_pvh(pai);
         
+        LOCK_PVH(pai);
         if (pv_h->pmap == PMAP_NULL) {
             /*
              * No mappings yet.
@@ -658,14 +1518,27 @@ pmap_enter_options(
             pv_h->va = va;
             pv_h->pmap = pmap;
             pv_h->next = PV_ENTRY_NULL;
-            if(wired)
-                pv_h->attr |= ATTR_WIRED;
-            
+            pv_h->attr = attr;
         } else {
             /*
-             * Handle this case.
+             * Aliased page, chain a new entry after the head. The
+             * entry has to be allocated without any locks held.
              */
+            if(pv_e == PV_ENTRY_NULL) {
+                UNLOCK_PVH(pai);
+                PMAP_READ_UNLOCK(pmap, spl);
+                pv_e = (pv_entry_t) zalloc(pv_entry_zone);
+                goto Retry;
+            }
+            pv_e->va = va;
+            pv_e->pmap = pmap;
+            pv_e->attr = attr;
+            pv_e->next = pv_h->next;
+            pv_h->next = pv_e;
+            pv_e = PV_ENTRY_NULL;
         }
+        template_pte = pmap_refmod_enter(pmap, pai, template_pte, attr, fault_type, options);
+        UNLOCK_PVH(pai);
     }
 
     /*
@@ -677,21 +1550,6 @@ pmap_enter_options(
     /*
      * Enter it in the pmap.
      */
-    template_pte = (pa & L2_ADDR_MASK) | L2_SMALL_PAGE | L2_ACCESS_PRW;
-    if(!wired)
-        template_pte |= L2_ACCESS_USER;
-    
-    /*
-     * Add caching flags.
-     */
-    if(flags & VM_MEM_NOT_CACHEABLE) {
-        template_pte |= mmu_texcb_small(MMU_DMA);
-    } else if(flags & VM_MEM_COHERENT) {
-        template_pte |= mmu_texcb_small(MMU_CODE);
-    } else {
-        template_pte |= mmu_texcb_small(MMU_DATA);
-    }
-
     WRITE_PTE(pte, template_pte);
     
     /*
@@ -701,12 +1559,17 @@ pmap_enter_options(
         pmap->stats.wired_count++;
     
 done:
-    PMAP_UNLOCK(pmap);
-    
     /*
-     * Flush TLB.
+     * Flush TLB. A fresh entry cannot be cached, a replaced one can.
      */
-    flush_mmu_single(pa);
+    if(old_pte != 0)
+        pmap_flush_tlb_range(pmap, va, va + PAGE_SIZE);
+
+    PMAP_READ_UNLOCK(pmap, spl);
+    
+    if(pv_e != PV_ENTRY_NULL)
+        zfree(pv_entry_zone, pv_e);
+    pmap_pv_free(pv_free);
     
     return KERN_SUCCESS;
 }
@@ -769,7 +1632,7 @@ pmap_map(vm_offset_t virt,
     
     ps = PAGE_SIZE;
     while (start_addr < end_addr) {
-        pmap_enter(kernel_pmap, (vm_map_offset_t)virt, (start_addr), prot, flags, FALSE, TRUE);
+        pmap_enter(kernel_pmap, (vm_map_offset_t)virt, (start_addr), prot, VM_PROT_NONE, flags, TRUE);
         virt += ps;
         start_addr += ps;
     }
@@ -799,15 +1662,66 @@ io_map(vm_offset_t phys_addr, vm_size_t size, unsigned int flags)
 			       flags);
 	}
 	else {
-	    (void) kmem_alloc_pageable(kernel_map, &start, round_page(size));
-	    (void) pmap_map(start, phys_addr, phys_addr + round_page(size),
-			    VM_PROT_READ|VM_PROT_WRITE,
-			    flags);
+	    vm_map_offset_t map_addr = vm_map_min(kernel_map);
+	    vm_map_offset_t mask = 0;
+
+	    /*
+	     * Align the virtual range like the physical one so that it
+	     * can be mapped with sections or large pages.
+	     */
+	    if (round_page(size) >= L1_SECT_SIZE && !(phys_addr & (L1_SECT_SIZE - 1)))
+		mask = L1_SECT_SIZE - 1;
+	    else if (round_page(size) >= L2_LARGE_SIZE && !(phys_addr & (L2_LARGE_SIZE - 1)))
+		mask = L2_LARGE_SIZE - 1;
+
+	    (void) vm_map_enter(kernel_map, &map_addr, round_page(size),
+				mask, VM_FLAGS_ANYWHERE,
+				VM_OBJECT_NULL, (vm_object_offset_t) 0, FALSE,
+				VM_PROT_DEFAULT, VM_PROT_ALL, VM_INHERIT_DEFAULT);
+	    start = CAST_DOWN(vm_offset_t, map_addr);
+
+	    pmap_map_block(kernel_pmap, start, (ppnum_t)atop(phys_addr),
+			   (uint32_t)atop(round_page(size)),
+			   VM_PROT_READ|VM_PROT_WRITE, flags, 0);
 	}
 
 	return (start);
 }
 
+/**
+ * pmap_map_block
+ *
+ * Map a physically contiguous block of size pages starting at page
+ * number pa, using the largest mappings that alignment allows.
+ */
+void
+pmap_map_block(pmap_t pmap, addr64_t va, ppnum_t pa, uint32_t size,
+               vm_prot_t prot, int attr, __unused unsigned int flags)
+{
+    vm_offset_t vaddr = (vm_offset_t)va;
+    uint32_t paddr = ptoa(pa);
+    uint32_t remaining = ptoa(size);
+    uint32_t step;
+
+    while (remaining) {
+        if (!((vaddr | paddr) & (L1_SECT_SIZE - 1)) && remaining >= L1_SECT_SIZE &&
+            pmap_enter_block(pmap, vaddr, paddr, L1_SECT_SIZE, prot, attr) == KERN_SUCCESS) {
+            step = L1_SECT_SIZE;
+        } else if (!((vaddr | paddr) & (L2_LARGE_SIZE - 1)) && remaining >= L2_LARGE_SIZE &&
+                   pmap_enter_block(pmap, vaddr, paddr, L2_LARGE_SIZE, prot, attr) == KERN_SUCCESS) {
+            step = L2_LARGE_SIZE;
+        } else {
+            pmap_enter(pmap, vaddr, paddr, prot, VM_PROT_NONE, attr & ~VM_MEM_SUPERPAGE,
+                       pmap == kernel_pmap);
+            step = PAGE_SIZE;
+        }
+
+        vaddr += step;
+        paddr += step;
+        remaining -= step;
+    }
+}
+
 vm_offset_t io_map_spec(vm_map_offset_t phys_addr, vm_size_t size, unsigned int flags)
 {
   return (io_map(phys_addr, size, flags));
@@ -834,11 +1748,14 @@ pmap_init(void)
     free_pmap_count = 0;
     
     pmap_zone = zinit((sizeof(struct pmap)), 400 * (sizeof(struct pmap)), 4096, "pmap");
+    pv_entry_zone = zinit((sizeof(struct pv_entry)), 10000 * (sizeof(struct pv_entry)), 4096, "pv_list");
 
     pmap_object = &pmap_object_store;
     _vm_object_allocate(mem_size, &pmap_object_store);
 
     pmap_initialized = TRUE;
+
+    pmap_l2_reserve_fill();
     
     return;
 }
@@ -852,6 +1769,7 @@ pmap_init(void)
 void pmap_page_protect(ppnum_t pn, vm_prot_t prot) {
     pv_entry_t pv_h, prev;
     pv_entry_t pv_e;
+    pv_entry_t pv_free = PV_ENTRY_NULL;
     pt_entry_t pte;
     boolean_t remove;
     pmap_t pmap;
@@ -910,14 +1828,22 @@ void pmap_page_protect(ppnum_t pn, vm_prot_t prot) {
                 va = pv_e->va;
                 pte = pmap_pte(pmap, va);
             }
+            if (pte == NULL)
+                panic("pmap_page_protect: pv entry for pmap %p va 0x%08x has no pte\n",
+                      pmap, va);
             if (remove || pmap == kernel_pmap) {
                 /*
                  * Remove the mapping.
                  */
                 WRITE_PTE(pte, 0);
+                pmap_flush_tlb_range(pmap, va, va + PAGE_SIZE);
 
                 assert(pmap->stats.resident_count >= 1);
                 pmap->stats.resident_count--;
+                if (pv_e->attr & ATTR_WIRED) {
+                    assert(pmap->stats.wired_count >= 1);
+                    pmap->stats.wired_count--;
+                }
                 /*
                  * Remove the pv_entry.
                  */
@@ -931,6 +1857,8 @@ void pmap_page_protect(ppnum_t pn, vm_prot_t prot) {
                      * Delete this entry.
                      */
                     prev->next = pv_e->next;
+                    pv_e->next = pv_free;
+                    pv_free = pv_e;
                 }
             } else {
                 /*
@@ -938,9 +1866,10 @@ void pmap_page_protect(ppnum_t pn, vm_prot_t prot) {
                  */
                 {
                     uint32_t *pte_ptr = (uint32_t*)phys_to_virt(pte);
+                    pv_e->attr &= ~ATTR_WRITE;
                     *pte_ptr &= ~(L2_ACCESS_PRW);
                     *pte_ptr |= (L2_ACCESS_PRO);
-                    flush_mmu_single(pn);
+                    pmap_flush_tlb_range(pmap, va, va + PAGE_SIZE);
                 }
                 /*
                  * Advance prev.
@@ -959,11 +1888,17 @@ void pmap_page_protect(ppnum_t pn, vm_prot_t prot) {
             pv_e = pv_h->next;
             if (pv_e != PV_ENTRY_NULL) {
                 *pv_h = *pv_e;
+                pv_e->next = pv_free;
+                pv_free = pv_e;
+            } else {
+                pv_h->attr = ATTR_NONE;
             }
         }
     }
     
     PMAP_WRITE_UNLOCK(spl);
+
+    pmap_pv_free(pv_free);
 }
 
 /*
@@ -973,7 +1908,7 @@ void pmap_page_protect(ppnum_t pn, vm_prot_t prot) {
 unsigned int pmap_disconnect(ppnum_t pa)
 {
     pmap_page_protect(pa, 0);
-    return 0;
+    return pmap_get_refmod(pa);
 }
 
 void
@@ -1008,6 +1943,11 @@ pmap_create(ledger_t ledger, vm_map_size_t size, __unused boolean_t is_64bit)
     
     if(!kernel_task)
         return PMAP_NULL;
+
+    /*
+     * Make up for L2 tables taken from the reserve since.
+     */
+    pmap_l2_reserve_fill();
     
     /*
      * Just zalloc a new one. Eventually get one out of the free list.
@@ -1049,6 +1989,11 @@ pmap_create(ledger_t ledger, vm_map_size_t size, __unused boolean_t is_64bit)
     
     our_pmap->ttb = phys_to_virt(address);
     our_pmap->ttb_phys = address;
+    our_pmap->asid = 0;
+    our_pmap->asid_generation = 0;     /* allocated on first switch */
+    our_pmap->pm_shared = FALSE;
+    our_pmap->pm_cpus = 0;
+    bzero(our_pmap->pm_nested, sizeof(our_pmap->pm_nested));
     bzero(phys_to_virt(address), PAGE_SIZE);
     
     kprintf("pmap_create: new ttb 0x%08x, 0x%08x\n", our_pmap->ttb, our_pmap->ttb_phys);
@@ -1063,12 +2008,79 @@ void mapping_adjust(void) {
     return;
 }
 
+/**
+ * pmap_remove
+ *
+ * Remove the given range of addresses from the specified map. L1 entries
+ * without an L2 table are skipped a whole section at a time, sections
+ * covered whole are dropped whole, and the TLB is flushed once for the
+ * range.
+ */
 void
 pmap_remove(pmap_t map,
             vm_map_offset_t s,
             vm_map_offset_t e)
 {
-    return;
+    pv_entry_t pv_free = PV_ENTRY_NULL;
+    vm_offset_t va, l1_end, end;
+    uint32_t tte, *tte_ptr;
+    pt_entry_t spte;
+    int removed = 0;
+    spl_t spl;
+
+    if (map == PMAP_NULL || s >= e)
+        return;
+
+    va = (vm_offset_t)trunc_page(s);
+    end = (vm_offset_t)round_page(e);
+    if (map != kernel_pmap && end > PMAP_USER_VA_LIMIT)
+        end = PMAP_USER_VA_LIMIT;
+
+    pmap_demote_edges(map, va, end);
+
+    PMAP_READ_LOCK(map, spl);
+
+    while (va < end) {
+        l1_end = (va + L1_SECT_SIZE) & L1_SECT_ADDR_MASK;
+        if (l1_end == 0 || l1_end > end)
+            l1_end = end;
+
+        tte_ptr = (uint32_t*)addr_to_tte(map->ttb, va);
+        tte = *tte_ptr;
+        if (tte_is_section(tte) && l1_end - va != L1_SECT_SIZE) {
+            /*
+             * Partial sections were demoted above, this one was
+             * entered since. Demote it too and go on with its pages.
+             */
+            if (removed) {
+                pmap_flush_tlb_range(map, trunc_page(s), va);
+                removed = 0;
+            }
+            PMAP_READ_UNLOCK(map, spl);
+            (void) pmap_demote_section(map, va, TRUE);
+            PMAP_READ_LOCK(map, spl);
+            continue;
+        } else if (tte_is_section(tte)) {
+            *tte_ptr = 0;
+            removed += L1_SECT_COUNT;
+            assert(map->stats.resident_count >= L1_SECT_COUNT);
+            map->stats.resident_count -= L1_SECT_COUNT;
+        } else if (tte_is_page_table(tte) && !pmap_l1_nested(map, va)) {
+            spte = L1_PTE_ADDR(tte) + pte_offset(va);
+            removed += pmap_remove_range(map, va, spte,
+                                         spte + (((l1_end - va) >> PAGE_SHIFT) * sizeof(pt_entry_t)),
+                                         &pv_free);
+        }
+
+        va = l1_end;
+    }
+
+    if (removed)
+        pmap_flush_tlb_range(map, trunc_page(s), end);
+
+    PMAP_READ_UNLOCK(map, spl);
+
+    pmap_pv_free(pv_free);
 }
 
 /**
@@ -1083,39 +2095,122 @@ pmap_change_wiring(pmap_t map,
                    boolean_t wired)
 {
     pt_entry_t pte;
+    pv_entry_t pv_e = PV_ENTRY_NULL;
+    uint32_t pa;
+    int pai = 0;
+    spl_t spl;
     
-    PMAP_LOCK(map);
+    PMAP_READ_LOCK(map, spl);
     
+    /*
+     * Block mappings are always resident and not counted as wired.
+     */
+    if (tte_is_section(*(uint32_t*)pmap_tte(map, vaddr))) {
+        PMAP_READ_UNLOCK(map, spl);
+        return;
+    }
+
     if ((pte = pmap_pte(map, vaddr)) == 0)
         panic("pmap_change_wiring: pte missing");
     
-    if (wired) {
+    if (pte_is_large_page(*(uint32_t*)phys_to_virt(pte))) {
+        PMAP_READ_UNLOCK(map, spl);
+        return;
+    }
+
+    /*
+     * Managed pages carry the wiring in their pv entry, which is what
+     * pmap_remove goes by.
+     */
+    pa = (*(uint32_t*)phys_to_virt(pte)) & L2_ADDR_MASK;
+    if (valid_page(pa)) {
+        pai = pa_index(pa);
+        LOCK_PVH(pai);
+        pv_e = pmap_pv_find(map, vaddr, pai);
+    }
+    
+    if (wired && !(pv_e && (pv_e->attr & ATTR_WIRED))) {
         /*
          * wiring down mapping
          */
+        if (pv_e)
+            pv_e->attr |= ATTR_WIRED;
         OSAddAtomic(+1,  &map->stats.wired_count);
-    } else if (!wired) {
+    } else if (!wired && !(pv_e && !(pv_e->attr & ATTR_WIRED))) {
         /*
          * unwiring mapping
          */
+        if (pv_e)
+            pv_e->attr &= ~ATTR_WIRED;
         assert(map->stats.wired_count >= 1);
         OSAddAtomic(-1,  &map->stats.wired_count);
     }
     
-    PMAP_UNLOCK(map);
+    if (valid_page(pa))
+        UNLOCK_PVH(pai);
+    
+    PMAP_READ_UNLOCK(map, spl);
+}
+
+/**
+ * pmap_asid_alloc
+ *
+ * Give a pmap an ASID from the current generation, starting a new
+ * generation if they have all been used, and bring this processor's TLB
+ * into the current generation. Both are done under the lock so that the
+ * ASID about to be loaded always belongs to the TLB's generation. Called
+ * with interrupts off.
+ */
+static void
+pmap_asid_alloc(pmap_t pmap, cpu_data_t *cdp)
+{
+    simple_lock(&pmap_asid_lock);
+    if (pmap != kernel_pmap && pmap->asid_generation != pmap_asid_generation) {
+        if (pmap_asid_next == PMAP_ASID_MAX) {
+            pmap_asid_generation++;
+            pmap_asid_next = 1;
+            pmap_asid_rollovers++;
+        }
+        pmap->asid = pmap_asid_next++;
+        pmap->asid_generation = pmap_asid_generation;
+    }
+    if (cdp->cpu_asid_generation != pmap_asid_generation) {
+        /*
+         * Park on the kernel table under the reserved ASID so nothing
+         * refills the TLB with an old tag, then flush.
+         */
+        set_mmu_ttb_asid(kernel_pmap->ttb_phys, 0);
+        flush_mmu_tlb();
+        cdp->cpu_asid_generation = pmap_asid_generation;
+    }
+    simple_unlock(&pmap_asid_lock);
 }
 
+/**
+ * pmap_switch
+ *
+ * Load the translation table of a pmap. User mappings are tagged with the
+ * pmap's ASID, so a processor only flushes its TLB the first time it
+ * switches after the ASIDs roll over. The processor stays in pm_cpus,
+ * its TLB may keep the pmap's entries.
+ */
 void pmap_switch(pmap_t tpmap)
 {
+    cpu_data_t* cdp;
     spl_t s;
 
 	s = splhigh();
-    if(current_cpu_datap()->user_pmap == tpmap) {
+    cdp = current_cpu_datap();
+    if(cdp->user_pmap == tpmap) {
         goto out;
     } else {
-        current_cpu_datap()->user_pmap = tpmap;
-        set_mmu_ttb(tpmap->ttb_phys);
-        flush_mmu_tlb();
+        if((tpmap != kernel_pmap && tpmap->asid_generation != pmap_asid_generation) ||
+           cdp->cpu_asid_generation != pmap_asid_generation)
+            pmap_asid_alloc(tpmap, cdp);
+        if(!(tpmap->pm_cpus & (1 << cpu_number())))
+            hw_atomic_or_noret(&tpmap->pm_cpus, 1 << cpu_number());
+        cdp->user_pmap = tpmap;
+        set_mmu_ttb_asid(tpmap->ttb_phys, tpmap->asid);
     }
 out:
 	splx(s);
@@ -1130,6 +2225,7 @@ void
 pmap_destroy(pmap_t pmap)
 {
     int refcount;
+    spl_t s;
 
     assert(pmap != NULL);
     
@@ -1142,6 +2238,17 @@ pmap_destroy(pmap_t pmap)
         return;
     }
     
+    /*
+     * Drop anything still tagged with our ASID, and make sure a pmap
+     * reallocated at this address is not mistaken for the loaded one.
+     */
+    s = splhigh();
+    if(pmap->asid_generation == pmap_asid_generation)
+        flush_mmu_asid(pmap->asid);
+    if(current_cpu_datap()->user_pmap == pmap)
+        pmap_switch(kernel_pmap);
+    splx(s);
+    
     ledger_dereference(pmap->ledger);
     zfree(pmap_zone, pmap);
     return;
@@ -1171,11 +2278,147 @@ void pmap_zero_page(vm_offset_t p)
 }
 
 /**
- * ohai.
+ * pmap_clear_refmod
+ *
+ * Clear the referenced and/or modified state of a page. The user mappings
+ * of the page are made invalid or read-only again so that the next access
+ * is seen.
  */
 void pmap_clear_refmod(ppnum_t pn, unsigned int mask)
 {
-    return;
+    pv_entry_t pv_e;
+    pt_entry_t pte;
+    uint32_t *pte_ptr, new_pte;
+    pmap_t pmap;
+    spl_t spl;
+    int pai;
+
+    assert(pn != vm_page_fictitious_addr);
+
+    if (!valid_page(pn))
+        return;
+
+    mask &= (PHYS_MODIFIED | PHYS_REFERENCED);
+
+    PMAP_WRITE_LOCK(spl);
+
+    pai = pa_index(pn);
+    pmap_phys_attributes[pai] &= ~mask;
+
+    if (pai_to_pvh(pai)->pmap != PMAP_NULL) {
+        for (pv_e = pai_to_pvh(pai); pv_e != PV_ENTRY_NULL; pv_e = pv_e->next) {
+            pmap = pv_e->pmap;
+            if (pmap == kernel_pmap) {
+                /* Not emulated, could be used at any time. */
+                pmap_phys_attributes[pai] |= PHYS_REFERENCED;
+                if (pv_e->attr & ATTR_WRITE)
+                    pmap_phys_attributes[pai] |= PHYS_MODIFIED;
+                continue;
+            }
+
+            simple_lock(&pmap->lock);
+            pte = pmap_pte(pmap, pv_e->va);
+            if (pte != NULL) {
+                pte_ptr = (uint32_t*)phys_to_virt(pte);
+                new_pte = pmap_refmod_pte(*pte_ptr, pv_e->attr, pmap_phys_attributes[pai]);
+                if (new_pte != *pte_ptr) {
+                    *pte_ptr = new_pte;
+                    pmap_flush_tlb_range(pmap, pv_e->va, pv_e->va + PAGE_SIZE);
+                }
+            }
+            simple_unlock(&pmap->lock);
+        }
+    }
+
+    PMAP_WRITE_UNLOCK(spl);
+}
+
+/**
+ * pmap_get_refmod
+ *
+ * Return the referenced and modified state of a page.
+ */
+unsigned int pmap_get_refmod(ppnum_t pn)
+{
+    if (!valid_page(pn))
+        return 0;
+
+    return pmap_phys_attributes[pa_index(pn)] & (PHYS_MODIFIED | PHYS_REFERENCED);
+}
+
+void pmap_clear_modify(ppnum_t pn)
+{
+    pmap_clear_refmod(pn, VM_MEM_MODIFIED);
+}
+
+void pmap_clear_reference(ppnum_t pn)
+{
+    pmap_clear_refmod(pn, VM_MEM_REFERENCED);
+}
+
+boolean_t pmap_is_modified(ppnum_t pn)
+{
+    return (pmap_get_refmod(pn) & VM_MEM_MODIFIED) ? TRUE : FALSE;
+}
+
+boolean_t pmap_is_referenced(ppnum_t pn)
+{
+    return (pmap_get_refmod(pn) & VM_MEM_REFERENCED) ? TRUE : FALSE;
+}
+
+/**
+ * pmap_fault_refmod
+ *
+ * Resolve a fault taken on a user mapping that is only invalid or
+ * read-only for the referenced/modified emulation. Returns FALSE if the
+ * access is not allowed by the mapping and has to go to vm_fault.
+ */
+boolean_t pmap_fault_refmod(pmap_t pmap, vm_offset_t va, vm_prot_t fault_type)
+{
+    pv_entry_t pv_e;
+    pt_entry_t pte;
+    uint32_t *pte_ptr;
+    uint32_t pa;
+    boolean_t resolved = FALSE;
+    spl_t spl;
+    int pai;
+
+    if (pmap == PMAP_NULL || pmap == kernel_pmap || va >= PMAP_USER_VA_LIMIT)
+        return FALSE;
+
+    va = trunc_page(va);
+
+    PMAP_READ_LOCK(pmap, spl);
+
+    pte = pmap_pte(pmap, va);
+    if (pte == NULL)
+        goto out;
+    pte_ptr = (uint32_t*)phys_to_virt(pte);
+    if (*pte_ptr == 0 || pte_is_large_page(*pte_ptr))
+        goto out;
+
+    pa = *pte_ptr & L2_ADDR_MASK;
+    if (!valid_page(pa))
+        goto out;
+
+    pai = pa_index(pa);
+    LOCK_PVH(pai);
+    pv_e = pmap_pv_find(pmap, va, pai);
+    if (pv_e != PV_ENTRY_NULL &&
+        (!(fault_type & VM_PROT_WRITE) || (pv_e->attr & ATTR_WRITE))) {
+        pmap_phys_attributes[pai] |= PHYS_REFERENCED;
+        if (fault_type & VM_PROT_WRITE)
+            pmap_phys_attributes[pai] |= PHYS_MODIFIED;
+        *pte_ptr = pmap_refmod_pte(*pte_ptr, pv_e->attr, pmap_phys_attributes[pai]);
+        pmap_flush_tlb_range(pmap, va, va + PAGE_SIZE);
+        resolved = TRUE;
+    }
+    UNLOCK_PVH(pai);
+
+out:
+    PMAP_READ_UNLOCK(pmap, spl);
+
+    return resolved;
 }
 
 /*
@@ -1188,36 +2431,150 @@ void pmap_clear_refmod(ppnum_t pn, unsigned int mask)
  *	size   = Size of nest area
  *
  *	Inserts a pmap into another.  This is used to implement shared segments.
+ *
+ *	Nesting is done a section at a time: the L1 entries of grand are
+ *	pointed at the L2 tables of subord, so anything entered into subord
+ *	is seen by every pmap it is nested into.
  */
-uint64_t pmap_nesting_size_min = 0x8000000;
-uint64_t pmap_nesting_size_max = 0x8000000;
+uint64_t pmap_nesting_size_min = L1_SECT_SIZE;
+uint64_t pmap_nesting_size_max = PMAP_USER_VA_LIMIT;
 
 kern_return_t pmap_nest(pmap_t grand, pmap_t subord, addr64_t va_start, addr64_t nstart, uint64_t size) {
-    uint32_t section_counter;
-    uint32_t ttb_grand;
-    uint32_t ttb_subord;
+    vm_offset_t vaddr;
+    uint32_t *tte_grand;
+    uint32_t *tte_subord;
+    uint32_t i, num_l1;
     
     assert(grand && subord);
     
     kprintf("pmap_nest: grand %p[0x%llx] -> subord: %p[0x%llx], size: 0x%llx\n",
             grand, va_start, subord, nstart, size);
     
-    /* Copy the pmap mappings for one to another. */
-    assert(size != 0);
+    if ((size & (pmap_nesting_size_min - 1)) ||
+        (va_start & (pmap_nesting_size_min - 1)) ||
+        (nstart & (pmap_nesting_size_min - 1)) ||
+        ((va_start + size) > PMAP_USER_VA_LIMIT))
+        return KERN_INVALID_VALUE;
+
+    if (size == 0)
+        panic("pmap_nest: size is invalid - 0x%llx\n", size);
 
 	if (va_start != nstart)
 		panic("pmap_nest: va_start(0x%llx) != nstart(0x%llx)\n", va_start, nstart);
 
+    num_l1 = (uint32_t)(size >> 20);
+
+    /*
+     * Make sure the subordinate has an L2 table for every section, they
+     * are what gets shared.
+     */
     PMAP_LOCK(subord);
     subord->pm_shared = TRUE;
+    for (i = 0, vaddr = (vm_offset_t)nstart; i < num_l1; i++, vaddr += L1_SECT_SIZE) {
+        while (!tte_is_page_table(*(uint32_t*)addr_to_tte(subord->ttb, vaddr))) {
+            PMAP_UNLOCK(subord);
+            if (tte_is_section(*(uint32_t*)addr_to_tte(subord->ttb, vaddr)))
+                (void) pmap_demote_section(subord, vaddr, TRUE);
+            else
+                pmap_expand(subord, vaddr);
+            PMAP_LOCK(subord);
+        }
+    }
     PMAP_UNLOCK(subord);
     
     kprintf("ttb of subordinate is 0x%08x, ttb grand: 0x%08x\n",
-            grand->ttb, subord->ttb);
+            subord->ttb, grand->ttb);
+    
+    /*
+     * Point the grand pmap at them. The slots must be empty or nested
+     * already, so there is nothing in the TLB to flush; anything the
+     * grand pmap mapped there itself would be lost.
+     */
+    PMAP_LOCK(grand);
+    for (i = 0, vaddr = (vm_offset_t)va_start; i < num_l1; i++, vaddr += L1_SECT_SIZE) {
+        tte_grand = (uint32_t*)addr_to_tte(grand->ttb, vaddr);
+        if (*tte_grand != 0 && !pmap_l1_nested(grand, vaddr)) {
+            PMAP_UNLOCK(grand);
+            return KERN_FAILURE;
+        }
+    }
+    for (i = 0, vaddr = (vm_offset_t)va_start; i < num_l1; i++, vaddr += L1_SECT_SIZE) {
+        tte_subord = (uint32_t*)addr_to_tte(subord->ttb, vaddr);
+        tte_grand = (uint32_t*)addr_to_tte(grand->ttb, vaddr);
+        
+        *tte_grand = *tte_subord;
+        pmap_l1_set_nested(grand, vaddr);
+    }
+    PMAP_UNLOCK(grand);
     
-    panic("not yet\n");
+    return KERN_SUCCESS;
+}
+
+/*
+ *	kern_return_t pmap_unnest(grand, vaddr, size)
+ *
+ *	grand  = the pmap that we will un-nest subord from
+ *	vaddr  = start of range in pmap to be unnested
+ *	size   = size of range in pmap to be unnested
+ *
+ *	Removes a pmap from another.  This is used to implement shared segments.
+ *	The L2 tables stay with the subordinate pmap.
+ */
+kern_return_t pmap_unnest(pmap_t grand, addr64_t vaddr, uint64_t size) {
+    vm_offset_t va, va_end;
+    spl_t spl;
+    
+    if ((size & (pmap_nesting_size_min - 1)) ||
+        (vaddr & (pmap_nesting_size_min - 1))) {
+        panic("pmap_unnest(%p,0x%llx,0x%llx): unaligned...\n",
+              grand, vaddr, size);
+    }
+    
+    va = (vm_offset_t)vaddr;
+    va_end = (vm_offset_t)(vaddr + size);
+    if (va_end > PMAP_USER_VA_LIMIT)
+        va_end = PMAP_USER_VA_LIMIT;
+    
+    PMAP_LOCK(grand);
+    
+    for (; va < va_end; va += L1_SECT_SIZE) {
+        if (!pmap_l1_nested(grand, va))
+            continue;
+        *(uint32_t*)addr_to_tte(grand->ttb, va) = 0;
+        pmap_l1_clear_nested(grand, va);
+    }
+    
+    PMAP_UNLOCK(grand);
+
+    /*
+     * The shootdown waits for other processors, which must not be
+     * spinning on the pmap lock meanwhile. The L2 tables stay with
+     * the subordinate pmap, so entries still cached until then only
+     * point at valid tables.
+     */
+    SPLVM(spl);
+    pmap_flush_tlb_range(grand, (vm_offset_t)vaddr, va_end);
+    SPLX(spl);
+    
+    return KERN_SUCCESS;
+}
+
+/*
+ * Invoked by the Mach VM to determine the platform specific unnest region.
+ * Nesting is per section, which is also pmap_nesting_size_min, so the VM
+ * range never needs widening.
+ */
+boolean_t pmap_adjust_unnest_parameters(__unused pmap_t p, __unused vm_map_offset_t *s, __unused vm_map_offset_t *e) {
+    return FALSE;
 }
 
+/**
+ * pmap_protect
+ *
+ * Lower the protection on the given range of addresses. Only write access
+ * is tracked by the hardware entries here, so anything that keeps write
+ * permission is left alone.
+ */
 void
 pmap_protect(
 	pmap_t		map,
@@ -1225,7 +2582,114 @@ pmap_protect(
 	vm_map_offset_t	eva,
 	vm_prot_t	prot)
 {
-	return;
+	vm_offset_t va, l1_end, end, pva;
+	uint32_t tte, *tte_ptr, *pte_ptr, *epte_ptr;
+	uint32_t pa;
+	pv_entry_t pv_e;
+	int changed = 0, i, pai;
+	spl_t spl;
+
+	if (map == PMAP_NULL || sva >= eva)
+		return;
+
+	if (prot == VM_PROT_NONE) {
+		pmap_remove(map, sva, eva);
+		return;
+	}
+
+	if (prot & VM_PROT_WRITE)
+		return;
+
+	va = (vm_offset_t)trunc_page(sva);
+	end = (vm_offset_t)round_page(eva);
+	if (map != kernel_pmap && end > PMAP_USER_VA_LIMIT)
+		end = PMAP_USER_VA_LIMIT;
+
+	pmap_demote_edges(map, va, end);
+
+	PMAP_READ_LOCK(map, spl);
+
+	while (va < end) {
+		l1_end = (va + L1_SECT_SIZE) & L1_SECT_ADDR_MASK;
+		if (l1_end == 0 || l1_end > end)
+			l1_end = end;
+
+		tte_ptr = (uint32_t*)addr_to_tte(map->ttb, va);
+		tte = *tte_ptr;
+		if (tte_is_section(tte) && l1_end - va != L1_SECT_SIZE) {
+			/*
+			 * A partial section entered since the edges were
+			 * demoted. Demote it too and go on with its pages.
+			 */
+			if (changed) {
+				pmap_flush_tlb_range(map, trunc_page(sva), va);
+				changed = 0;
+			}
+			PMAP_READ_UNLOCK(map, spl);
+			(void) pmap_demote_section(map, va, TRUE);
+			PMAP_READ_LOCK(map, spl);
+			continue;
+		} else if (tte_is_section(tte)) {
+			if ((tte & (L1_SECT_APX_BIT | (1 << L1_SECT_AP_SHIFT))) !=
+			    (L1_SECT_APX_BIT | (1 << L1_SECT_AP_SHIFT))) {
+				*tte_ptr = tte | L1_SECT_APX_BIT | (1 << L1_SECT_AP_SHIFT);
+				changed++;
+			}
+		} else if (tte_is_page_table(tte) && !pmap_l1_nested(map, va)) {
+			pte_ptr = (uint32_t*)phys_to_virt(L1_PTE_ADDR(tte) + pte_offset(va));
+			epte_ptr = pte_ptr + ((l1_end - va) >> PAGE_SHIFT);
+			for (pva = va; pte_ptr < epte_ptr; pte_ptr++, pva += PAGE_SIZE) {
+				if (*pte_ptr == 0)
+					continue;
+				/*
+				 * Large pages keep AP where small pages do, but
+				 * all 16 entries have to agree.
+				 */
+				if (pte_is_large_page(*pte_ptr)) {
+					if ((*pte_ptr & L2_ACCESS_PRO) == L2_ACCESS_PRO)
+						continue;
+					if (((uint32_t)pte_ptr & (L2_LARGE_COUNT * sizeof(uint32_t) - 1)) ||
+					    epte_ptr - pte_ptr < L2_LARGE_COUNT) {
+						pmap_demote_large(pte_ptr);
+					} else {
+						for (i = 0; i < L2_LARGE_COUNT; i++) {
+							pte_ptr[i] &= ~(L2_ACCESS_PRW);
+							pte_ptr[i] |= (L2_ACCESS_PRO);
+						}
+						pte_ptr += L2_LARGE_COUNT - 1;
+						pva += (L2_LARGE_COUNT - 1) * PAGE_SIZE;
+						changed++;
+						continue;
+					}
+				}
+				/*
+				 * The mapping loses write permission, also for
+				 * the modify emulation fault.
+				 */
+				pa = *pte_ptr & L2_ADDR_MASK;
+				if (valid_page(pa)) {
+					pai = pa_index(pa);
+					LOCK_PVH(pai);
+					pv_e = pmap_pv_find(map, pva, pai);
+					if (pv_e != PV_ENTRY_NULL)
+						pv_e->attr &= ~ATTR_WRITE;
+					UNLOCK_PVH(pai);
+				}
+				if ((*pte_ptr & L2_ACCESS_PRO) == L2_ACCESS_PRO)
+					continue;
+				*pte_ptr &= ~(L2_ACCESS_PRW);
+				*pte_ptr |= (L2_ACCESS_PRO);
+				changed++;
+			}
+		}
+
+		va = l1_end;
+	}
+
+	if (changed)
+		pmap_flush_tlb_range(map, trunc_page(sva), end);
+
+	PMAP_READ_UNLOCK(map, spl);
 }
 
 /**
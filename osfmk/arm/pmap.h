@@ -65,10 +65,14 @@ struct pmap {
 	decl_simple_lock_data(,lock)	/* lock on map */
 	uint32_t        ttb;
     uint32_t        ttb_phys;
+    uint32_t        asid;           /* address space ID, 0 is the kernel */
+    uint32_t        asid_generation;    /* allocator generation of asid */
     vm_offset_t     l2_cache;
     int             ref_count;
     ledger_t        ledger;
-    boolean_t       pm_shared;
+    boolean_t       pm_shared;      /* nested into other pmaps */
+    uint32_t        pm_cpus;        /* processors that may cache our entries */
+    uint32_t        pm_nested[PMAP_USER_L1_COUNT / 32];    /* L1 slots borrowed from a nested pmap */
     task_map_t      pm_task_map;
     int             nx_enabled;
     struct pmap_statistics  stats;
@@ -80,7 +84,7 @@ struct pmap {
 #define pmap_kernel_va(VA)	\
 	(((VA) >= VM_MIN_KERNEL_ADDRESS) && ((VA) <= vm_last_addr))
 
-#define SUPERPAGE_NBASEPAGES 0
+#define SUPERPAGE_NBASEPAGES 0 /* block mappings are not on pv lists, no superpages */
 
 #define PMAP_DEFAULT_CACHE	0
 #define PMAP_INHIBIT_CACHE	1
@@ -125,6 +129,15 @@ struct pmap {
 
 #define L1_PTE_ADDR(tte) (tte & L1_PTE_ADDR_MASK)
 
+#define L1_SECT_SIZE 0x00100000 /* 1MB: VA covered by one L1 entry */
+
+/*
+ * User translation tables are a single page; with TTBCR.N = 2 they
+ * translate the low 1GB and everything above goes through TTBR1.
+ */
+#define PMAP_USER_L1_COUNT (PAGE_SIZE / sizeof(pd_entry_t))
+#define PMAP_USER_VA_LIMIT (PMAP_USER_L1_COUNT * L1_SECT_SIZE)
+
 #define L1_TYPE_MASK 3 /* two least bits */
 
 #define L1_TYPE_FAULT 0
@@ -149,6 +162,36 @@ struct pmap {
 #define L2_B_BIT 0x4 /* B bit */
 #define L2_S_BIT 0x400 /* S bit */
 #define L2_NG_BIT 0x800 /* nG bit */
+#define L2_AP_MASK 0x30 /* AP[1:0] */
+#define L2_APX_BIT 0x200 /* APX bit */
+#define L2_TEX_MASK 0x1c0 /* TEX[2:0] */
+#define L2_TYPE_MASK 3 /* two least bits */
+
+/*
+ * 64KB large pages. A large page is entered as 16 identical,
+ * consecutive L2 entries; TEX and XN move compared to a small page.
+ */
+#define L2_LARGE_PAGE 0x1
+#define L2_LARGE_SIZE 0x10000
+#define L2_LARGE_COUNT (L2_LARGE_SIZE / PAGE_SIZE)
+#define L2_LARGE_ADDR_MASK 0xffff0000 /* Bits [31:16] */
+#define L2_LARGE_TEX_SHIFT 12
+#define L2_LARGE_NX_BIT 0x8000 /* XN bit */
+
+#define pte_is_large_page(pte) ((pte & L2_TYPE_MASK) == L2_LARGE_PAGE)
+
+/*
+ * 1MB sections, entered directly into the L1 table.
+ */
+#define L1_SECT_COUNT (L1_SECT_SIZE / PAGE_SIZE)
+#define L1_SECT_NX_BIT (1 << 4) /* XN bit */
+#define L1_SECT_AP_SHIFT 10
+#define L1_SECT_TEX_SHIFT 12
+#define L1_SECT_APX_BIT (1 << 15) /* APX bit */
+#define L1_SECT_S_BIT (1 << 16) /* S bit */
+#define L1_SECT_NG_BIT (1 << 17) /* nG bit */
+
+#define tte_is_section(tte) ((tte & L1_TYPE_MASK) == L1_TYPE_SECT)
 
 extern addr64_t	   	kvtophys(vm_offset_t va);				/* Get physical address from kernel virtual */
 extern vm_map_offset_t kvtophys64(vm_map_offset_t va);				/* Get 64-bit physical address from kernel virtual */
@@ -184,10 +227,17 @@ extern void sync_ppage(ppnum_t pa);
 extern void	sync_cache_virtual(vm_offset_t va, unsigned length);
 extern void flush_dcache(vm_offset_t va, unsigned length, boolean_t phys);
 extern void flush_dcache64(addr64_t va, unsigned length, boolean_t phys);
+extern void clean_dcache_range(vm_offset_t va, vm_size_t length);
 extern void invalidate_dcache(vm_offset_t va, unsigned length, boolean_t phys);
 extern void invalidate_dcache64(addr64_t va, unsigned length, boolean_t phys);
 extern void invalidate_icache(vm_offset_t va, unsigned length, boolean_t phys);
 extern void invalidate_icache64(addr64_t va, unsigned length, boolean_t phys);
+extern void flush_mmu_tlb(void);
+extern void flush_mmu_single(vm_offset_t va);
+extern void flush_mmu_range(vm_offset_t start, vm_offset_t end, uint32_t asid);
+extern void flush_mmu_asid(uint32_t asid);
+extern void flush_mmu_range_all_asid(vm_offset_t start, vm_offset_t end);
+extern void set_mmu_ttb_asid(uint32_t ttb, uint32_t asid);
 extern void pmap_map_block(pmap_t pmap, addr64_t va, ppnum_t pa, uint32_t size, vm_prot_t prot, int attr, unsigned int flags);
 extern int pmap_map_block_rc(pmap_t pmap, addr64_t va, ppnum_t pa, uint32_t size, vm_prot_t prot, int attr, unsigned int flags);
 
@@ -200,6 +250,9 @@ extern void pmap_init_sharedpage(vm_offset_t cpg);
 extern void pmap_disable_NX(pmap_t pmap);
 
 extern boolean_t pmap_valid_page(ppnum_t pn);
+extern boolean_t pmap_fault_refmod(pmap_t pmap, vm_offset_t va, vm_prot_t fault_type);
+struct cpu_tlb_request;
+extern void pmap_flush_tlb_request(struct cpu_tlb_request *req);
 
 extern void pt_fake_zone_init(int);
 extern void pt_fake_zone_info(int *, vm_size_t *, vm_size_t *, vm_size_t *, vm_size_t *, 
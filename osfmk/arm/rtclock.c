@@ -41,6 +41,7 @@
 #include <kern/macro_help.h>
 #include <kern/misc_protos.h>
 #include <kern/spl.h>
+#include <kern/simple_lock.h>
 #include <kern/assert.h>
 #include <kern/etimer.h>
 #include <mach/vm_prot.h>
@@ -52,6 +53,7 @@
 #include <sys/kdebug.h>
 
 #include <arm/machine_cpu.h>
+#include <arm/mp.h>
 
 #include <pexpert/pexpert.h>
 #include <pexpert/arm/boot.h>
@@ -60,11 +62,28 @@
 #include <libkern/OSBase.h>
 
 static uint32_t rtclock_sec_divisor;
-static uint64_t rtclock_min_decrementer = 1 * NSEC_PER_USEC;
-static uint64_t rtclock_max_decrementer = 100000000;
+
+/* Decrementer bounds in absolute time, set up by rtclock_init. */
+static uint64_t rtclock_min_decrementer = 1;
+static uint64_t rtclock_max_decrementer = 0;
 
 static uint64_t rtclock_scaler = 0;
 
+/*
+ * Largest amount a non-critical timer deadline may be pushed back so
+ * that it shares a pop with its neighbours, see timer_call_slop.
+ * Set with the "timer_coalesce_us" boot-arg.
+ */
+static uint32_t rtclock_coalesce_us = 1000;
+uint64_t rtclock_coalesce_window = 0;
+
+/*
+ * There is a single decrementer, owned by the boot processor, and every
+ * pop is passed on by mp_broadcast_clock. It is always programmed for
+ * the earliest pop any processor wants.
+ */
+decl_simple_lock_data(static, rtclock_pop_lock)
+
 extern uint64_t clock_decrementer;
 
 static uint64_t
@@ -75,33 +94,58 @@ deadline_to_decrementer(
 	uint64_t	delta;
 
 	if (deadline <= now)
-		return rtclock_sec_divisor;
+		return rtclock_min_decrementer;
 	else {
 		delta = deadline - now;
-        //kprintf("wat %llu %llu %llu %llu\n", delta, deadline, now, (deadline - now));
+		if (delta < rtclock_min_decrementer)
+			return rtclock_min_decrementer;
+		if (delta > rtclock_max_decrementer)
+			return rtclock_max_decrementer;
 		return (delta);
 	}
 }
 
 int setPop(uint64_t time)
 {
+	cpu_data_t	*cdp = current_cpu_datap();
+	cpu_data_t	*pp;
 	uint64_t	now;
 	uint64_t	pop;
-    
+	unsigned int	cpu;
+
+	/* Too early, the timer is still ticking at its boot period. */
+	if (!rtclock_scaler)
+		return 0;
+
+	now = mach_absolute_time();
+
 	/* 0 and EndOfAllTime are special-cases for "clear the timer" */
-	if (time == 0 || time == EndOfAllTime ) {
-		time = EndOfAllTime;
-		now = 0;
-		pop = deadline_to_decrementer(0, 0);
-	} else {
-		now = pe_arm_get_timebase(NULL) * rtclock_scaler;	/* The time in nanoseconds */
-		pop = deadline_to_decrementer(time, now);
+	if (time == 0 || time == EndOfAllTime)
+		cdp->rtcPop = EndOfAllTime;
+	else
+		cdp->rtcPop = now + deadline_to_decrementer(time, now);
+
+	/*
+	 * Pick the earliest pop of all processors. Pops of other processors
+	 * that are already due have been signalled and will be reprogrammed
+	 * from there; counting them here would only re-fire the timer.
+	 */
+	simple_lock(&rtclock_pop_lock);
+
+	pop = cdp->rtcPop;
+	for (cpu = 0; cpu < real_ncpus; cpu++) {
+		pp = cpu_data_ptr[cpu];
+		if (pp == NULL || pp == cdp || !pp->cpu_running)
+			continue;
+		if (pp->rtcPop > now && pp->rtcPop < pop)
+			pop = pp->rtcPop;
 	}
 
-	/* Record requested and actual deadlines set */
-	current_cpu_datap()->rtcPop	= pop;
+	pe_arm_set_timer_decrementer(deadline_to_decrementer(pop, now));
 
-	return (pop - now);
+	simple_unlock(&rtclock_pop_lock);
+
+	return (int)(cdp->rtcPop - now);
 }
 
 
@@ -109,6 +153,11 @@ void rtclock_intr(arm_saved_state_t* regs) {
     /* Interrupts must be enabled. */
 
     spl_t x = splclock();
+
+    /* Only the boot processor takes the timebase interrupt. */
+    if (cpu_number() == master_cpu && real_ncpus > 1)
+        mp_broadcast_clock(mach_absolute_time() + rtclock_min_decrementer);
+
     etimer_intr(0, 0);
     splx(x);
     
@@ -213,6 +262,8 @@ int rtclock_init(void)
 {
     kprintf("rtclock_init: hello\n");
     
+    simple_lock_init(&rtclock_pop_lock, 0);
+    
     /* Interrupts must be initialized for the timer to work */
     assert(!ml_get_interrupts_enabled());
     
@@ -224,6 +275,16 @@ int rtclock_init(void)
         panic("Invalid RTC second divisor, perhaps the RTC wasn't configured correctly?");
     }
     
+    /*
+     * Everything is one-shot from here on; the longest pop is one second
+     * so a lost deadline never stalls the clock for long.
+     */
+    rtclock_min_decrementer = 1;
+    rtclock_max_decrementer = rtclock_sec_divisor;
+
+    PE_parse_boot_argn("timer_coalesce_us", &rtclock_coalesce_us, sizeof(rtclock_coalesce_us));
+    rtclock_coalesce_window = ((uint64_t)rtclock_coalesce_us * NSEC_PER_USEC) / (NSEC_PER_SEC / rtclock_sec_divisor);
+
     rtclock_scaler = (NSEC_PER_SEC / rtclock_sec_divisor);
 
     /* Did they go away? */
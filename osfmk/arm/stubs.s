@@ -121,7 +121,6 @@ UNIMPLEMENTED_STUB(_kdb_on)
 
 UNIMPLEMENTED_STUB(_kern_dump)
 
-UNIMPLEMENTED_STUB(_machine_signal_idle)
 UNIMPLEMENTED_STUB(_mapping_set_mod)
 
 UNIMPLEMENTED_STUB(_ml_nofault_copydeclare_stub)
@@ -133,7 +132,6 @@ UNIMPLEMENTED_STUB(_pmsControl)
 
 UNIMPLEMENTED_STUB(_sdt_invop)
 
-UNIMPLEMENTED_STUB(_slave_machine_init)
 
 UNIMPLEMENTED_STUB(_tempDTraceTrapHook)
 
@@ -154,11 +152,8 @@ UNIMPLEMENTED_STUB(_commpage_text_populate)
 UNIMPLEMENTED_STUB(_cons_ops_index)
 UNIMPLEMENTED_STUB(_consider_machine_collect)
 UNIMPLEMENTED_STUB(_cpu_control)
-UNIMPLEMENTED_STUB(_cpu_data_ptr)
-UNIMPLEMENTED_STUB(_cpu_exit_wait)
 UNIMPLEMENTED_STUB(_cpu_info)
 UNIMPLEMENTED_STUB(_cpu_info_count)
-UNIMPLEMENTED_STUB(_cpu_start)
 UNIMPLEMENTED_STUB(_cpuid_cpusubtype)
 UNIMPLEMENTED_STUB(_cpuid_cputype)
 UNIMPLEMENTED_STUB(_debug_boot_arg)
@@ -173,7 +168,6 @@ UNIMPLEMENTED_STUB(_gIOHibernateHandoffPages)
 UNIMPLEMENTED_STUB(_gIOHibernateState)
 UNIMPLEMENTED_STUB(_get_useraddr)
 UNIMPLEMENTED_STUB(_halt_all_cpus)
-UNIMPLEMENTED_STUB(_handle_pending_TLB_flushes)
 UNIMPLEMENTED_STUB(_hibernate_page_bitmap_count)
 UNIMPLEMENTED_STUB(_hibernate_page_bitmap_pin)
 UNIMPLEMENTED_STUB(_hibernate_page_bitset)
@@ -203,28 +197,19 @@ UNIMPLEMENTED_STUB(_ml_thread_is64bit)
 UNIMPLEMENTED_STUB(_nx_enabled)
 UNIMPLEMENTED_STUB(_panicDialogDesired)
 UNIMPLEMENTED_STUB(_panic_display_pal_info)
-UNIMPLEMENTED_STUB(_pmap_adjust_unnest_parameters)
 UNIMPLEMENTED_STUB(_pmap_attribute)
 UNIMPLEMENTED_STUB(_pmap_attribute_cache_sync)
 UNIMPLEMENTED_STUB(_pmap_cache_attributes)
-UNIMPLEMENTED_STUB(_pmap_clear_modify)
-UNIMPLEMENTED_STUB(_pmap_clear_reference)
 UNIMPLEMENTED_STUB(_pmap_copy)
 UNIMPLEMENTED_STUB(_pmap_copy_part_page)
 UNIMPLEMENTED_STUB(_pmap_disable_NX)
-UNIMPLEMENTED_STUB(_pmap_get_refmod)
-UNIMPLEMENTED_STUB(_pmap_is_modified)
-UNIMPLEMENTED_STUB(_pmap_is_referenced)
-UNIMPLEMENTED_STUB(_pmap_map_block)
 UNIMPLEMENTED_STUB(_pmap_mem_regions)
 UNIMPLEMENTED_STUB(_pmap_mem_regions_count)
 UNIMPLEMENTED_STUB(_pmap_resident_max)
 UNIMPLEMENTED_STUB(_pmap_set_cache_attributes)
 UNIMPLEMENTED_STUB(_pmap_sync_page_attributes_phys)
-UNIMPLEMENTED_STUB(_pmap_unnest)
 UNIMPLEMENTED_STUB(_pt_fake_zone_info)
 UNIMPLEMENTED_STUB(_pt_fake_zone_init)
-UNIMPLEMENTED_STUB(_real_ncpus)
 UNIMPLEMENTED_STUB(_save_kdebug_enable)
 UNIMPLEMENTED_STUB(_saved_state64)
 UNIMPLEMENTED_STUB(_segHIBB)
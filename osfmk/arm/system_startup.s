@@ -176,6 +176,75 @@ mmu_initialized:
     /* Boot to ARM init. */
     bx      lr
 
+/*
+ * Secondary processor startup.
+ *
+ * The platform expert starts secondary processors here, at the physical
+ * address, with the MMU off. The bootstrap translation table and stack
+ * come from _slave_boot_args, set up by cpu_start. The table is the
+ * kernel's plus an identity section for this code; once running at the
+ * virtual address we move to the kernel's table proper.
+ */
+EnterARM(arm_slave_start)
+    cpsid   if
+
+    /* Virtual to physical offset, to read the arguments. */
+    adr     r4, _arm_slave_start
+    LoadConstantToReg(_arm_slave_start, r5)
+    sub     r5, r5, r4
+    LoadConstantToReg(_slave_boot_args, r6)
+    sub     r6, r6, r5
+    ldr     r7, [r6]            /* bootstrap ttb */
+    ldr     r8, [r6, #4]        /* stack */
+
+    /* Adjust DACR register. */
+    mov     r4, #0x1
+    mcr     p15, 0, r4, c3, c0, 0
+
+    /* Clean TLB and instruction cache, TTBR0 covers everything. */
+    mov     r4, #0
+    mcr     p15, 0, r4, c8, c7, 0
+    mcr     p15, 0, r4, c7, c5, 0
+    mcr     p15, 0, r4, c2, c0, 2
+    mcr     p15, 0, r4, c13, c0, 1
+
+    orr     r4, r7, #0x18
+    mcr     p15, 0, r4, c2, c0, 0
+    isb     sy
+
+    /* Start MMU, with high vectors and unaligned access like the boot processor. */
+    mrc     p15, 0, r4, c1, c0, 0
+    orr     r4, r4, #1
+    orr     r4, r4, #(1 << 13)
+    orr     r4, r4, #(1 << 23)
+    mcr     p15, 0, r4, c1, c0, 0
+    isb     sy
+
+    /* Off the identity section. */
+    LoadConstantToReg(slave_virtual, pc)
+
+slave_virtual:
+    /* Switch to the kernel translation tables. */
+    LoadConstantToReg(_kernel_pmap, r4)
+    ldr     r4, [r4]
+    ldr     r4, [r4, PMAP_TTB_PHYS]
+    orr     r4, r4, #0x18
+    mcr     p15, 0, r4, c2, c0, 0
+    mcr     p15, 0, r4, c2, c0, 1
+    mov     r4, #2
+    mcr     p15, 0, r4, c2, c0, 2
+    mov     r4, #0
+    mcr     p15, 0, r4, c8, c7, 0
+    mcr     p15, 0, r4, c7, c5, 0
+    dsb     sy
+    isb     sy
+
+    /* Zero the frame pointer and go to ARM slave init. */
+    mov     r7, #0
+    mov     sp, r8
+    LoadConstantToReg(_arm_slave_init, lr)
+    bx      lr
+
 /*
  * Initial stack
  */
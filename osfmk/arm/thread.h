@@ -77,6 +77,9 @@ struct machine_thread {
     int                 vfp_enable;
     arm_vfp_state_t     vfp_regs;
 
+    int                 vfp_kernel;         /* kernel is using NEON */
+    arm_vfp_state_t     vfp_kernel_regs;    /* ...and its registers while switched out */
+
     uint32_t            preempt_count;
 
 #ifdef	MACH_BSD
@@ -40,6 +40,8 @@
 #include <arm/cpu_data.h>
 #include <kern/thread.h>
 #include <arm/misc_protos.h>
+#include <arm/armops.h>
+#include <arm/machine_routines.h>
 #include <kern/kalloc.h>
 #include <vm/vm_kern.h>
 #include <vm/vm_map.h>
@@ -56,6 +58,13 @@ thread_t Switch_context(thread_t old_thread, thread_continue_t continuation, thr
 void Call_continuation(thread_continue_t continuation, void *parameter, wait_result_t wresult, vm_offset_t stack);
 
 static void save_vfp_context(thread_t thread);
+static void save_vfp_kernel_context(thread_t thread);
+static void load_vfp_kernel_context(thread_t thread);
+
+/*
+ * Set at boot if the block copy routines may use NEON.
+ */
+uint32_t arm_neon_enabled = 0;
 
 /**
  * arm_set_threadpid_user_readonly
@@ -82,8 +91,9 @@ void arm_set_threadpid_priv_readwrite(uint32_t* address) {
  */
 void machine_set_current_thread(thread_t thread)
 {
-    /* Set the current thread. */
+    /* Set the current thread, it now runs on this processor. */
     CurrentThread = thread;
+    thread->machine.cpu_data = current_cpu_datap();
     
     arm_set_threadpid_user_readonly((uint32_t*)thread->machine.cthread_self);
     arm_set_threadpid_priv_readwrite((uint32_t*)thread);
@@ -132,6 +142,7 @@ kern_return_t machine_thread_create(thread_t thread, task_t task)
     thread->machine.cpu_data = cpu_datap(cpu_number());
     thread->machine.vfp_enable = 0;
     thread->machine.vfp_dirty = 0;
+    thread->machine.vfp_kernel = 0;
 
     /* Also kernel threads */
     thread->machine.uss = &thread->machine.user_regs;
@@ -159,8 +170,10 @@ thread_t machine_switch_context(thread_t old, thread_continue_t continuation, th
     assert(datap != NULL);
     
     datap->old_thread = old;
+    new->machine.cpu_data = datap;
 
     save_vfp_context(old);
+    save_vfp_kernel_context(old);
     
     new_pmap = new->map->pmap;
     if ((old->map->pmap != new_pmap)) {
@@ -169,11 +182,12 @@ thread_t machine_switch_context(thread_t old, thread_continue_t continuation, th
         }
     }
        
-    /* VFP save needed */
-        
 	retval = Switch_context(old, continuation, new);
 	assert(retval != NULL);
 
+    /* We are old again. */
+    load_vfp_kernel_context(old);
+
 	return retval;
 }
 
@@ -248,6 +262,77 @@ static void save_vfp_context(thread_t thread)
     }
 }
 
+/**
+ * save_vfp_kernel_context
+ *
+ * A thread switched out in the middle of a NEON block copy keeps the
+ * kernel's registers in the pcb until it runs again.
+ */
+static void save_vfp_kernel_context(thread_t thread)
+{
+    if(thread->machine.vfp_kernel) {
+        vfp_context_save(&thread->machine.vfp_kernel_regs);
+        vfp_enable_exception(FALSE);
+    }
+}
+
+/**
+ * load_vfp_kernel_context
+ *
+ * Undo save_vfp_kernel_context once the thread is back on a processor.
+ */
+static void load_vfp_kernel_context(thread_t thread)
+{
+    if(thread->machine.vfp_kernel) {
+        vfp_enable_exception(TRUE);
+        vfp_context_load(&thread->machine.vfp_kernel_regs);
+    }
+}
+
+/**
+ * vfp_kernel_enter
+ *
+ * Claim the NEON registers for the kernel. Live user state is written back
+ * to the pcb first and is reloaded by the undefined instruction handler on
+ * its next use. Interrupts are held off while the ownership changes so a
+ * context switch never sees it half done. Must not be used from interrupt
+ * context, the callers check for that.
+ */
+void vfp_kernel_enter(void)
+{
+    thread_t    thread = current_thread();
+    boolean_t   istate;
+
+    istate = ml_set_interrupts_enabled(FALSE);
+
+    assert(!thread->machine.vfp_kernel);
+    save_vfp_context(thread);
+    thread->machine.vfp_enable = 0;
+    thread->machine.vfp_kernel = 1;
+    vfp_enable_exception(TRUE);
+
+    ml_set_interrupts_enabled(istate);
+}
+
+/**
+ * vfp_kernel_exit
+ *
+ * Give the NEON registers back. The unit is left disabled so that user
+ * state gets loaded again before anyone else can see the registers.
+ */
+void vfp_kernel_exit(void)
+{
+    thread_t    thread = current_thread();
+    boolean_t   istate;
+
+    istate = ml_set_interrupts_enabled(FALSE);
+
+    vfp_enable_exception(FALSE);
+    thread->machine.vfp_kernel = 0;
+
+    ml_set_interrupts_enabled(istate);
+}
+
 /**
  * machine_stack_attach
  *
@@ -53,6 +53,10 @@
 
 #define FAILURE_TRANSLATION     5   /* Translation fault on page */
 #define FAILURE_SECTION         7   /* Translation fault on section */
+#define FAILURE_PERM_SECTION    0xD /* Permission fault on section */
+#define FAILURE_PERM_PAGE       0xF /* Permission fault on page */
+
+#define FSR_WNR                 (1 << 11)   /* Data abort caused by a write */
 
 #define FSR_FAIL                0xF /* Bits for failure in DFSR register */
 
@@ -286,11 +290,20 @@ void sleh_abort(void* context, int reason)
             goto panicOut;
         }
         
+        /* Writes need write access, the pmap maps read-only for copy-on-write */
+        if((reason == SLEH_ABORT_TYPE_DATA_ABORT) && (abort_context->fsr & FSR_WNR))
+            prot |= VM_PROT_WRITE;
+        
         /* Check to see if it is a fault */
         if(((abort_context->fsr & FSR_FAIL) == FAILURE_TRANSLATION) ||
-           ((abort_context->fsr & FSR_FAIL) == FAILURE_SECTION)) {
+           ((abort_context->fsr & FSR_FAIL) == FAILURE_SECTION) ||
+           ((abort_context->fsr & FSR_FAIL) == FAILURE_PERM_PAGE) ||
+           ((abort_context->fsr & FSR_FAIL) == FAILURE_PERM_SECTION)) {
             map = thread->map;
             assert(map);
+            /* First access since the page's referenced/modified state was cleared */
+            if(pmap_fault_refmod(map->pmap, abort_context->far, prot))
+                return;
             /* Attempt to fault it */
             kr = vm_fault(map, vm_map_trunc_page(abort_context->far), prot,
                         FALSE, THREAD_UNINT, NULL, 0);
@@ -117,3 +117,18 @@ EnterARM(vfp_enable_exception)
     /* Return the original state. */
     mov     r0, r2
     bx      lr
+
+/**
+ * vfp_neon_present
+ *
+ * Return whether the processor implements the Advanced SIMD (NEON)
+ * load/store and integer instructions, according to MVFR1.
+ */
+EnterARM(vfp_neon_present)
+    vmrs    r1, mvfr1
+    mov     r0, #0
+    tst     r1, #0xf00
+    bxeq    lr
+    tst     r1, #0xf000
+    movne   r0, #1
+    bx      lr
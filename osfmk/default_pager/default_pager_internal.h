@@ -95,6 +95,16 @@
 
 #define	USE_PRECIOUS	0
 
+/*
+ * Compressed memory pool ahead of the paging segments (dp_compressor.c).
+ * It needs the WKdm compressor, which is built along with hibernation.
+ */
+#if HIBERNATION
+#define	CONFIG_DP_COMPRESSOR	1
+#else
+#define	CONFIG_DP_COMPRESSOR	0
+#endif
+
 #ifdef	USER_PAGER
 #define UP(stuff)	stuff
 #else	/* USER_PAGER */
@@ -584,6 +594,9 @@ typedef struct vstruct {
 		struct vs_map	*vsu_dmap;	/* Direct map of clusters */
 		struct vs_map	**vsu_imap;	/* Indirect map of clusters */
 	} vs_un;
+#if CONFIG_DP_COMPRESSOR
+	queue_head_t		vs_dpc_slots;	/* pages in the compressed pool */
+#endif
 } *vstruct_t;
 
 #define vs_dmap vs_un.vsu_dmap
@@ -771,6 +784,19 @@ extern unsigned int	ps_vstruct_allocated_pages(vstruct_t,
 						   unsigned int);
 extern boolean_t	bs_set_default_clsize(unsigned int);
 
+#if CONFIG_DP_COMPRESSOR
+extern void		dpc_init(void);
+extern boolean_t	dpc_pageout(vstruct_t,
+				    upl_t,
+				    upl_page_info_t *,
+				    unsigned int,
+				    dp_offset_t);
+extern kern_return_t	dpc_pagein(vstruct_t,
+				   dp_offset_t,
+				   dp_size_t);
+extern void		dpc_vstruct_dealloc(vstruct_t);
+#endif	/* CONFIG_DP_COMPRESSOR */
+
 extern boolean_t	verbose;
 
 extern thread_call_t	default_pager_backing_store_monitor_callout;
@@ -284,6 +284,9 @@ bs_initialize(void)
 		clustered_reads[i] = 0;
 	}
 
+#if CONFIG_DP_COMPRESSOR
+	dpc_init();
+#endif
 }
 
 /*
@@ -1376,6 +1379,9 @@ ps_vstruct_create(
 		vs->vs_indirect = FALSE;
 	}
 	vs->vs_xfer_pending = FALSE;
+#if CONFIG_DP_COMPRESSOR
+	queue_init(&vs->vs_dpc_slots);
+#endif
 	DP_DEBUG(DEBUG_VS_INTERNAL,
 		 ("map=0x%x, indirect=%d\n", (int) vs->vs_dmap, vs->vs_indirect));
 
@@ -1854,6 +1860,10 @@ ps_vstruct_dealloc(
 	unsigned int	i;
 //	spl_t	s;
 
+#if CONFIG_DP_COMPRESSOR
+	dpc_vstruct_dealloc(vs);
+#endif
+
 	VS_MAP_LOCK(vs);
 
 	/*
@@ -2948,6 +2958,15 @@ pvs_cluster_read(
 		 */
 		if (fault_info == NULL || ((vm_object_fault_info_t)fault_info)->cluster_size > PAGE_SIZE)
 			request_flags |= UPL_NOBLOCK;
+
+#if CONFIG_DP_COMPRESSOR
+		/*
+		 * the compressed pool holds the newest copy of
+		 * any page it has, so look there first
+		 */
+		if (dpc_pagein(vs, vs_offset, cnt) == KERN_SUCCESS)
+			return KERN_SUCCESS;
+#endif
 	}
 
 again:
@@ -3434,6 +3453,15 @@ vs_cluster_write(
 
 		pl = UPL_GET_INTERNAL_PAGE_LIST(upl);
 
+#if CONFIG_DP_COMPRESSOR
+		/*
+		 * keep what compresses well in memory; only the
+		 * rest goes on to the paging segments
+		 */
+		if (dpc_pageout(vs, upl, pl, upl->size / PAGE_SIZE, upl_offset_in_object))
+			return KERN_SUCCESS;
+#endif
+
 		seg_size = cl_size - (upl_offset_in_object % cl_size);
 		upl_offset_aligned = upl_offset_in_object & ~(cl_size - 1);
 		page_index = 0;
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2013 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ *	Default Pager.
+ *		Compressed memory pool.
+ *
+ *	Dirty anonymous pages handed to the default pager are first
+ *	compressed with WKdm and kept in kernel memory.  Only pages
+ *	that do not compress well, or that arrive while the pool is
+ *	full, go on to the paging segments.  A fault on a pooled page
+ *	is satisfied by decompressing it straight into the UPL, and
+ *	the pool copy is released: the page comes back dirty.
+ *
+ *	Each pooled page lives in its own kalloc'ed slot, so the
+ *	kalloc size classes do the packing.  Slots are found through
+ *	a hash on <vstruct, offset> and are also queued on their
+ *	vstruct so that they can be released when it goes away.
+ *
+ *	The pool limit applies to the compressed bytes held, i.e.
+ *	the memory the pool actually takes.  Compression runs outside
+ *	of dpc_lock, each pageout in a scratch buffer of its own.
+ *
+ *	tools/tests/dp_compressor is a user space round trip test
+ *	of the WKdm routines used here.
+ */
+
+#include <mach/memory_object_control.h>
+#include <mach/machine.h>
+#include <mach/upl.h>
+#include <default_pager/default_pager_internal.h>
+
+#include <kern/kalloc.h>
+#include <kern/queue.h>
+#include <kern/clock.h>
+
+#include <vm/vm_kern.h>
+#include <vm/vm_map.h>
+#include <vm/vm_pageout.h>
+#include <vm/vm_protos.h>
+
+#include <pexpert/pexpert.h>
+
+/*
+ * Statistics, exported through the vm.dp_compressor_* sysctls; they
+ * stay zero when the pool is not configured.
+ */
+unsigned int	dpc_pool_max_pages;		/* limit on atop(dpc_pool_bytes) */
+unsigned int	dpc_pool_pages;			/* pages held in the pool */
+uint64_t	dpc_pool_bytes;			/* compressed bytes held */
+uint64_t	dpc_compressions;		/* pages compressed into the pool */
+uint64_t	dpc_compress_rejects;		/* pages that did not compress */
+uint64_t	dpc_pool_full;			/* pages sent on because of the limit */
+uint64_t	dpc_decompressions;		/* faults satisfied from the pool */
+uint64_t	dpc_decompress_ns;		/* time spent decompressing */
+
+#if CONFIG_DP_COMPRESSOR
+
+#include <libkern/WKdm.h>
+
+/*
+ * Only keep a page if it shrinks to this size or less; anything
+ * larger is cheaper to write to the paging segments.
+ */
+#define DPC_MAX_CSIZE		((PAGE_SIZE * 3) / 4)
+
+/* default pool limit, as a percentage of physical memory */
+#define DPC_POOL_PERCENT	10
+
+/* pages of a pageout UPL considered; matches VM_SUPER_CLUSTER */
+#define DPC_UPL_PAGES_MAX	64
+
+#define DPC_HASH_SIZE		1024
+#define DPC_HASH(vs, offset)						\
+	((((uintptr_t)(vs) >> 4) ^ ((offset) >> PAGE_SHIFT)) & (DPC_HASH_SIZE - 1))
+
+struct dpc_slot {
+	queue_chain_t	ds_hash_link;	/* chain in dpc_hash bucket */
+	queue_chain_t	ds_vs_link;	/* chain in vs_dpc_slots */
+	vstruct_t	ds_vs;
+	dp_offset_t	ds_offset;	/* page offset in the vstruct */
+	unsigned int	ds_size;	/* compressed bytes in ds_data */
+	WK_word		ds_data[0];
+};
+
+typedef struct dpc_slot	*dpc_slot_t;
+
+#define DPC_SLOT_SIZE(csize)	(sizeof (struct dpc_slot) + (csize))
+
+/* compressor output can exceed a page for data that does not compress */
+#define DPC_SCRATCH_SIZE	(2 * PAGE_SIZE)
+
+static queue_head_t	dpc_hash[DPC_HASH_SIZE];
+static lck_mtx_t	dpc_lock;	/* hash, slot queues, free scratch, stats */
+
+/*
+ * One scratch buffer per processor, so that pageouts running at the
+ * same time each compress in their own.  Free ones are linked through
+ * their first word.
+ */
+static WK_word		*dpc_scratch_free;
+static boolean_t	dpc_scratch_wanted;
+
+#define DPC_LOCK()	lck_mtx_lock(&dpc_lock)
+#define DPC_UNLOCK()	lck_mtx_unlock(&dpc_lock)
+
+boolean_t	dpc_enabled = FALSE;
+
+void
+dpc_init(void)
+{
+	uint32_t	percent;
+	WK_word		*scratch;
+	int		ncpus;
+	int		i;
+
+	if (PAGE_SIZE != PAGE_SIZE_IN_BYTES)
+		return;
+
+	if (!PE_parse_boot_argn("dp_compressor", &percent, sizeof (percent)))
+		percent = DPC_POOL_PERCENT;
+	if (percent == 0 || percent > 100)
+		return;
+
+	ncpus = (machine_info.max_cpus > 0) ? machine_info.max_cpus : 1;
+	scratch = (WK_word *) kalloc(ncpus * DPC_SCRATCH_SIZE);
+	if (scratch == NULL)
+		return;
+	for (i = 0; i < ncpus; i++) {
+		*(WK_word **) scratch = dpc_scratch_free;
+		dpc_scratch_free = scratch;
+		scratch += DPC_SCRATCH_SIZE / sizeof (WK_word);
+	}
+
+	lck_mtx_init(&dpc_lock, &default_pager_lck_grp, &default_pager_lck_attr);
+	for (i = 0; i < DPC_HASH_SIZE; i++)
+		queue_init(&dpc_hash[i]);
+
+	dpc_pool_max_pages = (unsigned int) ((atop_64(max_mem) * percent) / 100);
+	dpc_enabled = TRUE;
+}
+
+/*
+ * Take a scratch buffer, waiting for one if they are all in use.
+ */
+static WK_word *
+dpc_scratch_get(void)
+{
+	WK_word		*scratch;
+
+	DPC_LOCK();
+	while ((scratch = dpc_scratch_free) == NULL) {
+		dpc_scratch_wanted = TRUE;
+		lck_mtx_sleep(&dpc_lock, LCK_SLEEP_DEFAULT,
+			      (event_t) &dpc_scratch_free, THREAD_UNINT);
+	}
+	dpc_scratch_free = *(WK_word **) scratch;
+	DPC_UNLOCK();
+
+	return (scratch);
+}
+
+static void
+dpc_scratch_put(
+	WK_word		*scratch)
+{
+	DPC_LOCK();
+	*(WK_word **) scratch = dpc_scratch_free;
+	dpc_scratch_free = scratch;
+	if (dpc_scratch_wanted) {
+		dpc_scratch_wanted = FALSE;
+		thread_wakeup((event_t) &dpc_scratch_free);
+	}
+	DPC_UNLOCK();
+}
+
+/*
+ * Called with dpc_lock held.
+ */
+static dpc_slot_t
+dpc_lookup(
+	vstruct_t	vs,
+	dp_offset_t	offset)
+{
+	queue_t		bucket;
+	dpc_slot_t	slot;
+
+	bucket = &dpc_hash[DPC_HASH(vs, offset)];
+	queue_iterate(bucket, slot, dpc_slot_t, ds_hash_link) {
+		if (slot->ds_vs == vs && slot->ds_offset == offset)
+			return (slot);
+	}
+	return (NULL);
+}
+
+/*
+ * Called with dpc_lock held; the caller frees the slot.
+ */
+static void
+dpc_remove(
+	dpc_slot_t	slot)
+{
+	queue_remove(&dpc_hash[DPC_HASH(slot->ds_vs, slot->ds_offset)],
+		     slot, dpc_slot_t, ds_hash_link);
+	queue_remove(&slot->ds_vs->vs_dpc_slots, slot, dpc_slot_t, ds_vs_link);
+
+	dpc_pool_pages--;
+	dpc_pool_bytes -= slot->ds_size;
+}
+
+/*
+ * Compress the dirty pages of a pageout UPL into the pool.  Pages
+ * that make it in are committed and marked clean and absent in "pl" so that
+ * vs_cluster_write() leaves them alone; any older pool copy of the
+ * others is dropped, since they are headed for the paging segments.
+ * Returns TRUE if that emptied the UPL, which has then been
+ * deallocated.
+ */
+boolean_t
+dpc_pageout(
+	vstruct_t	vs,
+	upl_t		upl,
+	upl_page_info_t	*pl,
+	unsigned int	num_pages,
+	dp_offset_t	upl_offset_in_object)
+{
+	vm_map_offset_t	kaddr;
+	dpc_slot_t	slot, old;
+	dp_offset_t	offset;
+	WK_word		*scratch;
+	unsigned int	page_index;
+	unsigned int	csize;
+	uint64_t	pooled = 0;
+	boolean_t	empty = FALSE;
+	boolean_t	full, reject;
+
+	if (!dpc_enabled)
+		return (FALSE);
+
+	if (vm_map_enter_upl(kernel_map, upl, &kaddr) != KERN_SUCCESS)
+		return (FALSE);
+
+	scratch = dpc_scratch_get();
+
+	if (num_pages > DPC_UPL_PAGES_MAX)
+		num_pages = DPC_UPL_PAGES_MAX;
+
+	for (page_index = 0; page_index < num_pages; page_index++) {
+		if (!UPL_PAGE_PRESENT(pl, page_index) ||
+		    !(UPL_DIRTY_PAGE(pl, page_index) || UPL_PRECIOUS_PAGE(pl, page_index)))
+			continue;
+
+		offset = upl_offset_in_object + (page_index * PAGE_SIZE);
+		slot = NULL;
+		full = reject = FALSE;
+
+		/*
+		 * The limit is checked without the lock; it is only
+		 * overshot by what the pageouts in progress add.
+		 */
+		if (atop_64(dpc_pool_bytes) >= dpc_pool_max_pages) {
+			full = TRUE;
+		} else {
+			csize = WKdm_compress((WK_word *)(uintptr_t)(kaddr + (page_index * PAGE_SIZE)),
+					      scratch, PAGE_SIZE_IN_WORDS);
+			if (csize > DPC_MAX_CSIZE) {
+				reject = TRUE;
+			} else {
+				slot = (dpc_slot_t) kalloc_noblock(DPC_SLOT_SIZE(csize));
+				if (slot != NULL) {
+					slot->ds_vs = vs;
+					slot->ds_offset = offset;
+					slot->ds_size = csize;
+					bcopy(scratch, slot->ds_data, csize);
+				}
+			}
+		}
+
+		DPC_LOCK();
+		if (full)
+			dpc_pool_full++;
+		if (reject)
+			dpc_compress_rejects++;
+		old = dpc_lookup(vs, offset);
+		if (old != NULL)
+			dpc_remove(old);
+		if (slot != NULL) {
+			queue_enter(&dpc_hash[DPC_HASH(vs, offset)], slot,
+				    dpc_slot_t, ds_hash_link);
+			queue_enter(&vs->vs_dpc_slots, slot, dpc_slot_t, ds_vs_link);
+			dpc_pool_pages++;
+			dpc_pool_bytes += csize;
+			dpc_compressions++;
+			pooled |= (1ULL << page_index);
+		}
+		DPC_UNLOCK();
+
+		if (old != NULL)
+			kfree(old, DPC_SLOT_SIZE(old->ds_size));
+	}
+
+	dpc_scratch_put(scratch);
+	vm_map_remove_upl(kernel_map, upl);
+
+	for (page_index = 0; page_index < num_pages && !empty; page_index++) {
+		if ((pooled & (1ULL << page_index)) == 0)
+			continue;
+
+		upl_commit_range(upl, page_index * PAGE_SIZE, PAGE_SIZE,
+				 UPL_COMMIT_CLEAR_DIRTY | UPL_COMMIT_NOTIFY_EMPTY,
+				 NULL, 0, &empty);
+		pl[page_index].phys_addr = 0;
+		pl[page_index].dirty = FALSE;
+		pl[page_index].precious = FALSE;
+	}
+
+	if (empty)
+		upl_deallocate(upl);
+
+	return (empty);
+}
+
+/*
+ * Satisfy a data request from the pool.  Returns KERN_FAILURE if
+ * the page is not pooled and the paging segments must be tried.
+ * A "cnt" of 0 only asks whether the page is present.
+ */
+kern_return_t
+dpc_pagein(
+	vstruct_t	vs,
+	dp_offset_t	vs_offset,
+	dp_size_t	cnt)
+{
+	upl_t		upl;
+	upl_page_info_t	*pl;
+	unsigned int	page_list_count;
+	vm_map_offset_t	kaddr;
+	dpc_slot_t	slot;
+	uint64_t	start, elapsed;
+
+	if (!dpc_enabled || dpc_pool_pages == 0)
+		return (KERN_FAILURE);
+
+	vs_offset = trunc_page(vs_offset);
+
+	DPC_LOCK();
+	slot = dpc_lookup(vs, vs_offset);
+	DPC_UNLOCK();
+
+	if (slot == NULL)
+		return (KERN_FAILURE);
+	if (cnt == 0)
+		return (KERN_SUCCESS);
+
+	/*
+	 * The pool copy is released once it has been decompressed,
+	 * so have the page come back dirty.
+	 */
+	page_list_count = 0;
+	memory_object_super_upl_request(vs->vs_control, (memory_object_offset_t)vs_offset,
+					PAGE_SIZE, PAGE_SIZE,
+					&upl, NULL, &page_list_count,
+					UPL_NO_SYNC | UPL_RET_ONLY_ABSENT | UPL_SET_LITE |
+					UPL_SET_INTERNAL | UPL_REQUEST_SET_DIRTY);
+
+	pl = UPL_GET_INTERNAL_PAGE_LIST(upl);
+	if (!UPL_PAGE_PRESENT(pl, 0)) {
+		/* already resident; nothing to provide */
+		upl_abort(upl, 0);
+		upl_deallocate(upl);
+		return (KERN_SUCCESS);
+	}
+
+	if (vm_map_enter_upl(kernel_map, upl, &kaddr) != KERN_SUCCESS) {
+		upl_abort(upl, 0);
+		upl_deallocate(upl);
+		return (KERN_FAILURE);
+	}
+
+	/* once off the hash the slot is ours, decompress it unlocked */
+	DPC_LOCK();
+	slot = dpc_lookup(vs, vs_offset);
+	if (slot != NULL)
+		dpc_remove(slot);
+	DPC_UNLOCK();
+
+	if (slot == NULL) {
+		vm_map_remove_upl(kernel_map, upl);
+		upl_abort(upl, 0);
+		upl_deallocate(upl);
+		return (KERN_FAILURE);
+	}
+
+	start = mach_absolute_time();
+	WKdm_decompress(slot->ds_data, (WK_word *)(uintptr_t)kaddr, PAGE_SIZE_IN_WORDS);
+	absolutetime_to_nanoseconds(mach_absolute_time() - start, &elapsed);
+
+	vm_map_remove_upl(kernel_map, upl);
+	kfree(slot, DPC_SLOT_SIZE(slot->ds_size));
+
+	DPC_LOCK();
+	dpc_decompressions++;
+	dpc_decompress_ns += elapsed;
+	DPC_UNLOCK();
+
+	upl_commit(upl, NULL, 0);
+	upl_deallocate(upl);
+
+	return (KERN_SUCCESS);
+}
+
+/*
+ * Release every pooled page of a vstruct that is going away.
+ */
+void
+dpc_vstruct_dealloc(
+	vstruct_t	vs)
+{
+	dpc_slot_t	slot;
+
+	if (!dpc_enabled)
+		return;
+
+	DPC_LOCK();
+	while (!queue_empty(&vs->vs_dpc_slots)) {
+		slot = (dpc_slot_t) queue_first(&vs->vs_dpc_slots);
+		dpc_remove(slot);
+
+		DPC_UNLOCK();
+		kfree(slot, DPC_SLOT_SIZE(slot->ds_size));
+		DPC_LOCK();
+	}
+	DPC_UNLOCK();
+}
+
+#endif	/* CONFIG_DP_COMPRESSOR */
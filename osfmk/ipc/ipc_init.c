@@ -113,6 +113,15 @@ vm_map_t ipc_kernel_copy_map;
 vm_size_t ipc_kernel_copy_map_size = IPC_KERNEL_COPY_MAP_SIZE;
 vm_size_t ipc_kmsg_max_vm_space = ((IPC_KERNEL_COPY_MAP_SIZE * 7) / 8);
 
+/*
+ * default threshold above which page-aligned, virtually copied
+ * out-of-line regions are lent rather than copied on write;
+ * new tasks inherit their parent's setting (TASK_OOL_LOAN_POLICY)
+ */
+#define IPC_KMSG_OOL_LOAN_THRESHOLD (1024 * 1024)
+unsigned int ipc_kmsg_ool_loan_threshold = IPC_KMSG_OOL_LOAN_THRESHOLD;
+unsigned int ipc_kmsg_ool_loans = 0;
+
 /* 
  * values to limit inline message body handling
  * avoid copyin/out limits - even after accounting for maximum descriptor expansion.
@@ -171,6 +180,7 @@ ipc_bootstrap(void)
 	/* cant charge callers for port allocations (references passed) */
 	zone_change(ipc_object_zones[IOT_PORT], Z_CALLERACCT, FALSE);
 	zone_change(ipc_object_zones[IOT_PORT], Z_NOENCRYPT, TRUE);
+	zone_change(ipc_object_zones[IOT_PORT], Z_CACHING_ENABLED, TRUE);
 
 	ipc_object_zones[IOT_PORT_SET] =
 		zinit(sizeof(struct ipc_pset),
@@ -189,6 +199,7 @@ ipc_bootstrap(void)
 			      IKM_SAVED_KMSG_SIZE,
 			      "ipc kmsgs");
 	zone_change(ipc_kmsg_zone, Z_CALLERACCT, FALSE);
+	zone_change(ipc_kmsg_zone, Z_CACHING_ENABLED, TRUE);
 
 #if CONFIG_MACF_MACH
 	ipc_labelh_zone = 
@@ -488,6 +488,7 @@ extern vm_size_t	ipc_kmsg_max_space;
 extern vm_size_t	ipc_kmsg_max_vm_space;
 extern vm_size_t	ipc_kmsg_max_body_space;
 extern vm_size_t	msg_ool_size_small;
+extern unsigned int	ipc_kmsg_ool_loans;
 
 #define MSG_OOL_SIZE_SMALL	msg_ool_size_small
 
@@ -562,7 +563,154 @@ mach_msg_return_t ipc_kmsg_copyin_body(
  *	The per-processor cache seems to miss less than a per-thread cache,
  *	and it also uses less memory.  Access to the cache doesn't
  *	require locking.
+ *
+ *	Messages are rounded up to one of IKM_CACHE_CLASSES sizes, each
+ *	with its own stash.  ikm_cache_size[] holds the buffer sizes
+ *	(including IKM_OVERHEAD) and ikm_cache_depth[] how many buffers of
+ *	each size a processor may keep.  The smallest class covers most
+ *	MIG requests and replies and comes from ipc_kmsg_zone; the larger
+ *	ones, for messages carrying inline data or descriptors, come from
+ *	kalloc.  Larger messages are not cached.
+ */
+
+static const mach_msg_size_t ikm_cache_size[IKM_CACHE_CLASSES] = {
+	IKM_SAVED_KMSG_SIZE, 512, 1024, 2048, 4096, 8192
+};
+
+static const unsigned int ikm_cache_depth[IKM_CACHE_CLASSES] = {
+	IKM_STASH, 8, 8, 4, 4, 2
+};
+
+/*
+ *	ipc_kmsg_cache_collect() bumps ikm_cache_epoch.  Each processor
+ *	notices the change on its next ipc_kmsg_free() and gives back
+ *	everything in its stashes.
+ */
+static unsigned int ikm_cache_epoch;
+
+/*
+ *	Routine:	ikm_cache_class
+ *	Purpose:
+ *		Return the smallest cache class whose messages hold
+ *		size bytes, or -1 if the message is too large to cache.
+ */
+static __inline int
+ikm_cache_class(
+	mach_msg_size_t	size)
+{
+	int class;
+
+	for (class = 0; class < IKM_CACHE_CLASSES; class++)
+		if (size <= ikm_less_overhead(ikm_cache_size[class]))
+			return (class);
+	return (-1);
+}
+
+/*
+ *	Routine:	ikm_cache_release
+ *	Purpose:
+ *		Return a list of cached kmsgs, linked through ikm_next,
+ *		to the allocators they came from.
+ *	Conditions:
+ *		Nothing locked, preemption enabled.
+ */
+static void
+ikm_cache_release(
+	ipc_kmsg_t	list)
+{
+	ipc_kmsg_t kmsg;
+
+	while ((kmsg = list) != IKM_NULL) {
+		int class = ikm_cache_class(kmsg->ikm_size);
+
+		list = kmsg->ikm_next;
+		if (class == 0)
+			zfree(ipc_kmsg_zone, kmsg);
+		else
+			kfree(kmsg, ikm_cache_size[class]);
+	}
+}
+
+/*
+ *	Routine:	ikm_cache_drain
+ *	Purpose:
+ *		Empty every stash of a processor's cache, returning
+ *		the kmsgs as a list for ikm_cache_release().
+ *	Conditions:
+ *		Preemption disabled.
+ */
+static ipc_kmsg_t
+ikm_cache_drain(
+	struct ikm_cache	*cache)
+{
+	ipc_kmsg_t list = IKM_NULL;
+	int class;
+
+	cache->epoch = ikm_cache_epoch;
+	for (class = 0; class < IKM_CACHE_CLASSES; class++) {
+		struct ikm_stash *stash = &cache->stash[class];
+
+		while (stash->avail > 0) {
+			ipc_kmsg_t kmsg = stash->entries[--stash->avail];
+
+			kmsg->ikm_next = list;
+			list = kmsg;
+		}
+	}
+	return (list);
+}
+
+/*
+ *	Routine:	ipc_kmsg_cache_collect
+ *	Purpose:
+ *		Called under memory pressure to release the memory
+ *		held in the per-processor kmsg caches.  The current
+ *		processor's cache is emptied right away, the others
+ *		on their next ipc_kmsg_free().
+ *	Conditions:
+ *		Nothing locked.
+ */
+void
+ipc_kmsg_cache_collect(void)
+{
+	ipc_kmsg_t list;
+
+	(void)hw_atomic_add(&ikm_cache_epoch, 1);
+
+	disable_preemption();
+	list = ikm_cache_drain(&PROCESSOR_DATA(current_processor(), ikm_cache));
+	enable_preemption();
+
+	ikm_cache_release(list);
+}
+
+/*
+ *	Routine:	ipc_kmsg_cache_stats
+ *	Purpose:
+ *		Sum the cache hit and miss counts of all processors.
  */
+void
+ipc_kmsg_cache_stats(
+	uint64_t	*hits,
+	uint64_t	*misses)
+{
+	processor_t processor;
+	int class;
+
+	*hits = *misses = 0;
+
+	simple_lock(&processor_list_lock);
+	for (processor = processor_list; processor != PROCESSOR_NULL;
+	     processor = processor->processor_list) {
+		struct ikm_cache *cache = &PROCESSOR_DATA(processor, ikm_cache);
+
+		for (class = 0; class < IKM_CACHE_CLASSES; class++) {
+			*hits += cache->stash[class].hits;
+			*misses += cache->stash[class].misses;
+		}
+	}
+	simple_unlock(&processor_list_lock);
+}
 
 /*
  *	Routine:	ipc_kmsg_alloc
@@ -578,6 +726,7 @@ ipc_kmsg_alloc(
 {
 	mach_msg_size_t max_expanded_size;
 	ipc_kmsg_t kmsg;
+	int class;
 
 	/*
 	 * LP64support -
@@ -611,26 +760,32 @@ ipc_kmsg_alloc(
 	} else
 		max_expanded_size = msg_and_trailer_size;
 
-	if (max_expanded_size < IKM_SAVED_MSG_SIZE)
-		max_expanded_size = IKM_SAVED_MSG_SIZE; 	/* round up for ikm_cache */
-
-	if (max_expanded_size == IKM_SAVED_MSG_SIZE) {
-		struct ikm_cache	*cache;
+	class = ikm_cache_class(max_expanded_size);
+	if (class >= 0) {
+		struct ikm_stash	*stash;
 		unsigned int		i;
 
+		/* round up for ikm_cache */
+		max_expanded_size = ikm_less_overhead(ikm_cache_size[class]);
+
 		disable_preemption();
-		cache = &PROCESSOR_DATA(current_processor(), ikm_cache);
-		if ((i = cache->avail) > 0) {
-			assert(i <= IKM_STASH);
-			kmsg = cache->entries[--i];
-			cache->avail = i;
+		stash = &PROCESSOR_DATA(current_processor(), ikm_cache).stash[class];
+		if ((i = stash->avail) > 0) {
+			assert(i <= ikm_cache_depth[class]);
+			kmsg = stash->entries[--i];
+			stash->avail = i;
+			stash->hits++;
 			enable_preemption();
 			ikm_check_init(kmsg, max_expanded_size);
 			ikm_set_header(kmsg, msg_and_trailer_size);
 			return (kmsg);
 		}
+		stash->misses++;
 		enable_preemption();
-		kmsg = (ipc_kmsg_t)zalloc(ipc_kmsg_zone);
+		if (class == 0)
+			kmsg = (ipc_kmsg_t)zalloc(ipc_kmsg_zone);
+		else
+			kmsg = (ipc_kmsg_t)kalloc(ikm_cache_size[class]);
 	} else {
 		kmsg = (ipc_kmsg_t)kalloc(ikm_plus_overhead(max_expanded_size));
 	}
@@ -661,6 +816,7 @@ ipc_kmsg_free(
 {
 	mach_msg_size_t size = kmsg->ikm_size;
 	ipc_port_t port;
+	int class;
 
 #if CONFIG_MACF_MACH
 	if (kmsg->ikm_sender != NULL) {
@@ -691,20 +847,32 @@ ipc_kmsg_free(
 	/*
 	 * Peek and see if it has to go back in the cache.
 	 */
-	if (kmsg->ikm_size == IKM_SAVED_MSG_SIZE) {
+	class = ikm_cache_class(size);
+	if (class >= 0) {
 		struct ikm_cache	*cache;
+		struct ikm_stash	*stash;
+		ipc_kmsg_t		list = IKM_NULL;
 		unsigned int		i;
 
+		assert(size == ikm_less_overhead(ikm_cache_size[class]));
+
 		disable_preemption();
 		cache = &PROCESSOR_DATA(current_processor(), ikm_cache);
-		if ((i = cache->avail) < IKM_STASH) {
-			cache->entries[i] = kmsg;
-			cache->avail = i + 1;
-			enable_preemption();
-			return;
+		if (cache->epoch != ikm_cache_epoch)
+			list = ikm_cache_drain(cache);
+		stash = &cache->stash[class];
+		if ((i = stash->avail) < ikm_cache_depth[class]) {
+			stash->entries[i] = kmsg;
+			stash->avail = i + 1;
+			kmsg = IKM_NULL;
 		}
 		enable_preemption();
-		zfree(ipc_kmsg_zone, kmsg);
+
+		if (kmsg != IKM_NULL) {
+			kmsg->ikm_next = list;
+			list = kmsg;
+		}
+		ikm_cache_release(list);
 		return;
 	}
 	kfree(kmsg, ikm_plus_overhead(size));
@@ -1524,6 +1692,27 @@ ipc_kmsg_put(
 	return mr;
 }
 
+/*
+ *	Routine:	ipc_kmsg_put_size
+ *	Purpose:
+ *		Number of bytes ipc_kmsg_put copies out to the current
+ *		task for a message of the given in-kernel size.  On LP64
+ *		user messages have the smaller legacy header.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+mach_msg_size_t
+ipc_kmsg_put_size(
+	mach_msg_size_t		size)
+{
+#if defined(__LP64__)
+	if (current_task() != kernel_task)
+		size -= LEGACY_HEADER_SIZE_DELTA;
+#endif
+	return size;
+}
+
 /*
  *	Routine:	ipc_kmsg_put_to_kernel
  *	Purpose:
@@ -1545,6 +1734,92 @@ ipc_kmsg_put_to_kernel(
 	ipc_kmsg_free(kmsg);
 }
 
+#if !CONFIG_MACF_MACH
+/*
+ *	Routine:	ipc_kmsg_copyin_header_shared
+ *	Purpose:
+ *		Fast path of ipc_kmsg_copyin_header for the common
+ *		send: a copy-send destination, with either no reply
+ *		port or a send-once right made from a receive right.
+ *		Neither copyin changes an entry, so the space is only
+ *		read-locked and concurrent senders do not serialize
+ *		on it.  Returns FALSE, with nothing changed, for
+ *		anything the general path must handle (dead ports,
+ *		missing rights, an inactive space).
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+static boolean_t
+ipc_kmsg_copyin_header_shared(
+	ipc_space_t		space,
+	mach_port_name_t	dest_name,
+	mach_port_name_t	reply_name,
+	mach_msg_type_name_t	reply_type,
+	boolean_t		notify,
+	ipc_port_t		*destp,
+	ipc_port_t		*replyp)
+{
+	ipc_entry_t dest_entry, reply_entry;
+	ipc_port_t dest_port, reply_port = IP_NULL;
+
+	is_read_lock(space);
+	if (!is_active(space))
+		goto slow;
+
+	dest_entry = ipc_entry_lookup(space, dest_name);
+	if (dest_entry == IE_NULL ||
+	    (dest_entry->ie_bits & MACH_PORT_TYPE_SEND) == 0)
+		goto slow;
+	dest_port = (ipc_port_t) dest_entry->ie_object;
+	assert(dest_port != IP_NULL);
+
+	if (reply_type == MACH_MSG_TYPE_MAKE_SEND_ONCE) {
+		reply_entry = ipc_entry_lookup(space, reply_name);
+		if (reply_entry == IE_NULL ||
+		    (reply_entry->ie_bits & MACH_PORT_TYPE_RECEIVE) == 0)
+			goto slow;
+		reply_port = (ipc_port_t) reply_entry->ie_object;
+		assert(reply_port != IP_NULL);
+	}
+
+	ip_lock(dest_port);
+	if (!ip_active(dest_port)) {
+		/* turning the right into a dead name needs the write lock */
+		ip_unlock(dest_port);
+		goto slow;
+	}
+	assert(dest_port->ip_srights > 0);
+	dest_port->ip_srights++;
+	ip_reference(dest_port);
+
+	if (notify && dest_entry->ie_request != IE_REQ_NONE &&
+	    dest_port->ip_receiver != ipc_space_kernel && ip_full(dest_port))
+		ipc_port_request_sparm(dest_port, dest_name, dest_entry->ie_request);
+	ip_unlock(dest_port);
+
+	if (reply_port != IP_NULL) {
+		ip_lock(reply_port);
+		assert(ip_active(reply_port));
+		assert(reply_port->ip_receiver_name == reply_name);
+		assert(reply_port->ip_receiver == space);
+		reply_port->ip_sorights++;
+		ip_reference(reply_port);
+		ip_unlock(reply_port);
+	}
+
+	is_read_unlock(space);
+
+	*destp = dest_port;
+	*replyp = reply_port;
+	return TRUE;
+
+ slow:
+	is_read_unlock(space);
+	return FALSE;
+}
+#endif	/* !CONFIG_MACF_MACH */
+
 /*
  *	Routine:	ipc_kmsg_copyin_header
  *	Purpose:
@@ -1600,6 +1875,27 @@ ipc_kmsg_copyin_header(
 	     !MACH_MSG_TYPE_PORT_ANY_SEND(reply_type)))
 		return MACH_SEND_INVALID_HEADER;
 
+#if !CONFIG_MACF_MACH
+	if (dest_type == MACH_MSG_TYPE_COPY_SEND &&
+	    MACH_PORT_VALID(dest_name) &&
+	    (reply_type == 0 ||
+	     (reply_type == MACH_MSG_TYPE_MAKE_SEND_ONCE &&
+	      MACH_PORT_VALID(reply_name) && reply_name != dest_name))) {
+		ipc_port_t dport, rport;
+
+		if (ipc_kmsg_copyin_header_shared(space, dest_name, reply_name,
+						  reply_type, notify,
+						  &dport, &rport)) {
+			msg->msgh_bits = (MACH_MSGH_BITS_OTHER(mbits) |
+				MACH_MSGH_BITS(MACH_MSG_TYPE_PORT_SEND,
+					ipc_object_copyin_type(reply_type)));
+			msg->msgh_remote_port = dport;
+			msg->msgh_local_port = rport;
+			return MACH_MSG_SUCCESS;
+		}
+	}
+#endif	/* !CONFIG_MACF_MACH */
+
 	reply_soright = IP_NULL; /* in case we go to invalid dest early */
 
 	is_write_lock(space);
@@ -2129,6 +2425,26 @@ ipc_kmsg_copyin_ool_descriptor(
         *paddr += round_page(length);
         *space_needed -= round_page(length);
     } else {
+        kern_return_t kr;
+
+        /*
+         * Large page-aligned regions that are virtually copied
+         * and kept by the sender are lent to the message when
+         * their object uses the delayed copy strategy: the
+         * sender only loses write access to its resident pages,
+         * and a page is copied only if the sender writes it
+         * again.  The size threshold is a per-task policy.
+         */
+        if (copy_options == MACH_MSG_VIRTUAL_COPY && !dealloc &&
+            map == current_map() &&
+            current_task()->ool_loan_threshold != 0 &&
+            length >= current_task()->ool_loan_threshold &&
+            vm_map_copyin_loan(map, addr, (vm_map_size_t)length,
+                copy) == KERN_SUCCESS) {
+            ipc_kmsg_ool_loans++;
+            dsc->address = (void *)*copy;
+            return user_dsc;
+        }
 
         /*
          * Make a vm_map_copy_t of the of the data.  If the
@@ -2138,7 +2454,7 @@ ipc_kmsg_copyin_ool_descriptor(
          * NOTE: A virtual copy is OK if the original is being
          * deallocted, even if a physical copy was requested.
          */
-        kern_return_t kr = vm_map_copyin(map, addr, 
+        kr = vm_map_copyin(map, addr, 
                 (vm_map_size_t)length, dealloc, copy);
         if (kr != KERN_SUCCESS) {
             *mr = (kr == KERN_RESOURCE_SHORTAGE) ?
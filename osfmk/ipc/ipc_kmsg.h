@@ -264,6 +264,14 @@ extern ipc_kmsg_t ipc_kmsg_alloc(
 extern void ipc_kmsg_free(
 	ipc_kmsg_t	kmsg);
 
+/* Release the per-processor kernel message caches */
+extern void ipc_kmsg_cache_collect(void);
+
+/* Sum the per-processor kernel message cache hits and misses */
+extern void ipc_kmsg_cache_stats(
+	uint64_t	*hits,
+	uint64_t	*misses);
+
 /* Destroy kernel message */
 extern void ipc_kmsg_destroy(
 	ipc_kmsg_t	kmsg);
@@ -313,6 +321,10 @@ extern mach_msg_return_t ipc_kmsg_put(
 	ipc_kmsg_t		kmsg,
 	mach_msg_size_t		size);
 
+/* Size ipc_kmsg_put copies out for a kernel message size */
+extern mach_msg_size_t ipc_kmsg_put_size(
+	mach_msg_size_t		size);
+
 /* Copy a kernel message buffer to a kernel message */
 extern void ipc_kmsg_put_to_kernel(
 	mach_msg_header_t	*msg,
@@ -101,6 +101,10 @@
 int ipc_mqueue_full;		/* address is event for queue space */
 int ipc_mqueue_rcv;		/* address is event for message arrival */
 
+/* combined send/receive: direct switches to the receiver, and misses */
+uint32_t ipc_mqueue_handoff_hits;
+uint32_t ipc_mqueue_handoff_fallbacks;
+
 /* forward declarations */
 void ipc_mqueue_receive_results(wait_result_t result);
 
@@ -441,7 +445,7 @@ ipc_mqueue_send(
 		}
 	}
 
-	ipc_mqueue_post(mqueue, kmsg);
+	ipc_mqueue_post(mqueue, kmsg, option);
 	return MACH_MSG_SUCCESS;
 }
 
@@ -485,14 +489,22 @@ ipc_mqueue_release_msgcount(
  *		receiver is waiting, we can release our reserved space in
  *		the message queue.
  *
+ *		With MACH_SEND_HANDOFF, a receiver that can be switched to
+ *		directly is not put on a run queue but left in the sending
+ *		thread's ith_handoff, for ipc_mqueue_receive() to run.
+ *		If the sender switches to any other thread first,
+ *		thread_dispatch() puts the receiver on a run queue.
+ *
  *	Conditions:
  *		If we need to queue, our space in the message queue is reserved.
  */
 void
 ipc_mqueue_post(
 	register ipc_mqueue_t 	mqueue,
-	register ipc_kmsg_t		kmsg)
+	register ipc_kmsg_t		kmsg,
+	mach_msg_option_t		option)
 {
+	thread_t self = current_thread();
 	spl_t s;
 
 	/*
@@ -507,8 +519,17 @@ ipc_mqueue_post(
 		wait_queue_t waitq = &mqueue->imq_wait_queue;
 		thread_t receiver;
 		mach_msg_size_t msize;
+		boolean_t handoff = FALSE;
 
-		receiver = wait_queue_wakeup64_identity_locked(
+		if ((option & MACH_SEND_HANDOFF) && self->ith_handoff == THREAD_NULL)
+			receiver = wait_queue_wakeup64_handoff_locked(
+							waitq,
+							IPC_MQUEUE_RECEIVE,
+							THREAD_AWAKENED,
+							FALSE,
+							&handoff);
+		else
+			receiver = wait_queue_wakeup64_identity_locked(
 							waitq,
 							IPC_MQUEUE_RECEIVE,
 							THREAD_AWAKENED,
@@ -531,6 +552,8 @@ ipc_mqueue_post(
 		 * go look for another thread that can.
 		 */
 		if (receiver->ith_state != MACH_RCV_IN_PROGRESS) {
+				  if (handoff)
+					  thread_setrun(receiver, SCHED_PREEMPT | SCHED_TAILQ);
 				  thread_unlock(receiver);
 				  continue;
 		}
@@ -560,6 +583,8 @@ ipc_mqueue_post(
 
 			receiver->ith_kmsg = kmsg;
 			receiver->ith_seqno = mqueue->imq_seqno++;
+			if (handoff)
+				self->ith_handoff = receiver;
 			thread_unlock(receiver);
 
 			/* we didn't need our reserved spot in the queue */
@@ -574,11 +599,16 @@ ipc_mqueue_post(
 		 */
 		receiver->ith_kmsg = IKM_NULL;
 		receiver->ith_seqno = 0;
+		if (handoff)
+			thread_setrun(receiver, SCHED_PREEMPT | SCHED_TAILQ);
 		thread_unlock(receiver);
 	}
 
 	imq_unlock(mqueue);
 	splx(s);
+
+	if ((option & MACH_SEND_HANDOFF) && self->ith_handoff == THREAD_NULL)
+		(void)hw_atomic_add(&ipc_mqueue_handoff_fallbacks, 1);
 	
 	current_task()->messages_sent++;
 	return;
@@ -639,6 +669,34 @@ ipc_mqueue_receive_results(wait_result_t saved_wait_result)
 	}
 }
 
+/*
+ *	Routine:	ipc_mqueue_handoff_cancel
+ *	Purpose:
+ *		Dispatch a receiver that ipc_mqueue_post() left for a
+ *		direct handoff we are not going to make.
+ *	Conditions:
+ *		Nothing locked.
+ */
+void
+ipc_mqueue_handoff_cancel(
+	thread_t	self)
+{
+	thread_t thread = self->ith_handoff;
+	spl_t s;
+
+	if (thread == THREAD_NULL)
+		return;
+	self->ith_handoff = THREAD_NULL;
+
+	s = splsched();
+	thread_lock(thread);
+	thread_setrun(thread, SCHED_PREEMPT | SCHED_TAILQ);
+	thread_unlock(thread);
+	splx(s);
+
+	(void)hw_atomic_add(&ipc_mqueue_handoff_fallbacks, 1);
+}
+
 void
 ipc_mqueue_receive_continue(
 	__unused void *param,
@@ -690,20 +748,44 @@ ipc_mqueue_receive(
         wresult = ipc_mqueue_receive_on_thread(mqueue, option, max_size,
                                                rcv_timeout, interruptible,
                                                self);
-        if (wresult == THREAD_NOT_WAITING)
+        if (wresult == THREAD_NOT_WAITING) {
+		ipc_mqueue_handoff_cancel(self);
                 return;
+	}
 
 	if (wresult == THREAD_WAITING) {
+		thread_t handoff = self->ith_handoff;
+
 		counter((interruptible == THREAD_ABORTSAFE) ? 
 			c_ipc_mqueue_receive_block_user++ :
 			c_ipc_mqueue_receive_block_kernel++);
 
-		if (self->ith_continuation)
-			thread_block(ipc_mqueue_receive_continue);
-			/* NOTREACHED */
+		if (handoff != THREAD_NULL) {
+			/*
+			 * Switch straight to the thread we just sent to,
+			 * giving it the rest of our quantum.
+			 */
+			spl_t s;
+
+			self->ith_handoff = THREAD_NULL;
+			(void)hw_atomic_add(&ipc_mqueue_handoff_hits, 1);
 
-		wresult = thread_block(THREAD_CONTINUE_NULL);
-	}
+			s = splsched();
+			if (self->ith_continuation)
+				thread_run(self, ipc_mqueue_receive_continue, NULL, handoff);
+				/* NOTREACHED */
+
+			wresult = thread_run(self, THREAD_CONTINUE_NULL, NULL, handoff);
+			splx(s);
+		} else {
+			if (self->ith_continuation)
+				thread_block(ipc_mqueue_receive_continue);
+				/* NOTREACHED */
+
+			wresult = thread_block(THREAD_CONTINUE_NULL);
+		}
+	} else
+		ipc_mqueue_handoff_cancel(self);
 	ipc_mqueue_receive_results(wresult);
 }
 
@@ -185,7 +185,12 @@ extern mach_msg_return_t ipc_mqueue_send(
 /* Deliver message to message queue or waiting receiver */
 extern void ipc_mqueue_post(
 	ipc_mqueue_t		mqueue,
-	ipc_kmsg_t		kmsg);
+	ipc_kmsg_t		kmsg,
+	mach_msg_option_t	option);
+
+/* Dispatch a receiver left for a direct handoff */
+extern void ipc_mqueue_handoff_cancel(
+	thread_t		self);
 
 /* Receive a message from a message queue */
 extern void ipc_mqueue_receive(
@@ -172,6 +172,92 @@ ipc_right_lookup_two_write(
 	return KERN_SUCCESS;
 }
 
+/*
+ *	Routine:	ipc_right_lookup_read
+ *	Purpose:
+ *		Finds an entry in a space, given the name, for
+ *		callers that only translate the name and will not
+ *		change the entry.
+ *	Conditions:
+ *		Nothing locked.  If successful, the space is read-locked.
+ *	Returns:
+ *		KERN_SUCCESS		Found an entry.
+ *		KERN_INVALID_TASK	The space is dead.
+ *		KERN_INVALID_NAME	Name doesn't exist in space.
+ */
+
+kern_return_t
+ipc_right_lookup_read(
+	ipc_space_t		space,
+	mach_port_name_t	name,
+	ipc_entry_t		*entryp)
+{
+	ipc_entry_t entry;
+
+	assert(space != IS_NULL);
+
+	is_read_lock(space);
+
+	if (!is_active(space)) {
+		is_read_unlock(space);
+		return KERN_INVALID_TASK;
+	}
+
+	if ((entry = ipc_entry_lookup(space, name)) == IE_NULL) {
+		is_read_unlock(space);
+		return KERN_INVALID_NAME;
+	}
+
+	*entryp = entry;
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	ipc_right_lookup_two_read
+ *	Purpose:
+ *		Like ipc_right_lookup_read except that it returns two
+ *		entries for two different names that were looked
+ *		up under the same space lock.
+ *	Conditions:
+ *		Nothing locked.  If successful, the space is read-locked.
+ *	Returns:
+ *		KERN_INVALID_TASK	The space is dead.
+ *		KERN_INVALID_NAME	Name doesn't exist in space.
+ */
+
+kern_return_t
+ipc_right_lookup_two_read(
+	ipc_space_t		space,
+	mach_port_name_t	name1,
+	ipc_entry_t		*entryp1,
+	mach_port_name_t	name2,
+	ipc_entry_t		*entryp2)
+{
+	ipc_entry_t entry1;
+	ipc_entry_t entry2;
+
+	assert(space != IS_NULL);
+
+	is_read_lock(space);
+
+	if (!is_active(space)) {
+		is_read_unlock(space);
+		return KERN_INVALID_TASK;
+	}
+
+	if ((entry1 = ipc_entry_lookup(space, name1)) == IE_NULL) {
+		is_read_unlock(space);
+		return KERN_INVALID_NAME;
+	}
+	if ((entry2 = ipc_entry_lookup(space, name2)) == IE_NULL) {
+		is_read_unlock(space);
+		return KERN_INVALID_NAME;
+	}
+	*entryp1 = entry1;
+	*entryp2 = entry2;
+	return KERN_SUCCESS;
+}
+
 /*
  *	Routine:	ipc_right_reverse
  *	Purpose:
@@ -71,8 +71,19 @@
 #include <ipc/ipc_port.h>
 #include <ipc/ipc_entry.h>
 
-#define	ipc_right_lookup_read		ipc_right_lookup_write
-#define ipc_right_lookup_two_read	ipc_right_lookup_two_write
+/* Find an entry in a space, given the name; space read-locked */
+extern kern_return_t ipc_right_lookup_read(
+	ipc_space_t		space,
+	mach_port_name_t	name,
+	ipc_entry_t		*entryp);
+
+/* Find two entries in a space, given two names; space read-locked */
+extern kern_return_t ipc_right_lookup_two_read(
+	ipc_space_t		space,
+	mach_port_name_t	name1,
+	ipc_entry_t		*entryp1,
+	mach_port_name_t	name2,
+	ipc_entry_t		*entryp2);
 
 /* Find an entry in a space, given the name */
 extern kern_return_t ipc_right_lookup_write(
@@ -103,6 +103,13 @@
  *	that need it grown wait for the first.  We do almost all the
  *	work with the space unlocked, so lookups proceed pretty much
  *	unaffected while the grow operation is underway.
+ *
+ *	The space lock is a reader-writer lock.  Lookups that only
+ *	translate names (ipc_right_lookup_read, ipc_object_translate,
+ *	receive-side copyin and the copy-send fast path of message
+ *	copyin) hold it shared and run concurrently with each other;
+ *	anything that changes an entry, or publishes a grown table,
+ *	holds it exclusive.
  */
 
 typedef natural_t ipc_space_refs_t;
@@ -111,7 +118,7 @@ typedef natural_t ipc_space_refs_t;
 #define IS_GROWING	0x20000000	/* space is growing */
 
 struct ipc_space {
-	lck_spin_t	is_lock_data;
+	decl_lck_rw_data(,is_lock_data)
 	ipc_space_refs_t is_bits;	/* holds refs, active, growing */
 	ipc_entry_num_t is_table_size;	/* current size of table */
 	ipc_entry_t is_table;		/* an array of entries */
@@ -165,20 +172,20 @@ extern ipc_space_t default_pager_space;
 extern lck_grp_t 	ipc_lck_grp;
 extern lck_attr_t 	ipc_lck_attr;
 
-#define	is_lock_init(is)	lck_spin_init(&(is)->is_lock_data, &ipc_lck_grp, &ipc_lck_attr)
-#define	is_lock_destroy(is)	lck_spin_destroy(&(is)->is_lock_data, &ipc_lck_grp)
+#define	is_lock_init(is)	lck_rw_init(&(is)->is_lock_data, &ipc_lck_grp, &ipc_lck_attr)
+#define	is_lock_destroy(is)	lck_rw_destroy(&(is)->is_lock_data, &ipc_lck_grp)
 
-#define	is_read_lock(is)	lck_spin_lock(&(is)->is_lock_data)
-#define is_read_unlock(is)	lck_spin_unlock(&(is)->is_lock_data)
-#define is_read_sleep(is)	lck_spin_sleep(&(is)->is_lock_data,	\
+#define	is_read_lock(is)	lck_rw_lock_shared(&(is)->is_lock_data)
+#define is_read_unlock(is)	lck_rw_done(&(is)->is_lock_data)
+#define is_read_sleep(is)	lck_rw_sleep(&(is)->is_lock_data,	\
 							LCK_SLEEP_DEFAULT,					\
 							(event_t)(is),						\
 							THREAD_UNINT)
 
-#define	is_write_lock(is)	lck_spin_lock(&(is)->is_lock_data)
-#define	is_write_lock_try(is)	lck_spin_try_lock(&(is)->is_lock_data)
-#define is_write_unlock(is)	lck_spin_unlock(&(is)->is_lock_data)
-#define is_write_sleep(is)	lck_spin_sleep(&(is)->is_lock_data,	\
+#define	is_write_lock(is)	lck_rw_lock_exclusive(&(is)->is_lock_data)
+#define	is_write_lock_try(is)	lck_rw_try_lock_exclusive(&(is)->is_lock_data)
+#define is_write_unlock(is)	lck_rw_done(&(is)->is_lock_data)
+#define is_write_sleep(is)	lck_rw_sleep(&(is)->is_lock_data,	\
 							LCK_SLEEP_DEFAULT,					\
 							(event_t)(is),						\
 							THREAD_UNINT)
@@ -143,6 +143,16 @@ mach_msg_return_t msg_receive_error(
 	mach_port_seqno_t	seqno,
 	ipc_space_t		space);
 
+static void mach_msg_receive_batch(
+	ipc_object_t		object,
+	mach_vm_address_t	msg_addr,
+	mach_msg_size_t		offset,
+	mach_msg_size_t		rcv_size,
+	mach_msg_option_t	option);
+
+/* most messages a single MACH_RCV_BATCH receive returns */
+#define MACH_RCV_BATCH_MAX	64
+
 security_token_t KERNEL_SECURITY_TOKEN = KERNEL_SECURITY_TOKEN_VALUE;
 audit_token_t KERNEL_AUDIT_TOKEN = KERNEL_AUDIT_TOKEN_VALUE;
 
@@ -269,9 +279,9 @@ mach_msg_receive_results(void)
 	mach_msg_option_t option = self->ith_option;
 	ipc_kmsg_t        kmsg = self->ith_kmsg;
 	mach_port_seqno_t seqno = self->ith_seqno;
+	mach_msg_size_t   rcv_size = self->ith_msize;
 	mach_msg_trailer_size_t trailer_size;
-
-	io_release(object);
+	mach_msg_size_t   size;
 
 	if (mr != MACH_MSG_SUCCESS) {
 
@@ -329,14 +339,125 @@ mach_msg_receive_results(void)
 		}
 		goto out;
 	}
-	mr = ipc_kmsg_put(msg_addr,
-			  kmsg,
-			  kmsg->ikm_header->msgh_size + 
-			  trailer_size);
+	size = kmsg->ikm_header->msgh_size + trailer_size;
+	mr = ipc_kmsg_put(msg_addr, kmsg, size);
+
+	if (mr == MACH_MSG_SUCCESS &&
+	    (option & (MACH_RCV_BATCH|MACH_RCV_OVERWRITE)) == MACH_RCV_BATCH)
+		mach_msg_receive_batch(object, msg_addr,
+				       round_msg(ipc_kmsg_put_size(size)),
+				       rcv_size, option);
  out:
+	io_release(object);
 	return mr;
 }
 
+/*
+ *	Routine:	mach_msg_receive_batch	[internal]
+ *	Purpose:
+ *		MACH_RCV_BATCH: once the first message of a receive is
+ *		copied out, copy out whatever else is already queued on
+ *		the same port or port set, without blocking.  Each message
+ *		goes right after the previous one as copied out (with the
+ *		user header size), at round_msg boundaries, for as long as
+ *		it fits in the rcv_size buffer with room to spare for the
+ *		mach_msg_batch_end_t that ends the batch.  A message that
+ *		does not fit stays queued.  Messages are taken in queue
+ *		order, each with its own seqno.
+ *
+ *		A message whose copyout fails is returned as a single
+ *		receive would return it, and it ends the batch; the end
+ *		record carries the error.
+ *	Conditions:
+ *		Nothing locked.  The caller holds a reference on object.
+ */
+static void
+mach_msg_receive_batch(
+	ipc_object_t		object,
+	mach_vm_address_t	msg_addr,
+	mach_msg_size_t		offset,
+	mach_msg_size_t		rcv_size,
+	mach_msg_option_t	option)
+{
+	thread_t self = current_thread();
+	ipc_space_t space = current_space();
+	vm_map_t map = current_map();
+	ipc_mqueue_t mqueue;
+	mach_msg_batch_end_t end;
+	mach_msg_return_t error = MACH_MSG_SUCCESS;
+	mach_msg_size_t count = 1;
+
+	/* no room for the end record: a batch of one */
+	if (offset > rcv_size || rcv_size - offset < sizeof(end))
+		return;
+
+	if (io_otype(object) == IOT_PORT_SET)
+		mqueue = &((ipc_pset_t) object)->ips_messages;
+	else
+		mqueue = &((ipc_port_t) object)->ip_messages;
+
+	/* leave messages that don't fit on the queue, and never block */
+	option |= MACH_RCV_LARGE | MACH_RCV_TIMEOUT;
+
+	while (count < MACH_RCV_BATCH_MAX) {
+		mach_msg_trailer_size_t trailer_size;
+		mach_msg_return_t mr;
+		mach_msg_size_t size;
+		mach_msg_size_t space_left;
+		ipc_kmsg_t kmsg;
+
+		space_left = rcv_size - offset - sizeof(end);
+		if (space_left < sizeof(mach_msg_header_t))
+			break;
+
+		(void) ipc_mqueue_receive_on_thread(mqueue, option,
+				space_left, 0, THREAD_ABORTSAFE, self);
+		if (self->ith_state != MACH_MSG_SUCCESS)
+			break;
+
+		kmsg = self->ith_kmsg;
+		trailer_size = ipc_kmsg_add_trailer(kmsg, space, option, self,
+				self->ith_seqno, FALSE,
+				kmsg->ikm_header->msgh_remote_port->ip_context);
+
+		mr = ipc_kmsg_copyout(kmsg, space, map, MACH_MSG_BODY_NULL);
+		if (mr != MACH_MSG_SUCCESS) {
+			mach_msg_return_t put_mr;
+
+			if ((mr &~ MACH_MSG_MASK) == MACH_RCV_BODY_ERROR) {
+				size = kmsg->ikm_header->msgh_size + trailer_size;
+				put_mr = ipc_kmsg_put(msg_addr + offset, kmsg, size);
+			} else {
+				/* reduced to its header, as msg_receive_error does */
+				size = sizeof(mach_msg_header_t) + trailer_size;
+				put_mr = msg_receive_error(kmsg, msg_addr + offset,
+						option, self->ith_seqno, space);
+			}
+			if (put_mr == MACH_MSG_SUCCESS) {
+				offset += round_msg(ipc_kmsg_put_size(size));
+				count++;
+				error = mr;
+			} else
+				error = put_mr;
+			break;
+		}
+
+		size = kmsg->ikm_header->msgh_size + trailer_size;
+		mr = ipc_kmsg_put(msg_addr + offset, kmsg, size);
+		if (mr != MACH_MSG_SUCCESS) {
+			error = mr;
+			break;
+		}
+		offset += round_msg(ipc_kmsg_put_size(size));
+		count++;
+	}
+
+	bzero(&end, sizeof(end));
+	end.count = count;
+	end.error = error;
+	(void) copyout((char *) &end, msg_addr + offset, sizeof(end));
+}
+
 mach_msg_return_t
 mach_msg_receive(
 	mach_msg_header_t	*msg,
@@ -412,6 +533,7 @@ mach_msg_overwrite_trap(
 	
 	if (option & MACH_SEND_MSG) {
 		ipc_space_t space = current_space();
+		mach_msg_option_t send_option = option & MACH_SEND_TIMEOUT;
 		ipc_kmsg_t kmsg;
 
 		mr = ipc_kmsg_get(msg_addr, send_size, &kmsg);
@@ -425,9 +547,21 @@ mach_msg_overwrite_trap(
 			return mr;
 		}
 
-		mr = ipc_kmsg_send(kmsg, option & MACH_SEND_TIMEOUT, msg_timeout);
+		/*
+		 * RPC fast path: if we are about to wait for the reply,
+		 * let ipc_mqueue_post() hold on to the receiver it hands
+		 * the request to, and switch directly to it when
+		 * ipc_mqueue_receive() blocks below.  If we block or are
+		 * preempted before that, thread_dispatch() puts the
+		 * receiver on a run queue instead.
+		 */
+		if (option & MACH_RCV_MSG)
+			send_option |= MACH_SEND_HANDOFF;
+
+		mr = ipc_kmsg_send(kmsg, send_option, msg_timeout);
 
 		if (mr != MACH_MSG_SUCCESS) {
+			ipc_mqueue_handoff_cancel(current_thread());
 			mr |= ipc_kmsg_copyout_pseudo(kmsg, space, map, MACH_MSG_BODY_NULL);
 			(void) ipc_kmsg_put(msg_addr, kmsg, kmsg->ikm_header->msgh_size);
 			return mr;
@@ -442,6 +576,7 @@ mach_msg_overwrite_trap(
 
 		mr = ipc_mqueue_copyin(space, rcv_name, &mqueue, &object);
 		if (mr != MACH_MSG_SUCCESS) {
+			ipc_mqueue_handoff_cancel(self);
 			return mr;
 		}
 		/* hold ref for object */
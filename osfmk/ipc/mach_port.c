@@ -1294,13 +1294,18 @@ mach_port_move_member(
 
 	queue_init(links);
 
-	kr = ipc_right_lookup_read(space, member, &entry);
+	/*
+	 *	Changing set membership takes the space write lock,
+	 *	so that it is serialized with every other change to
+	 *	the member's and the set's rights.
+	 */
+	kr = ipc_right_lookup_write(space, member, &entry);
 	if (kr != KERN_SUCCESS)
 		goto done;
-	/* space is read-locked and active */
+	/* space is write-locked and active */
 
 	if ((entry->ie_bits & MACH_PORT_TYPE_RECEIVE) == 0) {
-		is_read_unlock(space);
+		is_write_unlock(space);
 		kr = KERN_INVALID_RIGHT;
 		goto done;
 	}
@@ -1313,13 +1318,13 @@ mach_port_move_member(
 	else {
 		entry = ipc_entry_lookup(space, after);
 		if (entry == IE_NULL) {
-			is_read_unlock(space);
+			is_write_unlock(space);
 			kr = KERN_INVALID_NAME;
 			goto done;
 		}
 
 		if ((entry->ie_bits & MACH_PORT_TYPE_PORT_SET) == 0) {
-			is_read_unlock(space);
+			is_write_unlock(space);
 			kr = KERN_INVALID_RIGHT;
 			goto done;
 		}
@@ -1336,7 +1341,7 @@ mach_port_move_member(
 		ips_unlock(nset);
 	}
 	ip_unlock(port);
-	is_read_unlock(space);
+	is_write_unlock(space);
 
  done:
 	if (kr != KERN_SUCCESS && wql != WAIT_QUEUE_LINK_NULL)
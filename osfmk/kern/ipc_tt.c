@@ -430,6 +430,7 @@ ipc_thread_init(
 	ipc_kmsg_queue_init(&thread->ith_messages);
 
 	thread->ith_rpc_reply = IP_NULL;
+	thread->ith_handoff = THREAD_NULL;
 }
 
 void
@@ -78,6 +78,7 @@
 #include <vm/vm_object.h>
 #include <vm/vm_map.h>
 #include <libkern/OSMalloc.h>
+#include <pexpert/pexpert.h>
 
 #ifdef MACH_BSD
 zone_t kalloc_zone(vm_size_t);
@@ -137,12 +138,17 @@ KALLOC_ZINFO_SFREE(vm_size_t bytes)
 }
 
 /*
- *	All allocations of size less than kalloc_max are rounded to the
- *	next nearest sized zone.  This allocator is built on top of
+ *	All allocations of size less than kalloc_max_prerounded are rounded
+ *	to the next nearest sized zone.  This allocator is built on top of
  *	the zone allocator.  A zone is created for each potential size
  *	that we are willing to get in small blocks.
  *
- *	We assume that kalloc_max is not greater than 64K;
+ *	Size classes are spaced roughly 1.25x apart (three per power of
+ *	two) so that internal fragmentation stays bounded at about 25%
+ *	all the way up to KALLOC_MAX_ZONE_SIZE.  The larger classes are
+ *	backed by multi-page zone chunks (zinit() picks an allocation size
+ *	that is a whole number of elements), which keeps mid-size requests
+ *	out of kalloc_map and off its map lock.
  *
  *	Note that kalloc_max is somewhat confusingly named.
  *	It represents the first power of two for which no zone exists.
@@ -153,89 +159,106 @@ KALLOC_ZINFO_SFREE(vm_size_t bytes)
  *	then allocate from kernel map rather than kalloc_map.
  */
 
+#define KALLOC_MAX_ZONE_SIZE	32768
+
 #if KALLOC_MINSIZE == 16 && KALLOC_LOG2_MINALIGN == 4
 
 /*
- * "Legacy" aka "power-of-2" backing zones with 16-byte minimum
- * size and alignment.  Users of this profile would probably
- * benefit from some tuning.
+ * 16-byte minimum size and alignment.  Classes at or below
+ * MAX_SIZE_ZDLUT are multiples of 16; classes above it are
+ * multiples of KALLOC_ZDLUT_GRAIN.
  */
 
 #define K_ZONE_SIZES			\
-	16,				\
-	32,				\
-/* 6 */	64,				\
-	128,				\
-	256,				\
-/* 9 */	512,				\
-	1024,				\
-	2048,				\
-/* C */	4096
-
+	16,	32,	48,		\
+/* 6 */	64,	80,	96,		\
+	128,	160,	192,		\
+	256,	320,	384,		\
+/* 9 */	512,	640,	768,		\
+	1024,	1280,	1536,		\
+	2048,	2560,	3072,		\
+/* C */	4096,	5120,	6144,		\
+	8192,	10240,	12288,		\
+	16384,	20480,	24576,		\
+/* F */	32768
 
 #define K_ZONE_NAMES			\
-	"kalloc.16",			\
-	"kalloc.32",			\
-/* 6 */	"kalloc.64",			\
-	"kalloc.128",			\
-	"kalloc.256",			\
-/* 9 */	"kalloc.512",			\
-	"kalloc.1024",			\
-	"kalloc.2048",			\
-/* C */	"kalloc.4096"
+	"kalloc.16",	"kalloc.32",	"kalloc.48",	\
+/* 6 */	"kalloc.64",	"kalloc.80",	"kalloc.96",	\
+	"kalloc.128",	"kalloc.160",	"kalloc.192",	\
+	"kalloc.256",	"kalloc.320",	"kalloc.384",	\
+/* 9 */	"kalloc.512",	"kalloc.640",	"kalloc.768",	\
+	"kalloc.1024",	"kalloc.1280",	"kalloc.1536",	\
+	"kalloc.2048",	"kalloc.2560",	"kalloc.3072",	\
+/* C */	"kalloc.4096",	"kalloc.5120",	"kalloc.6144",	\
+	"kalloc.8192",	"kalloc.10240",	"kalloc.12288",	\
+	"kalloc.16384",	"kalloc.20480",	"kalloc.24576",	\
+/* F */	"kalloc.32768"
 
 #define K_ZONE_MAXIMA			\
-	1024,				\
-	4096,				\
-/* 6 */	4096,				\
-	4096,				\
-	4096,				\
-/* 9 */	1024,				\
-	1024,				\
-	1024,				\
-/* C */	1024
+	1024,	4096,	4096,		\
+/* 6 */	4096,	4096,	4096,		\
+	4096,	4096,	4096,		\
+	4096,	1024,	1024,		\
+/* 9 */	1024,	1024,	1024,		\
+	1024,	1024,	1024,		\
+	1024,	1024,	1024,		\
+/* C */	1024,	1024,	1024,		\
+	4096,	256,	256,		\
+	256,	128,	128,		\
+/* F */	128
 
 #elif KALLOC_MINSIZE == 8 && KALLOC_LOG2_MINALIGN == 3
 
 /*
- * Tweaked for ARM (and x64) in 04/2011
+ * As above, with 8-byte granularity for the smallest structures
+ * (tweaked for ARM and x64 in 04/2011).
  */
 
 #define K_ZONE_SIZES			\
 /* 3 */	8,				\
 	16,	24,			\
 	32,	40,	48,		\
-/* 6 */	64,	88,	112, 		\
-	128, 	192,			\
-	256, 	384,			\
-/* 9 */	512,	768, 			\
-	1024,	1536,			\
-	2048,	3072,			\
-	4096,	6144
+/* 6 */	64,	80,	96,		\
+	128,	160,	192,		\
+	256,	320,	384,		\
+/* 9 */	512,	640,	768,		\
+	1024,	1280,	1536,		\
+	2048,	2560,	3072,		\
+/* C */	4096,	5120,	6144,		\
+	8192,	10240,	12288,		\
+	16384,	20480,	24576,		\
+/* F */	32768
 
 #define K_ZONE_NAMES			\
 /* 3 */	"kalloc.8",			\
 	"kalloc.16",	"kalloc.24",	\
 	"kalloc.32",	"kalloc.40",	"kalloc.48",	\
-/* 6 */	"kalloc.64",	"kalloc.88",	"kalloc.112",	\
-	"kalloc.128",	"kalloc.192",	\
-	"kalloc.256",	"kalloc.384",	\
-/* 9 */	"kalloc.512",	"kalloc.768",	\
-	"kalloc.1024",	"kalloc.1536",	\
-	"kalloc.2048",	"kalloc.3072",	\
-	"kalloc.4096",	"kalloc.6144"
+/* 6 */	"kalloc.64",	"kalloc.80",	"kalloc.96",	\
+	"kalloc.128",	"kalloc.160",	"kalloc.192",	\
+	"kalloc.256",	"kalloc.320",	"kalloc.384",	\
+/* 9 */	"kalloc.512",	"kalloc.640",	"kalloc.768",	\
+	"kalloc.1024",	"kalloc.1280",	"kalloc.1536",	\
+	"kalloc.2048",	"kalloc.2560",	"kalloc.3072",	\
+/* C */	"kalloc.4096",	"kalloc.5120",	"kalloc.6144",	\
+	"kalloc.8192",	"kalloc.10240",	"kalloc.12288",	\
+	"kalloc.16384",	"kalloc.20480",	"kalloc.24576",	\
+/* F */	"kalloc.32768"
 
 #define	K_ZONE_MAXIMA			\
 /* 3 */	1024,				\
 	1024,	1024,			\
 	4096,	4096,	4096,		\
 /* 6 */	4096,	4096,	4096,		\
-	4096,	4096,			\
-	4096,	4096,			\
-/* 9 */	1024,	1024,			\
-	1024,	1024,			\
-	1024,	1024,			\
-/* C */	1024,	64
+	4096,	4096,	4096,		\
+	4096,	4096,	4096,		\
+/* 9 */	1024,	1024,	1024,		\
+	1024,	1024,	1024,		\
+	1024,	1024,	1024,		\
+/* C */	1024,	1024,	1024,		\
+	1024,	256,	256,		\
+	256,	128,	128,		\
+/* F */	128
 
 #else
 #error	missing zone size parameters for kalloc
@@ -244,41 +267,40 @@ KALLOC_ZINFO_SFREE(vm_size_t bytes)
 #define KALLOC_MINALIGN (1 << KALLOC_LOG2_MINALIGN)
 
 static const int k_zone_size[] = {
-	K_ZONE_SIZES,
-	8192,
-	16384,
-/* F */	32768
+	K_ZONE_SIZES
 };
 
 #define N_K_ZONE	(sizeof (k_zone_size) / sizeof (k_zone_size[0]))
 
 /*
- * Many kalloc() allocations are for small structures containing a few
- * pointers and longs - the k_zone_dlut[] direct lookup table, indexed by
- * size normalized to the minimum alignment, finds the right zone index
- * for them in one dereference.
+ * Every zone-backed size is mapped to its zone in one dereference.
+ * Small allocations, which are mostly structures containing a few
+ * pointers and longs, use k_zone_dlut[], indexed by size normalized
+ * to the minimum alignment.  Larger ones use k_zone_dlut_large[],
+ * indexed by size normalized to KALLOC_ZDLUT_GRAIN; every class above
+ * MAX_SIZE_ZDLUT is a multiple of the grain, so rounding up to it
+ * never skips a zone that would have fit.
  */
 
 #define INDEX_ZDLUT(size)	\
 			(((size) + KALLOC_MINALIGN - 1) / KALLOC_MINALIGN)
-#define N_K_ZDLUT	(2048 / KALLOC_MINALIGN)
-				/* covers sizes [0 .. 2048 - KALLOC_MINALIGN] */
+#define N_K_ZDLUT	(2048 / KALLOC_MINALIGN + 1)
+				/* covers sizes [0 .. 2048] */
 #define MAX_SIZE_ZDLUT	((N_K_ZDLUT - 1) * KALLOC_MINALIGN)
 
-static int8_t k_zone_dlut[N_K_ZDLUT];	/* table of indices into k_zone[] */
+#define KALLOC_ZDLUT_GRAIN	256
+#define INDEX_ZDLUT_LARGE(size)	\
+			(((size) + KALLOC_ZDLUT_GRAIN - 1) / KALLOC_ZDLUT_GRAIN)
+#define N_K_ZDLUT_LARGE	(KALLOC_MAX_ZONE_SIZE / KALLOC_ZDLUT_GRAIN + 1)
+				/* covers sizes [0 .. KALLOC_MAX_ZONE_SIZE] */
 
-/*
- * If there's no hit in the DLUT, then start searching from k_zindex_start.
- */
-static int k_zindex_start;
+static int8_t k_zone_dlut[N_K_ZDLUT];	/* table of indices into k_zone[] */
+static int8_t k_zone_dlut_large[N_K_ZDLUT_LARGE];
 
 static zone_t k_zone[N_K_ZONE];
 
 static const char *k_zone_name[N_K_ZONE] = {
-	K_ZONE_NAMES,
-	"kalloc.8192",
-	"kalloc.16384",
-/* F */	"kalloc.32768"
+	K_ZONE_NAMES
 };
 
 /*
@@ -288,12 +310,20 @@ static const char *k_zone_name[N_K_ZONE] = {
  *  means its patchable in case you're wrong!
  */
 unsigned int k_zone_max[N_K_ZONE] = {
-	K_ZONE_MAXIMA,
-	4096,
-	64,
-/* F */	64
+	K_ZONE_MAXIMA
 };
 
+/*
+ * Per size class histogram of zone-backed allocations.  The requested
+ * byte counts, set against elem_size times the allocation counts, give
+ * the internal fragmentation of each class.  Collection costs two
+ * atomic operations per kalloc/kfree and is off unless the "kalloc_hist"
+ * boot-arg or the kern.kalloc_histogram_enable sysctl turns it on.
+ */
+int kalloc_histogram_enabled = 0;
+
+static struct kalloc_class_stat k_zone_stat[N_K_ZONE];
+
 /* #define KALLOC_DEBUG		1 */
 
 /* forward declarations */
@@ -325,6 +355,20 @@ void OSMalloc_init(void);
 void OSMalloc_Tagref(OSMallocTag	tag);
 void OSMalloc_Tagrele(OSMallocTag	tag);
 
+/*
+ * Given an allocation size, return the index of the kalloc zone
+ * it belongs to.
+ */
+static __inline int
+get_zone_index(vm_size_t size)
+{
+	assert(size < kalloc_max_prerounded);
+
+	if (size <= MAX_SIZE_ZDLUT)
+		return ((int)k_zone_dlut[INDEX_ZDLUT(size)]);
+	return ((int)k_zone_dlut_large[INDEX_ZDLUT_LARGE(size)]);
+}
+
 /*
  *	Initialize the memory allocator.  This should be called only
  *	once on a system wide basis (i.e. first processor to get here
@@ -365,18 +409,16 @@ kalloc_init(
 	kalloc_map_max = min + kalloc_map_size - 1;
 
 	/*
-	 *	Ensure that zones up to size 8192 bytes exist.
-	 *	This is desirable because messages are allocated
-	 *	with kalloc, and messages up through size 8192 are common.
+	 *	Ensure that zones up to KALLOC_MAX_ZONE_SIZE bytes exist.
+	 *	This is desirable because messages, xattrs, network buffers
+	 *	and IOKit containers are allocated with kalloc, and sizes up
+	 *	through 32K are common.
 	 */
 
-	if (PAGE_SIZE < 16*1024)
-		kalloc_max = 16*1024;
-	else
-		kalloc_max = PAGE_SIZE;
+	kalloc_max = KALLOC_MAX_ZONE_SIZE * 2;
 	kalloc_max_prerounded = kalloc_max / 2 + 1;
-	/* size it to be more than 16 times kalloc_max (256k) for allocations from kernel map */
-	kalloc_kernmap_size = (kalloc_max * 16) + 1;
+	/* allocations of 256k and more come from the kernel map */
+	kalloc_kernmap_size = (kalloc_max * 4) + 1;
 	kalloc_largest_allocated = kalloc_kernmap_size;
 
 	/*
@@ -385,65 +427,59 @@ kalloc_init(
 	 *	for the allocation, as we aren't sure how the memory
 	 *	will be handled.
 	 */
-	for (i = 0; (size = k_zone_size[i]) < kalloc_max; i++) {
+	for (i = 0; i < (int)N_K_ZONE; i++) {
+		size = k_zone_size[i];
 		k_zone[i] = zinit(size, k_zone_max[i] * size, size,
 				  k_zone_name[i]);
 		zone_change(k_zone[i], Z_CALLERACCT, FALSE);
+		zone_change(k_zone[i], Z_CACHING_ENABLED, TRUE);
+		k_zone_stat[i].kcs_elem_size = size;
 	}
 
 	/*
-	 * Build the Direct LookUp Table for small allocations
+	 * Build the Direct LookUp Tables
 	 */
-	for (i = 0, size = 0; i <= N_K_ZDLUT; i++, size += KALLOC_MINALIGN) {
+	for (i = 0, size = 0; i < (int)N_K_ZDLUT; i++, size += KALLOC_MINALIGN) {
 		int zindex = 0;
 
 		while ((vm_size_t)k_zone_size[zindex] < size)
 			zindex++;
-
-		if (i == N_K_ZDLUT) {
-			k_zindex_start = zindex;
-			break;
-		}
 		k_zone_dlut[i] = (int8_t)zindex;
 	}
+	for (i = 0, size = 0; i < (int)N_K_ZDLUT_LARGE; i++, size += KALLOC_ZDLUT_GRAIN) {
+		int zindex = 0;
 
-#ifdef KALLOC_DEBUG
-	printf("kalloc_init: k_zindex_start %d\n", k_zindex_start);
+		while ((vm_size_t)k_zone_size[zindex] < size)
+			zindex++;
+		k_zone_dlut_large[i] = (int8_t)zindex;
+	}
+
+	if (!PE_parse_boot_argn("kalloc_hist", &kalloc_histogram_enabled,
+				sizeof (kalloc_histogram_enabled)))
+		kalloc_histogram_enabled = 0;
 
+#ifdef KALLOC_DEBUG
 	/*
-	 * Do a quick synthesis to see how well/badly we can
-	 * find-a-zone for a given size.
+	 * Check that each size around a class boundary lands in the
+	 * smallest zone that fits it.
 	 * Useful when debugging/tweaking the array of zone sizes.
-	 * Cache misses probably more critical than compare-branches!
 	 */
 	for (i = 0; i < (int)N_K_ZONE; i++) {
-		vm_size_t testsize = (vm_size_t)k_zone_size[i] - 1;
-		int compare = 0;
-		int zindex;
-
-		if (testsize < MAX_SIZE_ZDLUT) {
-			compare += 1;	/* 'if' (T) */
-
-			long dindex = INDEX_ZDLUT(testsize);
-			zindex = (int)k_zone_dlut[dindex];
-
-		} else if (testsize < kalloc_max_prerounded) {
-
-			compare += 2;	/* 'if' (F), 'if' (T) */
-
-			zindex = k_zindex_start;
-			while ((vm_size_t)k_zone_size[zindex] < testsize) {
-				zindex++;
-				compare++;	/* 'while' (T) */
-			}
-			compare++;	/* 'while' (F) */
-		} else
-			break;	/* not zone-backed */
-
-		zone_t z = k_zone[zindex];
-		printf("kalloc_init: req size %4lu: %11s took %d compare%s\n",
-		    (unsigned long)testsize, z->zone_name, compare,
-		    compare == 1 ? "" : "s");
+		vm_size_t testsize;
+
+		for (testsize = (vm_size_t)k_zone_size[i] - 1;
+		     testsize <= (vm_size_t)k_zone_size[i] + 1 &&
+		     testsize < kalloc_max_prerounded; testsize++) {
+			int zindex = get_zone_index(testsize);
+
+			if ((vm_size_t)k_zone_size[zindex] < testsize ||
+			    (zindex > 0 &&
+			     (vm_size_t)k_zone_size[zindex - 1] >= testsize))
+				panic("kalloc_init: req size %lu maps to %s",
+				    (unsigned long)testsize, k_zone_name[zindex]);
+		}
+		printf("kalloc_init: %11s alloc size %lu\n",
+		    k_zone[i]->zone_name, (unsigned long)k_zone[i]->alloc_size);
 	}
 #endif
 	kalloc_lck_grp = lck_grp_alloc_init("kalloc.large", LCK_GRP_ATTR_NULL);
@@ -454,53 +490,25 @@ kalloc_init(
 #endif	
 }
 
-/*
- * Given an allocation size, return the kalloc zone it belongs to.
- * Direct LookUp Table variant.
- */
-static __inline zone_t
-get_zone_dlut(vm_size_t size)
-{
-	long dindex = INDEX_ZDLUT(size);
-	int zindex = (int)k_zone_dlut[dindex];
-	return (k_zone[zindex]);
-}
-
-/* As above, but linear search k_zone_size[] for the next zone that fits. */
-
-static __inline zone_t
-get_zone_search(vm_size_t size, int zindex)
-{
-	assert(size < kalloc_max_prerounded);
-
-	while ((vm_size_t)k_zone_size[zindex] < size)
-		zindex++;
-
-	assert((unsigned)zindex < N_K_ZONE &&
-	    (vm_size_t)k_zone_size[zindex] < kalloc_max);
-
-	return (k_zone[zindex]);
-}
-
 void *
 kalloc_canblock(
 		vm_size_t	size,
 		boolean_t       canblock)
 {
 	zone_t z;
+	int zindex;
+	void *addr;
 
-	if (size < MAX_SIZE_ZDLUT)
-		z = get_zone_dlut(size);
-	else if (size < kalloc_max_prerounded)
-		z = get_zone_search(size, k_zindex_start);
-	else {
+	if (size < kalloc_max_prerounded) {
+		zindex = get_zone_index(size);
+		z = k_zone[zindex];
+	} else {
 		/*
 		 * If size is too large for a zone, then use kmem_alloc.
 		 * (We use kmem_alloc instead of kmem_alloc_kobject so that
 		 * krealloc can use kmem_realloc.)
 		 */
 		vm_map_t alloc_map;
-		void *addr;
 
 		/* kmem_alloc could block so we return if noblock */
 		if (!canblock) {
@@ -549,7 +557,12 @@ kalloc_canblock(
 		    z, z->zone_name, (unsigned long)size);
 #endif
 	assert(size <= z->elem_size);
-	return (zalloc_canblock(z, canblock));
+	addr = zalloc_canblock(z, canblock);
+	if (kalloc_histogram_enabled && addr != NULL) {
+		OSAddAtomic64(1, &k_zone_stat[zindex].kcs_allocs);
+		OSAddAtomic64(size, &k_zone_stat[zindex].kcs_bytes_requested);
+	}
+	return (addr);
 }
 
 void *
@@ -574,12 +587,12 @@ kfree(
 	vm_size_t	size)
 {
 	zone_t z;
+	int zindex;
 
-	if (size < MAX_SIZE_ZDLUT)
-		z = get_zone_dlut(size);
-	else if (size < kalloc_max_prerounded)
-		z = get_zone_search(size, k_zindex_start);
-	else {
+	if (size < kalloc_max_prerounded) {
+		zindex = get_zone_index(size);
+		z = k_zone[zindex];
+	} else {
 		/* if size was too large for a zone, then use kmem_free */
 
 		vm_map_t alloc_map = kernel_map;
@@ -630,6 +643,10 @@ kfree(
 		    z, z->zone_name, (unsigned long)size);
 #endif
 	assert(size <= z->elem_size);
+	if (kalloc_histogram_enabled) {
+		OSAddAtomic64(1, &k_zone_stat[zindex].kcs_frees);
+		OSAddAtomic64(size, &k_zone_stat[zindex].kcs_bytes_released);
+	}
 	zfree(z, data);
 }
 
@@ -638,14 +655,28 @@ zone_t
 kalloc_zone(
 	vm_size_t       size)
 {
-	if (size < MAX_SIZE_ZDLUT)
-		return (get_zone_dlut(size));
-	if (size <= kalloc_max)
-		return (get_zone_search(size, k_zindex_start));
+	if (size < kalloc_max_prerounded)
+		return (k_zone[get_zone_index(size)]);
 	return (ZONE_NULL);
 }
 #endif
 
+/*
+ * Copy out the per size class histogram.  Returns the number of
+ * size classes; at most count entries are filled in.
+ */
+unsigned int
+kalloc_histogram(
+	struct kalloc_class_stat	*stats,
+	unsigned int			count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count && i < N_K_ZONE; i++)
+		stats[i] = k_zone_stat[i];
+	return (N_K_ZONE);
+}
+
 void
 kalloc_fake_zone_init(int zone_index)
 {
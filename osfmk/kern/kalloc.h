@@ -71,6 +71,28 @@ extern void *kalloc_noblock(vm_size_t	size);
 extern void kfree(void		*data,
 		  vm_size_t	size);
 
+#ifdef	XNU_KERNEL_PRIVATE
+
+/*
+ * Per size class kalloc statistics, collected while
+ * kalloc_histogram_enabled is set.
+ */
+struct kalloc_class_stat {
+	uint64_t	kcs_elem_size;		/* size class */
+	uint64_t	kcs_allocs;		/* allocations served */
+	uint64_t	kcs_frees;		/* frees returned */
+	uint64_t	kcs_bytes_requested;	/* sum of sizes asked for */
+	uint64_t	kcs_bytes_released;	/* sum of sizes freed */
+};
+
+extern int kalloc_histogram_enabled;
+
+extern unsigned int kalloc_histogram(
+				struct kalloc_class_stat	*stats,
+				unsigned int			count);
+
+#endif	/* XNU_KERNEL_PRIVATE */
+
 __END_DECLS
 
 #ifdef	MACH_KERNEL_PRIVATE
@@ -75,11 +75,17 @@ struct processor_data {
 	/* VM event counters */
 	vm_statistics64_data_t	vm_stat;
 
-	/* IPC free message cache */
+	/* IPC free message caches, one per kmsg size class */
 	struct ikm_cache {
 #define IKM_STASH	16
-		ipc_kmsg_t				entries[IKM_STASH];
-		unsigned int			avail;
+#define IKM_CACHE_CLASSES	6
+		struct ikm_stash {
+			ipc_kmsg_t			entries[IKM_STASH];
+			unsigned int		avail;
+			unsigned int		hits;
+			unsigned int		misses;
+		}					stash[IKM_CACHE_CLASSES];
+		unsigned int			epoch;
 	}						ikm_cache;
 
 	unsigned long			page_grab_count;
@@ -1016,6 +1016,54 @@ thread_go(
 	return (KERN_NOT_WAITING);
 }
 
+/*
+ *	Routine:	thread_go_handoff
+ *	Purpose:
+ *		Unblock a thread that the caller means to switch to
+ *		directly with thread_run().  If the thread is eligible
+ *		for a handoff from this processor it is left runnable
+ *		but on no run queue, and the caller must either
+ *		thread_run() it or dispatch it with thread_setrun().
+ *		Otherwise it is dispatched as thread_go() would.
+ *	Conditions:
+ *		thread lock held, IPC locks may be held.
+ *		thread must have been pulled from wait queue under same lock hold.
+ *  Returns:
+ *		TRUE  - Thread was left for the caller to run
+ *		FALSE - Thread was set running, or was not waiting
+ */
+boolean_t
+thread_go_handoff(
+	thread_t		thread,
+	wait_result_t	wresult)
+{
+	processor_t		processor = current_processor();
+
+	assert(thread->at_safe_point == FALSE);
+	assert(thread->wait_event == NO_EVENT64);
+	assert(thread->wait_queue == WAIT_QUEUE_NULL);
+
+	if ((thread->state & (TH_WAIT|TH_TERMINATE)) != TH_WAIT)
+		return (FALSE);
+
+	if (thread_unblock(thread, wresult))
+		return (FALSE);
+
+	/*
+	 *	Same restrictions as thread_switch(): no realtime
+	 *	on either side, and no binding to another processor.
+	 */
+	if (processor->current_pri < BASEPRI_RTQUEUES			&&
+		thread->sched_pri < BASEPRI_RTQUEUES				&&
+		(thread->bound_processor == PROCESSOR_NULL	||
+		 thread->bound_processor == processor)				)
+		return (TRUE);
+
+	thread_setrun(thread, SCHED_PREEMPT | SCHED_TAILQ);
+
+	return (FALSE);
+}
+
 /*
  *	Routine:	thread_mark_wait_locked
  *	Purpose:
@@ -2302,6 +2350,9 @@ need_stack:
 	return (TRUE);
 }
 
+/* direct IPC handoffs that ended up on a run queue; see ipc_mqueue.c */
+extern uint32_t		ipc_mqueue_handoff_fallbacks;
+
 /*
  *	thread_dispatch:
  *
@@ -2320,6 +2371,22 @@ thread_dispatch(
 	processor_t		processor = self->last_processor;
 
 	if (thread != THREAD_NULL) {
+		/*
+		 *	A receiver that ipc_mqueue_post() left for a direct
+		 *	handoff we did not make, because we blocked or were
+		 *	preempted first: it is on no run queue, so put it on
+		 *	one now.
+		 */
+		if (thread->ith_handoff != THREAD_NULL) {
+			thread_t	handoff = thread->ith_handoff;
+
+			thread->ith_handoff = THREAD_NULL;
+			thread_lock(handoff);
+			thread_setrun(handoff, SCHED_PREEMPT | SCHED_TAILQ);
+			thread_unlock(handoff);
+			(void)hw_atomic_add(&ipc_mqueue_handoff_fallbacks, 1);
+		}
+
 		/*
 		 *	If blocked at a continuation, discard
 		 *	the stack.
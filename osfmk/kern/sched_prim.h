@@ -106,6 +106,11 @@ extern kern_return_t	thread_go(
 						 	thread_t		thread,
 							wait_result_t	wresult);
 
+/* Unblock thread for a direct handoff */
+extern boolean_t		thread_go_handoff(
+							thread_t		thread,
+							wait_result_t	wresult);
+
 /* Handle threads at context switch */
 extern void			thread_dispatch(
 						thread_t		old_thread,
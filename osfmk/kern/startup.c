@@ -328,6 +328,7 @@ kernel_bootstrap_thread(void)
 #endif
 
 	vm_kernel_reserved_entry_init();
+	vm_page_radix_reserve_init();
 	
 #if MACH_KDP
 	kernel_bootstrap_kprintf("calling kdp_init\n");
@@ -171,6 +171,8 @@ int task_max = CONFIG_TASK_MAX; /* Max number of tasks */
 /* externs for BSD kernel */
 extern void proc_getexecutableuuid(void *, unsigned char *, unsigned long);
 
+extern unsigned int ipc_kmsg_ool_loan_threshold;
+
 /* Forwards */
 
 void		task_hold_locked(
@@ -430,6 +432,12 @@ task_create_internal(
 	if (parent_task)
 		vm_map_set_user_wire_limit(new_task->map, (vm_size_t)parent_task->map->user_wire_limit);
 
+	/* Inherit the OOL page-loaning threshold from parent */
+	if (parent_task)
+		new_task->ool_loan_threshold = parent_task->ool_loan_threshold;
+	else
+		new_task->ool_loan_threshold = ipc_kmsg_ool_loan_threshold;
+
 	lck_mtx_init(&new_task->lock, &task_lck_grp, &task_lck_attr);
 	queue_init(&new_task->threads);
 	new_task->suspend_count = 0;
@@ -272,6 +272,9 @@ struct task {
 	/* Virtual timers */
 	uint32_t		vtimers;
 
+	/* Lend page-aligned OOL regions at least this large; 0 = never */
+	vm_size_t		ool_loan_threshold;
+
 	/* IPC structures */
 	decl_lck_mtx_data(,itk_lock_data)
 	struct ipc_port *itk_self;	/* not a right, doesn't hold ref */
@@ -48,6 +48,8 @@ extern void memorystatus_on_suspend(int pid);
 extern void memorystatus_on_resume(int pid);
 #endif
 
+extern unsigned int ipc_kmsg_ool_loan_threshold;
+
 static int proc_apply_bgtaskpolicy_internal(task_t, int, int);
 static int proc_restore_bgtaskpolicy_internal(task_t, int, int, int);
 static int task_get_cpuusage(task_t task, uint32_t * percentagep, uint64_t * intervalp, uint64_t * deadlinep);
@@ -283,6 +285,20 @@ task_policy_set(
 		break;
 	}
 
+	case TASK_OOL_LOAN_POLICY:
+	{
+		task_ool_loan_policy_t info = (task_ool_loan_policy_t)policy_info;
+
+		if (count < TASK_OOL_LOAN_POLICY_COUNT)
+			return (KERN_INVALID_ARGUMENT);
+
+		task_lock(task);
+		task->ool_loan_threshold = info->threshold;
+		task_unlock(task);
+
+		break;
+	}
+
 	default:
 		result = KERN_INVALID_ARGUMENT;
 		break;
@@ -379,6 +395,23 @@ task_policy_get(
 		break;
 	}
 
+	case TASK_OOL_LOAN_POLICY:
+	{
+		task_ool_loan_policy_t		info = (task_ool_loan_policy_t)policy_info;
+
+		if (*count < TASK_OOL_LOAN_POLICY_COUNT)
+			return (KERN_INVALID_ARGUMENT);
+
+		if (*get_default)
+			info->threshold = ipc_kmsg_ool_loan_threshold;
+		else {
+			task_lock(task);
+			info->threshold = (natural_t)task->ool_loan_threshold;
+			task_unlock(task);
+		}
+		break;
+	}
+
 	default:
 		return (KERN_INVALID_ARGUMENT);
 	}
@@ -332,6 +332,7 @@ struct thread {
 	/* IPC data structures */
 	struct ipc_kmsg_queue ith_messages;
 	mach_port_t ith_rpc_reply;			/* reply port for kernel RPCs */
+	struct thread *ith_handoff;			/* receiver to run when we block */
 
 	/* Ast/Halt data structures */
 	vm_offset_t					recover;		/* page fault recover(copyin/out) */
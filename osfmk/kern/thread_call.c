@@ -53,7 +53,19 @@
 static zone_t			thread_call_zone;
 static struct wait_queue	daemon_wqueue;
 
+/*
+ * Each group has its own lock, so callouts of different priorities
+ * never contend with one another.  The pool of internal callouts is
+ * only used by the high-priority group and is covered by its lock;
+ * the daemon wakeup flag is updated atomically.
+ */
 struct thread_call_group {
+#if defined(__i386__) || defined(__x86_64__)
+	lck_mtx_t		lock;
+#else
+	lck_spin_t		lock;
+#endif
+
 	queue_head_t		pending_queue;
 	uint32_t		pending_count;
 
@@ -72,6 +84,10 @@ struct thread_call_group {
 
 	uint32_t		flags;
 	sched_call_t		sched_call;
+
+	/* log2 histograms, in microseconds; see thread_call_group_stats() */
+	uint64_t		latency_hist[THREAD_CALL_HIST_BUCKETS];
+	uint64_t		runtime_hist[THREAD_CALL_HIST_BUCKETS];
 };
 
 typedef struct thread_call_group	*thread_call_group_t;
@@ -87,7 +103,7 @@ typedef struct thread_call_group	*thread_call_group_t;
 #define THREAD_CALL_MACH_FACTOR_CAP	3
 
 static struct thread_call_group	thread_call_groups[THREAD_CALL_GROUP_COUNT];
-static boolean_t		thread_call_daemon_awake;
+static volatile uint32_t	thread_call_daemon_awake;
 static thread_call_data_t	internal_call_storage[INTERNAL_CALL_COUNT];
 static queue_head_t		thread_call_internal_queue;
 static uint64_t 		thread_call_dealloc_interval_abs;
@@ -108,7 +124,7 @@ static void			thread_call_dealloc_timer(timer_call_param_t p0, timer_call_param_
 static void			thread_call_group_setup(thread_call_group_t group, thread_call_priority_t pri, uint32_t target_thread_count, boolean_t parallel);
 static void			sched_call_thread(int type, thread_t thread);
 static void			thread_call_start_deallocate_timer(thread_call_group_t group);
-static void			thread_call_wait_locked(thread_call_t call);
+static void			thread_call_wait_locked(thread_call_t call, thread_call_group_t group);
 
 #define qe(x)		((queue_entry_t)(x))
 #define TC(x)		((thread_call_t)(x))
@@ -119,38 +135,52 @@ lck_grp_t               thread_call_lck_grp;
 lck_attr_t              thread_call_lck_attr;
 lck_grp_attr_t          thread_call_lck_grp_attr;
 
-#if defined(__i386__) || defined(__x86_64__)
-lck_mtx_t		thread_call_lock_data;
-#else
-lck_spin_t		thread_call_lock_data;
-#endif
-
+#define thread_call_lock_spin(group)		\
+	lck_mtx_lock_spin_always(&(group)->lock)
 
-#define thread_call_lock_spin()			\
-	lck_mtx_lock_spin_always(&thread_call_lock_data)
-
-#define thread_call_unlock()			\
-	lck_mtx_unlock_always(&thread_call_lock_data)
+#define thread_call_unlock(group)		\
+	lck_mtx_unlock_always(&(group)->lock)
 
 
 static inline spl_t
-disable_ints_and_lock(void)
+disable_ints_and_lock(thread_call_group_t group)
 {
 	spl_t s;
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	return s;
 }
 
 static inline void 
-enable_ints_and_unlock(void)
+enable_ints_and_unlock(thread_call_group_t group)
 {
-	thread_call_unlock();
+	thread_call_unlock(group);
 	(void)spllo();
 }
 
+/*
+ * Histogram bucket for an interval: bucket 0 holds intervals under
+ * 1us, bucket i those under 2^i us, and the last bucket the rest.
+ */
+static inline unsigned int
+thread_call_hist_bucket(uint64_t interval)
+{
+	uint64_t	usecs;
+	unsigned int	bucket = 0;
+
+	absolutetime_to_nanoseconds(interval, &usecs);
+	usecs /= NSEC_PER_USEC;
+
+	while (usecs != 0 && bucket < THREAD_CALL_HIST_BUCKETS - 1) {
+		usecs >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
 
 static inline boolean_t
 group_isparallel(thread_call_group_t group)
@@ -238,6 +268,12 @@ thread_call_group_setup(
 		uint32_t			target_thread_count,
 		boolean_t			parallel)
 {
+#if defined(__i386__) || defined(__x86_64__)
+	lck_mtx_init(&group->lock, &thread_call_lck_grp, &thread_call_lck_attr);
+#else
+	lck_spin_init(&group->lock, &thread_call_lck_grp, &thread_call_lck_attr);
+#endif
+
 	queue_init(&group->pending_queue);
 	queue_init(&group->delayed_queue);
 
@@ -297,6 +333,7 @@ thread_call_initialize(void)
 	thread_call_t			call;
 	kern_return_t			result;
 	thread_t			thread;
+	thread_call_group_t		group;
 	int				i;
 
 	i = sizeof (thread_call_data_t);
@@ -309,12 +346,6 @@ thread_call_initialize(void)
 	lck_grp_init(&thread_call_queues_lck_grp, "thread_call_queues", &thread_call_lck_grp_attr);
 	lck_grp_init(&thread_call_lck_grp, "thread_call", &thread_call_lck_grp_attr);
 
-#if defined(__i386__) || defined(__x86_64__)
-        lck_mtx_init(&thread_call_lock_data, &thread_call_lck_grp, &thread_call_lck_attr);
-#else
-        lck_spin_init(&thread_call_lock_data, &thread_call_lck_grp, &thread_call_lck_attr);
-#endif
-
 	nanotime_to_absolutetime(0, THREAD_CALL_DEALLOC_INTERVAL_NS, &thread_call_dealloc_interval_abs);
 	wait_queue_init(&daemon_wqueue, SYNC_POLICY_FIFO);
 
@@ -323,7 +354,8 @@ thread_call_initialize(void)
 	thread_call_group_setup(&thread_call_groups[THREAD_CALL_PRIORITY_KERNEL], THREAD_CALL_PRIORITY_KERNEL, 1, TRUE);
 	thread_call_group_setup(&thread_call_groups[THREAD_CALL_PRIORITY_HIGH], THREAD_CALL_PRIORITY_HIGH, THREAD_CALL_THREAD_MIN, FALSE);
 
-	disable_ints_and_lock();
+	group = &thread_call_groups[THREAD_CALL_PRIORITY_HIGH];
+	disable_ints_and_lock(group);
 
 	queue_init(&thread_call_internal_queue);
 	for (
@@ -336,7 +368,7 @@ thread_call_initialize(void)
 
 	thread_call_daemon_awake = TRUE;
 
-	enable_ints_and_unlock();
+	enable_ints_and_unlock(group);
 
 	result = kernel_thread_start_priority((thread_continue_t)thread_call_daemon, NULL, BASEPRI_PREEMPT + 1, &thread);
 	if (result != KERN_SUCCESS)
@@ -361,7 +393,7 @@ thread_call_setup(
  *
  *	Allocate an internal callout entry.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  */
 static __inline__ thread_call_t
 _internal_call_allocate(void)
@@ -382,7 +414,7 @@ _internal_call_allocate(void)
  *	Release an internal callout entry which
  *	is no longer pending (or delayed).
  *
- * 	Called with thread_call_lock held.
+ * 	Called with the high-priority group lock held.
  */
 static __inline__ void
 _internal_call_release(
@@ -402,7 +434,7 @@ _internal_call_release(
  *	Returns TRUE if the entry was already
  *	on a queue.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  */
 static __inline__ boolean_t
 _pending_call_enqueue(
@@ -417,6 +449,8 @@ _pending_call_enqueue(
 		call->tc_submit_count++;
 	}
 
+	call->tc_pending_timestamp = mach_absolute_time();
+
 	group->pending_count++;
 
 	thread_call_wake(group);
@@ -434,7 +468,7 @@ _pending_call_enqueue(
  *	Returns TRUE if the entry was already
  *	on a queue.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  */
 static __inline__ boolean_t
 _delayed_call_enqueue(
@@ -461,7 +495,7 @@ _delayed_call_enqueue(
  *
  *	Returns TRUE if the entry was on a queue.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  */
 static __inline__ boolean_t
 _call_dequeue(
@@ -487,7 +521,7 @@ _call_dequeue(
  *	Reset the timer so that it
  *	next expires when the entry is due.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  */
 static __inline__ void
 _set_delayed_call_timer(
@@ -506,7 +540,7 @@ _set_delayed_call_timer(
  *	Returns	TRUE if any matching entries
  *	were found.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  */
 static boolean_t
 _remove_from_pending_queue(
@@ -551,7 +585,7 @@ _remove_from_pending_queue(
  *	Returns	TRUE if any matching entries
  *	were found.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  */
 static boolean_t
 _remove_from_delayed_queue(
@@ -608,7 +642,7 @@ thread_call_func(
 	spl_t			s;
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	call = TC(queue_first(&group->pending_queue));
 
@@ -629,7 +663,7 @@ thread_call_func(
 		_pending_call_enqueue(call, group);
 	}
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 }
 
@@ -652,7 +686,7 @@ thread_call_func_delayed(
 	spl_t			s;
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	call = _internal_call_allocate();
 	call->tc_call.func	= func;
@@ -664,7 +698,7 @@ thread_call_func_delayed(
 	if (queue_first(&group->delayed_queue) == qe(call))
 		_set_delayed_call_timer(call, group);
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 }
 
@@ -686,11 +720,12 @@ thread_call_func_cancel(
 		thread_call_param_t		param,
 		boolean_t			cancel_all)
 {
-	boolean_t	result;
-	spl_t		s;
+	boolean_t		result;
+	thread_call_group_t	group = &thread_call_groups[THREAD_CALL_PRIORITY_HIGH];
+	spl_t			s;
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	if (cancel_all)
 		result = _remove_from_pending_queue(func, param, cancel_all) |
@@ -699,7 +734,7 @@ thread_call_func_cancel(
 		result = _remove_from_pending_queue(func, param, cancel_all) ||
 			_remove_from_delayed_queue(func, param, cancel_all);
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 
 	return (result);
@@ -759,14 +794,15 @@ boolean_t
 thread_call_free(
 		thread_call_t		call)
 {
-	spl_t	s;
-	int32_t refs;
+	thread_call_group_t	group = thread_call_get_group(call);
+	spl_t			s;
+	int32_t			refs;
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	if (call->tc_call.queue != NULL) {
-		thread_call_unlock();
+		thread_call_unlock(group);
 		splx(s);
 
 		return (FALSE);
@@ -777,7 +813,7 @@ thread_call_free(
 		panic("Refcount negative: %d\n", refs);
 	}	
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 
 	if (refs == 0) {
@@ -806,7 +842,7 @@ thread_call_enter(
 	group = thread_call_get_group(call);
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	if (call->tc_call.queue != &group->pending_queue) {
 		result = _pending_call_enqueue(call, group);
@@ -814,7 +850,7 @@ thread_call_enter(
 
 	call->tc_call.param1 = 0;
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 
 	return (result);
@@ -832,7 +868,7 @@ thread_call_enter1(
 	group = thread_call_get_group(call);
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	if (call->tc_call.queue != &group->pending_queue) {
 		result = _pending_call_enqueue(call, group);
@@ -840,7 +876,7 @@ thread_call_enter1(
 
 	call->tc_call.param1 = param1;
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 
 	return (result);
@@ -867,7 +903,7 @@ thread_call_enter_delayed(
 	group = thread_call_get_group(call);
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	result = _delayed_call_enqueue(call, group, deadline);
 
@@ -876,7 +912,7 @@ thread_call_enter_delayed(
 
 	call->tc_call.param1 = 0;
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 
 	return (result);
@@ -896,7 +932,7 @@ thread_call_enter1_delayed(
 	group = thread_call_get_group(call);
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 	abstime =  mach_absolute_time();
 
 	result = _delayed_call_enqueue(call, group, deadline);
@@ -910,7 +946,7 @@ thread_call_enter1_delayed(
 #if CONFIG_DTRACE
 	DTRACE_TMR4(thread_callout__create, thread_call_func_t, call->tc_call.func, 0, (call->ttd >> 32), (unsigned) (call->ttd & 0xFFFFFFFF));
 #endif
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 
 	return (result);
@@ -935,11 +971,11 @@ thread_call_cancel(
 	group = thread_call_get_group(call);
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	result = _call_dequeue(call, group);
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 #if CONFIG_DTRACE
 	DTRACE_TMR4(thread_callout__cancel, thread_call_func_t, call->tc_call.func, 0, (call->ttd >> 32), (unsigned) (call->ttd & 0xFFFFFFFF));
@@ -970,14 +1006,14 @@ thread_call_cancel_wait(
 	group = thread_call_get_group(call);
 
 	(void) splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	result = _call_dequeue(call, group);
 	if (result == FALSE) {
-		thread_call_wait_locked(call);
+		thread_call_wait_locked(call, group);
 	}
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	(void) spllo();
 
 	return result;
@@ -1006,7 +1042,7 @@ thread_call_is_delayed(
 	group = thread_call_get_group(call);
 
 	s = splsched();
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	if (call->tc_call.queue == &group->delayed_queue) {
 		if (deadline != NULL)
@@ -1014,7 +1050,7 @@ thread_call_is_delayed(
 		result = TRUE;
 	}
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 	splx(s);
 
 	return (result);
@@ -1030,7 +1066,7 @@ thread_call_is_delayed(
  *	the daemon thread in order to
  *	create additional call threads.
  *
- *	Called with thread_call_lock held.
+ *	Called with the group lock held.
  *
  *	For high-priority group, only does wakeup/creation if there are no threads
  *	running.
@@ -1052,8 +1088,8 @@ thread_call_wake(
 				group->flags &= TCG_DEALLOC_ACTIVE;
 			}
 		} else {
-			if (!thread_call_daemon_awake && thread_call_group_should_add_thread(group)) {
-				thread_call_daemon_awake = TRUE;
+			if (thread_call_group_should_add_thread(group) &&
+			    hw_compare_and_store(FALSE, TRUE, &thread_call_daemon_awake)) {
 				wait_queue_wakeup_one(&daemon_wqueue, NO_EVENT, THREAD_AWAKENED, -1);
 			}
 		}
@@ -1075,7 +1111,7 @@ sched_call_thread(
 
 	group = &thread_call_groups[THREAD_CALL_PRIORITY_HIGH]; /* XXX */
 
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	switch (type) {
 
@@ -1090,7 +1126,7 @@ sched_call_thread(
 			break;
 	}
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 }
 
 /* 
@@ -1100,7 +1136,7 @@ sched_call_thread(
  * if the client has so requested.
  */
 static void
-thread_call_finish(thread_call_t call)
+thread_call_finish(thread_call_t call, thread_call_group_t group)
 {
 	boolean_t dowake = FALSE;
 
@@ -1113,12 +1149,12 @@ thread_call_finish(thread_call_t call)
 
 		/* 
 		 * Dropping lock here because the sched call for the 
-		 * high-pri group can take the big lock from under
+		 * high-pri group can take the group lock from under
 		 * a thread lock.
 		 */
-		thread_call_unlock();
+		thread_call_unlock(group);
 		thread_wakeup((event_t)call);
-		thread_call_lock_spin();
+		thread_call_lock_spin(group);
 	}
 
 	if (call->tc_refs == 0) {
@@ -1126,11 +1162,11 @@ thread_call_finish(thread_call_t call)
 			panic("Someone waiting on a thread call that is scheduled for free: %p\n", call->tc_call.func);
 		}
 
-		enable_ints_and_unlock();
+		enable_ints_and_unlock(group);
 
 		zfree(thread_call_zone, call);
 
-		(void)disable_ints_and_lock();
+		(void)disable_ints_and_lock(group);
 	}
 
 }
@@ -1160,7 +1196,7 @@ thread_call_thread(
 		panic("thread_terminate() returned?");
 	}
 
-	(void)disable_ints_and_lock();
+	(void)disable_ints_and_lock(group);
 
 	thread_sched_call(self, group->sched_call);
 
@@ -1168,10 +1204,14 @@ thread_call_thread(
 		thread_call_t			call;
 		thread_call_func_t		func;
 		thread_call_param_t		param0, param1;
+		uint64_t			start;
 
 		call = TC(dequeue_head(&group->pending_queue));
 		group->pending_count--;
 
+		start = mach_absolute_time();
+		group->latency_hist[thread_call_hist_bucket(start - call->tc_pending_timestamp)]++;
+
 		func = call->tc_call.func;
 		param0 = call->tc_call.param0;
 		param1 = call->tc_call.param1;
@@ -1190,7 +1230,7 @@ thread_call_thread(
 		} else
 			canwait = FALSE;
 
-		enable_ints_and_unlock();
+		enable_ints_and_unlock(group);
 
 		KERNEL_DEBUG_CONSTANT(
 				MACHDBG_CODE(DBG_MACH_SCHED,MACH_CALLOUT) | DBG_FUNC_NONE,
@@ -1206,11 +1246,13 @@ thread_call_thread(
 
 		(void)thread_funnel_set(self->funnel_lock, FALSE);		/* XXX */
 
-		(void) disable_ints_and_lock();
+		(void) disable_ints_and_lock(group);
+
+		group->runtime_hist[thread_call_hist_bucket(mach_absolute_time() - start)]++;
 		
 		if (canwait) {
 			/* Frees if so desired */
-			thread_call_finish(call);
+			thread_call_finish(call, group);
 		}
 	}
 
@@ -1243,7 +1285,7 @@ thread_call_thread(
 			panic("kcall worker unable to assert wait?");
 		}   
 
-		enable_ints_and_unlock();
+		enable_ints_and_unlock(group);
 
 		thread_block_parameter((thread_continue_t)thread_call_thread, group);
 	} else {
@@ -1252,14 +1294,14 @@ thread_call_thread(
 
 			wait_queue_assert_wait(&group->idle_wqueue, NO_EVENT, THREAD_UNINT, 0); /* Interrupted means to exit */
 
-			enable_ints_and_unlock();
+			enable_ints_and_unlock(group);
 
 			thread_block_parameter((thread_continue_t)thread_call_thread, group);
 			/* NOTREACHED */
 		}
 	}
 
-	enable_ints_and_unlock();
+	enable_ints_and_unlock(group);
 
 	thread_terminate(self);
 	/* NOTREACHED */
@@ -1276,16 +1318,21 @@ thread_call_daemon_continue(__unused void *arg)
 	int		i;
 	kern_return_t	kr;
 	thread_call_group_t group;
+	boolean_t	needed;
 
-	(void)disable_ints_and_lock();
+	(void)splsched();
 
+again:
 	/* Starting at zero happens to be high-priority first. */
 	for (i = 0; i < THREAD_CALL_GROUP_COUNT; i++) {
 		group = &thread_call_groups[i];
+
+		thread_call_lock_spin(group);
+
 		while (thread_call_group_should_add_thread(group)) {
 			group->active_count++;
 
-			enable_ints_and_unlock();
+			enable_ints_and_unlock(group);
 
 			kr = thread_call_thread_create(group);
 			if (kr != KERN_SUCCESS) {
@@ -1294,19 +1341,42 @@ thread_call_daemon_continue(__unused void *arg)
 				 * We can try again later.
 				 */
 				delay(10000); /* 10 ms */
-				(void)disable_ints_and_lock();
+				(void)splsched();
 				goto out;
 			}
 
-			(void)disable_ints_and_lock();
+			(void)disable_ints_and_lock(group);
 		}
+
+		thread_call_unlock(group);
 	}
 
 out:
-	thread_call_daemon_awake = FALSE;
+	/*
+	 * Wakers only signal the daemon when they flip the flag from
+	 * FALSE to TRUE, so after clearing it look at the groups once
+	 * more: a request posted during the scan above would otherwise
+	 * be lost.
+	 */
 	wait_queue_assert_wait(&daemon_wqueue, NO_EVENT, THREAD_UNINT, 0);
+	thread_call_daemon_awake = FALSE;
+	OSMemoryBarrier();
+
+	needed = FALSE;
+	for (i = 0; i < THREAD_CALL_GROUP_COUNT && !needed; i++) {
+		group = &thread_call_groups[i];
+
+		thread_call_lock_spin(group);
+		needed = thread_call_group_should_add_thread(group);
+		thread_call_unlock(group);
+	}
+
+	if (needed && hw_compare_and_store(FALSE, TRUE, &thread_call_daemon_awake)) {
+		clear_wait(current_thread(), THREAD_AWAKENED);
+		goto again;
+	}
 
-	enable_ints_and_unlock();
+	(void)spllo();
 
 	thread_block_parameter((thread_continue_t)thread_call_daemon_continue, NULL);
 	/* NOTREACHED */
@@ -1358,7 +1428,7 @@ thread_call_delayed_timer(
 	thread_call_group_t		group = p0;
 	uint64_t				timestamp;
 
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	timestamp = mach_absolute_time();
 
@@ -1377,7 +1447,7 @@ thread_call_delayed_timer(
 	if (!queue_end(&group->delayed_queue, qe(call)))
 		_set_delayed_call_timer(call, group);
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 }
 
 /*
@@ -1395,7 +1465,7 @@ thread_call_dealloc_timer(
 	kern_return_t res;
 	boolean_t terminated = FALSE;
 	
-	thread_call_lock_spin();
+	thread_call_lock_spin(group);
 
 	now = mach_absolute_time();
 	if (group->idle_count > 0) {
@@ -1428,7 +1498,7 @@ thread_call_dealloc_timer(
 		group->flags &= ~TCG_DEALLOC_ACTIVE;
 	}
 
-	thread_call_unlock();
+	thread_call_unlock(group);
 }
 
 /*
@@ -1438,7 +1508,7 @@ thread_call_dealloc_timer(
  * at the beginning of our wait.
  */
 static void
-thread_call_wait_locked(thread_call_t call)
+thread_call_wait_locked(thread_call_t call, thread_call_group_t group)
 {
 	uint64_t submit_count;
 	wait_result_t res;
@@ -1455,7 +1525,7 @@ thread_call_wait_locked(thread_call_t call)
 			panic("Unable to assert wait?");
 		}
 
-		thread_call_unlock();
+		thread_call_unlock(group);
 		(void) spllo();
 
 		res = thread_block(NULL);
@@ -1464,7 +1534,7 @@ thread_call_wait_locked(thread_call_t call)
 		}
 	
 		(void) splsched();
-		thread_call_lock_spin();
+		thread_call_lock_spin(group);
 	}
 }
 
@@ -1476,11 +1546,41 @@ boolean_t
 thread_call_isactive(thread_call_t call) 
 {
 	boolean_t active;
+	thread_call_group_t group = thread_call_get_group(call);
 
-	disable_ints_and_lock();
+	disable_ints_and_lock(group);
 	active = (call->tc_submit_count > call->tc_finish_count);
-	enable_ints_and_unlock();
+	enable_ints_and_unlock(group);
 
 	return active;
 }
 
+/*
+ * Copy out the per-group latency and runtime histograms; at most
+ * count entries are filled in.  Returns the number of groups.
+ */
+unsigned int
+thread_call_group_stats(
+	struct thread_call_group_stat	*stats,
+	unsigned int			count)
+{
+	thread_call_group_t	group;
+	unsigned int		i;
+	spl_t			s;
+
+	for (i = 0; i < count && i < THREAD_CALL_GROUP_COUNT; i++) {
+		group = &thread_call_groups[i];
+
+		s = disable_ints_and_lock(group);
+
+		stats[i].tcs_pri = i;
+		stats[i].tcs_pad = 0;
+		bcopy(group->latency_hist, stats[i].tcs_latency, sizeof (stats[i].tcs_latency));
+		bcopy(group->runtime_hist, stats[i].tcs_runtime, sizeof (stats[i].tcs_runtime));
+
+		thread_call_unlock(group);
+		splx(s);
+	}
+
+	return (THREAD_CALL_GROUP_COUNT);
+}
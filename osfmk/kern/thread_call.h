@@ -216,6 +216,31 @@ boolean_t		thread_call_isactive(
 						thread_call_t call);
 __END_DECLS
 
+#ifdef	XNU_KERNEL_PRIVATE
+
+__BEGIN_DECLS
+
+/*
+ * Per thread call group statistics.  Bucket 0 counts intervals under
+ * 1us, bucket i intervals under 2^i us; the last bucket takes the rest.
+ */
+#define THREAD_CALL_HIST_BUCKETS	20
+
+struct thread_call_group_stat {
+	uint32_t	tcs_pri;				/* thread_call_priority_t */
+	uint32_t	tcs_pad;
+	uint64_t	tcs_latency[THREAD_CALL_HIST_BUCKETS];	/* enqueue to run */
+	uint64_t	tcs_runtime[THREAD_CALL_HIST_BUCKETS];	/* callout duration */
+};
+
+extern unsigned int	thread_call_group_stats(
+						struct thread_call_group_stat	*stats,
+						unsigned int			count);
+
+__END_DECLS
+
+#endif	/* XNU_KERNEL_PRIVATE */
+
 #ifdef	MACH_KERNEL_PRIVATE
 
 #include <kern/call_entry.h>
@@ -230,6 +255,7 @@ struct thread_call {
 	int32_t				tc_refs;
 
 	uint64_t			ttd; /* Time to deadline at creation */
+	uint64_t			tc_pending_timestamp; /* Last put on the pending queue */
 }; 
 
 #define THREAD_CALL_ALLOC		0x01
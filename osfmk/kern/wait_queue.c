@@ -71,6 +71,7 @@
 #include <kern/queue.h>
 #include <kern/spl.h>
 #include <mach/sync_policy.h>
+#include <mach/machine.h>
 #include <kern/mach_param.h>
 #include <kern/sched_prim.h>
 
@@ -129,18 +130,35 @@ struct wait_queue boot_wait_queue[1];
 __private_extern__ struct wait_queue *wait_queues = &boot_wait_queue[0];
 __private_extern__ uint32_t num_wait_queues = 1;
 
+static struct wait_hash_stat boot_wait_hash_stat[1];
+static struct wait_hash_stat *wait_hash_stat = &boot_wait_hash_stat[0];
+
 #define	P2ROUNDUP(x, align) (-(-((uint32_t)(x)) & -(align)))
 #define ROUNDDOWN(x,y)	(((x)/(y))*(y))
 
+/*
+ * Buckets per possible processor; with few threads per CPU the
+ * table is sized by this floor rather than by thread_max.
+ */
+#define WAIT_HASH_CPU_BUCKETS	64
+
 static uint32_t
 compute_wait_hash_size(void)
 {
-	uint32_t hsize, queues;
+	uint32_t hsize, queues, ncpus;
 	
 	if (PE_parse_boot_argn("wqsize", &hsize, sizeof(hsize)))
 		return (hsize);
 
-	queues = thread_max / 11;
+	/*
+	 * Aim for at most four waiters per bucket with every thread
+	 * blocked, and enough buckets that the processors waking
+	 * threads rarely meet on the same bucket lock.
+	 */
+	ncpus = (machine_info.max_cpus > 0) ? machine_info.max_cpus : 1;
+	queues = thread_max / 4;
+	if (queues < ncpus * WAIT_HASH_CPU_BUCKETS)
+		queues = ncpus * WAIT_HASH_CPU_BUCKETS;
 	hsize = P2ROUNDUP(queues * sizeof(struct wait_queue), PAGE_SIZE);
 
 	return hsize;
@@ -184,11 +202,43 @@ wait_queues_init(void)
 	if (kret != KERN_SUCCESS || wait_queues == NULL)
 		panic("kernel_memory_allocate() failed to allocate wait queues, error: %d, whsize: 0x%x", kret, whsize);
 
+	whsize = P2ROUNDUP(num_wait_queues * sizeof (struct wait_hash_stat), PAGE_SIZE);
+
+	kret = kernel_memory_allocate(kernel_map, (vm_offset_t *) &wait_hash_stat,
+	    whsize, 0, KMA_KOBJECT|KMA_NOPAGEWAIT);
+
+	if (kret != KERN_SUCCESS || wait_hash_stat == NULL)
+		panic("kernel_memory_allocate() failed to allocate wait hash statistics, error: %d, whsize: 0x%x", kret, whsize);
+
 	for (i = 0; i < num_wait_queues; i++) {
 		wait_queue_init(&wait_queues[i], SYNC_POLICY_FIFO);
+		bzero(&wait_hash_stat[i], sizeof (struct wait_hash_stat));
 	}
 }
 
+/*
+ *	Routine:	wait_hash_stats
+ *	Purpose:
+ *		Copy out the global event hash bucket statistics;
+ *		at most count entries are filled in.
+ *	Returns:
+ *		The number of buckets.
+ *	Conditions:
+ *		Nothing locked.  The counters are read without the
+ *		bucket locks and may be slightly stale.
+ */
+unsigned int
+wait_hash_stats(
+	struct wait_hash_stat *stats,
+	unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count && i < num_wait_queues; i++)
+		stats[i] = wait_hash_stat[i];
+	return (num_wait_queues);
+}
+
 void
 wait_queue_bootstrap(void)
 {
@@ -1198,6 +1248,14 @@ wait_queue_assert_wait64_locked(
 	 */
 	wait_result = thread_mark_wait_locked(thread, interruptible);
 	if (wait_result == THREAD_WAITING) {
+		int index = wait_hash_index(wq);
+
+		if (index >= 0) {
+			wait_hash_stat[index].whs_waits++;
+			if (!wait_queue_empty(wq))
+				wait_hash_stat[index].whs_collisions++;
+		}
+
 		if (!wq->wq_fifo
 			|| (thread->options & TH_OPT_VMPRIV)
 			|| realtime)
@@ -1311,15 +1369,23 @@ _wait_queue_select64_all(
 	wait_queue_element_t wq_element;
 	wait_queue_element_t wqe_next;
 	queue_t q;
+	int index;
 
 	q = &wq->wq_queue;
 
+	index = wait_hash_index(wq);
+	if (index >= 0)
+		wait_hash_stat[index].whs_wakeups++;
+
 	wq_element = (wait_queue_element_t) queue_first(q);
 	while (!queue_end(q, (queue_entry_t)wq_element)) {
 		WAIT_QUEUE_ELEMENT_CHECK(wq, wq_element);
 		wqe_next = (wait_queue_element_t)
 			   queue_next((queue_t) wq_element);
 
+		if (index >= 0)
+			wait_hash_stat[index].whs_scanned++;
+
 		/*
 		 * We may have to recurse if this is a compound wait queue.
 		 */
@@ -1509,15 +1575,23 @@ _wait_queue_select64_one(
 	wait_queue_element_t wqe_next;
 	thread_t t = THREAD_NULL;
 	queue_t q;
+	int index;
 
 	q = &wq->wq_queue;
 
+	index = wait_hash_index(wq);
+	if (index >= 0)
+		wait_hash_stat[index].whs_wakeups++;
+
 	wq_element = (wait_queue_element_t) queue_first(q);
 	while (!queue_end(q, (queue_entry_t)wq_element)) {
 		WAIT_QUEUE_ELEMENT_CHECK(wq, wq_element);
 		wqe_next = (wait_queue_element_t)
 			       queue_next((queue_t) wq_element);
 
+		if (index >= 0)
+			wait_hash_stat[index].whs_scanned++;
+
 		/*
 		 * We may have to recurse if this is a compound wait queue.
 		 */
@@ -1709,6 +1783,43 @@ wait_queue_wakeup64_identity_locked(
 }
 
 
+/*
+ *	Routine:	wait_queue_wakeup64_handoff_locked
+ *	Purpose:
+ *		As wait_queue_wakeup64_identity_locked, but if the thread
+ *		can be handed off to directly, leave it off the run queues
+ *		and set *handoff (see thread_go_handoff).
+ *
+ * 	Conditions:
+ *		at splsched
+ *		wait queue locked
+ *		possibly recursive
+ * 	Returns:
+ *		a pointer to the locked thread that was awakened
+ */
+__private_extern__ thread_t
+wait_queue_wakeup64_handoff_locked(
+	wait_queue_t wq,
+	event64_t event,
+	wait_result_t result,
+	boolean_t unlock,
+	boolean_t *handoff)
+{
+	thread_t thread;
+
+	assert(wait_queue_held(wq));
+
+	thread = _wait_queue_select64_one(wq, event);
+	if (unlock)
+		wait_queue_unlock(wq);
+
+	*handoff = FALSE;
+	if (thread)
+		*handoff = thread_go_handoff(thread, result);
+	return thread;  /* still locked if not NULL */
+}
+
+
 /*
  *	Routine:	wait_queue_wakeup64_one_locked
  *	Purpose:
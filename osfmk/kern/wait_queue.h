@@ -242,6 +242,14 @@ __private_extern__ thread_t wait_queue_wakeup64_identity_locked(
 			wait_result_t result,
 			boolean_t unlock);
 
+/* as above, but leave the thread to be handed off to if possible */
+__private_extern__ thread_t wait_queue_wakeup64_handoff_locked(
+			wait_queue_t wait_queue,
+			event64_t wake_event,
+			wait_result_t result,
+			boolean_t unlock,
+			boolean_t *handoff);
+
 /* wakeup thread iff its still waiting for a particular event on locked queue */
 __private_extern__ kern_return_t wait_queue_wakeup64_thread_locked(
 			wait_queue_t wait_queue,
@@ -252,30 +260,31 @@ __private_extern__ kern_return_t wait_queue_wakeup64_thread_locked(
 
 __private_extern__ uint32_t num_wait_queues;
 __private_extern__ struct wait_queue *wait_queues;
-/* The Jenkins "one at a time" hash.
- * TBD: There may be some value to unrolling here,
- * depending on the architecture.
+/*
+ * Event hash: the 64-bit finalizer from MurmurHash3.  Events are
+ * kernel addresses that share their high bits and are usually
+ * aligned, so every input bit must be mixed into the low-order
+ * bits that select the bucket.
  */
-static inline uint32_t wq_hash(char *key)
+static inline uint32_t wq_hash(uintptr_t key)
 {
-	uint32_t hash = 0;
-	size_t i, length = sizeof(char *);
+	uint64_t hash = (uint64_t)key;
 
-	for (i = 0; i < length; i++) {
-		hash += key[i];
-		hash += (hash << 10);
-		hash ^= (hash >> 6);
-	}
- 
-	hash += (hash << 3);
-	hash ^= (hash >> 11);
-	hash += (hash << 15);
+	hash ^= (hash >> 33);
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= (hash >> 33);
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= (hash >> 33);
 
-	hash &= (num_wait_queues - 1);
-	return hash;
+	return ((uint32_t)hash & (num_wait_queues - 1));
 }
 
-#define	wait_hash(event) wq_hash((char *)&event) 
+#define	wait_hash(event) wq_hash((uintptr_t)(event))
+
+/* index of a global event hash bucket, or -1 for any other wait queue */
+#define	wait_hash_index(wq)						\
+	(((wq) >= &wait_queues[0] && (wq) < &wait_queues[num_wait_queues]) ? \
+	 (int)((wq) - &wait_queues[0]) : -1)
 
 #endif	/* MACH_KERNEL_PRIVATE */
 
@@ -349,6 +358,21 @@ extern kern_return_t wait_queue_set_unlink_all_nofree(
 
 extern wait_queue_link_t wait_queue_link_allocate(void);
 
+/*
+ * Per bucket statistics for the global event hash used by
+ * assert_wait() and thread_wakeup().
+ */
+struct wait_hash_stat {
+	uint64_t	whs_waits;	/* threads queued on the bucket */
+	uint64_t	whs_collisions;	/* ... while other waiters were queued */
+	uint64_t	whs_wakeups;	/* wakeups posted to the bucket */
+	uint64_t	whs_scanned;	/* waiters examined by those wakeups */
+};
+
+extern unsigned int wait_hash_stats(
+			struct wait_hash_stat *stats,
+			unsigned int count);
+
 #endif /* XNU_KERNEL_PRIVATE */
 
 /* legacy API */
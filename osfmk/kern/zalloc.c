@@ -76,12 +76,14 @@
 
 #include <kern/kern_types.h>
 #include <kern/assert.h>
+#include <kern/cpu_number.h>
 #include <kern/host.h>
 #include <kern/macro_help.h>
 #include <kern/sched.h>
 #include <kern/locks.h>
 #include <kern/sched_prim.h>
 #include <kern/misc_protos.h>
+#include <kern/processor.h>
 #include <kern/thread_call.h>
 #include <kern/zalloc.h>
 #include <kern/kalloc.h>
@@ -149,6 +151,14 @@ boolean_t	corruption_debug_flag    = FALSE;	/* enabled by "-zc" boot-arg */
  */
 #define is_kernel_data_addr(a)	(!(a) || ((a) >= vm_min_kernel_address && !((a) & 0x3)))
 
+static inline void	zone_page_count_free(
+				vm_offset_t	addr,
+				vm_size_t	size);
+
+static inline void	zone_page_count_alloc(
+				vm_offset_t	addr,
+				vm_size_t	size);
+
 /*
  * Frees the specified element, which is within the specified zone. If this
  * element should be poisoned and its free list checker should be set, both are
@@ -179,6 +189,9 @@ free_to_zone(zone_t zone, void *elem) {
 	((vm_offset_t *) elem)[0] = zone->free_elements;
 	zone->free_elements = (vm_offset_t) elem;
 	zone->count--;
+
+	if (zone->collectable)
+		zone_page_count_free((vm_offset_t) elem, zone->elem_size);
 }
 
 /*
@@ -222,6 +235,13 @@ alloc_from_zone(zone_t zone, void **ret) {
 		zone->count++;
 		zone->sum_count++;
 		zone->free_elements = ((vm_offset_t *) elem)[0];
+
+		/* zone_gc() resumes from the head if its cursor was taken */
+		if (__improbable(zone->gc_cursor == (vm_offset_t) elem))
+			zone->gc_cursor = 0;
+
+		if (zone->collectable)
+			zone_page_count_alloc((vm_offset_t) elem, zone->elem_size);
 	}
 	*ret = elem;
 }
@@ -277,13 +297,17 @@ boolean_t zinfo_per_task = FALSE;		/* enabled by -zinfop in boot-args */
  * be a minimum of 1, including if a zone element spans multiple
  * pages).
  *
- * Asynchronously, the zone_gc() logic attempts to walk zone free
- * lists to see if all the elements on a zone page are free. If
- * "collect_count" (which it increments during the scan) matches
- * "alloc_count", the zone page is a candidate for collection and the
- * physical page is returned to the VM system. During this process, the
- * first word of the zone page is re-used to maintain a linked list of
- * to-be-collected zone pages.
+ * "free_count" is kept up to date by free_to_zone()/alloc_from_zone()
+ * under the zone lock, so a page whose "free_count" equals its
+ * "alloc_count" has every element sitting on the zone's free list.
+ *
+ * Asynchronously, the zone_gc() logic walks zone free lists in short
+ * slices and pulls out the elements that sit on such pages. If
+ * "collect_count" (which it increments for every element pulled)
+ * matches "alloc_count", the zone page is a candidate for collection
+ * and the physical page is returned to the VM system. During this
+ * process, the first word of the zone page is re-used to maintain a
+ * linked list of to-be-collected zone pages.
  */
 typedef uint32_t zone_page_index_t;
 #define ZONE_PAGE_INDEX_INVALID ((zone_page_index_t)0xFFFFFFFFU)
@@ -291,6 +315,7 @@ typedef uint32_t zone_page_index_t;
 struct zone_page_table_entry {
 	volatile	uint16_t	alloc_count;
 	volatile	uint16_t	collect_count;
+	volatile	uint16_t	free_count;
 };
 
 #define	ZONE_PAGE_USED  0
@@ -319,6 +344,10 @@ boolean_t	zone_page_collectable(
 				vm_offset_t	addr,
 				vm_size_t	size);
 
+boolean_t	zone_page_reclaimable(
+				vm_offset_t	addr,
+				vm_size_t	size);
+
 void		zone_page_keep(
 				vm_offset_t	addr,
 				vm_size_t	size);
@@ -1073,6 +1102,310 @@ hashaddr(uintptr_t pt, uint32_t max_size)
 
 /* End of all leak-detection code */
 #pragma mark -
+#pragma mark Per-CPU Zone Caches
+
+/*
+ * Per-CPU magazine caches (opt-in via zone_change(zone, Z_CACHING_ENABLED, TRUE))
+ *
+ * Each processor keeps a "loaded" and a "previous" magazine, a fixed-depth
+ * array of free elements, and satisfies zalloc/zfree from them with only
+ * preemption disabled.  When both are exhausted (or both are full) whole
+ * magazines are traded with the zone's depot of full and empty magazines,
+ * under the depot's spin lock, which is the only shared state touched.
+ * Only when the depot can't help do we fall back to the zone lock and the
+ * zone's free list.
+ *
+ * Elements sitting in a magazine are still counted as allocated in
+ * zone->count; per-cpu allocation counts are folded into sum_count when
+ * zone statistics are reported.  Zones that are being logged, sampled by
+ * the leak detector or debugged with ZONE_DEBUG bypass the caches so that
+ * every operation is still seen.  zone_gc() returns the contents of the
+ * depot to the zone before looking for free pages.
+ */
+#define ZONE_MAGAZINE_SIZE	16	/* elements per magazine */
+#define ZONE_DEPOT_EXTRA	4	/* depot magazines beyond 2 per cpu */
+#define ZONE_CACHE_MAX_CPUS	64	/* covers MAX_CPUS on all platforms */
+
+#define zone_cache_magazine_limit()	(2 * processor_avail_count + ZONE_DEPOT_EXTRA)
+
+struct zone_magazine {
+	struct zone_magazine	*zm_next;	/* depot linkage */
+	uint32_t		zm_count;	/* number of elements held */
+	void			*zm_elements[ZONE_MAGAZINE_SIZE];
+};
+
+struct zone_cpu_cache {
+	struct zone_magazine	*zcc_loaded;	/* allocate and free from this one */
+	struct zone_magazine	*zcc_previous;	/* and swap to this one */
+	uint64_t		zcc_allocs;	/* allocations satisfied here */
+};
+
+struct zone_cache {
+	decl_simple_lock_data(,	zc_depot_lock)	/* protects the depot */
+	struct zone_magazine	*zc_full;	/* depot of full magazines */
+	struct zone_magazine	*zc_empty;	/* depot of empty magazines */
+	uint32_t		zc_full_count;
+	uint32_t		zc_magazines;	/* magazines owned by this zone */
+	struct zone_cpu_cache	zc_cpu[ZONE_CACHE_MAX_CPUS];
+};
+
+static zone_t	zone_cache_zone = ZONE_NULL;	/* struct zone_cache */
+static zone_t	zone_magazine_zone = ZONE_NULL;	/* struct zone_magazine */
+
+unsigned int	zone_cache_depot_misses;
+unsigned int	zone_cache_gc_drained;
+
+static void	zone_cache_init(zone_t zone);
+static void	zone_cache_drain_depot(zone_t zone);
+
+/*
+ * Can this operation be satisfied from the per-cpu cache?
+ */
+static inline boolean_t
+zone_cache_usable(zone_t zone)
+{
+	if (!zone->cpu_cache_enabled || DO_LOGGING(zone))
+		return (FALSE);
+#if CONFIG_ZLEAKS
+	if (zone->zleak_on)
+		return (FALSE);
+#endif /* CONFIG_ZLEAKS */
+#if	ZONE_DEBUG
+	if (zone_debug_enabled(zone))
+		return (FALSE);
+#endif	/* ZONE_DEBUG */
+	return (TRUE);
+}
+
+/*
+ *	zone_cache_alloc:
+ *
+ *	Return an element from this processor's magazines, refilling them
+ *	from the depot if needed.  Returns NULL if there is nothing cached.
+ */
+static void *
+zone_cache_alloc(zone_t zone)
+{
+	struct zone_cache	*zc = zone->zcache;
+	struct zone_cpu_cache	*zcc;
+	struct zone_magazine	*mag;
+	void			*elem = NULL;
+
+	disable_preemption();
+	if (cpu_number() >= ZONE_CACHE_MAX_CPUS) {
+		enable_preemption();
+		return (NULL);
+	}
+	zcc = &zc->zc_cpu[cpu_number()];
+
+	if (zcc->zcc_loaded == NULL || zcc->zcc_loaded->zm_count == 0) {
+		if (zcc->zcc_previous != NULL && zcc->zcc_previous->zm_count != 0) {
+			mag = zcc->zcc_loaded;
+			zcc->zcc_loaded = zcc->zcc_previous;
+			zcc->zcc_previous = mag;
+		} else if (zc->zc_full != NULL) {
+			/*
+			 * Both magazines are empty (or missing), trade
+			 * the previous one for a full one from the depot.
+			 */
+			simple_lock(&zc->zc_depot_lock);
+
+			if ((mag = zc->zc_full) != NULL) {
+				zc->zc_full = mag->zm_next;
+				zc->zc_full_count--;
+
+				if (zcc->zcc_previous != NULL) {
+					zcc->zcc_previous->zm_next = zc->zc_empty;
+					zc->zc_empty = zcc->zcc_previous;
+				}
+				zcc->zcc_previous = zcc->zcc_loaded;
+				zcc->zcc_loaded = mag;
+			}
+			simple_unlock(&zc->zc_depot_lock);
+		}
+	}
+	if ((mag = zcc->zcc_loaded) != NULL && mag->zm_count != 0) {
+		elem = mag->zm_elements[--mag->zm_count];
+		zcc->zcc_allocs++;
+	}
+	enable_preemption();
+
+	return (elem);
+}
+
+/*
+ *	zone_cache_free:
+ *
+ *	Put an element into this processor's magazines.  Returns FALSE if
+ *	there was no room and the element should go back to the zone.
+ */
+static boolean_t
+zone_cache_free(zone_t zone, void *elem)
+{
+	struct zone_cache	*zc = zone->zcache;
+	struct zone_cpu_cache	*zcc;
+	struct zone_magazine	*mag;
+	boolean_t		cached = FALSE;
+
+	disable_preemption();
+	if (cpu_number() >= ZONE_CACHE_MAX_CPUS) {
+		enable_preemption();
+		return (FALSE);
+	}
+	zcc = &zc->zc_cpu[cpu_number()];
+
+	if (zcc->zcc_loaded == NULL || zcc->zcc_loaded->zm_count == ZONE_MAGAZINE_SIZE) {
+		if (zcc->zcc_previous != NULL && zcc->zcc_previous->zm_count != ZONE_MAGAZINE_SIZE) {
+			mag = zcc->zcc_loaded;
+			zcc->zcc_loaded = zcc->zcc_previous;
+			zcc->zcc_previous = mag;
+		} else if (zc->zc_empty != NULL) {
+			/*
+			 * Both magazines are full (or missing), trade
+			 * the previous one for an empty one from the depot.
+			 */
+			simple_lock(&zc->zc_depot_lock);
+
+			if ((mag = zc->zc_empty) != NULL) {
+				zc->zc_empty = mag->zm_next;
+
+				if (zcc->zcc_previous != NULL) {
+					zcc->zcc_previous->zm_next = zc->zc_full;
+					zc->zc_full = zcc->zcc_previous;
+					zc->zc_full_count++;
+				}
+				zcc->zcc_previous = zcc->zcc_loaded;
+				zcc->zcc_loaded = mag;
+			}
+			simple_unlock(&zc->zc_depot_lock);
+		}
+	}
+	if ((mag = zcc->zcc_loaded) != NULL && mag->zm_count != ZONE_MAGAZINE_SIZE) {
+		mag->zm_elements[mag->zm_count++] = elem;
+		cached = TRUE;
+	}
+	enable_preemption();
+
+	return (cached);
+}
+
+/*
+ *	zone_cache_grow:
+ *
+ *	The depot had no empty magazine to offer; add one, up to the
+ *	zone's limit, so that the next free can be cached.
+ */
+static void
+zone_cache_grow(zone_t zone)
+{
+	struct zone_cache	*zc = zone->zcache;
+	struct zone_magazine	*mag;
+
+	if (zc->zc_magazines >= zone_cache_magazine_limit())
+		return;
+
+	zone_cache_depot_misses++;
+
+	mag = (struct zone_magazine *) zalloc_noblock(zone_magazine_zone);
+	if (mag == NULL)
+		return;
+	mag->zm_count = 0;
+
+	simple_lock(&zc->zc_depot_lock);
+	if (zc->zc_magazines < zone_cache_magazine_limit()) {
+		mag->zm_next = zc->zc_empty;
+		zc->zc_empty = mag;
+		zc->zc_magazines++;
+		mag = NULL;
+	}
+	simple_unlock(&zc->zc_depot_lock);
+
+	if (mag != NULL)
+		zfree(zone_magazine_zone, mag);
+}
+
+/*
+ *	zone_cache_drain_depot:
+ *
+ *	Give the elements in the depot's full magazines back to the zone
+ *	and release the empty magazines.  The per-cpu magazines are left
+ *	alone; they are small and belong to their processors.
+ */
+static void
+zone_cache_drain_depot(zone_t zone)
+{
+	struct zone_cache	*zc = zone->zcache;
+	struct zone_magazine	*full, *empty, *mag;
+	uint32_t		n;
+
+	simple_lock(&zc->zc_depot_lock);
+	full = zc->zc_full;
+	empty = zc->zc_empty;
+	zc->zc_full = zc->zc_empty = NULL;
+	zc->zc_full_count = 0;
+	simple_unlock(&zc->zc_depot_lock);
+
+	if (full == NULL && empty == NULL)
+		return;
+
+	lock_zone(zone);
+	for (mag = full; mag != NULL; mag = mag->zm_next) {
+		for (n = 0; n < mag->zm_count; n++)
+			free_to_zone(zone, mag->zm_elements[n]);
+		zone_cache_gc_drained += mag->zm_count;
+		mag->zm_count = 0;
+	}
+	unlock_zone(zone);
+
+	for (n = 0; full != NULL || empty != NULL; n++) {
+		if ((mag = full) != NULL)
+			full = mag->zm_next;
+		else {
+			mag = empty;
+			empty = mag->zm_next;
+		}
+		zfree(zone_magazine_zone, mag);
+	}
+
+	simple_lock(&zc->zc_depot_lock);
+	zc->zc_magazines -= n;
+	simple_unlock(&zc->zc_depot_lock);
+}
+
+/*
+ * Sum of the allocations satisfied from the per-cpu caches.
+ */
+static uint64_t
+zone_cache_sum_count(zone_t zone)
+{
+	uint64_t	sum = 0;
+	unsigned int	cpu;
+
+	if (!zone->cpu_cache_enabled)
+		return (0);
+
+	for (cpu = 0; cpu < ZONE_CACHE_MAX_CPUS; cpu++)
+		sum += zone->zcache->zc_cpu[cpu].zcc_allocs;
+
+	return (sum);
+}
+
+static void
+zone_cache_init(zone_t zone)
+{
+	struct zone_cache	*zc;
+
+	if (zone->cpu_cache_enabled || zone_cache_zone == ZONE_NULL)
+		return;
+
+	zc = (struct zone_cache *) zalloc(zone_cache_zone);
+	bzero(zc, sizeof (*zc));
+	simple_lock_init(&zc->zc_depot_lock, 0);
+
+	zone->zcache = zc;
+	zone->cpu_cache_enabled = TRUE;
+}
+
 
 /*
  *	zinit initializes a new zone.  The zone data structures themselves
@@ -1161,6 +1494,7 @@ use_this_allocation:
 	z->sum_count = 0LL;
 	z->doing_alloc = FALSE;
 	z->doing_gc = FALSE;
+	z->gc_cursor = 0;
 	z->exhaustible = FALSE;
 	z->collectable = TRUE;
 	z->allows_foreign = FALSE;
@@ -1173,6 +1507,8 @@ use_this_allocation:
 	z->async_prio_refill = FALSE;
 	z->gzalloc_exempt = FALSE;
 	z->alignment_required = FALSE;
+	z->cpu_cache_enabled = FALSE;
+	z->zcache = NULL;
 	z->prio_refill_watermark = 0;
 	z->zone_replenish_thread = NULL;
 #if CONFIG_ZLEAKS
@@ -1577,6 +1913,17 @@ zone_init(
 	lck_grp_init(&zone_lck_grp, "zones", &zone_lck_grp_attr);
 	lck_attr_setdefault(&zone_lck_attr);
 	lck_mtx_init_ext(&zone_gc_lock, &zone_lck_ext, &zone_lck_grp, &zone_lck_attr);
+
+	zone_cache_zone = zinit(sizeof(struct zone_cache), 128 * sizeof(struct zone_cache),
+				sizeof(struct zone_cache), "zone caches");
+	zone_change(zone_cache_zone, Z_COLLECT, FALSE);
+	zone_change(zone_cache_zone, Z_CALLERACCT, FALSE);
+	zone_change(zone_cache_zone, Z_NOENCRYPT, TRUE);
+
+	zone_magazine_zone = zinit(sizeof(struct zone_magazine), 8192 * sizeof(struct zone_magazine),
+				   PAGE_SIZE, "zone magazines");
+	zone_change(zone_magazine_zone, Z_CALLERACCT, FALSE);
+	zone_change(zone_magazine_zone, Z_NOENCRYPT, TRUE);
 	
 #if CONFIG_ZLEAKS
 	/*
@@ -1621,6 +1968,7 @@ zone_page_table_expand(zone_page_index_t pindex)
 		for (i=0; i < zone_page_table_second_level_size; i++) {
 			entry_array[i].alloc_count = ZONE_PAGE_UNUSED;
 			entry_array[i].collect_count = 0;
+			entry_array[i].free_count = 0;
 		}
 
 		if (OSCompareAndSwapPtr(NULL, entry_array, first_level_ptr)) {
@@ -1681,6 +2029,12 @@ zalloc_canblock(
 	did_gzalloc = (addr != 0);
 #endif
 
+	if (addr == 0 && zone_cache_usable(zone)) {
+		addr = (vm_offset_t) zone_cache_alloc(zone);
+		if (addr != 0)
+			goto zalloc_done;
+	}
+
 	lock_zone(zone);
 
 	/*
@@ -1727,15 +2081,6 @@ zalloc_canblock(
 			 */
 			zone->waiting = TRUE;
 			zone_sleep(zone);
-		} else if (zone->doing_gc) {
-			/* zone_gc() is running. Since we need an element
-			 * from the free list that is currently being
-			 * collected, set the waiting bit and try to
-			 * interrupt the GC process, and try again
-			 * when we obtain the lock.
-			 */
-			zone->waiting = TRUE;
-			zone_sleep(zone);
 		} else {
 			vm_offset_t space;
 			vm_size_t alloc_size;
@@ -1965,6 +2310,7 @@ empty_slot:
 	if (zone_replenish_wakeup)
 		thread_wakeup(&zone->zone_replenish_thread);
 
+zalloc_done:
 	TRACE_MACHLEAKS(ZALLOC_CODE, ZALLOC_CODE_2, zone->elem_size, addr);
 
 	if (addr) {
@@ -2131,6 +2477,12 @@ zfree(
 		return;
 	}
 
+	if (__probable(!gzfreed) && zone_cache_usable(zone)) {
+		if (zone_cache_free(zone, addr))
+			goto zfree_done;
+		zone_cache_grow(zone);
+	}
+
 	lock_zone(zone);
 
 	/*
@@ -2249,6 +2601,7 @@ zfree(
 	}
 	unlock_zone(zone);
 
+zfree_done:
 	{
 		thread_t thr = current_thread();
 		task_t task;
@@ -2306,6 +2659,10 @@ zone_change(
 			gzalloc_reconfigure(zone);
 #endif
 			break;
+		case Z_CACHING_ENABLED:
+			if (value == TRUE)
+				zone_cache_init(zone);
+			break;
 		case Z_ALIGNMENT_REQUIRED:
 			zone->alignment_required = value;
 #if	ZONE_DEBUG			
@@ -2374,6 +2731,89 @@ zone_page_collectable(
 	return (FALSE);
 }
 
+/*
+ * Does any page under the element have all of its elements on the
+ * zone free list?  This is only a hint for zone_gc() to pick which
+ * elements to pull; zone_page_collectable() makes the final call.
+ */
+boolean_t
+zone_page_reclaimable(
+	vm_offset_t	addr,
+	vm_size_t	size)
+{
+	struct zone_page_table_entry	*zp;
+	zone_page_index_t i, j;
+
+#if	ZONE_ALIAS_ADDR
+	addr = zone_virtual_addr(addr);
+#endif
+
+	i = (zone_page_index_t)atop_kernel(addr-zone_map_min_address);
+	j = (zone_page_index_t)atop_kernel((addr+size-1) - zone_map_min_address);
+
+	for (; i <= j; i++) {
+		zp = zone_page_table_lookup(i);
+		if (zp->alloc_count != ZONE_PAGE_UNUSED &&
+		    zp->free_count == zp->alloc_count)
+			return (TRUE);
+	}
+
+	return (FALSE);
+}
+
+/*
+ * Maintain the per-page free counts as elements go on and off
+ * the zone free list.  Called with the zone locked.
+ */
+static inline void
+zone_page_count_free(
+	vm_offset_t	addr,
+	vm_size_t	size)
+{
+	struct zone_page_table_entry	*zp;
+	zone_page_index_t i, j;
+
+	if (!from_zone_map(addr, size))
+		return;
+
+#if	ZONE_ALIAS_ADDR
+	addr = zone_virtual_addr(addr);
+#endif
+
+	i = (zone_page_index_t)atop_kernel(addr-zone_map_min_address);
+	j = (zone_page_index_t)atop_kernel((addr+size-1) - zone_map_min_address);
+
+	for (; i <= j; i++) {
+		zp = zone_page_table_lookup(i);
+		++zp->free_count;
+	}
+}
+
+static inline void
+zone_page_count_alloc(
+	vm_offset_t	addr,
+	vm_size_t	size)
+{
+	struct zone_page_table_entry	*zp;
+	zone_page_index_t i, j;
+
+	if (!from_zone_map(addr, size))
+		return;
+
+#if	ZONE_ALIAS_ADDR
+	addr = zone_virtual_addr(addr);
+#endif
+
+	i = (zone_page_index_t)atop_kernel(addr-zone_map_min_address);
+	j = (zone_page_index_t)atop_kernel((addr+size-1) - zone_map_min_address);
+
+	for (; i <= j; i++) {
+		zp = zone_page_table_lookup(i);
+		if (zp->free_count > 0)
+			--zp->free_count;
+	}
+}
+
 void
 zone_page_keep(
 	vm_offset_t	addr,
@@ -2451,6 +2891,7 @@ zone_page_init(
 		assert(zp);
 		zp->alloc_count = ZONE_PAGE_UNUSED;
 		zp->collect_count = 0;
+		zp->free_count = 0;
 	}
 }
 
@@ -2514,12 +2955,15 @@ zone_page_free_element(
 
 		if (zp->collect_count > 0)
 			--zp->collect_count;
+		if (zp->free_count > 0)
+			--zp->free_count;
 		if (--zp->alloc_count == 0) {
 			vm_address_t        free_page_address;
 			vm_address_t        prev_free_page_address;
 
 			zp->alloc_count  = ZONE_PAGE_UNUSED;
 			zp->collect_count = 0;
+			zp->free_count = 0;
 
 
 			/*
@@ -2582,12 +3026,22 @@ struct {
 				elems_kept;
 } zgc_stats;
 
+/*
+ * zone_gc() handles at most this many free elements per zone lock hold.
+ */
+#define ZONE_GC_SLICE	64
+
 /*	Zone garbage collection
  *
- *	zone_gc will walk through all the free elements in all the
+ *	zone_gc will walk through the free elements in all the
  *	zones that are marked collectable looking for reclaimable
  *	pages.  zone_gc is called by consider_zone_gc when the system
  *	begins to run out of memory.
+ *
+ *	Each zone is processed in slices of ZONE_GC_SLICE elements
+ *	and the zone lock is dropped in between, so allocators never
+ *	wait on the collector; only elements on pages that are
+ *	entirely free are taken off the free list.
  */
 void
 zone_gc(boolean_t all_zones)
@@ -2624,9 +3078,9 @@ zone_gc(boolean_t all_zones)
 #endif /* MACH_ASSERT */
 
 	for (i = 0; i < max_zones; i++, z = z->next_zone) {
-		unsigned int			n, m;
+		unsigned int			n, budget;
 		vm_size_t			elt_size, size_freed;
-		struct zone_free_element	*elt, *base_elt, *base_prev, *prev, *scan, *keep, *tail;
+		struct zone_free_element	*elt, *next, *scan, *keep, *tail;
 		int				kmem_frees = 0;
 
 		assert(z != ZONE_NULL);
@@ -2637,6 +3091,9 @@ zone_gc(boolean_t all_zones)
 		if (all_zones == FALSE && z->elem_size < PAGE_SIZE)
 			continue;
 
+		if (z->cpu_cache_enabled)
+			zone_cache_drain_depot(z);
+
 		lock_zone(z);
 
 		elt_size = z->elem_size;
@@ -2657,104 +3114,67 @@ zone_gc(boolean_t all_zones)
 		}
 
 		z->doing_gc = TRUE;
+		z->gc_cursor = 0;
 
 		/*
-		 * Snatch all of the free elements away from the zone.
+		 * Never look at more elements than were free when we
+		 * started, so that a busy zone cannot keep us here.
 		 */
-
-		scan = (void *)z->free_elements;
-		z->free_elements = 0;
+		budget = (unsigned int)(z->cur_size / elt_size - z->count);
 
 		unlock_zone(z);
 
 		/*
 		 * Pass 1:
 		 *
-		 * Determine which elements we can attempt to collect
-		 * and count them up in the page table.  Foreign elements
-		 * are returned to the zone.
+		 * Walk the free list a slice at a time and pull out the
+		 * elements whose page has all of its elements free,
+		 * counting them up in the page table.  "gc_cursor" is
+		 * the last element we left on the list; if an allocator
+		 * takes it, everything in front of it is gone too and we
+		 * simply carry on from the head.
 		 */
 
-		prev = (void *)&scan;
-		elt = scan;
-		n = 0; tail = keep = NULL;
-
+		scan = tail = NULL;
 		zone_free_page_head = ZONE_PAGE_INDEX_INVALID;
 		zone_free_page_tail = ZONE_PAGE_INDEX_INVALID;
 
+		while (budget > 0) {
+			lock_zone(z);
 
-		while (elt != NULL) {
-			if (from_zone_map(elt, elt_size)) {
-				zone_page_collect((vm_offset_t)elt, elt_size);
-
-				prev = elt;
-				elt = elt->next;
+			for (n = 0; n < ZONE_GC_SLICE && budget > 0; n++, budget--) {
+				if (z->gc_cursor == 0)
+					elt = (void *)z->free_elements;
+				else
+					elt = ((struct zone_free_element *)z->gc_cursor)->next;
 
-				++zgc_stats.elems_collected;
-			}
-			else {
-				if (keep == NULL)
-					keep = tail = elt;
-				else {
-					ADD_ELEMENT(z, tail, elt);
-					tail = elt;
+				if (elt == NULL) {
+					budget = 0;
+					break;
 				}
 
-				ADD_ELEMENT(z, prev, elt->next);
-				elt = elt->next;
-				ADD_ELEMENT(z, tail, NULL);
-			}
-
-			/*
-			 * Dribble back the elements we are keeping.
-			 */
-
-			if (++n >= 50) {
-				if (z->waiting == TRUE) {
-					/* z->waiting checked without lock held, rechecked below after locking */
-					lock_zone(z);
-
-					if (keep != NULL) {
-						ADD_LIST_TO_ZONE(z, keep, tail);
-						tail = keep = NULL;
-					} else {
-						m =0;
-						base_elt = elt;
-						base_prev = prev;
-						while ((elt != NULL) && (++m < 50)) { 
-							prev = elt;
-							elt = elt->next;
-						}
-						if (m !=0 ) {
-							ADD_LIST_TO_ZONE(z, base_elt, prev);
-							ADD_ELEMENT(z, base_prev, elt);
-							prev = base_prev;
-						}
-					}
-
-					if (z->waiting) {
-						z->waiting = FALSE;
-						zone_wakeup(z);
-					}
-
-					unlock_zone(z);
+				if (!from_zone_map(elt, elt_size) ||
+				    !zone_page_reclaimable((vm_offset_t)elt, elt_size)) {
+					z->gc_cursor = (vm_offset_t)elt;
+					continue;
 				}
-				n =0;
-			}
-		}
 
-		/*
-		 * Return any remaining elements.
-		 */
+				if (z->gc_cursor == 0)
+					z->free_elements = (vm_offset_t)elt->next;
+				else
+					ADD_ELEMENT(z, (struct zone_free_element *)z->gc_cursor, elt->next);
 
-		if (keep != NULL) {
-			lock_zone(z);
+				zone_page_collect((vm_offset_t)elt, elt_size);
 
-			ADD_LIST_TO_ZONE(z, keep, tail);
+				if (scan == NULL)
+					scan = tail = elt;
+				else {
+					ADD_ELEMENT(z, tail, elt);
+					tail = elt;
+				}
+				ADD_ELEMENT(z, tail, NULL);
 
-			if (z->waiting) {
-				z->waiting = FALSE;
-				zone_wakeup(z);
+				++zgc_stats.elems_collected;
 			}
 
 			unlock_zone(z);
@@ -2764,81 +3184,49 @@ zone_gc(boolean_t all_zones)
 		 * Pass 2:
 		 *
 		 * Determine which pages we can reclaim and
-		 * free those elements.
+		 * free those elements.  Elements on pages that
+		 * picked up an allocation meanwhile go back to
+		 * the zone.
 		 */
 
-		size_freed = 0;
 		elt = scan;
-		n = 0; tail = keep = NULL;
 
 		while (elt != NULL) {
-			if (zone_page_collectable((vm_offset_t)elt, elt_size)) {
-				struct zone_free_element *next_elt = elt->next;
+			lock_zone(z);
 
-				size_freed += elt_size;
+			size_freed = 0;
+			tail = keep = NULL;
 
+			for (n = 0; elt != NULL && n < ZONE_GC_SLICE; n++) {
 				/*
 				 * If this is the last allocation on the page(s),
 				 * we may use their storage to maintain the linked
 				 * list of free-able pages. So store elt->next because
 				 * "elt" may be scribbled over.
 				 */
-				zone_page_free_element(&zone_free_page_head, &zone_free_page_tail, (vm_offset_t)elt, elt_size);
-
-				elt = next_elt;
+				next = elt->next;
 
-				++zgc_stats.elems_freed;
-			}
-			else {
-				zone_page_keep((vm_offset_t)elt, elt_size);
+				if (zone_page_collectable((vm_offset_t)elt, elt_size)) {
+					size_freed += elt_size;
+					zone_page_free_element(&zone_free_page_head, &zone_free_page_tail, (vm_offset_t)elt, elt_size);
 
-				if (keep == NULL)
-					keep = tail = elt;
-				else {
-					ADD_ELEMENT(z, tail, elt);
-					tail = elt;
+					++zgc_stats.elems_freed;
 				}
+				else {
+					zone_page_keep((vm_offset_t)elt, elt_size);
 
-				elt = elt->next;
-				ADD_ELEMENT(z, tail, NULL);
-
-				++zgc_stats.elems_kept;
-			}
-
-			/*
-			 * Dribble back the elements we are keeping,
-			 * and update the zone size info.
-			 */
-
-			if (++n >= 50) {
-				lock_zone(z);
-
-				z->cur_size -= size_freed;
-				size_freed = 0;
-
-				if (keep != NULL) {
-					ADD_LIST_TO_ZONE(z, keep, tail);
-				}
+					if (keep == NULL)
+						keep = tail = elt;
+					else {
+						ADD_ELEMENT(z, tail, elt);
+						tail = elt;
+					}
 
-				if (z->waiting) {
-					z->waiting = FALSE;
-					zone_wakeup(z);
+					++zgc_stats.elems_kept;
 				}
 
-				unlock_zone(z);
-
-				n = 0; tail = keep = NULL;
+				elt = next;
 			}
-		}
-
-		/*
-		 * Return any remaining elements, and update
-		 * the zone size info.
-		 */
-
-		lock_zone(z);
-
-		if (size_freed > 0 || keep != NULL) {
 
 			z->cur_size -= size_freed;
 
@@ -2846,13 +3234,17 @@ zone_gc(boolean_t all_zones)
 				ADD_LIST_TO_ZONE(z, keep, tail);
 			}
 
+			if (z->waiting) {
+				z->waiting = FALSE;
+				zone_wakeup(z);
+			}
+
+			unlock_zone(z);
 		}
 
+		lock_zone(z);
 		z->doing_gc = FALSE;
-		if (z->waiting) {
-			z->waiting = FALSE;
-			zone_wakeup(z);
-		}
+		z->gc_cursor = 0;
 		unlock_zone(z);
 
 
@@ -3044,7 +3436,7 @@ task_zone_info(
 		zi->tzi_max_size = (uint64_t)zcopy.max_size;
 		zi->tzi_elem_size = (uint64_t)zcopy.elem_size;
 		zi->tzi_alloc_size = (uint64_t)zcopy.alloc_size;
-		zi->tzi_sum_size = zcopy.sum_count * zcopy.elem_size;
+		zi->tzi_sum_size = (zcopy.sum_count + zone_cache_sum_count(&zcopy)) * zcopy.elem_size;
 		zi->tzi_exhaustible = (uint64_t)zcopy.exhaustible;
 		zi->tzi_collectable = (uint64_t)zcopy.collectable;
 		zi->tzi_caller_acct = (uint64_t)zcopy.caller_acct;
@@ -3221,7 +3613,7 @@ mach_zone_info(
 		zi->mzi_max_size = (uint64_t)zcopy.max_size;
 		zi->mzi_elem_size = (uint64_t)zcopy.elem_size;
 		zi->mzi_alloc_size = (uint64_t)zcopy.alloc_size;
-		zi->mzi_sum_size = zcopy.sum_count * zcopy.elem_size;
+		zi->mzi_sum_size = (zcopy.sum_count + zone_cache_sum_count(&zcopy)) * zcopy.elem_size;
 		zi->mzi_exhaustible = (uint64_t)zcopy.exhaustible;
 		zi->mzi_collectable = (uint64_t)zcopy.collectable;
 		zn++;
@@ -124,7 +124,8 @@ struct zone {
 	/* boolean_t */	no_callout:1,
 	/* boolean_t */	async_prio_refill:1,
 	/* boolean_t */	gzalloc_exempt:1,
-	/* boolean_t */	alignment_required:1;
+	/* boolean_t */	alignment_required:1,
+	/* boolean_t */	cpu_cache_enabled:1;	/* per-cpu magazines in front of the zone */
 	int		index;		/* index into zone_info arrays for this zone */
 	struct zone *	next_zone;	/* Link for all-zones list */
 	thread_call_data_t call_async_alloc;	/* callout for asynchronous alloc */
@@ -144,6 +145,8 @@ struct zone {
 #if	CONFIG_GZALLOC
 	gzalloc_data_t	gz;
 #endif /* CONFIG_GZALLOC */
+	struct zone_cache *zcache;	/* per-cpu magazines and depot */
+	vm_offset_t	gc_cursor;	/* last free element zone_gc() kept */
 };
 
 /*
@@ -266,6 +269,7 @@ extern void		zone_prio_refill_configure(zone_t, vm_size_t);
 				 */
 #define Z_ALIGNMENT_REQUIRED 8
 #define Z_GZALLOC_EXEMPT 9	/* Not tracked in guard allocation mode */
+#define Z_CACHING_ENABLED 10	/* Front the zone with per-cpu magazines */
 /* Preallocate space for zone from zone map */
 extern void		zprealloc(
 					zone_t		zone,
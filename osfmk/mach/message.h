@@ -594,10 +594,12 @@ typedef integer_t mach_msg_option_t;
 #define MACH_SEND_NOTIFY	0x00000080	/* arm send-possible notify */
 #define MACH_SEND_ALWAYS	0x00010000	/* internal use only */
 #define MACH_SEND_TRAILER	0x00020000	
+#define MACH_SEND_HANDOFF	0x00040000	/* internal use only */
 
 #define MACH_RCV_TIMEOUT	0x00000100
 #define MACH_RCV_NOTIFY		0x00000200	/* reserved - legacy */
 #define MACH_RCV_INTERRUPT	0x00000400	/* libmach implements */
+#define MACH_RCV_BATCH		0x00000800	/* fill buffer with queued msgs */
 #define MACH_RCV_OVERWRITE	0x00001000
 
 /* 
@@ -750,6 +752,25 @@ typedef kern_return_t mach_msg_return_t;
 #define MACH_RCV_IN_PROGRESS_TIMED      0x10004011
                 /* Waiting for receive with timeout. (Internal use only.) */
 
+/*
+ *  MACH_RCV_BATCH: follows the last message of a batch when
+ *  the first message leaves room for it; otherwise the receive
+ *  returned only that first message.  The header is zeroed, so
+ *  msgh_size is 0.  count is the number of messages before it,
+ *  the first included.  error is MACH_MSG_SUCCESS, or what went
+ *  wrong with the message that ended the batch.  A message whose
+ *  rights or memory could not be copied out is in the buffer, as
+ *  a single receive would return it, and is counted; one that
+ *  could not be written to the buffer (MACH_RCV_INVALID_DATA)
+ *  is not.
+ */
+typedef struct
+{
+	mach_msg_header_t	header;
+	mach_msg_size_t		count;
+	mach_msg_return_t	error;
+} mach_msg_batch_end_t;
+
 
 __BEGIN_DECLS
 
@@ -127,4 +127,25 @@ typedef struct task_category_policy		*task_category_policy_t;
 #define TASK_CATEGORY_POLICY_COUNT	((mach_msg_type_number_t) \
 	(sizeof (task_category_policy_data_t) / sizeof (integer_t)))
 
+/*
+ * TASK_OOL_LOAN_POLICY sets the size at or above which page-aligned
+ * out-of-line memory sent by the task with MACH_MSG_VIRTUAL_COPY is
+ * lent to the message, instead of being copied on write: the task
+ * keeps its mapping, and only pages it modifies after the send are
+ * copied.  A threshold of zero disables lending for the task.  New
+ * tasks inherit the threshold of their parent.
+ */
+
+#define TASK_OOL_LOAN_POLICY		2
+
+struct task_ool_loan_policy {
+	natural_t		threshold;	/* bytes */
+};
+
+typedef struct task_ool_loan_policy		task_ool_loan_policy_data_t;
+typedef struct task_ool_loan_policy		*task_ool_loan_policy_t;
+
+#define TASK_OOL_LOAN_POLICY_COUNT	((mach_msg_type_number_t) \
+	(sizeof (task_ool_loan_policy_data_t) / sizeof (integer_t)))
+
 #endif	/* _MACH_TASK_POLICY_H_ */
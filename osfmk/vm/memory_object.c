@@ -543,6 +543,15 @@ vm_object_update_extent(
 	     offset < offset_end && object->resident_page_count;
 	     offset += PAGE_SIZE_64) {
 
+		if (object->memq_radix != NULL) {
+			/*
+			 * the object's pages are indexed by offset...
+			 * skip straight over the non-resident ones
+			 */
+			if ((m = vm_page_lookup_next(object, offset, offset_end)) == VM_PAGE_NULL)
+				break;
+			offset = m->offset;
+		}
 	        /*
 		 * Limit the number of pages to be cleaned at once to a contiguous
 		 * run, or at most MAX_UPL_TRANSFER size
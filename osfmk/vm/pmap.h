@@ -534,6 +534,10 @@ extern pmap_t	kernel_pmap;			/* The kernel's map */
 #define PMAP_OPTIONS_NOENTER	0x2		/* expand pmap if needed
 						 * but don't enter mapping
 						 */
+#define PMAP_OPTIONS_PREMAP	0x4		/* no access yet (fault_type
+						 * VM_PROT_NONE), but enter a
+						 * valid mapping anyway
+						 */
 
 #if	!defined(__LP64__)
 extern vm_offset_t	pmap_extract(pmap_t pmap,
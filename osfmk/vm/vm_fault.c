@@ -274,6 +274,16 @@ boolean_t	vm_page_deactivate_behind = TRUE;
 
 int vm_default_behind = VM_DEFAULT_DEACTIVATE_BEHIND_WINDOW;
 
+/*
+ * fault-around window, in pages, given VM_BEHAVIOR_DEFAULT
+ * reference behavior... 0 or 1 disables it
+ */
+#define VM_DEFAULT_FAULT_AROUND_WINDOW	16
+#define VM_FAULT_AROUND_MAX		64		/* we use it to size an array on the stack */
+
+int vm_fault_around_pages = VM_DEFAULT_FAULT_AROUND_WINDOW;
+unsigned int vm_fault_around_mapped = 0;
+
 #define MAX_SEQUENTIAL_RUN	(1024 * 1024 * 1024)
 
 /*
@@ -677,6 +687,7 @@ vm_fault_zero_page(vm_page_t m, boolean_t no_zero_fill)
 
 	if (no_zero_fill == TRUE) {
 		my_fault = DBG_NZF_PAGE_FAULT;
+		m->zeroed = FALSE;
 	} else {
 		vm_page_zero_fill(m);
 
@@ -1337,7 +1348,7 @@ vm_fault_page(
 			/*
 			 * Allocate a new page for this object/offset pair as a placeholder
 			 */
-			m = vm_page_grab();
+			m = vm_page_grab_zeroed();
 #if TRACEFAULTPAGE
 			dbgTrace(0xBEEF000D, (unsigned int) m, (unsigned int) object);	/* (TEST/DEBUG) */
 #endif
@@ -1666,7 +1677,7 @@ dont_look_for_page:
 			        return (error);
 
 			if (m == VM_PAGE_NULL) {
-				m = vm_page_grab();
+				m = vm_page_grab_zeroed();
 
 				if (m == VM_PAGE_NULL) {
 					vm_fault_cleanup(object, VM_PAGE_NULL);
@@ -2323,6 +2334,7 @@ vm_fault_enter(vm_page_t m,
 	boolean_t	previously_pmapped = m->pmapped;
 	boolean_t	must_disconnect = 0;
 	boolean_t	map_is_switched, map_is_switch_protected;
+	boolean_t	premap;
 	
 	vm_object_lock_assert_held(m->object);
 #if DEBUG
@@ -2333,6 +2345,10 @@ vm_fault_enter(vm_page_t m,
 		assert(m->fictitious);
 		return KERN_SUCCESS;
 	}
+	/*
+	 * entered ahead of any access (vm_fault_around)
+	 */
+	premap = (fault_type == VM_PROT_NONE && !change_wiring);
 
 	if (*type_of_fault == DBG_ZERO_FILL_FAULT) {
 
@@ -2352,7 +2368,7 @@ vm_fault_enter(vm_page_t m,
 		 */
 		prot &= ~VM_PROT_WRITE;
 	}       
-	if (m->pmapped == FALSE) {
+	if (m->pmapped == FALSE && !premap) {
 
 		if ((*type_of_fault == DBG_CACHE_HIT_FAULT) && m->clustered) {
 		        /*
@@ -2563,7 +2579,8 @@ vm_fault_enter(vm_page_t m,
 		 * holding the object lock if we need to wait for a page in
 		 * pmap_enter() - <rdar://problem/7138958> */
 		PMAP_ENTER_OPTIONS(pmap, vaddr, m, prot, fault_type, 0,
-				  wired, PMAP_OPTIONS_NOWAIT, pe_result);
+				  wired, PMAP_OPTIONS_NOWAIT |
+				  (premap ? PMAP_OPTIONS_PREMAP : 0), pe_result);
 
 		if(pe_result == KERN_RESOURCE_SHORTAGE) {
 
@@ -2625,6 +2642,11 @@ after_the_pmap_enter:
 		}
 		vm_page_unlock_queues();
 
+	} else if (premap) {
+		/*
+		 * the page has not been used yet, so it keeps
+		 * its queue and its age
+		 */
 	} else {
 	        if (kr != KERN_SUCCESS) {
 		        vm_page_lockspin_queues();
@@ -2718,6 +2740,148 @@ after_the_pmap_enter:
 }
 
 
+/*
+ * vm_fault_around
+ *
+ * After a soft fault on a file-backed object, enter
+ * read-only mappings for the neighbouring pages that
+ * are already resident, so that touching them doesn't
+ * cost another trap.  The window follows the behavior
+ * specified: ahead of the fault for sequential access,
+ * behind it for reverse sequential access, and around
+ * it (aligned to the window size) by default.
+ *
+ * Only pages that can be entered without changing the
+ * object are considered, since the object may only be
+ * locked "shared" here.  They are entered with a fault
+ * type of VM_PROT_NONE: the pmap enters a valid read-only
+ * mapping without marking the page referenced, and
+ * vm_fault_enter() neither moves the page on the queues
+ * nor counts a pagein for it.  Pages entered this way are
+ * marked "premapped" so that the pageout scan can tell
+ * whether the page was referenced before it aged out.
+ *
+ * object must be locked and the map lookup still valid;
+ * "offset" and "vaddr" describe the page just entered.
+ */
+static
+void
+vm_fault_around(
+	vm_object_t		object,
+	vm_object_offset_t	offset,
+	pmap_t			pmap,
+	vm_map_offset_t		vaddr,
+	vm_prot_t		prot,
+	vm_object_fault_info_t	fault_info)
+{
+	vm_object_offset_t	window_size;
+	vm_object_offset_t	first, last, cur_offset;
+	vm_map_offset_t		cur_vaddr;
+	vm_page_t		m;
+	vm_page_t		page_run[VM_FAULT_AROUND_MAX];
+	int			pages_in_run = 0;
+	int			window;
+	int			type_of_fault;
+	boolean_t		need_retry;
+	int			n;
+
+	window = vm_fault_around_pages;
+
+	if (window <= 1 || object == kernel_object)
+		return;
+	if (window > VM_FAULT_AROUND_MAX)
+		window = VM_FAULT_AROUND_MAX;
+	window_size = window * PAGE_SIZE_64;
+
+	offset = vm_object_trunc_page(offset);
+	vaddr = vm_map_trunc_page(vaddr);
+
+	switch (fault_info->behavior) {
+	case VM_BEHAVIOR_RANDOM:
+		return;
+	case VM_BEHAVIOR_SEQUENTIAL:
+		first = offset + PAGE_SIZE_64;
+		last = offset + window_size;
+		break;
+	case VM_BEHAVIOR_RSEQNTL:
+		if (offset >= window_size - PAGE_SIZE_64)
+			first = offset - (window_size - PAGE_SIZE_64);
+		else
+			first = 0;
+		last = offset;
+		break;
+	case VM_BEHAVIOR_DEFAULT:
+	default:
+		first = offset - (offset % window_size);
+		last = first + window_size;
+		break;
+	}
+	/*
+	 * stay within the map entry and the object
+	 */
+	if (first < fault_info->lo_offset)
+		first = fault_info->lo_offset;
+	if (last > fault_info->hi_offset)
+		last = fault_info->hi_offset;
+	if (last > object->vo_size)
+		last = object->vo_size;
+
+	for (cur_offset = first; cur_offset < last; cur_offset += PAGE_SIZE_64) {
+
+		if (cur_offset == offset)
+			continue;
+
+		m = vm_page_lookup(object, cur_offset);
+
+		if (m == VM_PAGE_NULL || m->busy || m->unusual || m->fictitious ||
+		    m->laundry || m->encrypted || m->no_cache || m->cleaning)
+			continue;
+		/*
+		 * these would need the object locked exclusively
+		 */
+		if (vm_page_is_slideable(m) || VM_FAULT_NEED_CS_VALIDATION(pmap, m))
+			continue;
+
+		cur_vaddr = vaddr + (cur_offset - offset);
+
+		if (pmap_find_phys(pmap, (addr64_t) cur_vaddr) != 0) {
+			/*
+			 * already mapped... don't downgrade it
+			 */
+			continue;
+		}
+		type_of_fault = DBG_CACHE_HIT_FAULT;
+		need_retry = FALSE;
+
+		if (vm_fault_enter(m, pmap, cur_vaddr,
+				   prot & ~VM_PROT_WRITE, VM_PROT_NONE,
+				   FALSE, FALSE,
+				   fault_info->no_cache, fault_info->cs_bypass,
+				   &need_retry, &type_of_fault) != KERN_SUCCESS)
+			continue;
+
+		if (need_retry == TRUE) {
+			/*
+			 * the pmap needs to grow... that's not
+			 * worth blocking for on a speculative mapping
+			 */
+			break;
+		}
+		page_run[pages_in_run++] = m;
+	}
+	if (pages_in_run) {
+		vm_page_lockspin_queues();
+
+		for (n = 0; n < pages_in_run; n++)
+			page_run[n]->premapped = TRUE;
+
+		vm_page_unlock_queues();
+
+		OSAddAtomic(pages_in_run, &vm_fault_around_mapped);
+	}
+}
+
+
 /*
  *	Routine:	vm_fault
  *	Purpose:
@@ -2776,6 +2940,7 @@ vm_fault(
 	int			cur_object_lock_type;
 	vm_object_t		top_object = VM_OBJECT_NULL;
 	int			throttle_delay;
+	boolean_t		fault_around = FALSE;
 
 
 	KERNEL_DEBUG_CONSTANT_IST(KDEBUG_TRACE, 
@@ -3256,6 +3421,17 @@ FastPmapEnter:
 				 * cur_object == NULL or it's been unlocked
 				 * no paging references on either object or cur_object
 				 */
+				/*
+				 * only pre-map neighbours of a page found in the
+				 * top-level, file-backed object of a plain mapping...
+				 * a shadow could hide them at the top level
+				 */
+				fault_around = (top_object == VM_OBJECT_NULL &&
+						!object->internal &&
+						!wired && !change_wiring &&
+						caller_pmap == PMAP_NULL &&
+						map == original_map &&
+						!fault_info.no_cache);
 				if (caller_pmap) {
 				        kr = vm_fault_enter(m,
 							    caller_pmap,
@@ -3310,6 +3486,13 @@ FastPmapEnter:
 
 					vm_fault_deactivate_behind(object, cur_offset, fault_info.behavior);
 				}
+				if (kr == KERN_SUCCESS && need_retry == FALSE && fault_around == TRUE) {
+					/*
+					 * the map lookup is still valid, so we
+					 * can pre-map this page's resident neighbours
+					 */
+					vm_fault_around(object, cur_offset, pmap, vaddr, prot, &fault_info);
+				}
 				/*
 				 * That's it, clean up and return.
 				 */
@@ -3566,7 +3749,7 @@ FastPmapEnter:
 						goto RetryFault;
 					}
 				}
-				m = vm_page_alloc(object, offset);
+				m = vm_page_alloc_zeroed(object, offset);
 
 				if (m == VM_PAGE_NULL) {
 				        /*
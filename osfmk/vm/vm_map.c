@@ -1237,6 +1237,16 @@ vm_map_find_space(
 			start = map->min_offset;
 		else
 			start = entry->vme_end;
+
+		/*
+		 *	Skip ahead to the first hole that can fit the
+		 *	request.  A front guard page shifts the alignment,
+		 *	so leave that case to the loop below.
+		 */
+		if (!(flags & VM_FLAGS_GUARD_BEFORE))
+			(void) vm_map_store_find_space(map, size, mask,
+						       map->max_offset,
+						       &entry, &start);
 	}
 
 	/*
@@ -1759,6 +1769,14 @@ StartAgain: ;
 				}
 				entry = tmp_entry;
 			}
+
+			/*
+			 *	Skip ahead to the first hole that can fit
+			 *	the request; the loop below validates it.
+			 */
+			(void) vm_map_store_find_space(map, size, mask,
+						       effective_max_offset,
+						       &entry, &start);
 		}
 
 		/*
@@ -2006,6 +2024,7 @@ StartAgain: ;
 			map->size += (end - entry->vme_end);
 			assert(entry->vme_start < end);
 			entry->vme_end = end;
+			vm_map_store_update_gap(map, entry);
 			vm_map_store_update_first_free(map, map->first_free);
 			RETURN(KERN_SUCCESS);
 		}
@@ -8171,6 +8190,144 @@ vm_map_copyin_object(
 	return(KERN_SUCCESS);
 }
 
+/*
+ *	vm_map_copyin_loan:
+ *
+ *	Copy in a page-aligned region that lies within a single map
+ *	entry by lending the source pages to the copy, rather than by
+ *	the symmetric copy-on-write that vm_map_copyin performs.
+ *
+ *	The copy gets an asymmetric copy object (vm_object_copy_delayed)
+ *	shadowing the source object.  The source entry is neither clipped
+ *	nor marked needs_copy; only its resident pages are write
+ *	protected, and a page is pushed to the copy object only when the
+ *	source writes it again.
+ *
+ *	Only MEMORY_OBJECT_COPY_DELAY objects qualify.  Returns
+ *	KERN_NOT_SUPPORTED, with nothing changed, when the region does
+ *	not qualify or the map changed during the copy; the caller
+ *	should then use vm_map_copyin.
+ */
+kern_return_t
+vm_map_copyin_loan(
+	vm_map_t		src_map,
+	vm_map_address_t	src_addr,
+	vm_map_size_t		len,
+	vm_map_copy_t		*copy_result)	/* OUT */
+{
+	vm_map_entry_t		src_entry;
+	vm_map_entry_t		new_entry;
+	vm_map_copy_t		copy;
+	vm_object_t		src_object;
+	vm_object_t		new_object;
+	vm_object_offset_t	src_offset;
+	vm_map_address_t	src_end;
+	vm_map_version_t	version;
+
+	src_end = src_addr + len;
+	if (len == 0 || src_end < src_addr ||
+	    !page_aligned(src_addr) || !page_aligned(len))
+		return KERN_NOT_SUPPORTED;
+
+	copy = (vm_map_copy_t) zalloc(vm_map_copy_zone);
+	vm_map_copy_first_entry(copy) =
+		vm_map_copy_last_entry(copy) = vm_map_copy_to_entry(copy);
+	copy->type = VM_MAP_COPY_ENTRY_LIST;
+	copy->cpy_hdr.nentries = 0;
+	copy->cpy_hdr.entries_pageable = TRUE;
+
+	vm_map_store_init( &(copy->cpy_hdr) );
+
+	copy->offset = src_addr;
+	copy->size = len;
+
+	new_entry = vm_map_copy_entry_create(copy, !copy->cpy_hdr.entries_pageable);
+
+	vm_map_lock_read(src_map);
+
+	if (!vm_map_lookup_entry(src_map, src_addr, &src_entry) ||
+	    src_entry->is_sub_map ||
+	    src_entry->vme_end < src_end ||
+	    src_entry->wired_count != 0 ||
+	    (src_entry->protection & VM_PROT_READ) == VM_PROT_NONE)
+		goto NotSupported;
+
+	/*
+	 *	Only objects that already use the asymmetric strategy can
+	 *	be given a delayed copy object: symmetric ones (ordinary
+	 *	anonymous memory) must be copied with needs_copy, which
+	 *	vm_map_copyin does.
+	 */
+	src_object = src_entry->object.vm_object;
+	if (src_object == VM_OBJECT_NULL ||
+	    src_object->phys_contiguous ||
+	    src_object->copy_strategy != MEMORY_OBJECT_COPY_DELAY)
+		goto NotSupported;
+
+	src_offset = src_entry->offset + (src_addr - src_entry->vme_start);
+
+	/*
+	 *	As in vm_map_copyin_internal, hold a reference on the object
+	 *	and drop the map lock for the copy, then verify that the map
+	 *	has not changed underneath us.  A wired page anywhere below
+	 *	the region makes the delayed copy fail.
+	 */
+	vm_object_reference(src_object);
+	version.main_timestamp = src_map->timestamp;
+	vm_map_unlock_read(src_map);
+
+	vm_object_lock_shared(src_object);
+	new_object = vm_object_copy_delayed(src_object, src_offset, len, TRUE);
+	if (new_object == VM_OBJECT_NULL) {
+		vm_object_deallocate(src_object);
+		goto NotSupportedUnlocked;
+	}
+
+	vm_map_lock_read(src_map);
+	if (version.main_timestamp != src_map->timestamp &&
+	    (!vm_map_lookup_entry(src_map, src_addr, &src_entry) ||
+	     src_entry->is_sub_map ||
+	     src_entry->vme_end < src_end ||
+	     src_entry->wired_count != 0 ||
+	     (src_entry->protection & VM_PROT_READ) == VM_PROT_NONE ||
+	     src_entry->object.vm_object != src_object ||
+	     src_entry->offset + (src_addr - src_entry->vme_start) != src_offset)) {
+		/*
+		 *	Verification failed.  Dropping the copy object
+		 *	undoes the delayed copy.
+		 */
+		vm_map_unlock_read(src_map);
+		vm_object_deallocate(new_object);
+		vm_object_deallocate(src_object);
+		goto NotSupportedUnlocked;
+	}
+
+	vm_map_entry_copy(new_entry, src_entry);
+	new_entry->use_pmap = FALSE;	/* clr address space specifics */
+	new_entry->vme_start = src_addr;
+	new_entry->vme_end = src_end;
+	new_entry->object.vm_object = new_object;
+	new_entry->offset = src_offset;
+	new_entry->needs_copy = TRUE;
+
+	vm_map_unlock_read(src_map);
+
+	/* the entry holds its own reference on src_object */
+	vm_object_deallocate(src_object);
+
+	vm_map_copy_entry_link(copy, vm_map_copy_last_entry(copy), new_entry);
+
+	*copy_result = copy;
+	return KERN_SUCCESS;
+
+ NotSupported:
+	vm_map_unlock_read(src_map);
+ NotSupportedUnlocked:
+	vm_map_copy_entry_dispose(copy, new_entry);
+	vm_map_copy_discard(copy);
+	return KERN_NOT_SUPPORTED;
+}
+
 static void
 vm_map_fork_share(
 	vm_map_t	old_map,
@@ -10228,6 +10385,8 @@ vm_map_simplify_entry(
 		assert(prev_entry->vme_start < this_entry->vme_end);
 		this_entry->vme_start = prev_entry->vme_start;
 		this_entry->offset = prev_entry->offset;
+		/* the unlink measured our predecessor's hole to our old start */
+		vm_map_store_update_gap(map, this_entry->vme_prev);
 		if (prev_entry->is_sub_map) {
 			vm_map_deallocate(prev_entry->object.sub_map);
 		} else {
@@ -12765,6 +12924,7 @@ void
 vm_map_set_32bit(vm_map_t map)
 {
 	map->max_offset = (vm_map_offset_t)VM_MAX_ADDRESS;
+	vm_map_store_update_gap(map, vm_map_last_entry(map));
 }
 
 
@@ -12772,6 +12932,7 @@ void
 vm_map_set_64bit(vm_map_t map)
 {
 	map->max_offset = (vm_map_offset_t)MACH_VM_MAX_ADDRESS;
+	vm_map_store_update_gap(map, vm_map_last_entry(map));
 }
 
 vm_map_offset_t
@@ -12852,6 +13013,8 @@ vm_map_raise_max_offset(
 			}
 		}
 	}
+	if (ret == KERN_SUCCESS)
+		vm_map_store_update_gap(map, vm_map_last_entry(map));
 
 	vm_map_unlock(map);
 	return ret;
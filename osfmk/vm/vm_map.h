@@ -983,6 +983,12 @@ extern kern_return_t	vm_map_copyin_common(
 				vm_map_copy_t		*copy_result,	/* OUT */
 				boolean_t		use_maxprot);
 
+extern kern_return_t	vm_map_copyin_loan(
+				vm_map_t		src_map,
+				vm_map_address_t	src_addr,
+				vm_map_size_t		len,
+				vm_map_copy_t		*copy_result);	/* OUT */
+
 extern void		vm_map_disable_NX(
 			        vm_map_t		map);
 
@@ -168,6 +168,46 @@ vm_map_store_copy_reset( vm_map_copy_t copy,vm_map_entry_t entry)
 #endif
 }
 
+/*
+ *	vm_map_store_update_gap:
+ *
+ *	Called when an entry's end moves without the entry
+ *	being relinked, e.g. when a mapping is extended in place,
+ *	or on the previous entry when an entry's start moves.
+ */
+void
+vm_map_store_update_gap( __unused vm_map_t map, __unused vm_map_entry_t entry)
+{
+#ifdef VM_MAP_STORE_USE_RB
+	vm_map_store_update_gap_rb(&map->hdr, entry);
+#endif
+}
+
+/*
+ *	vm_map_store_find_space:
+ *
+ *	Advance "*entry"/"*start" to the first hole at or after them
+ *	that can hold "size" bytes aligned to "mask" below "limit".
+ *	Returns FALSE, leaving them untouched, when the store has no
+ *	index to search, in which case callers fall back to walking
+ *	the entry list.
+ */
+boolean_t
+vm_map_store_find_space(
+	__unused vm_map_t	map,
+	__unused vm_map_size_t	size,
+	__unused vm_map_offset_t mask,
+	__unused vm_map_offset_t limit,
+	__unused vm_map_entry_t	*entry,
+	__unused vm_map_offset_t *start)
+{
+#ifdef VM_MAP_STORE_USE_RB
+	return (vm_map_store_find_space_rb(map, size, mask, limit, entry, start));
+#else
+	return FALSE;
+#endif
+}
+
 void
 vm_map_store_update_first_free( vm_map_t map, vm_map_entry_t first_free)
 {
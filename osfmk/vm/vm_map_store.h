@@ -38,6 +38,7 @@
 #define VM_MAP_STORE_USE_RB
 #endif
 
+#include <mach/vm_types.h>
 #include <libkern/tree.h>
 
 struct _vm_map;
@@ -48,6 +49,7 @@ struct vm_map_header;
 struct vm_map_store {
 #ifdef VM_MAP_STORE_USE_RB
 	RB_ENTRY(vm_map_store) entry;
+	vm_map_size_t	max_gap;	/* largest hole following any entry in this subtree */
 #endif
 };
 
@@ -127,6 +129,8 @@ void	vm_map_store_entry_unlink( struct _vm_map*, struct vm_map_entry*);
 void	vm_map_store_update_first_free( struct _vm_map*, struct vm_map_entry*);
 void	vm_map_store_copy_insert( struct _vm_map*, struct vm_map_entry*, struct vm_map_copy*);
 void	vm_map_store_copy_reset( struct vm_map_copy*, struct vm_map_entry*);
+void	vm_map_store_update_gap( struct _vm_map*, struct vm_map_entry*);
+boolean_t vm_map_store_find_space( struct _vm_map*, vm_map_size_t, vm_map_offset_t, vm_map_offset_t, struct vm_map_entry**, vm_map_offset_t*);
 #if MACH_ASSERT
 boolean_t first_free_is_valid_store( struct _vm_map*);
 #endif
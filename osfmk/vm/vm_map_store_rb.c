@@ -28,11 +28,65 @@
 
 #include <vm/vm_map_store_rb.h>
 
-RB_GENERATE(rb_head, vm_map_store, entry, rb_node_compare);
-
 #define VME_FOR_STORE( store)	\
 	(vm_map_entry_t)(((unsigned long)store) - ((unsigned long)sizeof(struct vm_map_links)))
 
+/*
+ *	Each node of the tree caches the size of the largest hole
+ *	that follows any entry in its subtree ("max_gap"), so that
+ *	vm_map_store_find_space_rb() can skip whole subtrees that
+ *	cannot satisfy an allocation.  The hole following an entry
+ *	is computed from the entry list; the last entry's "next" is
+ *	the map header, whose end is the end of the map.
+ */
+static vm_map_size_t
+vm_map_store_entry_gap_rb( vm_map_entry_t entry )
+{
+	vm_map_entry_t next = entry->vme_next;
+
+	if (next->vme_start >= entry->vme_end)
+		return (next->vme_start - entry->vme_end);
+	if (next->vme_end > entry->vme_end)
+		return (next->vme_end - entry->vme_end);
+	return 0;
+}
+
+static void
+vm_map_store_augment_rb( struct vm_map_store *store )
+{
+	struct vm_map_store *child;
+	vm_map_size_t max_gap;
+
+	max_gap = vm_map_store_entry_gap_rb(VME_FOR_STORE(store));
+	if ((child = RB_LEFT(store, entry)) != NULL && child->max_gap > max_gap)
+		max_gap = child->max_gap;
+	if ((child = RB_RIGHT(store, entry)) != NULL && child->max_gap > max_gap)
+		max_gap = child->max_gap;
+	store->max_gap = max_gap;
+}
+
+/*
+ * The tree code calls RB_AUGMENT on every node whose children change
+ * during a rotation, insertion or removal.
+ */
+#undef RB_AUGMENT
+#define RB_AUGMENT(x)	vm_map_store_augment_rb(x)
+
+RB_GENERATE(rb_head, vm_map_store, entry, rb_node_compare);
+
+/*
+ * Recompute "max_gap" from "store" up to the root, after the hole
+ * following its entry changed.
+ */
+static void
+vm_map_store_propagate_gap_rb( struct vm_map_store *store )
+{
+	while (store != NULL) {
+		vm_map_store_augment_rb(store);
+		store = rb_head_RB_GETPARENT(store);
+	}
+}
+
 void
 vm_map_store_init_rb( struct vm_map_header* hdr )
 {
@@ -96,15 +150,20 @@ boolean_t vm_map_store_lookup_entry_rb( vm_map_t map, vm_map_offset_t address, v
 	return FALSE;
 }
 
-void 	vm_map_store_entry_link_rb( struct vm_map_header *mapHdr, __unused vm_map_entry_t after_where, vm_map_entry_t entry)
+void 	vm_map_store_entry_link_rb( struct vm_map_header *mapHdr, vm_map_entry_t after_where, vm_map_entry_t entry)
 {
 	struct rb_head *rbh = &(mapHdr->rb_head_store);
 	struct vm_map_store *store = &(entry->store);
 	struct vm_map_store *tmp_store;
+
+	store->max_gap = vm_map_store_entry_gap_rb(entry);
 	if((tmp_store = RB_INSERT( rb_head, rbh, store )) != NULL) {
 		panic("VMSEL: INSERT FAILED: 0x%lx, 0x%lx, 0x%lx, 0x%lx", (uintptr_t)entry->vme_start, (uintptr_t)entry->vme_end,
 				(uintptr_t)(VME_FOR_STORE(tmp_store))->vme_start,  (uintptr_t)(VME_FOR_STORE(tmp_store))->vme_end);
 	}
+	vm_map_store_propagate_gap_rb(store);
+	/* the entry now splits the hole that followed "after_where" */
+	vm_map_store_update_gap_rb(mapHdr, after_where);
 }
 
 void	vm_map_store_entry_unlink_rb( struct vm_map_header *mapHdr, vm_map_entry_t entry)
@@ -113,13 +172,19 @@ void	vm_map_store_entry_unlink_rb( struct vm_map_header *mapHdr, vm_map_entry_t
 	struct vm_map_store *rb_entry;
 	struct vm_map_store *store = &(entry->store);
 	
+	struct vm_map_store *parent;
+	
 	rb_entry = RB_FIND( rb_head, rbh, store);	
 	if(rb_entry == NULL)
 		panic("NO ENTRY TO DELETE");
+	parent = rb_head_RB_GETPARENT(store);
 	RB_REMOVE( rb_head, rbh, store );
+	vm_map_store_propagate_gap_rb(parent);
+	/* the previous entry absorbed the removed entry's range into its hole */
+	vm_map_store_update_gap_rb(mapHdr, entry->vme_prev);
 }
 
-void	vm_map_store_copy_insert_rb( vm_map_t map, __unused vm_map_entry_t after_where, vm_map_copy_t copy)
+void	vm_map_store_copy_insert_rb( vm_map_t map, vm_map_entry_t after_where, vm_map_copy_t copy)
 {
 	struct vm_map_header *mapHdr = &(map->hdr);
 	struct rb_head *rbh = &(mapHdr->rb_head_store);
@@ -130,16 +195,19 @@ void	vm_map_store_copy_insert_rb( vm_map_t map, __unused vm_map_entry_t after_wh
 	while (entry != vm_map_copy_to_entry(copy) && nentries > 0) {		
 		vm_map_entry_t prev = entry;
 		store = &(entry->store);
+		store->max_gap = vm_map_store_entry_gap_rb(entry);
 		if( RB_INSERT( rb_head, rbh, store ) != NULL){
 			panic("VMSCIR1: INSERT FAILED: %d: %p, %p, %p, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx",inserted, prev, entry, vm_map_copy_to_entry(copy), 
 					(uintptr_t)prev->vme_start,  (uintptr_t)prev->vme_end,  (uintptr_t)entry->vme_start,  (uintptr_t)entry->vme_end,  
 					 (uintptr_t)(VME_FOR_STORE(rbh->rbh_root))->vme_start,  (uintptr_t)(VME_FOR_STORE(rbh->rbh_root))->vme_end);
 		} else {
+			vm_map_store_propagate_gap_rb(store);
 			entry = entry->vme_next;
 			inserted++;
 			nentries--;
 		}
 	}
+	vm_map_store_update_gap_rb(mapHdr, after_where);
 }
 
 void
@@ -164,3 +232,106 @@ void	update_first_free_rb( __unused vm_map_t map, __unused vm_map_entry_t entry)
 	return ;
 }
 
+/*
+ *	vm_map_store_update_gap_rb:
+ *
+ *	The hole following "entry" changed size, either because
+ *	its end moved or because its successor changed.
+ */
+void
+vm_map_store_update_gap_rb( struct vm_map_header *mapHdr, vm_map_entry_t entry)
+{
+	if (entry == (vm_map_entry_t) &mapHdr->links)
+		return;
+	vm_map_store_propagate_gap_rb(&(entry->store));
+}
+
+/*
+ *	vm_map_store_find_space_rb:
+ *
+ *	Starting with the hole that follows "*entry_p" at or above
+ *	"*start_p", find the lowest hole in which "size" bytes fit
+ *	once aligned to "mask" without going past "limit".  Subtrees
+ *	whose largest hole is smaller than "size" are skipped, so the
+ *	search is logarithmic in the number of entries unless many
+ *	holes are large enough but defeated by the alignment.
+ *
+ *	On success, "*entry_p" is the entry preceding the hole and
+ *	"*start_p" the lowest address in it; the caller still aligns
+ *	and checks the result.  The map must be locked.
+ */
+boolean_t
+vm_map_store_find_space_rb(
+	vm_map_t		map,
+	vm_map_size_t		size,
+	vm_map_offset_t		mask,
+	vm_map_offset_t		limit,
+	vm_map_entry_t		*entry_p,	/* IN/OUT */
+	vm_map_offset_t		*start_p)	/* IN/OUT */
+{
+	vm_map_entry_t		header = vm_map_to_entry(map);
+	vm_map_entry_t		entry = *entry_p;
+	vm_map_offset_t		start, end, hole_end;
+	struct vm_map_store	*store, *tmp;
+
+	if (size == 0)
+		return FALSE;
+
+	store = RB_ROOT(&(map->hdr.rb_head_store));
+	if (entry == header) {
+		/* the hole below the first entry is not cached in the tree */
+		start = *start_p;
+		if (header->vme_next == header)
+			hole_end = limit;
+		else
+			hole_end = header->vme_next->vme_start;
+		end = (start + mask) & ~mask;
+		if (end >= start && end + size > end && end + size <= hole_end &&
+		    end + size <= limit)
+			return TRUE;
+
+		/* consider every entry, starting with the lowest promising one */
+		if (store == NULL || store->max_gap < size)
+			return FALSE;
+		while ((tmp = RB_LEFT(store, entry)) != NULL && tmp->max_gap >= size)
+			store = tmp;
+		entry = VME_FOR_STORE(store);
+	} else {
+		store = &(entry->store);
+	}
+
+	for (;;) {
+		start = entry->vme_end;
+		if (start < *start_p)
+			start = *start_p;
+		if (start >= limit)
+			return FALSE;
+
+		if (entry->vme_next == header)
+			hole_end = limit;
+		else
+			hole_end = entry->vme_next->vme_start;
+		if (hole_end > limit)
+			hole_end = limit;
+		end = (start + mask) & ~mask;
+		if (end >= start && end + size > end && end + size <= hole_end) {
+			*entry_p = entry;
+			*start_p = start;
+			return TRUE;
+		}
+
+		/* move to the next entry whose subtree has a large enough hole */
+		if ((tmp = RB_RIGHT(store, entry)) != NULL && tmp->max_gap >= size) {
+			store = tmp;
+			while ((tmp = RB_LEFT(store, entry)) != NULL && tmp->max_gap >= size)
+				store = tmp;
+		} else {
+			while ((tmp = rb_head_RB_GETPARENT(store)) != NULL &&
+			       store == RB_RIGHT(tmp, entry))
+				store = tmp;
+			if ((store = tmp) == NULL)
+				return FALSE;
+		}
+		entry = VME_FOR_STORE(store);
+	}
+}
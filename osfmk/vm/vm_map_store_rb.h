@@ -42,5 +42,7 @@ void	vm_map_store_entry_unlink_rb( struct vm_map_header*, struct vm_map_entry*);
 void	vm_map_store_copy_insert_rb( struct _vm_map*, struct vm_map_entry*, struct vm_map_copy*);
 void	vm_map_store_copy_reset_rb( struct vm_map_copy*, struct vm_map_entry*, int);
 void	update_first_free_rb(struct _vm_map*, struct vm_map_entry*);
+void	vm_map_store_update_gap_rb( struct vm_map_header*, struct vm_map_entry*);
+boolean_t vm_map_store_find_space_rb( struct _vm_map*, vm_map_size_t, vm_map_offset_t, vm_map_offset_t, struct vm_map_entry**, vm_map_offset_t*);
 
 #endif /* _VM_VM_MAP_STORE_RB_H */
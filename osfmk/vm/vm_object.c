@@ -561,6 +561,7 @@ vm_object_bootstrap(void)
 #endif
 	vm_object_template.vo_size = 0;
 	vm_object_template.memq_hint = VM_PAGE_NULL;
+	vm_object_template.memq_radix = NULL;
 	vm_object_template.ref_count = 1;
 #if	TASK_SWAPPER
 	vm_object_template.res_count = 1;
@@ -1779,6 +1780,9 @@ vm_object_reap(
 
 	object->shadow = VM_OBJECT_NULL;
 
+	/* the page index goes away with the last resident page */
+	assert(object->memq_radix == NULL);
+
 	vm_object_lock_destroy(object);
 	/*
 	 *	Free the space for the object.
@@ -5248,6 +5252,7 @@ retry:
  */
 unsigned int vm_object_page_remove_lookup = 0;
 unsigned int vm_object_page_remove_iterate = 0;
+unsigned int vm_object_page_remove_index = 0;
 
 __private_extern__ void
 vm_object_page_remove(
@@ -5263,7 +5268,23 @@ vm_object_page_remove(
 	 *	It balances vm_object_lookup vs iteration.
 	 */
 
-	if (atop_64(end - start) < (unsigned)object->resident_page_count/16) {
+	if (object->memq_radix != NULL) {
+		/*
+		 * the object's pages are indexed by offset, so
+		 * we can visit just the resident ones in the range
+		 */
+		vm_object_page_remove_index++;
+
+		while (start < end &&
+		       (p = vm_page_lookup_next(object, start, end)) != VM_PAGE_NULL) {
+			start = p->offset + PAGE_SIZE_64;
+
+			assert(!p->cleaning && !p->pageout && !p->laundry);
+			if (!p->fictitious && p->pmapped)
+			        pmap_disconnect(p->phys_page);
+			VM_PAGE_FREE(p);
+		}
+	} else if (atop_64(end - start) < (unsigned)object->resident_page_count/16) {
 		vm_object_page_remove_lookup++;
 
 		for (; start < end; start += PAGE_SIZE_64) {
@@ -138,6 +138,10 @@ struct vm_object {
 	} vo_un1;
 
 	struct vm_page		*memq_hint;
+	struct vm_page_radix_node *memq_radix;	/* offset index of resident pages,
+						 * replaces the page hash for
+						 * large objects (see vm_resident.c)
+						 */
 	int			ref_count;	/* Number of references */
 #if	TASK_SWAPPER
 	int			res_count;	/* Residency references (swap)*/
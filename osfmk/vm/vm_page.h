@@ -192,7 +192,9 @@ struct vm_page {
 					 *  the free list (P) */
 			no_cache:1,	/* page is not to be cached and should
 					 * be reused ahead of other pages (P) */
-			__unused_pageq_bits:3;	/* 3 bits available here */
+			premapped:1,	/* entered by fault-around and not yet
+					 * seen by the pageout scan (P) */
+			__unused_pageq_bits:2;	/* 2 bits available here */
 
 	ppnum_t		phys_page;	/* Physical address of page, passed
 					 *  to pmap_enter (read-only) */
@@ -242,7 +244,9 @@ struct vm_page {
 		        lopage:1,
 			slid:1,
 			was_dirty:1,	/* was this page previously dirty? */
-			__unused_object_bits:8;  /* 8 bits available here */
+			zeroed:1,	/* page came from the pre-zeroed
+					 * cache and has not been touched (O) */
+			__unused_object_bits:7;  /* 7 bits available here */
 
 #if __LP64__
 	unsigned int __unused_padding;	/* Pad structure explicitly
@@ -496,6 +500,8 @@ extern void		vm_page_bootstrap(
 					vm_offset_t	*endp) __attribute__((section("__TEXT, initcode")));
 
 extern void		vm_page_module_init(void) __attribute__((section("__TEXT, initcode")));
+
+extern void		vm_page_radix_reserve_init(void) __attribute__((section("__TEXT, initcode")));
 					
 extern void		vm_page_init_local_q(void);
 
@@ -507,6 +513,11 @@ extern vm_page_t	vm_page_lookup(
 					vm_object_t		object,
 					vm_object_offset_t	offset);
 
+extern vm_page_t	vm_page_lookup_next(
+					vm_object_t		object,
+					vm_object_offset_t	offset,
+					vm_object_offset_t	end);
+
 extern vm_page_t	vm_page_grab_fictitious(void);
 
 extern vm_page_t	vm_page_grab_guard(void);
@@ -522,6 +533,10 @@ extern vm_page_t	vm_page_grab(void);
 
 extern vm_page_t	vm_page_grablo(void);
 
+extern vm_page_t	vm_page_grab_zeroed(void);
+
+extern void		vm_page_zero_thread_init(void);
+
 extern void		vm_page_release(
 					vm_page_t	page);
 
@@ -536,6 +551,10 @@ extern vm_page_t	vm_page_alloclo(
 					vm_object_t		object,
 					vm_object_offset_t	offset);
 
+extern vm_page_t	vm_page_alloc_zeroed(
+					vm_object_t		object,
+					vm_object_offset_t	offset);
+
 extern vm_page_t	vm_page_alloc_guard(
 	vm_object_t		object,
 	vm_object_offset_t	offset);
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2013 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ * 
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ *	File:	vm/vm_page_radix.c
+ *
+ *	Each node has 64 slots and a bitmap of the occupied ones.
+ *	Leaves (shift 0) hold the items themselves, so lookups take
+ *	a handful of steps and range walks only visit occupied
+ *	slots.  The root grows upwards as larger indexes are
+ *	inserted, and nodes are freed as soon as they are empty:
+ *	the tree goes away with its last item.
+ *
+ *	The caller serializes all operations on a tree.
+ *	vm_page_radix_node_alloc() must not block, and may fail.
+ */
+
+#ifdef	KERNEL
+#include <mach/mach_types.h>
+#include <kern/assert.h>
+#include <kern/misc_protos.h>
+#else
+#include <assert.h>
+#include <stddef.h>
+#include <strings.h>
+#endif
+
+#include <vm/vm_page_radix.h>
+
+static int
+vm_page_radix_ffs(
+	uint64_t	bits)
+{
+	if ((uint32_t) bits)
+		return (ffs((uint32_t) bits) - 1);
+	return (ffs((uint32_t) (bits >> 32)) + 31);
+}
+
+/*
+ * does a node at this level cover "index"?
+ */
+#define VM_PAGE_RADIX_COVERS(node, index)				\
+	((node)->shift + VM_PAGE_RADIX_SHIFT >= 64 ||			\
+	 ((index) >> ((node)->shift + VM_PAGE_RADIX_SHIFT)) == 0)
+
+/*
+ * the first index under "slot" of a node at this level,
+ * keeping the bits of "index" above the node
+ */
+static uint64_t
+vm_page_radix_slot_index(
+	uint64_t	index,
+	unsigned int	shift,
+	int		slot)
+{
+	index &= ~((1ULL << shift) - 1);
+	index &= ~((uint64_t) VM_PAGE_RADIX_MASK << shift);
+
+	return (index | ((uint64_t) slot << shift));
+}
+
+static struct vm_page_radix_node *
+vm_page_radix_node_get(
+	unsigned int	shift)
+{
+	struct vm_page_radix_node *node;
+
+	if ((node = vm_page_radix_node_alloc()) != NULL) {
+		bzero(node, sizeof (*node));
+		node->shift = shift;
+	}
+	return (node);
+}
+
+void
+vm_page_radix_free_tree(
+	struct vm_page_radix_node *node)
+{
+	uint64_t	bits;
+
+	if (node->shift != 0) {
+		for (bits = node->present; bits; bits &= bits - 1)
+			vm_page_radix_free_tree(node->slots[vm_page_radix_ffs(bits)]);
+	}
+	vm_page_radix_node_free(node);
+}
+
+void *
+vm_page_radix_lookup(
+	struct vm_page_radix_node *node,
+	uint64_t	index)
+{
+	if (node == NULL || !VM_PAGE_RADIX_COVERS(node, index))
+		return (NULL);
+
+	while (node->shift != 0) {
+		node = node->slots[(index >> node->shift) & VM_PAGE_RADIX_MASK];
+		if (node == NULL)
+			return (NULL);
+	}
+	return (node->slots[index & VM_PAGE_RADIX_MASK]);
+}
+
+/*
+ * on failure, the tree may be left with empty nodes...
+ * the caller is expected to free it
+ */
+kern_return_t
+vm_page_radix_insert(
+	struct vm_page_radix_node **rootp,
+	uint64_t	index,
+	void		*item)
+{
+	struct vm_page_radix_node *node, *child;
+	int		slot;
+
+	if ((node = *rootp) == NULL) {
+		if ((node = vm_page_radix_node_get(0)) == NULL)
+			return (KERN_RESOURCE_SHORTAGE);
+		*rootp = node;
+	}
+	/*
+	 * grow the tree until its root covers this index
+	 */
+	while (!VM_PAGE_RADIX_COVERS(node, index)) {
+		if (node->present == 0) {
+			node->shift += VM_PAGE_RADIX_SHIFT;
+			continue;
+		}
+		if ((child = vm_page_radix_node_get(node->shift + VM_PAGE_RADIX_SHIFT)) == NULL)
+			return (KERN_RESOURCE_SHORTAGE);
+		child->slots[0] = node;
+		child->present = 1;
+		*rootp = node = child;
+	}
+	while (node->shift != 0) {
+		slot = (index >> node->shift) & VM_PAGE_RADIX_MASK;
+
+		if ((child = node->slots[slot]) == NULL) {
+			if ((child = vm_page_radix_node_get(node->shift - VM_PAGE_RADIX_SHIFT)) == NULL)
+				return (KERN_RESOURCE_SHORTAGE);
+			node->slots[slot] = child;
+			node->present |= (1ULL << slot);
+		}
+		node = child;
+	}
+	slot = index & VM_PAGE_RADIX_MASK;
+
+	assert(node->slots[slot] == NULL);
+	node->slots[slot] = item;
+	node->present |= (1ULL << slot);
+
+	return (KERN_SUCCESS);
+}
+
+void
+vm_page_radix_remove(
+	struct vm_page_radix_node **rootp,
+	uint64_t	index,
+	void		*item)
+{
+	struct vm_page_radix_node *path[VM_PAGE_RADIX_MAX_DEPTH];
+	struct vm_page_radix_node *node = *rootp;
+	struct vm_page_radix_node *child;
+	int		depth = 0;
+	int		slot;
+
+	assert(node != NULL && VM_PAGE_RADIX_COVERS(node, index));
+
+	while (node->shift != 0) {
+		path[depth++] = node;
+		node = node->slots[(index >> node->shift) & VM_PAGE_RADIX_MASK];
+		assert(node != NULL);
+	}
+	slot = index & VM_PAGE_RADIX_MASK;
+
+	assert(node->slots[slot] == item);
+	node->slots[slot] = NULL;
+	node->present &= ~(1ULL << slot);
+
+	/*
+	 * free the nodes this left empty...
+	 * the tree goes away with the last item
+	 */
+	while (node->present == 0) {
+		if (depth == 0) {
+			*rootp = NULL;
+			vm_page_radix_node_free(node);
+			break;
+		}
+		child = node;
+		node = path[--depth];
+		slot = (index >> node->shift) & VM_PAGE_RADIX_MASK;
+
+		node->slots[slot] = NULL;
+		node->present &= ~(1ULL << slot);
+		vm_page_radix_node_free(child);
+	}
+}
+
+/*
+ * the item with the lowest index in ["index", "last"]
+ */
+void *
+vm_page_radix_next(
+	struct vm_page_radix_node *root,
+	uint64_t	index,
+	uint64_t	last)
+{
+	struct vm_page_radix_node *path[VM_PAGE_RADIX_MAX_DEPTH];
+	struct vm_page_radix_node *node = root;
+	uint64_t	bits;
+	int		depth = 0;
+	int		slot;
+
+	if (node == NULL || index > last || !VM_PAGE_RADIX_COVERS(node, index))
+		return (NULL);
+
+	for (;;) {
+		slot = (index >> node->shift) & VM_PAGE_RADIX_MASK;
+		bits = node->present & (~0ULL << slot);
+
+		while (bits == 0) {
+			/*
+			 * nothing at or after "index" under this node...
+			 * climb to the nearest ancestor with an occupied
+			 * slot after the one we came from.  "index" only
+			 * moves once we've found it.
+			 */
+			if (depth == 0)
+				return (NULL);
+			node = path[--depth];
+			slot = (index >> node->shift) & VM_PAGE_RADIX_MASK;
+
+			if (slot == VM_PAGE_RADIX_MASK)
+				bits = 0;
+			else
+				bits = node->present & (~0ULL << (slot + 1));
+		}
+		if (vm_page_radix_ffs(bits) != slot) {
+			slot = vm_page_radix_ffs(bits);
+			index = vm_page_radix_slot_index(index, node->shift, slot);
+
+			if (index > last)
+				return (NULL);
+		}
+		if (node->shift == 0)
+			return (node->slots[slot]);
+
+		path[depth++] = node;
+		node = node->slots[slot];
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2013 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ * 
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ *	File:	vm/vm_page_radix.h
+ *
+ *	Radix tree indexing an object's resident pages by page
+ *	index (see vm_resident.c).  The tree code itself knows
+ *	nothing about objects or pages and also builds outside
+ *	the kernel, for tools/tests/vm_page_radix.
+ */
+
+#ifndef	_VM_VM_PAGE_RADIX_H_
+#define _VM_VM_PAGE_RADIX_H_
+
+#ifdef	KERNEL
+#include <mach/mach_types.h>
+#else
+#include <stdint.h>
+#include <mach/kern_return.h>
+#endif
+
+#define VM_PAGE_RADIX_SHIFT	6
+#define VM_PAGE_RADIX_SLOTS	(1 << VM_PAGE_RADIX_SHIFT)
+#define VM_PAGE_RADIX_MASK	(VM_PAGE_RADIX_SLOTS - 1)
+#define VM_PAGE_RADIX_MAX_DEPTH	((64 + VM_PAGE_RADIX_SHIFT - 1) / VM_PAGE_RADIX_SHIFT)
+
+struct vm_page_radix_node {
+	uint64_t	present;	/* bitmap of non-empty slots */
+	unsigned int	shift;		/* page index bits below this level */
+	void		*slots[VM_PAGE_RADIX_SLOTS];	/* nodes, or pages at shift 0 */
+};
+
+extern void		*vm_page_radix_lookup(
+					struct vm_page_radix_node *root,
+					uint64_t	index);
+
+extern kern_return_t	vm_page_radix_insert(
+					struct vm_page_radix_node **rootp,
+					uint64_t	index,
+					void		*item);
+
+extern void		vm_page_radix_remove(
+					struct vm_page_radix_node **rootp,
+					uint64_t	index,
+					void		*item);
+
+extern void		*vm_page_radix_next(
+					struct vm_page_radix_node *root,
+					uint64_t	index,
+					uint64_t	last);
+
+extern void		vm_page_radix_free_tree(
+					struct vm_page_radix_node *root);
+
+/*
+ * Node memory, supplied by the user of the tree
+ */
+extern struct vm_page_radix_node *vm_page_radix_node_alloc(void);
+
+extern void		vm_page_radix_node_free(
+					struct vm_page_radix_node *node);
+
+#endif	/* _VM_VM_PAGE_RADIX_H_ */
@@ -91,9 +91,13 @@
 #include <kern/xpr.h>
 #include <kern/kalloc.h>
 
+#include <ipc/ipc_kmsg.h>
+
 #include <machine/vm_tuning.h>
 #include <machine/commpage.h>
 
+#include <pexpert/pexpert.h>
+
 #include <vm/pmap.h>
 #include <vm/vm_fault.h>
 #include <vm/vm_map.h>
@@ -280,13 +284,20 @@ static void vm_pageout_garbage_collect(int);
 static void vm_pageout_iothread_continue(struct vm_pageout_queue *);
 static void vm_pageout_iothread_external(void);
 static void vm_pageout_iothread_internal(void);
+static int vm_pageout_iothread_requeue(struct vm_pageout_queue *, vm_object_t, vm_object_offset_t, int, int);
 static void vm_pageout_adjust_io_throttles(struct vm_pageout_queue *, struct vm_pageout_queue *, boolean_t);
 
 extern void vm_pageout_continue(void);
 extern void vm_pageout_scan(void);
 
-static thread_t	vm_pageout_external_iothread = THREAD_NULL;
-static thread_t	vm_pageout_internal_iothread = THREAD_NULL;
+/*
+ * I/O threads started per pageout queue; 0 at boot means size it from
+ * the processor count.  Pages at consecutive offsets of the same object
+ * found together on a pageout queue are handed to the pager in a
+ * single request of at most vm_pageout_cluster_pages pages.
+ */
+unsigned int vm_pageout_iothreads = 0;
+unsigned int vm_pageout_cluster_pages = 16;
 
 unsigned int vm_pageout_reserved_internal = 0;
 unsigned int vm_pageout_reserved_really = 0;
@@ -321,6 +332,8 @@ unsigned int vm_pageout_inactive_error = 0;	/* debugging */
 unsigned int vm_pageout_inactive_absent = 0;	/* debugging */
 unsigned int vm_pageout_inactive_notalive = 0;	/* debugging */
 unsigned int vm_pageout_inactive_used = 0;	/* debugging */
+unsigned int vm_fault_around_used = 0;		/* debugging */
+unsigned int vm_fault_around_wasted = 0;	/* debugging */
 unsigned int vm_pageout_cache_evicted = 0;	/* debugging */
 unsigned int vm_pageout_inactive_clean = 0;	/* debugging */
 unsigned int vm_pageout_speculative_clean = 0;	/* debugging */
@@ -400,6 +413,9 @@ boolean_t vm_pages_encrypted = FALSE; /* are there encrypted pages ? */
 struct	vm_pageout_queue vm_pageout_queue_internal;
 struct	vm_pageout_queue vm_pageout_queue_external;
 
+struct	vm_pageout_queue_stats vm_pageout_stats_internal;
+struct	vm_pageout_queue_stats vm_pageout_stats_external;
+
 unsigned int vm_page_speculative_target = 0;
 
 vm_object_t 	vm_pageout_scan_wants_object = VM_OBJECT_NULL;
@@ -866,9 +882,9 @@ vm_pageout_cluster(vm_page_t m, boolean_t pageout)
 	m->pageout_queue = TRUE;
 	queue_enter(&q->pgo_pending, m, vm_page_t, pageq);
 	
-	if (q->pgo_idle == TRUE) {
-	        q->pgo_idle = FALSE;
-	        thread_wakeup((event_t) &q->pgo_pending);
+	if (q->pgo_idle_threads != 0) {
+	        q->pgo_idle_threads--;
+	        thread_wakeup_one((event_t) &q->pgo_pending);
 	}
 
 	VM_PAGE_CHECK(m);
@@ -2212,6 +2228,18 @@ consider_inactive_page:
 				SET_PAGE_DIRTY(m, FALSE);
 			}
 		}
+		if (m->premapped) {
+			/*
+			 * mapped ahead of use by vm_fault_around()...
+			 * account for whether the mapping paid off
+			 */
+			m->premapped = FALSE;
+
+			if (m->reference)
+				vm_fault_around_used++;
+			else
+				vm_fault_around_wasted++;
+		}
 		
 		/*
 		 *   if (m->cleaning)
@@ -2698,17 +2726,64 @@ int fake_deadlock = 0;
 
 #endif
 
+/*
+ * Put the pages at offset + [first, count) pages that were pulled off
+ * the pageout queue as part of a cluster back at the head of the queue,
+ * if they are still waiting to be laundered, or give back the
+ * activity_in_progress reference they held if someone else has since
+ * taken them over.  Returns the number of pages requeued.
+ *
+ * The object must be locked.
+ */
+static int
+vm_pageout_iothread_requeue(
+	struct vm_pageout_queue	*q,
+	vm_object_t		object,
+	vm_object_offset_t	offset,
+	int			first,
+	int			count)
+{
+	vm_page_t	m;
+	int		i;
+	int		requeued = 0;
+
+	if (first >= count)
+		return (0);
+
+	vm_page_lockspin_queues();
+
+	for (i = count - 1; i >= first; i--) {
+		m = vm_page_lookup(object, offset + ptoa_64(i));
+
+		if (m == NULL ||
+		    m->busy || m->cleaning || m->pageout_queue || !m->laundry) {
+			vm_object_activity_end(object);
+			continue;
+		}
+		m->pageout_queue = TRUE;
+		queue_enter_first(&q->pgo_pending, m, vm_page_t, pageq);
+		requeued++;
+	}
+	vm_page_unlock_queues();
+
+	return (requeued);
+}
+
 static void
 vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 {
 	vm_page_t	m = NULL;
+	vm_page_t	buddy;
 	vm_object_t	object;
 	vm_object_offset_t offset;
 	memory_object_t	pager;
 	thread_t	self = current_thread();
+	int		cluster_pages;
+	int		run_pages;
+	uint64_t	io_start, io_ns;
 
-	if ((vm_pageout_internal_iothread != THREAD_NULL)
-	    && (self == vm_pageout_external_iothread )
+	if ((q == &vm_pageout_queue_external)
+	    && (vm_pageout_queue_internal.pgo_nthreads != 0)
 	    && (self->options & TH_OPT_VMPRIV))
 		self->options &= ~TH_OPT_VMPRIV;
 
@@ -2716,7 +2791,6 @@ vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 
         while ( !queue_empty(&q->pgo_pending) ) {
 
-		   q->pgo_busy = TRUE;
 		   queue_remove_first(&q->pgo_pending, m, vm_page_t, pageq);
 		   if (m->object == slide_info.slide_object) {
 			   panic("slid page %p not allowed on this path\n", m);
@@ -2738,6 +2812,32 @@ vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 		   object = m->object;
 		   offset = m->offset;
 
+		   /*
+		    * pull the pages queued right behind this one along
+		    * with it if they continue it in the same object, so
+		    * that the pager sees them in a single request and
+		    * no other iothread starts on them... each of them
+		    * holds its own activity_in_progress on the object
+		    */
+		   cluster_pages = 1;
+
+		   while (cluster_pages < (int)vm_pageout_cluster_pages &&
+			  cluster_pages < MAX_UPL_TRANSFER &&
+			  !queue_empty(&q->pgo_pending)) {
+
+			   buddy = (vm_page_t) queue_first(&q->pgo_pending);
+
+			   if (buddy->object != object ||
+			       buddy->offset != offset + ptoa_64(cluster_pages))
+				   break;
+
+			   queue_remove_first(&q->pgo_pending, buddy, vm_page_t, pageq);
+			   buddy->pageout_queue = FALSE;
+			   buddy->pageq.next = NULL;
+			   buddy->pageq.prev = NULL;
+
+			   cluster_pages++;
+		   }
 		   vm_page_unlock_queues();
 
 #ifdef FAKE_DEADLOCK
@@ -2774,6 +2874,7 @@ vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 			    * we merely need to release the activity_in_progress
 			    * we took when we put the page on the pageout queue
 			    */
+			   vm_pageout_iothread_requeue(q, object, offset, 1, cluster_pages);
 			   vm_object_activity_end(object);
 			   vm_object_unlock(object);
 
@@ -2814,6 +2915,7 @@ vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 				   /*
 				    *	And we are done with it.
 				    */
+				   vm_pageout_iothread_requeue(q, object, offset, 1, cluster_pages);
 			           vm_object_activity_end(object);
 				   vm_object_unlock(object);
 
@@ -2848,6 +2950,7 @@ vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 				    *	And we are done with it.
 				    */
 			   }
+			   vm_pageout_iothread_requeue(q, object, offset, 1, cluster_pages);
 			   vm_object_activity_end(object);
 			   vm_object_unlock(object);
 
@@ -2861,12 +2964,28 @@ vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 		    */
 		   VM_PAGE_CHECK(m);
 #endif
+		   /*
+		    * the cluster runs for as long as the pages we pulled
+		    * in behind this one are still waiting to be laundered...
+		    * the rest go back on the pageout queue
+		    */
+		   for (run_pages = 1; run_pages < cluster_pages; run_pages++) {
+			   buddy = vm_page_lookup(object, offset + ptoa_64(run_pages));
+
+			   if (buddy == NULL ||
+			       buddy->busy || buddy->cleaning || buddy->pageout_queue || !buddy->laundry)
+				   break;
+		   }
+		   vm_pageout_iothread_requeue(q, object, offset, run_pages, cluster_pages);
+
 		   /*
 		    * give back the activity_in_progress reference we
 		    * took when we queued up this page and replace it
 		    * it with a paging_in_progress reference that will
                     * also hold the paging offset from changing and
-                    * prevent the object from terminating
+                    * prevent the object from terminating... the rest
+		    * of the run keeps its references until we know
+		    * whether the pager took those pages
 		    */
 		   vm_object_activity_end(object);
 		   vm_object_paging_begin(object);
@@ -2874,27 +2993,44 @@ vm_pageout_iothread_continue(struct vm_pageout_queue *q)
 
                    /*
 		    * Send the data to the pager.
-		    * any pageout clustering happens there
+		    * any further pageout clustering happens there
 		    */
+		   io_start = mach_absolute_time();
+
 		   memory_object_data_return(pager,
-					     m->offset + object->paging_offset,
-					     PAGE_SIZE,
+					     offset + object->paging_offset,
+					     (memory_object_cluster_size_t) (run_pages * PAGE_SIZE),
 					     NULL,
 					     NULL,
 					     FALSE,
 					     FALSE,
 					     0);
 
+		   absolutetime_to_nanoseconds(mach_absolute_time() - io_start, &io_ns);
+
 		   vm_object_lock(object);
+		   /*
+		    * the pager is free to write a different window than
+		    * the one we asked for (the vnode pager clusters around
+		    * the first page on its own)... any page of the run it
+		    * left behind is still in the laundry but on no queue,
+		    * so put it back on the pageout queue
+		    */
+		   run_pages -= vm_pageout_iothread_requeue(q, object, offset, 1, run_pages);
 		   vm_object_paging_end(object);
 		   vm_object_unlock(object);
 
 		   vm_pageout_io_throttle();
 
 		   vm_page_lockspin_queues();
+
+		   q->pgo_stats->requests++;
+		   q->pgo_stats->pages += run_pages;
+		   q->pgo_stats->io_ns += io_ns;
+		   if (io_ns > q->pgo_stats->io_max_ns)
+			   q->pgo_stats->io_max_ns = io_ns;
 	}
-	q->pgo_busy = FALSE;
-	q->pgo_idle = TRUE;
+	q->pgo_idle_threads++;
 
 	assert_wait((event_t) q, THREAD_UNINT);
 	vm_page_unlock_queues();
@@ -2911,6 +3047,7 @@ vm_pageout_adjust_io_throttles(struct vm_pageout_queue *iq, struct vm_pageout_qu
 	uint32_t 	policy;
 	boolean_t	set_iq = FALSE;
 	boolean_t	set_eq = FALSE;
+	unsigned int	i;
 	
 	if (hibernate_cleaning_in_progress == TRUE)
 		req_lowpriority = FALSE;
@@ -2933,11 +3070,13 @@ vm_pageout_adjust_io_throttles(struct vm_pageout_queue *iq, struct vm_pageout_qu
 			DTRACE_VM(laundryunthrottle);
 		}
 		if (set_iq == TRUE) {
-			proc_apply_thread_diskacc(kernel_task, iq->pgo_tid, policy);
+			for (i = 0; i < iq->pgo_nthreads; i++)
+				proc_apply_thread_diskacc(kernel_task, iq->pgo_tid[i], policy);
 			iq->pgo_lowpriority = req_lowpriority;
 		}
 		if (set_eq == TRUE) {
-			proc_apply_thread_diskacc(kernel_task, eq->pgo_tid, policy);
+			for (i = 0; i < eq->pgo_nthreads; i++)
+				proc_apply_thread_diskacc(kernel_task, eq->pgo_tid[i], policy);
 			eq->pgo_lowpriority = req_lowpriority;
 		}
 		vm_page_lock_queues();
@@ -2957,7 +3096,7 @@ vm_pageout_iothread_external(void)
 
 	vm_page_lock_queues();
 
-	vm_pageout_queue_external.pgo_tid = self->thread_id;
+	vm_pageout_queue_external.pgo_tid[vm_pageout_queue_external.pgo_nthreads++] = self->thread_id;
 	vm_pageout_queue_external.pgo_lowpriority = TRUE;
 	vm_pageout_queue_external.pgo_inited = TRUE;
 
@@ -2980,7 +3119,7 @@ vm_pageout_iothread_internal(void)
 
 	vm_page_lock_queues();
 
-	vm_pageout_queue_internal.pgo_tid = self->thread_id;
+	vm_pageout_queue_internal.pgo_tid[vm_pageout_queue_internal.pgo_nthreads++] = self->thread_id;
 	vm_pageout_queue_internal.pgo_lowpriority = TRUE;
 	vm_pageout_queue_internal.pgo_inited = TRUE;
 
@@ -3043,6 +3182,8 @@ vm_pageout_garbage_collect(int collect)
 
 		stack_collect();
 
+		ipc_kmsg_cache_collect();
+
 		consider_machine_collect();
 
 		do {
@@ -3076,6 +3217,7 @@ vm_pageout(void)
 	thread_t	self = current_thread();
 	thread_t	thread;
 	kern_return_t	result;
+	unsigned int	i;
 	spl_t		s;
 
 	/*
@@ -3146,36 +3288,52 @@ vm_pageout(void)
 	queue_init(&vm_pageout_queue_external.pgo_pending);
 	vm_pageout_queue_external.pgo_maxlaundry = VM_PAGE_LAUNDRY_MAX;
 	vm_pageout_queue_external.pgo_laundry = 0;
-	vm_pageout_queue_external.pgo_idle = FALSE;
-	vm_pageout_queue_external.pgo_busy = FALSE;
+	vm_pageout_queue_external.pgo_nthreads = 0;
+	vm_pageout_queue_external.pgo_idle_threads = 0;
 	vm_pageout_queue_external.pgo_throttled = FALSE;
 	vm_pageout_queue_external.pgo_draining = FALSE;
 	vm_pageout_queue_external.pgo_lowpriority = FALSE;
-	vm_pageout_queue_external.pgo_tid = -1;
+	vm_pageout_queue_external.pgo_stats = &vm_pageout_stats_external;
 	vm_pageout_queue_external.pgo_inited = FALSE;
 
 
 	queue_init(&vm_pageout_queue_internal.pgo_pending);
 	vm_pageout_queue_internal.pgo_maxlaundry = 0;
 	vm_pageout_queue_internal.pgo_laundry = 0;
-	vm_pageout_queue_internal.pgo_idle = FALSE;
-	vm_pageout_queue_internal.pgo_busy = FALSE;
+	vm_pageout_queue_internal.pgo_nthreads = 0;
+	vm_pageout_queue_internal.pgo_idle_threads = 0;
 	vm_pageout_queue_internal.pgo_throttled = FALSE;
 	vm_pageout_queue_internal.pgo_draining = FALSE;
 	vm_pageout_queue_internal.pgo_lowpriority = FALSE;
-	vm_pageout_queue_internal.pgo_tid = -1;
+	vm_pageout_queue_internal.pgo_stats = &vm_pageout_stats_internal;
 	vm_pageout_queue_internal.pgo_inited = FALSE;
 
-	/* internal pageout thread started when default pager registered first time */
+	/*
+	 * each pageout queue gets a thread per 4 processors, so that
+	 * write-back isn't limited to what one thread can push through
+	 * the pager, but the iothreads don't crowd out everyone else
+	 */
+	if (vm_pageout_iothreads == 0 &&
+	    !PE_parse_boot_argn("vm_pageout_iothreads", &vm_pageout_iothreads, sizeof (vm_pageout_iothreads)))
+		vm_pageout_iothreads = (processor_count + 3) / 4;
+
+	if (vm_pageout_iothreads == 0)
+		vm_pageout_iothreads = 1;
+	else if (vm_pageout_iothreads > VM_PAGEOUT_IOTHREAD_MAX)
+		vm_pageout_iothreads = VM_PAGEOUT_IOTHREAD_MAX;
+
+	/* internal pageout threads started when default pager registered first time */
 	/* external pageout and garbage collection threads started here */
 
-	result = kernel_thread_start_priority((thread_continue_t)vm_pageout_iothread_external, NULL, 
-					      BASEPRI_PREEMPT - 1, 
-					      &vm_pageout_external_iothread);
-	if (result != KERN_SUCCESS)
-		panic("vm_pageout_iothread_external: create failed");
+	for (i = 0; i < vm_pageout_iothreads; i++) {
+		result = kernel_thread_start_priority((thread_continue_t)vm_pageout_iothread_external, NULL, 
+						      BASEPRI_PREEMPT - 1, 
+						      &thread);
+		if (result != KERN_SUCCESS)
+			panic("vm_pageout_iothread_external: create failed");
 
-	thread_deallocate(vm_pageout_external_iothread);
+		thread_deallocate(thread);
+	}
 
 	result = kernel_thread_start_priority((thread_continue_t)vm_pageout_garbage_collect, NULL,
 					      BASEPRI_DEFAULT, 
@@ -3194,6 +3352,8 @@ vm_pageout(void)
 
 	thread_deallocate(thread);
 
+	vm_page_zero_thread_init();
+
 	vm_object_reaper_init();
 
 
@@ -3226,12 +3386,25 @@ vm_pageout(void)
 kern_return_t
 vm_pageout_internal_start(void)
 {
-	kern_return_t result;
+	kern_return_t result = KERN_SUCCESS;
+	thread_t	thread;
+	unsigned int	i;
 
 	vm_pageout_queue_internal.pgo_maxlaundry = VM_PAGE_LAUNDRY_MAX;
-	result = kernel_thread_start_priority((thread_continue_t)vm_pageout_iothread_internal, NULL, BASEPRI_PREEMPT - 1, &vm_pageout_internal_iothread);
-	if (result == KERN_SUCCESS)
-		thread_deallocate(vm_pageout_internal_iothread);
+
+	for (i = 0; i < vm_pageout_iothreads; i++) {
+		result = kernel_thread_start_priority((thread_continue_t)vm_pageout_iothread_internal, NULL, BASEPRI_PREEMPT - 1, &thread);
+		if (result != KERN_SUCCESS)
+			break;
+		thread_deallocate(thread);
+	}
+	/*
+	 * run short handed rather than fail... the caller
+	 * only starts us again if no thread was created
+	 */
+	if (i != 0)
+		result = KERN_SUCCESS;
+
 	return result;
 }
 
@@ -176,16 +176,19 @@ extern unsigned int	vm_page_anonymous_count;
  * must hold the page queues lock to
  * manipulate this structure
  */
+#define VM_PAGEOUT_IOTHREAD_MAX		8	/* I/O threads per pageout queue */
+
 struct vm_pageout_queue {
-        queue_head_t	pgo_pending;	/* laundry pages to be processed by pager's iothread */
+        queue_head_t	pgo_pending;	/* laundry pages to be processed by pager's iothreads */
         unsigned int	pgo_laundry;	/* current count of laundry pages on queue or in flight */
         unsigned int	pgo_maxlaundry;
-	uint64_t	pgo_tid;	/* thread ID of I/O thread that services this queue */
-	uint8_t		pgo_lowpriority; /* iothread is set to use low priority I/O */
+        unsigned int	pgo_nthreads;	/* I/O threads that service this queue */
+        unsigned int	pgo_idle_threads; /* iothreads blocked waiting for work to do */
+	uint64_t	pgo_tid[VM_PAGEOUT_IOTHREAD_MAX]; /* thread IDs of those I/O threads */
+	uint8_t		pgo_lowpriority; /* iothreads are set to use low priority I/O */
+	struct vm_pageout_queue_stats *pgo_stats;
 
-        unsigned int	pgo_idle:1,	/* iothread is blocked waiting for work to do */
-	                pgo_busy:1,     /* iothread is currently processing request from pgo_pending */
-			pgo_throttled:1,/* vm_pageout_scan thread needs a wakeup when pgo_laundry drops */
+        unsigned int	pgo_throttled:1,/* vm_pageout_scan thread needs a wakeup when pgo_laundry drops */
 		        pgo_draining:1,
 			pgo_inited:1,
 			:0;
@@ -465,6 +468,19 @@ struct vm_page_stats_reusable {
 	uint64_t	can_reuse_failure;
 };
 extern struct vm_page_stats_reusable vm_page_stats_reusable;
+
+/*
+ * per pageout queue I/O statistics, updated by the
+ * queue's iothreads with the page queues lock held
+ */
+struct vm_pageout_queue_stats {
+	uint64_t	requests;	/* memory_object_data_return calls */
+	uint64_t	pages;		/* pages handed to the pager by those calls */
+	uint64_t	io_ns;		/* total time spent in the pager */
+	uint64_t	io_max_ns;	/* longest single call */
+};
+extern struct vm_pageout_queue_stats vm_pageout_stats_internal;
+extern struct vm_pageout_queue_stats vm_pageout_stats_external;
 	
 extern int hibernate_flush_memory(void);
 
@@ -80,6 +80,7 @@
 #include <vm/vm_init.h>
 #include <vm/vm_map.h>
 #include <vm/vm_page.h>
+#include <vm/vm_page_radix.h>
 #include <vm/vm_pageout.h>
 #include <vm/vm_kern.h>			/* kernel_memory_allocate() */
 #include <kern/misc_protos.h>
@@ -168,6 +169,32 @@ unsigned int	vm_page_bucket_lock_count = 0;		/* How big is array of locks? */
 
 lck_spin_t	*vm_page_bucket_locks;
 
+/*
+ *	Large objects index their resident pages by offset in a
+ *	per-object radix tree instead of the global page hash:
+ *	each node has 64 slots and a bitmap of the occupied ones,
+ *	so lookups take a handful of steps and range walks only
+ *	visit resident pages.  An object gets its index once it
+ *	has "vm_page_radix_threshold" resident pages (0 disables
+ *	this), and loses it with its last resident page or if a
+ *	node can't be allocated, in which case its pages go back
+ *	into the hash.  The index is protected by the object
+ *	lock, like the object's page list.
+ *
+ *	Nodes can't be allocated with a blocking zalloc() here,
+ *	so the zone keeps a reserve that a priority thread refills
+ *	(see vm_page_radix_reserve_init()).  An object that still
+ *	couldn't get its index tries again each time its page
+ *	count doubles, so rebuilding stays linear in its size.
+ */
+zone_t		vm_page_radix_zone;
+unsigned int	vm_page_radix_threshold = 128;
+unsigned int	vm_page_radix_objects = 0;	/* objects with an index */
+unsigned int	vm_page_radix_nodes = 0;	/* nodes allocated */
+unsigned int	vm_page_radix_fallbacks = 0;	/* indexes dropped for lack of nodes */
+
+#define VM_PAGE_RADIX_RESERVE	((4 * PAGE_SIZE) / sizeof (struct vm_page_radix_node))
+
 
 #if	MACH_PAGE_HASH_STATS
 /* This routine is only for debug.  It is intended to be called by
@@ -522,6 +549,7 @@ vm_page_bootstrap(
 	m->gobbled = FALSE;
 	m->private = FALSE;
 	m->throttled = FALSE;
+	m->premapped = FALSE;
 	m->__unused_pageq_bits = 0;
 
 	m->phys_page = 0;		/* reset later */
@@ -582,6 +610,7 @@ vm_page_bootstrap(
 		queue_init(&vm_page_queue_free[i]);
 
 	queue_init(&vm_lopage_queue_free);
+	queue_init(&vm_page_queue_zeroed);
 	queue_init(&vm_page_queue_active);
 	queue_init(&vm_page_queue_inactive);
 	queue_init(&vm_page_queue_cleaned);
@@ -939,6 +968,27 @@ vm_page_module_init(void)
         vm_page_zone->count += vm_page_pages;
         vm_page_zone->sum_count += vm_page_pages;
         vm_page_zone->cur_size += vm_page_pages * vm_page_zone->elem_size;
+
+	PE_parse_boot_argn("vm_page_radix", &vm_page_radix_threshold,
+			   sizeof (vm_page_radix_threshold));
+
+	vm_page_radix_zone = zinit((vm_size_t) sizeof(struct vm_page_radix_node),
+				   0, PAGE_SIZE, "vm page radix nodes");
+	zone_change(vm_page_radix_zone, Z_CALLERACCT, FALSE);
+	zone_change(vm_page_radix_zone, Z_NOENCRYPT, TRUE);
+}
+
+/*
+ *	vm_page_radix_reserve_init:
+ *
+ *	Start refilling the radix node zone from a priority thread,
+ *	so that the non-blocking allocations of the page index
+ *	normally find a node.  Called once threads can be created.
+ */
+void
+vm_page_radix_reserve_init(void)
+{
+	zone_prio_refill_configure(vm_page_radix_zone, VM_PAGE_RADIX_RESERVE);
 }
 
 /*
@@ -985,6 +1035,165 @@ vm_page_create(
 	 & vm_page_hash_mask)
 
 
+static void
+vm_page_hash_insert(
+	vm_page_t	mem)
+{
+	vm_page_bucket_t *bucket;
+	lck_spin_t	*bucket_lock;
+	int		hash_id;
+
+	hash_id = vm_page_hash(mem->object, mem->offset);
+	bucket = &vm_page_buckets[hash_id];
+	bucket_lock = &vm_page_bucket_locks[hash_id / BUCKETS_PER_LOCK];
+	
+	lck_spin_lock(bucket_lock);
+
+	mem->next = bucket->pages;
+	bucket->pages = mem;
+#if     MACH_PAGE_HASH_STATS
+	if (++bucket->cur_count > bucket->hi_count)
+		bucket->hi_count = bucket->cur_count;
+#endif /* MACH_PAGE_HASH_STATS */
+
+	lck_spin_unlock(bucket_lock);
+}
+
+static void
+vm_page_hash_remove(
+	vm_page_t	mem)
+{
+	vm_page_bucket_t *bucket;
+	vm_page_t	this;
+	lck_spin_t	*bucket_lock;
+	int		hash_id;
+
+	hash_id = vm_page_hash(mem->object, mem->offset);
+	bucket = &vm_page_buckets[hash_id];
+	bucket_lock = &vm_page_bucket_locks[hash_id / BUCKETS_PER_LOCK];
+
+	lck_spin_lock(bucket_lock);
+
+	if ((this = bucket->pages) == mem) {
+		/* optimize for common case */
+
+		bucket->pages = mem->next;
+	} else {
+		vm_page_t	*prev;
+
+		for (prev = &this->next;
+		     (this = *prev) != mem;
+		     prev = &this->next)
+			continue;
+		*prev = this->next;
+	}
+#if     MACH_PAGE_HASH_STATS
+	bucket->cur_count--;
+#endif /* MACH_PAGE_HASH_STATS */
+
+	lck_spin_unlock(bucket_lock);
+}
+
+
+/*
+ *	vm_page_radix_*:
+ *
+ *	The per-object page index (vm/vm_page_radix.c), keyed by
+ *	atop(offset).  The object must be locked, exclusively to
+ *	modify the index.  Nodes are allocated without blocking,
+ *	from the zone's reserve if need be, since we may be
+ *	holding the page queues lock as a spin lock.
+ */
+struct vm_page_radix_node *
+vm_page_radix_node_alloc(void)
+{
+	struct vm_page_radix_node *node;
+
+	node = (struct vm_page_radix_node *) zalloc_noblock(vm_page_radix_zone);
+
+	if (node != NULL)
+		OSAddAtomic(1, &vm_page_radix_nodes);
+	return (node);
+}
+
+void
+vm_page_radix_node_free(
+	struct vm_page_radix_node *node)
+{
+	zfree(vm_page_radix_zone, node);
+	OSAddAtomic(-1, &vm_page_radix_nodes);
+}
+
+/*
+ * move all of an object's pages from its index back into the hash
+ */
+static void
+vm_page_radix_disable(
+	vm_object_t	object)
+{
+	vm_page_t	m;
+
+	queue_iterate(&object->memq, m, vm_page_t, listq) {
+		vm_page_hash_insert(m);
+	}
+	vm_page_radix_free_tree(object->memq_radix);
+	object->memq_radix = NULL;
+
+	OSAddAtomic(-1, &vm_page_radix_objects);
+	vm_page_radix_fallbacks++;
+}
+
+/*
+ * should an object without an index try to get one now?
+ * at "threshold" pages, then each time the count doubles
+ */
+static boolean_t
+vm_page_radix_due(
+	vm_object_t	object)
+{
+	unsigned int	steps;
+
+	if (vm_page_radix_threshold == 0 ||
+	    (object->resident_page_count % vm_page_radix_threshold) != 0)
+		return (FALSE);
+	steps = object->resident_page_count / vm_page_radix_threshold;
+
+	return ((steps & (steps - 1)) == 0);
+}
+
+/*
+ * move all of an object's pages from the hash into a new index
+ */
+static void
+vm_page_radix_enable(
+	vm_object_t	object)
+{
+	vm_page_t	m;
+
+	assert(object->memq_radix == NULL);
+
+	queue_iterate(&object->memq, m, vm_page_t, listq) {
+		if (vm_page_radix_insert(&object->memq_radix,
+					 atop_64(m->offset), m) != KERN_SUCCESS) {
+			/*
+			 * the pages are all still hashed...
+			 * just drop what we've built so far
+			 */
+			if (object->memq_radix != NULL) {
+				vm_page_radix_free_tree(object->memq_radix);
+				object->memq_radix = NULL;
+			}
+			vm_page_radix_fallbacks++;
+			return;
+		}
+	}
+	queue_iterate(&object->memq, m, vm_page_t, listq) {
+		vm_page_hash_remove(m);
+	}
+	OSAddAtomic(1, &vm_page_radix_objects);
+}
+
+
 /*
  *	vm_page_insert:		[ internal use only ]
  *
@@ -1011,10 +1220,6 @@ vm_page_insert_internal(
 	boolean_t		insert_in_hash,
 	boolean_t		batch_pmap_op)
 {
-	vm_page_bucket_t *bucket;
-	lck_spin_t	*bucket_lock;
-	int	hash_id;
-
         XPR(XPR_VM_PAGE,
                 "vm_page_insert, object 0x%X offset 0x%X page 0x%X\n",
                 object, offset, mem, 0,0);
@@ -1061,22 +1266,20 @@ vm_page_insert_internal(
 		mem->offset = offset;
 
 		/*
-		 *	Insert it into the object_object/offset hash table
+		 *	Insert it into the object's index if it has one,
+		 *	otherwise into the object/offset hash table
 		 */
-		hash_id = vm_page_hash(object, offset);
-		bucket = &vm_page_buckets[hash_id];
-		bucket_lock = &vm_page_bucket_locks[hash_id / BUCKETS_PER_LOCK];
-	
-		lck_spin_lock(bucket_lock);
-
-		mem->next = bucket->pages;
-		bucket->pages = mem;
-#if     MACH_PAGE_HASH_STATS
-		if (++bucket->cur_count > bucket->hi_count)
-			bucket->hi_count = bucket->cur_count;
-#endif /* MACH_PAGE_HASH_STATS */
-
-		lck_spin_unlock(bucket_lock);
+		if (object->memq_radix != NULL &&
+		    vm_page_radix_insert(&object->memq_radix,
+					 atop_64(offset), mem) != KERN_SUCCESS) {
+			/*
+			 * couldn't grow the index... fall
+			 * back to hashing this object's pages
+			 */
+			vm_page_radix_disable(object);
+		}
+		if (object->memq_radix == NULL)
+			vm_page_hash_insert(mem);
 	}
 
 	{	
@@ -1105,6 +1308,16 @@ vm_page_insert_internal(
 	}
 	assert(object->resident_page_count >= object->wired_page_count);
 
+	if (object->memq_radix == NULL && vm_page_radix_due(object)) {
+		/*
+		 * the object is getting large... index its
+		 * pages by offset rather than hashing them...
+		 * if we can't get the nodes now, we'll try
+		 * again once it has twice as many pages
+		 */
+		vm_page_radix_enable(object);
+	}
+
 	assert(!mem->reusable);
 
 	if (object->purgable == VM_PURGABLE_VOLATILE) {
@@ -1165,6 +1378,18 @@ vm_page_replace(
 		      mem, object, offset, mem->object, mem->offset);
 	lck_mtx_assert(&vm_page_queue_lock, LCK_MTX_ASSERT_NOTOWNED);
 #endif
+	if (object->memq_radix != NULL) {
+		/*
+		 * the object's pages aren't hashed...
+		 * just free any page at this offset first
+		 */
+		found_m = (vm_page_t) vm_page_radix_lookup(object->memq_radix, atop_64(offset));
+		if (found_m != VM_PAGE_NULL)
+			vm_page_free_unlocked(found_m, TRUE);
+
+		vm_page_insert_internal(mem, object, offset, FALSE, TRUE, FALSE);
+		return;
+	}
 	/*
 	 *	Record the object/offset pair in this page
 	 */
@@ -1236,11 +1461,6 @@ vm_page_remove(
 	vm_page_t	mem,
 	boolean_t	remove_from_hash)
 {
-	vm_page_bucket_t *bucket;
-	vm_page_t	this;
-	lck_spin_t	*bucket_lock;
-	int		hash_id;
-
         XPR(XPR_VM_PAGE,
                 "vm_page_remove, object 0x%X offset 0x%X page 0x%X\n",
                 mem->object, mem->offset, 
@@ -1259,32 +1479,16 @@ vm_page_remove(
 #endif
 	if (remove_from_hash == TRUE) {
 		/*
-		 *	Remove from the object_object/offset hash table
+		 *	Remove from the object's index or from
+		 *	the object_object/offset hash table
 		 */
-		hash_id = vm_page_hash(mem->object, mem->offset);
-		bucket = &vm_page_buckets[hash_id];
-		bucket_lock = &vm_page_bucket_locks[hash_id / BUCKETS_PER_LOCK];
-
-		lck_spin_lock(bucket_lock);
-
-		if ((this = bucket->pages) == mem) {
-			/* optimize for common case */
-
-			bucket->pages = mem->next;
-		} else {
-			vm_page_t	*prev;
-
-			for (prev = &this->next;
-			     (this = *prev) != mem;
-			     prev = &this->next)
-				continue;
-			*prev = this->next;
-		}
-#if     MACH_PAGE_HASH_STATS
-		bucket->cur_count--;
-#endif /* MACH_PAGE_HASH_STATS */
-
-		lck_spin_unlock(bucket_lock);
+		if (mem->object->memq_radix != NULL) {
+			vm_page_radix_remove(&mem->object->memq_radix,
+					     atop_64(mem->offset), mem);
+			if (mem->object->memq_radix == NULL)
+				OSAddAtomic(-1, &vm_page_radix_objects);
+		} else
+			vm_page_hash_remove(mem);
 	}
 	/*
 	 *	Now remove from the object's list of backed pages.
@@ -1357,6 +1561,7 @@ unsigned long vm_page_lookup_hint_prev = 0;
 unsigned long vm_page_lookup_hint_miss = 0;
 unsigned long vm_page_lookup_bucket_NULL = 0;
 unsigned long vm_page_lookup_miss = 0;
+unsigned long vm_page_lookup_radix = 0;
 
 
 vm_page_t
@@ -1409,6 +1614,14 @@ vm_page_lookup(
 			}
 		}
 	}
+	if (object->memq_radix != NULL) {
+		/*
+		 * this object's pages are indexed by offset
+		 */
+		vm_page_lookup_radix++;
+		mem = (vm_page_t) vm_page_radix_lookup(object->memq_radix, atop_64(offset));
+		goto done;
+	}
 	/*
 	 * Search the hash table for this object/offset pair
 	 */
@@ -1444,7 +1657,7 @@ vm_page_lookup(
 			break;
 	}
 	lck_spin_unlock(bucket_lock);
-
+done:
 	if (mem != VM_PAGE_NULL) {
 		if (object->memq_hint != VM_PAGE_NULL) {
 			vm_page_lookup_hint_miss++;
@@ -1458,6 +1671,45 @@ vm_page_lookup(
 }
 
 
+/*
+ *	vm_page_lookup_next:
+ *
+ *	Returns the resident page with the lowest offset
+ *	in [offset, end) in the given object, or VM_PAGE_NULL.
+ *	This is meant for walking sparse ranges: it visits
+ *	only resident pages when the object has an index, and
+ *	otherwise scans the object's page list.
+ *
+ *	The object must be locked.  No side effects.
+ */
+vm_page_t
+vm_page_lookup_next(
+	vm_object_t		object,
+	vm_object_offset_t	offset,
+	vm_object_offset_t	end)
+{
+	vm_page_t	m;
+	vm_page_t	found = VM_PAGE_NULL;
+
+	vm_object_lock_assert_held(object);
+
+	if (object->memq_radix != NULL) {
+		if (end <= offset)
+			return (VM_PAGE_NULL);
+		return ((vm_page_t) vm_page_radix_next(object->memq_radix,
+						       atop_64(offset),
+						       atop_64(end - 1)));
+	}
+
+	queue_iterate(&object->memq, m, vm_page_t, listq) {
+		if (m->offset >= offset && m->offset < end &&
+		    (found == VM_PAGE_NULL || m->offset < found->offset))
+			found = m;
+	}
+	return (found);
+}
+
+
 /*
  *	vm_page_rename:
  *
@@ -1725,6 +1977,34 @@ unsigned int	vm_lopages_allocated_cpm_success = 0;
 unsigned int	vm_lopages_allocated_cpm_failed = 0;
 queue_head_t	vm_lopage_queue_free;
 
+
+/*
+ * pre-zeroed page cache...
+ * vm_page_zero_thread runs at the lowest kernel priority, so it only
+ * gets the processor when there is nothing else to do... it pulls pages
+ * off of the free list via vm_page_grab, zeroes them and parks them on
+ * vm_page_queue_zeroed so that zero-fill faults can skip the
+ * pmap_zero_page.  Like the per-cpu free lists, pages in this cache
+ * have already been removed from vm_page_free_count (busy, !free), and
+ * the cache is handed back to the free list as soon as the free count
+ * drops below vm_page_free_min.  The queue and its counters are
+ * protected by the vm_page_queue_free_lock.
+ */
+#define VM_PAGE_ZEROED_TARGET	256	/* default depth of the cache */
+#define VM_PAGE_ZEROED_SLACK	64	/* stay this far above free_target */
+#define VM_PAGE_ZEROED_MSECS	100	/* refill check interval */
+
+queue_head_t	vm_page_queue_zeroed;
+unsigned int	vm_page_zeroed_count = 0;
+unsigned int	vm_page_zeroed_target = VM_PAGE_ZEROED_TARGET;
+unsigned int	vm_page_zeroed_hits = 0;
+unsigned int	vm_page_zeroed_misses = 0;
+unsigned int	vm_page_zeroed_filled = 0;
+unsigned int	vm_page_zeroed_drained = 0;
+
+static void	vm_page_zeroed_drain(void);
+static void	vm_page_zero_thread(void);
+
 vm_page_t
 vm_page_grablo(void)
 {
@@ -1986,6 +2266,13 @@ return_page_from_cpu_list:
 	      ((vm_page_inactive_count + vm_page_speculative_count) < vm_page_inactive_min)))
 	         thread_wakeup((event_t) &vm_page_free_wanted);
 
+	/*
+	 * the pre-zeroed cache is a luxury... give it back
+	 * before we start pushing on the pageout daemon
+	 */
+	if (vm_page_zeroed_count && vm_page_free_count < vm_page_free_min)
+		vm_page_zeroed_drain();
+
 	VM_CHECK_MEMORYSTATUS;
 	
 //	dbgLog(mem->phys_page, vm_page_free_count, vm_page_wire_count, 4);	/* (TEST/DEBUG) */
@@ -2098,6 +2385,171 @@ vm_page_release(
 	VM_CHECK_MEMORYSTATUS;
 }
 
+/*
+ *	vm_page_grab_zeroed:
+ *
+ *	Like vm_page_grab, but prefer a page from the
+ *	pre-zeroed cache.  Pages that come from the cache
+ *	are marked "zeroed" so that vm_page_zero_fill
+ *	can skip clearing them.  Only used for pages that
+ *	are about to be zero-filled.
+ */
+vm_page_t
+vm_page_grab_zeroed(void)
+{
+	vm_page_t	mem;
+
+	if (vm_page_zeroed_count == 0) {
+		vm_page_zeroed_misses++;
+		return (vm_page_grab());
+	}
+	lck_mtx_lock_spin(&vm_page_queue_free_lock);
+
+	if (queue_empty(&vm_page_queue_zeroed)) {
+		vm_page_zeroed_misses++;
+		lck_mtx_unlock(&vm_page_queue_free_lock);
+
+		return (vm_page_grab());
+	}
+	queue_remove_first(&vm_page_queue_zeroed,
+			   mem,
+			   vm_page_t,
+			   pageq);
+	vm_page_zeroed_count--;
+	vm_page_zeroed_hits++;
+
+	lck_mtx_unlock(&vm_page_queue_free_lock);
+
+	mem->pageq.next = NULL;
+	mem->pageq.prev = NULL;
+
+	assert(mem->zeroed);
+	assert(mem->busy);
+	assert(!mem->free);
+	assert(mem->tabled == FALSE);
+	assert(mem->object == VM_OBJECT_NULL);
+	assert(mem->listq.next == NULL && mem->listq.prev == NULL);
+
+	if (vm_page_zeroed_count < (vm_page_zeroed_target / 2))
+		thread_wakeup((event_t) &vm_page_queue_zeroed);
+
+	return (mem);
+}
+
+vm_page_t
+vm_page_alloc_zeroed(
+	vm_object_t		object,
+	vm_object_offset_t	offset)
+{
+	register vm_page_t	mem;
+
+	vm_object_lock_assert_exclusive(object);
+	mem = vm_page_grab_zeroed();
+	if (mem == VM_PAGE_NULL)
+		return VM_PAGE_NULL;
+
+	vm_page_insert(mem, object, offset);
+
+	return(mem);
+}
+
+
+/*
+ *	vm_page_zeroed_drain:
+ *
+ *	Return the entire pre-zeroed cache to the free list.
+ */
+static void
+vm_page_zeroed_drain(void)
+{
+	vm_page_t	mem;
+	vm_page_t	local_freeq = VM_PAGE_NULL;
+
+	lck_mtx_lock_spin(&vm_page_queue_free_lock);
+
+	while ( !queue_empty(&vm_page_queue_zeroed)) {
+		queue_remove_first(&vm_page_queue_zeroed,
+				   mem,
+				   vm_page_t,
+				   pageq);
+		vm_page_zeroed_count--;
+		vm_page_zeroed_drained++;
+
+		mem->pageq.prev = NULL;
+		mem->pageq.next = (queue_entry_t) local_freeq;
+		local_freeq = mem;
+	}
+	lck_mtx_unlock(&vm_page_queue_free_lock);
+
+	while ((mem = local_freeq) != VM_PAGE_NULL) {
+		local_freeq = (vm_page_t) mem->pageq.next;
+
+		mem->pageq.next = NULL;
+		mem->zeroed = FALSE;
+
+		vm_page_release(mem);
+	}
+}
+
+
+/*
+ *	vm_page_zero_thread:
+ *
+ *	Keep the pre-zeroed cache topped up while there is
+ *	comfortably more free memory than the pageout daemon
+ *	is aiming for.  Runs at MAXPRI_THROTTLE so that it
+ *	only consumes otherwise idle cycles.
+ */
+static void
+vm_page_zero_thread(void)
+{
+	vm_page_t	mem;
+
+	while (vm_page_zeroed_count < vm_page_zeroed_target &&
+	       vm_page_free_wanted == 0 &&
+	       vm_page_free_count > (vm_page_free_target + VM_PAGE_ZEROED_SLACK)) {
+
+		if ((mem = vm_page_grab()) == VM_PAGE_NULL)
+			break;
+
+		pmap_zero_page(mem->phys_page);
+		mem->zeroed = TRUE;
+
+		lck_mtx_lock_spin(&vm_page_queue_free_lock);
+
+		queue_enter(&vm_page_queue_zeroed,
+			    mem,
+			    vm_page_t,
+			    pageq);
+		vm_page_zeroed_count++;
+		vm_page_zeroed_filled++;
+
+		lck_mtx_unlock(&vm_page_queue_free_lock);
+	}
+	assert_wait_timeout((event_t) &vm_page_queue_zeroed, THREAD_UNINT,
+			    VM_PAGE_ZEROED_MSECS, 1000*NSEC_PER_USEC);
+
+	thread_block((thread_continue_t) vm_page_zero_thread);
+	/*NOTREACHED*/
+}
+
+
+void
+vm_page_zero_thread_init(void)
+{
+	kern_return_t	result;
+	thread_t	thread;
+
+	result = kernel_thread_start_priority((thread_continue_t)vm_page_zero_thread, NULL,
+					      MAXPRI_THROTTLE,
+					      &thread);
+	if (result != KERN_SUCCESS)
+		panic("vm_page_zero_thread: create failed");
+
+	thread_deallocate(thread);
+}
+
+
 /*
  *	vm_page_wait:
  *
@@ -3297,6 +3749,14 @@ vm_page_zero_fill(
 	VM_PAGE_CHECK(m);
 #endif
 
+	if (m->zeroed) {
+		/*
+		 * came from the pre-zeroed cache and
+		 * nobody has touched it since
+		 */
+		m->zeroed = FALSE;
+		return;
+	}
 //	dbgTrace(0xAEAEAEAE, m->phys_page, 0);		/* (BRINGUP) */
 	pmap_zero_page(m->phys_page);
 }
@@ -3323,6 +3783,7 @@ vm_page_part_copy(
 	VM_PAGE_CHECK(src_m);
 	VM_PAGE_CHECK(dst_m);
 #endif
+	dst_m->zeroed = FALSE;
 	pmap_copy_part_page(src_m->phys_page, src_pa,
 			dst_m->phys_page, dst_pa, len);
 }
@@ -3403,6 +3864,7 @@ vm_page_copy(
 	}
 	dest_m->slid = src_m->slid;
 	dest_m->error = src_m->error; /* sliding src_m might have failed... */
+	dest_m->zeroed = FALSE;
 	pmap_copy_page(src_m->phys_page, dest_m->phys_page);
 }
 
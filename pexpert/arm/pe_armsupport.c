@@ -98,3 +98,75 @@ uint64_t pe_arm_get_timebase(__unused void* args)
     
     return gPESocDispatch.get_timebase();
 }
+
+/**
+ * pe_arm_get_cpu_count
+ *
+ * Get the number of processors in the SoC. Platforms that do not say
+ * have one.
+ */
+uint32_t pe_arm_get_cpu_count(void)
+{
+    if(gPESocDispatch.cpu_count == NULL)
+        return 1;
+    
+    return gPESocDispatch.cpu_count();
+}
+
+/**
+ * pe_arm_start_cpu
+ *
+ * Start a secondary processor at the given physical address.
+ */
+boolean_t pe_arm_start_cpu(int cpu, uint32_t entry_phys)
+{
+    if(gPESocDispatch.cpu_start == NULL)
+        return FALSE;
+    
+    return gPESocDispatch.cpu_start(cpu, entry_phys);
+}
+
+/**
+ * pe_arm_signal_cpu
+ *
+ * Send an inter-processor interrupt to a processor.
+ */
+void pe_arm_signal_cpu(int cpu)
+{
+    if(gPESocDispatch.cpu_signal == NULL)
+        panic("gPESocDispatch.cpu_signal was null, did you forget to set up the table?");
+    
+    gPESocDispatch.cpu_signal(cpu);
+}
+
+/**
+ * pe_arm_init_cpu
+ *
+ * Initialize the per-processor interrupt controller and timer state of a
+ * secondary processor, on that processor.
+ */
+uint32_t pe_arm_init_cpu(__unused void* args)
+{
+    if(gPESocDispatch.cpu_init == NULL)
+        panic("gPESocDispatch.cpu_init was null, did you forget to set up the table?");
+    
+    gPESocDispatch.cpu_init();
+    
+    return 0;
+}
+
+/**
+ * pe_arm_set_timer_decrementer
+ *
+ * Program the next one-shot timer pop, in timebase ticks from now.
+ * Returns FALSE on platforms whose timer still runs at a fixed period.
+ */
+boolean_t pe_arm_set_timer_decrementer(uint64_t ticks)
+{
+    if(gPESocDispatch.timer_decrementer == NULL)
+        return FALSE;
+    
+    gPESocDispatch.timer_decrementer(ticks);
+    
+    return TRUE;
+}
@@ -42,6 +42,7 @@
 PE_state_t  PE_state;
 
 extern void pe_identify_machine(void * args);
+extern void mp_cpus_start(void);
 
 /**
  * PE_init_platform
@@ -100,6 +101,11 @@ void PE_init_iokit(void)
 
     PE_init_printf(TRUE);
     
+    /*
+     * Bring up the other processors, if the platform has any.
+     */
+    mp_cpus_start();
+    
     StartIOKit( PE_state.deviceTreeHead, PE_state.bootArgs,
 			(void *)0, (void *)0);
 }
@@ -37,6 +37,7 @@
 #include <pexpert/arm/boot.h>
 
 #include <machine/machine_routines.h>
+#include <kern/simple_lock.h>
 
 #include <vm/pmap.h>
 #include <arm/pmap.h>
@@ -52,6 +53,7 @@
 
 extern void rtclock_intr(arm_saved_state_t* regs);
 extern void rtc_configure(uint64_t hz);
+extern int cpu_signal_handler(arm_saved_state_t* regs);
 
 vm_offset_t     gRealviewUartBase;
 vm_offset_t     gRealviewPicBase;
@@ -59,6 +61,7 @@ vm_offset_t     gRealviewTimerBase;
 vm_offset_t     gRealviewSysControllerBase;
 
 vm_offset_t     gRealviewPicDistribBase;
+vm_offset_t     gRealviewScuBase;
 
 vm_offset_t     gRealviewPl111Base;
 
@@ -67,12 +70,49 @@ static boolean_t    clock_initialized = FALSE;
 static boolean_t    clock_had_irq = FALSE;
 static uint64_t     clock_absolute_time = 0;
 
+/*
+ * The timer runs in one-shot mode. The timebase is clock_absolute_time
+ * plus however much of clock_loaded has counted down so far; every
+ * reprogram folds the elapsed part into clock_absolute_time first.
+ *
+ * Folding and reprogramming happen under clock_lock with interrupts
+ * off, from the timer interrupt as well as from setPop. clock_seq is
+ * odd while they are at it, readers retry instead of taking the lock.
+ */
+static uint64_t     clock_loaded = 0;
+static boolean_t    clock_rearmed = FALSE;
+static volatile uint32_t clock_seq = 0;
+decl_simple_lock_data(static, clock_lock)
+
+static void RealView_timer_load(uint64_t ticks);
+
+static boolean_t clock_write_begin(void)
+{
+    boolean_t istate = ml_set_interrupts_enabled(FALSE);
+
+    simple_lock(&clock_lock);
+    clock_seq++;
+    __asm__ __volatile__("dmb" : : : "memory");
+
+    return istate;
+}
+
+static void clock_write_end(boolean_t istate)
+{
+    __asm__ __volatile__("dmb" : : : "memory");
+    clock_seq++;
+    simple_unlock(&clock_lock);
+
+    ml_set_interrupts_enabled(istate);
+}
+
 static void timer_configure(void)
 {
     uint64_t hz = 32000;
     clock_decrementer = (hz / 700UL);     // For 500Hz.
     
     gPEClockFrequencyInfo.timebase_frequency_hz = hz;
+    simple_lock_init(&clock_lock, 0);
     
     kprintf(KPRINTF_PREFIX "decrementer frequency = %llu\n", clock_decrementer);
     
@@ -95,13 +135,32 @@ int RealView_getc(void)
     return 'A';
 }
 
+/*
+ * Processors with the multiprocessing extensions that are not marked as
+ * uniprocessor are MPCore parts, with the interrupt controller in the
+ * private memory region at PERIPHBASE.
+ */
+static boolean_t RealView_is_mpcore(void)
+{
+    uint32_t mpidr;
+
+    __asm__ __volatile__("mrc p15, 0, %0, c0, c0, 5" : "=r"(mpidr));
+    return ((mpidr & (3 << 30)) == (1 << 31));
+}
+
 void RealView_uart_init(void)
 {
     char temp_buf[16];
+    uint32_t periphbase;
 
     gRealviewUartBase = ml_io_map(REALVIEW_UART0_BASE, PAGE_SIZE);
 
-    if (PE_parse_boot_argn("-use_realview_eb_pic", temp_buf, sizeof(temp_buf))) {
+    if (RealView_is_mpcore()) {
+        __asm__ __volatile__("mrc p15, 4, %0, c15, c0, 0" : "=r"(periphbase));
+        gRealviewScuBase = ml_io_map(periphbase + MPCORE_SCU_OFFSET, PAGE_SIZE);
+        gRealviewPicBase = gRealviewScuBase + MPCORE_GIC_CPU_OFFSET;
+        gRealviewPicDistribBase = ml_io_map(periphbase + MPCORE_GIC_DIST_OFFSET, PAGE_SIZE);
+    } else if (PE_parse_boot_argn("-use_realview_eb_pic", temp_buf, sizeof(temp_buf))) {
         gRealviewPicBase = ml_io_map(REALVIEW_EB_PIC0_BASE, PAGE_SIZE);
         gRealviewPicDistribBase = ml_io_map(REALVIEW_EB_PIC0_BASE + PAGE_SIZE, PAGE_SIZE);
     } else {
@@ -129,6 +188,12 @@ void RealView_interrupt_init(void)
     /* enable distribution */
     HARDWARE_REGISTER(gRealviewPicDistribBase) |= PIC_ENABLE;
     
+    /* the SCU keeps the other processors coherent */
+    if (gRealviewScuBase) {
+        HARDWARE_REGISTER(gRealviewScuBase + SCU_CONTROL) |= SCU_ENABLE;
+        HARDWARE_REGISTER(gRealviewPicDistribBase + PIC_SGI_ENABLE) = 0xFFFF;
+    }
+    
     /* allow all interrupts */
     HARDWARE_REGISTER(gRealviewPicDistribBase + 0x104) = -1;
     HARDWARE_REGISTER(gRealviewPicDistribBase + 0x108) = -1;
@@ -186,6 +251,7 @@ void RealView_timebase_init(void)
     HARDWARE_REGISTER(gRealviewTimerBase + TIMER_CONTROL) |= TIMER_SIZE_32_BIT;
     HARDWARE_REGISTER(gRealviewTimerBase + TIMER_CONTROL) |= TIMER_ENABLE;
     HARDWARE_REGISTER(gRealviewTimerBase) = clock_decrementer;
+    clock_loaded = clock_decrementer;
 
     /* enable irqs so we can get ahold of the timer when it decrements */
     ml_set_interrupts_enabled(TRUE);
@@ -206,50 +272,120 @@ void RealView_timebase_init(void)
 void RealView_handle_interrupt(void* context)
 {
     arm_saved_state_t* regs = (arm_saved_state_t*)context;
+    boolean_t istate;
     uint32_t ack;
 
     /* Acknowledge interrupt */
-    ack = HARDWARE_REGISTER(gRealviewPicBase + 0xC);
+    ack = HARDWARE_REGISTER(gRealviewPicBase + PICACK);
 
-    /* Update absolute time */
-    clock_absolute_time += (clock_decrementer - RealView_timer_value());
-    
-    /* Kill the timer */
+    /* Software generated interrupts are inter-processor signals. */
+    if (PIC_INTERRUPT_ID(ack) < PIC_SGI_MAX) {
+        cpu_signal_handler(regs);
+        HARDWARE_REGISTER(gRealviewPicBase + PICEOI) = ack;
+        return;
+    }
+
+    /* Update absolute time and kill the timer */
+    istate = clock_write_begin();
+    RealView_timer_fold();
     HARDWARE_REGISTER(gRealviewTimerBase + TIMER_INTCLR) = 1;
+    clock_rearmed = FALSE;
+    clock_write_end(istate);
 
+    /* The event timer programs the next pop from here. */
     rtclock_intr((arm_saved_state_t*) context);
     
-    /* Restart timer. */
-    HARDWARE_REGISTER(gRealviewTimerBase) = clock_decrementer;
-    RealView_timer_enabled(TRUE);
+    /* Nobody asked for one, fall back to the periodic tick. */
+    istate = clock_write_begin();
+    if (!clock_rearmed && !clock_loaded)
+        RealView_timer_load(clock_decrementer);
+    clock_write_end(istate);
     
     clock_had_irq = TRUE;
     
     /* EOI. */
-    HARDWARE_REGISTER(gRealviewPicBase + 0x10) = ack;
+    HARDWARE_REGISTER(gRealviewPicBase + PICEOI) = ack;
     
     return;
 }
 
 uint64_t RealView_get_timebase(void)
 {
+    uint64_t absolute_time, loaded;
     uint32_t timestamp;
+    uint32_t seq;
     
     if(!clock_initialized)
         return 0;
     
-    timestamp = RealView_timer_value();
-    if(timestamp) {
-        uint64_t v = clock_absolute_time;
-        v += (uint64_t)(((uint64_t)clock_decrementer) - (uint64_t)(timestamp));
-        return v;
-    } else {
-        HARDWARE_REGISTER(gRealviewTimerBase) = clock_decrementer;
-        RealView_timer_enabled(TRUE);
-        clock_absolute_time += clock_decrementer;
-        
-        return clock_absolute_time;
-    }
+    /*
+     * An expired one-shot timer sits at zero until the interrupt
+     * handler reprograms it, which still reads correctly here. The
+     * timer and the pair it is relative to must come from the same
+     * side of a fold.
+     */
+    do {
+        while ((seq = clock_seq) & 1)
+            barrier();
+        __asm__ __volatile__("dmb" : : : "memory");
+        timestamp = RealView_timer_value();
+        absolute_time = clock_absolute_time;
+        loaded = clock_loaded;
+        __asm__ __volatile__("dmb" : : : "memory");
+    } while (seq != clock_seq);
+
+    return absolute_time + (loaded - (uint64_t)timestamp);
+}
+
+/**
+ * RealView_timer_fold
+ *
+ * Move the elapsed part of the current pop into the timebase. Called
+ * between clock_write_begin and clock_write_end.
+ */
+void RealView_timer_fold(void)
+{
+    uint64_t value = RealView_timer_value();
+    
+    clock_absolute_time += (clock_loaded - value);
+    clock_loaded = value;
+}
+
+/**
+ * RealView_timer_load
+ *
+ * Program a one-shot pop the given number of ticks from now, with the
+ * clock lock held.
+ */
+static void RealView_timer_load(uint64_t ticks)
+{
+    if (ticks == 0)
+        ticks = 1;
+    else if (ticks > 0xFFFFFFFFULL)
+        ticks = 0xFFFFFFFFULL;
+    
+    RealView_timer_enabled(FALSE);
+    RealView_timer_fold();
+    
+    HARDWARE_REGISTER(gRealviewTimerBase + TIMER_LOAD) = (uint32_t)ticks;
+    clock_loaded = ticks;
+    
+    RealView_timer_enabled(TRUE);
+    clock_rearmed = TRUE;
+}
+
+/**
+ * RealView_timer_set_decrementer
+ *
+ * Program a one-shot pop the given number of ticks from now.
+ */
+void RealView_timer_set_decrementer(uint64_t ticks)
+{
+    boolean_t istate;
+
+    istate = clock_write_begin();
+    RealView_timer_load(ticks);
+    clock_write_end(istate);
 }
 
 uint64_t RealView_timer_value(void)
@@ -265,6 +401,67 @@ void RealView_timer_enabled(int enable)
         HARDWARE_REGISTER(gRealviewTimerBase + TIMER_CONTROL) &= ~TIMER_SET_ENABLE;
 }
 
+/**
+ * RealView_cpu_count
+ *
+ * Number of processors the SCU reports, one without an SCU.
+ */
+uint32_t RealView_cpu_count(void)
+{
+    if (!gRealviewScuBase)
+        return 1;
+
+    return (HARDWARE_REGISTER(gRealviewScuBase + SCU_CONFIG) & 3) + 1;
+}
+
+/**
+ * RealView_cpu_signal
+ *
+ * Send the inter-processor SGI to a processor.
+ */
+void RealView_cpu_signal(int cpu)
+{
+    /* Make the signal visible before the interrupt is. */
+    __asm__ __volatile__("dsb sy" ::: "memory");
+
+    HARDWARE_REGISTER(gRealviewPicDistribBase + PIC_SGI_TRIGGER) =
+        PIC_SGI_TARGET(cpu) | REALVIEW_IPI_SGI;
+}
+
+/**
+ * RealView_cpu_start
+ *
+ * Point the boot monitor's system flags at the entry point and wake the
+ * parked processor up.
+ */
+boolean_t RealView_cpu_start(int cpu, uint32_t entry_phys)
+{
+    if (cpu >= RealView_cpu_count())
+        return FALSE;
+
+    kprintf(KPRINTF_PREFIX "starting cpu %d at 0x%08x\n", cpu, entry_phys);
+
+    HARDWARE_REGISTER(gRealviewSysControllerBase + REALVIEW_SYSCTL_FLAGSCLR) = 0xFFFFFFFF;
+    HARDWARE_REGISTER(gRealviewSysControllerBase + REALVIEW_SYSCTL_FLAGSSET) = entry_phys;
+
+    RealView_cpu_signal(cpu);
+
+    return TRUE;
+}
+
+/**
+ * RealView_cpu_init
+ *
+ * The interrupt controller CPU interface and the SGI enables are banked,
+ * so each processor sets up its own.
+ */
+void RealView_cpu_init(void)
+{
+    HARDWARE_REGISTER(gRealviewPicBase) |= PIC_ENABLE;
+    HARDWARE_REGISTER(gRealviewPicBase + PICPRIOMASK) |= PIC_ALLOW_INTR;
+    HARDWARE_REGISTER(gRealviewPicDistribBase + PIC_SGI_ENABLE) = 0xFFFF;
+}
+
 /*
  * Stub for printing out to framebuffer.
  */
@@ -341,9 +538,15 @@ void PE_init_SocSupport_realview(void)
 
     gPESocDispatch.timer_value = RealView_timer_value;
     gPESocDispatch.timer_enabled = RealView_timer_enabled;
+    gPESocDispatch.timer_decrementer = RealView_timer_set_decrementer;
     
     gPESocDispatch.framebuffer_init = RealView_framebuffer_init;
     
+    gPESocDispatch.cpu_count = RealView_cpu_count;
+    gPESocDispatch.cpu_start = RealView_cpu_start;
+    gPESocDispatch.cpu_signal = RealView_cpu_signal;
+    gPESocDispatch.cpu_init = RealView_cpu_init;
+    
     RealView_uart_init();
     RealView_framebuffer_init();
     
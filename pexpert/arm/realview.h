@@ -44,6 +44,24 @@
 
 #define REALVIEW_EB_PIC0_BASE   0x10050000
 
+/*
+ * The boot monitor parks secondary processors until the system flags hold
+ * an entry point and they are sent an interrupt.
+ */
+#define REALVIEW_SYSCTL_FLAGSSET    0x30
+#define REALVIEW_SYSCTL_FLAGSCLR    0x34
+
+/*
+ * Cortex-A9 MPCore private memory region, relative to PERIPHBASE.
+ */
+#define MPCORE_SCU_OFFSET       0x0
+#define MPCORE_GIC_CPU_OFFSET   0x100
+#define MPCORE_GIC_DIST_OFFSET  0x1000
+
+#define SCU_CONTROL             0x0
+#define SCU_CONFIG              0x4
+#define SCU_ENABLE              0x1
+
 #define HARDWARE_REGISTER(x)    *((unsigned int*)(x)) 
 
 #define LCDTIMING0_PPL(x)           ((((x) / 16 - 1) & 0x3f) << 2)
@@ -68,6 +86,17 @@
 #define PIC_ALLOW_INTR          0xF0
 
 #define PICPRIOMASK             0x4
+#define PICACK                  0xC
+#define PICEOI                  0x10
+
+#define PIC_SGI_ENABLE          0x100
+#define PIC_SGI_TRIGGER         0xF00
+
+#define PIC_INTERRUPT_ID(ack)   ((ack) & 0x3FF)
+#define PIC_SGI_MAX             16
+#define PIC_SGI_TARGET(cpu)     (1 << (16 + (cpu)))
+
+#define REALVIEW_IPI_SGI        1
 
 #define PIC_INTPRIO             0x10101010
 #define PIC_CPUPRIO             0x01010101
@@ -93,7 +122,13 @@ void RealView_handle_interrupt(void* context);
 uint64_t RealView_get_timebase(void);
 uint64_t RealView_timer_value(void);
 void RealView_timer_enabled(int enable);
+void RealView_timer_fold(void);
+void RealView_timer_set_decrementer(uint64_t ticks);
 void RealView_framebuffer_init(void);
+uint32_t RealView_cpu_count(void);
+boolean_t RealView_cpu_start(int cpu, uint32_t entry_phys);
+void RealView_cpu_signal(int cpu);
+void RealView_cpu_init(void);
 
 #endif
  
@@ -7,6 +7,11 @@ extern uint32_t pe_arm_init_interrupts(void *args);
 extern uint32_t pe_arm_init_timebase(void* args);
 extern boolean_t pe_arm_dispatch_interrupt(void* context);
 extern uint64_t pe_arm_get_timebase(void* args);
+extern uint32_t pe_arm_get_cpu_count(void);
+extern boolean_t pe_arm_start_cpu(int cpu, uint32_t entry_phys);
+extern void pe_arm_signal_cpu(int cpu);
+extern uint32_t pe_arm_init_cpu(void* args);
+extern boolean_t pe_arm_set_timer_decrementer(uint64_t ticks);
 
 int serial_init(void);
 int serial_getc(void);
@@ -45,7 +50,12 @@ typedef void (*SocDevice_HandleInterrupt)(void* context);
 typedef uint64_t (*SocDevice_GetTimebase)(void);
 typedef uint64_t (*SocDevice_GetTimer0_Value)(void);
 typedef void (*SocDevice_SetTimer0_Enabled)(int enable);
+typedef void (*SocDevice_SetTimer0_Decrementer)(uint64_t ticks);
 typedef void (*SocDevice_PrepareFramebuffer)(void);
+typedef uint32_t (*SocDevice_GetCpuCount)(void);
+typedef boolean_t (*SocDevice_StartCpu)(int cpu, uint32_t entry_phys);
+typedef void (*SocDevice_SignalCpu)(int cpu);
+typedef void (*SocDevice_InitializeCpu)(void);
 
 int PE_early_putc(int c);
 void PE_early_puts(char* s);
@@ -59,8 +69,13 @@ typedef struct SocDeviceDispatch {
     SocDevice_HandleInterrupt       handle_interrupt;
     SocDevice_GetTimer0_Value       timer_value;
     SocDevice_SetTimer0_Enabled     timer_enabled;
+    SocDevice_SetTimer0_Decrementer timer_decrementer;
     SocDevice_PrepareFramebuffer    framebuffer_init;
     SocDevice_GetTimebase           get_timebase;
+    SocDevice_GetCpuCount           cpu_count;
+    SocDevice_StartCpu              cpu_start;
+    SocDevice_SignalCpu             cpu_signal;
+    SocDevice_InitializeCpu         cpu_init;
 } SocDeviceDispatch;
 
 extern SocDeviceDispatch    gPESocDispatch;
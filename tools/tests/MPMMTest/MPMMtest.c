@@ -77,6 +77,7 @@ int			client_delay;
 int			client_spin;
 int			client_pages;
 int			portcount = 1;
+int			batch = 1;
 char			**server_port_name;
 
 void signal_handler(int sig) {
@@ -99,6 +100,7 @@ void usage(const char *progname) {
 	fprintf(stderr, "    -work num\t\tmicroseconds of client work\n");
 	fprintf(stderr, "    -pages num\t\tpages of memory touched by client work\n");
 	fprintf(stderr, "    -set num\t\tuse a portset stuffed with num ports in server\n");
+	fprintf(stderr, "    -batch num\t\tserver receives up to num messages at once (MACH_RCV_BATCH)\n");
 	fprintf(stderr, "default values are:\n");
 	fprintf(stderr, "    . no affinity\n");
 	fprintf(stderr, "    . not timeshare\n");
@@ -110,6 +112,7 @@ void usage(const char *progname) {
 	fprintf(stderr, "    . (num_available_processors+1)%%2 servers\n");
 	fprintf(stderr, "    . 4 clients per server\n");
 	fprintf(stderr, "    . no delay\n");
+	fprintf(stderr, "    . one message per receive\n");
 	exit(1);
 }
 
@@ -198,6 +201,13 @@ void parse_args(int argc, char *argv[]) {
 				usage(progname);
 			client_pages = strtoul(argv[1], NULL, 0);
 			argc -= 2; argv += 2;
+		} else if (0 == strcmp("-batch", argv[0])) {
+			if (argc < 2) 
+				usage(progname);
+			batch = strtoul(argv[1], NULL, 0);
+			if (batch < 1)
+				usage(progname);
+			argc -= 2; argv += 2;
 		} else if (0 == strcmp("-set", argv[0])) {
 			if (argc < 2) 
 				usage(progname);
@@ -220,6 +230,9 @@ void setup_server_ports(struct port_args *ports)
 	ports->req_size = MAX(sizeof(ipc_inline_message) +  
 			sizeof(u_int32_t) * num_ints, 
 			sizeof(ipc_complex_message));
+	if (batch > 1)
+		ports->req_size = ports->req_size * batch +
+			sizeof(mach_msg_batch_end_t);
 	ports->reply_size = sizeof(ipc_trivial_message) - 
 		sizeof(mach_msg_trailer_t);
 	ports->req_msg = malloc(ports->req_size);
@@ -355,14 +368,104 @@ thread_setup(int tag) {
 #endif
 }
 
+/*
+ * MACH_RCV_BATCH: count the messages a receive left in the buffer,
+ * and check them against the record that ends the batch
+ */
+static int
+batch_count(mach_msg_header_t *msg, int size)
+{
+	char			*p = (char *) msg;
+	char			*limit = p + size;
+	mach_msg_batch_end_t	*end;
+	mach_msg_trailer_t	*trailer;
+	int			n = 0;
+
+	for (;;) {
+		msg = (mach_msg_header_t *) p;
+		if (n > 0 && p + sizeof(mach_msg_batch_end_t) > limit) {
+			if (n == 1)
+				return 1;	/* no room left: a batch of one */
+			fprintf(stderr, "batch of %d has no end record\n", n);
+			exit(1);
+		}
+		if (n > 0 && msg->msgh_size == 0)
+			break;
+		trailer = (mach_msg_trailer_t *) (p + round_msg(msg->msgh_size));
+		p += round_msg(msg->msgh_size + trailer->msgh_trailer_size);
+		n++;
+	}
+
+	end = (mach_msg_batch_end_t *) p;
+	if (end->error != MACH_MSG_SUCCESS) {
+		mach_error("mach_msg (batch): ", end->error);
+		exit(1);
+	}
+	if (end->count != (mach_msg_size_t) n) {
+		fprintf(stderr, "batch end record counts %u messages, found %d\n",
+			end->count, n);
+		exit(1);
+	}
+	return n;
+}
+
+static mach_msg_header_t *
+batch_next(mach_msg_header_t *msg)
+{
+	mach_msg_trailer_t *trailer;
+
+	trailer = (mach_msg_trailer_t *)
+		((char *) msg + round_msg(msg->msgh_size));
+	return (mach_msg_header_t *) ((char *) msg +
+		round_msg(msg->msgh_size + trailer->msgh_trailer_size));
+}
+
+static void
+server_handle(struct port_args *args, mach_msg_header_t *msg, int idx)
+{
+	kern_return_t ret;
+
+	if (verbose)
+		printf("server received message %d\n", idx);
+	if (msg->msgh_bits & MACH_MSGH_BITS_COMPLEX) {
+		ret = vm_deallocate(mach_task_self(),  
+				(vm_address_t)((ipc_complex_message *)msg)->descriptor.address,  
+				((ipc_complex_message *)msg)->descriptor.size);
+	}
+
+	if (1 == msg->msgh_id) {
+		if (verbose) 
+			printf("server sending reply %d\n", idx);
+		args->reply_msg->msgh_bits = MACH_MSGH_BITS(MACH_MSG_TYPE_MOVE_SEND_ONCE, 0);
+		args->reply_msg->msgh_size = args->reply_size;
+		args->reply_msg->msgh_remote_port = msg->msgh_remote_port;
+		args->reply_msg->msgh_local_port = MACH_PORT_NULL;
+		args->reply_msg->msgh_id = 2;
+		ret = mach_msg(args->reply_msg, 
+				MACH_SEND_MSG, 
+				args->reply_size, 
+				0, 
+				MACH_PORT_NULL, 
+				MACH_MSG_TIMEOUT_NONE,  
+				MACH_PORT_NULL);
+		if (MACH_MSG_SUCCESS != ret) {
+			mach_error("mach_msg (send): ", ret);
+			exit(1);
+		}
+	}
+}
+
 void *
 server(void *serverarg) 
 {
 	struct port_args args;
 	int idx;
+	int i, n;
 	kern_return_t ret;
 	int totalmsg = num_msgs * num_clients;
 	mach_port_t recv_port;
+	mach_msg_option_t option;
+	mach_msg_header_t *msg;
 
 	args.server_num = (int) (long) serverarg;
 	setup_server_ports(&args);
@@ -370,12 +473,15 @@ server(void *serverarg)
 	thread_setup(args.server_num + 1);
 
 	recv_port = (useset) ? args.set : args.port;
+	option = MACH_RCV_MSG|MACH_RCV_INTERRUPT|MACH_RCV_LARGE;
+	if (batch > 1)
+		option |= MACH_RCV_BATCH;
 
-	for (idx = 0; idx < totalmsg; idx++) {
+	for (idx = 0; idx < totalmsg; ) {
 		if (verbose) 
 			printf("server awaiting message %d\n", idx);
 		ret = mach_msg(args.req_msg,  
-				MACH_RCV_MSG|MACH_RCV_INTERRUPT|MACH_RCV_LARGE, 
+				option, 
 				0, 
 				args.req_size,  
 				recv_port, 
@@ -389,34 +495,9 @@ server(void *serverarg)
 			mach_error("mach_msg (receive): ", ret);
 			exit(1);
 		}
-		if (verbose)
-			printf("server received message %d\n", idx);
-		if (args.req_msg->msgh_bits & MACH_MSGH_BITS_COMPLEX) {
-			ret = vm_deallocate(mach_task_self(),  
-					(vm_address_t)((ipc_complex_message *)args.req_msg)->descriptor.address,  
-					((ipc_complex_message *)args.req_msg)->descriptor.size);
-		}
-
-		if (1 == args.req_msg->msgh_id) {
-			if (verbose) 
-				printf("server sending reply %d\n", idx);
-			args.reply_msg->msgh_bits = MACH_MSGH_BITS(MACH_MSG_TYPE_MOVE_SEND_ONCE, 0);
-			args.reply_msg->msgh_size = args.reply_size;
-			args.reply_msg->msgh_remote_port = args.req_msg->msgh_remote_port;
-			args.reply_msg->msgh_local_port = MACH_PORT_NULL;
-			args.reply_msg->msgh_id = 2;
-			ret = mach_msg(args.reply_msg, 
-					MACH_SEND_MSG, 
-					args.reply_size, 
-					0, 
-					MACH_PORT_NULL, 
-					MACH_MSG_TIMEOUT_NONE,  
-					MACH_PORT_NULL);
-			if (MACH_MSG_SUCCESS != ret) {
-				mach_error("mach_msg (send): ", ret);
-				exit(1);
-			}
-		}
+		n = (batch > 1) ? batch_count(args.req_msg, args.req_size) : 1;
+		for (i = 0, msg = args.req_msg; i < n; i++, msg = batch_next(msg))
+			server_handle(&args, msg, idx++);
 	}
 	return NULL;
 }
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2013 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ *
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ *	Default Pager.
+ *		User space round trip test of the WKdm routines that the
+ *		compressed memory pool (dp_compressor.c) uses.
+ *
+ *	Not part of the kernel build: "make check" in this directory.
+ *
+ *	Every page pattern must decompress to what was compressed, and
+ *	the compressed size must fit the pool's two page scratch buffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WKdm.h"
+
+/* as in dp_compressor.c */
+#define DPC_SCRATCH_WORDS	(2 * PAGE_SIZE_IN_WORDS)
+#define DPC_MAX_CSIZE		((PAGE_SIZE_IN_BYTES * 3) / 4)
+
+static WK_word	src[PAGE_SIZE_IN_WORDS];
+static WK_word	dst[PAGE_SIZE_IN_WORDS];
+static WK_word	scratch[DPC_SCRATCH_WORDS];
+
+static unsigned int	rand_state = 0x2545f491;
+
+static WK_word
+next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return (rand_state);
+}
+
+static void
+fill_zero(void)
+{
+	memset(src, 0, sizeof (src));
+}
+
+static void
+fill_repeat(void)
+{
+	int i;
+
+	for (i = 0; i < PAGE_SIZE_IN_WORDS; i++)
+		src[i] = 0xdeadbeef;
+}
+
+static void
+fill_partial(void)
+{
+	int i;
+
+	/* same high bits, differing low bits: partial dictionary hits */
+	for (i = 0; i < PAGE_SIZE_IN_WORDS; i++)
+		src[i] = 0x12345000 | (next_rand() & 0x3ff);
+}
+
+static void
+fill_pointers(void)
+{
+	int i;
+
+	/* a few distinct "pointers" and small integers, like a heap page */
+	for (i = 0; i < PAGE_SIZE_IN_WORDS; i++) {
+		switch (next_rand() % 4) {
+		case 0:	src[i] = 0;				break;
+		case 1:	src[i] = 0x7fff5000 + (i & ~7) * 4;	break;
+		case 2:	src[i] = next_rand() & 0xff;		break;
+		default: src[i] = 0x00100000 + (next_rand() & 0xfff0);	break;
+		}
+	}
+}
+
+static void
+fill_text(void)
+{
+	static const char text[] =
+	    "Dirty anonymous pages handed to the default pager are first "
+	    "compressed with WKdm and kept in kernel memory. ";
+	char *p = (char *) src;
+	size_t i;
+
+	for (i = 0; i < sizeof (src); i++)
+		p[i] = text[i % (sizeof (text) - 1)];
+}
+
+static void
+fill_random(void)
+{
+	int i;
+
+	for (i = 0; i < PAGE_SIZE_IN_WORDS; i++)
+		src[i] = next_rand();
+}
+
+static void
+fill_half_random(void)
+{
+	int i;
+
+	fill_zero();
+	for (i = 0; i < PAGE_SIZE_IN_WORDS; i += 2)
+		src[i] = next_rand();
+}
+
+static struct {
+	const char	*name;
+	void		(*fill)(void);
+	int		compressible;	/* must fit DPC_MAX_CSIZE */
+} tests[] = {
+	{ "zero",		fill_zero,		1 },
+	{ "repeat",		fill_repeat,		1 },
+	{ "partial",		fill_partial,		1 },
+	{ "pointers",		fill_pointers,		1 },
+	{ "text",		fill_text,		0 },
+	{ "random",		fill_random,		0 },
+	{ "half random",	fill_half_random,	0 },
+};
+
+int
+main(void)
+{
+	unsigned int	csize;
+	unsigned int	i;
+	int		round;
+	int		failed = 0;
+
+	for (i = 0; i < sizeof (tests) / sizeof (tests[0]); i++) {
+		for (round = 0; round < 16; round++) {
+			tests[i].fill();
+			memset(scratch, 0xa5, sizeof (scratch));
+			memset(dst, 0x5a, sizeof (dst));
+
+			csize = WKdm_compress(src, scratch, PAGE_SIZE_IN_WORDS);
+			if (csize == 0 || csize > sizeof (scratch)) {
+				printf("FAIL %s: compressed size %u\n", tests[i].name, csize);
+				failed++;
+				break;
+			}
+			if (tests[i].compressible && csize > DPC_MAX_CSIZE) {
+				printf("FAIL %s: %u bytes, above the pool's %u\n",
+				       tests[i].name, csize, DPC_MAX_CSIZE);
+				failed++;
+				break;
+			}
+
+			WKdm_decompress(scratch, dst, PAGE_SIZE_IN_WORDS);
+			if (memcmp(src, dst, sizeof (src)) != 0) {
+				printf("FAIL %s: round %d does not round trip\n",
+				       tests[i].name, round);
+				failed++;
+				break;
+			}
+		}
+		if (round == 16)
+			printf("PASS %s: %u bytes\n", tests[i].name, csize);
+	}
+
+	return (failed ? 1 : 0);
+}
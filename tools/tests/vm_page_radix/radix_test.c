@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2013 Apple Inc. All rights reserved.
+ *
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_START@
+ * 
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. The rights granted to you under the License
+ * may not be used to create, or enable the creation or redistribution of,
+ * unlawful or unlicensed copies of an Apple operating system, or to
+ * circumvent, violate, or enable the circumvention or violation of, any
+ * terms of an Apple operating system software license agreement.
+ * 
+ * Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this file.
+ * 
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ * 
+ * @APPLE_OSREFERENCE_LICENSE_HEADER_END@
+ */
+
+/*
+ * User space test of the radix tree that indexes large objects'
+ * resident pages (osfmk/vm/vm_page_radix.c).  Each case inserts a
+ * set of page indexes, then checks every lookup, every range walk
+ * starting at or between them, and the teardown as they are
+ * removed again.  "make check" builds and runs it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vm/vm_page_radix.h>
+
+static int	nodes;		/* nodes currently allocated */
+static int	fail_after = -1;	/* allocations left before failing */
+
+struct vm_page_radix_node *
+vm_page_radix_node_alloc(void)
+{
+	if (fail_after == 0)
+		return (NULL);
+	if (fail_after > 0)
+		fail_after--;
+	nodes++;
+	return (malloc(sizeof (struct vm_page_radix_node)));
+}
+
+void
+vm_page_radix_node_free(
+	struct vm_page_radix_node *node)
+{
+	nodes--;
+	free(node);
+}
+
+#define P	4096ULL		/* indexes under one level 1 slot */
+
+static struct {
+	const char	*name;
+	uint64_t	index[8];
+	int		count;		/* sorted, distinct */
+} tests[] = {
+	{ "dense",		{ 0, 1, 2, 3, 63, 64, 65 },		7 },
+	{ "leaf boundary",	{ 10, 63, 64, 4095 },			4 },
+	{ "4096 boundary",	{ 10, 4040, 5000 },			3 },
+	{ "4096 skip",		{ 10, 4040, 3 * P + 7, 9 * P },		4 },
+	{ "4096^2 boundary",	{ 10, P * P - 1, P * P, P * P + 5000 },	4 },
+	{ "4096^2 skip",	{ 1, 4040, 5 * P * P + 3, 7 * P * P },	4 },
+	{ "top of range",	{ 0, P * P * P, ~0ULL - 64, ~0ULL },	4 },
+	{ "single high",	{ 1ULL << 40 },				1 },
+};
+
+/*
+ * the expected result of a walk of ["from", "last"]
+ */
+static int
+expected_next(int t, uint64_t from, uint64_t last)
+{
+	int	i;
+
+	for (i = 0; i < tests[t].count; i++) {
+		if (tests[t].index[i] >= from && tests[t].index[i] <= last)
+			return (i);
+	}
+	return (-1);
+}
+
+static int
+check_walk(int t, struct vm_page_radix_node *root, uint64_t from, uint64_t last)
+{
+	void	*found;
+	int	i;
+
+	found = vm_page_radix_next(root, from, last);
+	i = expected_next(t, from, last);
+
+	if (found != (i < 0 ? NULL : (void *) &tests[t].index[i])) {
+		printf("FAIL %s: walk [0x%llx, 0x%llx] found %p, expected index %d\n",
+		       tests[t].name, (unsigned long long) from,
+		       (unsigned long long) last, found, i);
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * walk the whole tree the way vm_object_page_remove() does
+ */
+static int
+check_full_walk(int t, struct vm_page_radix_node *root, int first)
+{
+	uint64_t	from = 0;
+	void		*found;
+	int		i = first;
+
+	while ((found = vm_page_radix_next(root, from, ~0ULL)) != NULL) {
+		if (i >= tests[t].count || found != &tests[t].index[i]) {
+			printf("FAIL %s: full walk found %p as item %d\n",
+			       tests[t].name, found, i);
+			return (1);
+		}
+		if (tests[t].index[i] == ~0ULL) {
+			i++;
+			break;
+		}
+		from = tests[t].index[i++] + 1;
+	}
+	if (i != tests[t].count) {
+		printf("FAIL %s: full walk stopped after %d of %d\n",
+		       tests[t].name, i - first, tests[t].count - first);
+		return (1);
+	}
+	return (0);
+}
+
+static int
+run(int t)
+{
+	struct vm_page_radix_node *root = NULL;
+	uint64_t	x, prev;
+	int		failed = 0;
+	int		i;
+
+	for (i = 0; i < tests[t].count; i++) {
+		if (vm_page_radix_insert(&root, tests[t].index[i], &tests[t].index[i]) != KERN_SUCCESS) {
+			printf("FAIL %s: insert 0x%llx\n", tests[t].name,
+			       (unsigned long long) tests[t].index[i]);
+			return (1);
+		}
+	}
+	for (i = 0; i < tests[t].count; i++) {
+		x = tests[t].index[i];
+
+		if (vm_page_radix_lookup(root, x) != &tests[t].index[i]) {
+			printf("FAIL %s: lookup 0x%llx\n", tests[t].name, (unsigned long long) x);
+			failed++;
+		}
+		if (x + 1 != 0 && expected_next(t, x + 1, x + 1) < 0 &&
+		    vm_page_radix_lookup(root, x + 1) != NULL) {
+			printf("FAIL %s: lookup 0x%llx found a page\n", tests[t].name,
+			       (unsigned long long) (x + 1));
+			failed++;
+		}
+		/* from the page itself, just after it, and from half way to it */
+		prev = i ? tests[t].index[i - 1] : 0;
+		failed += check_walk(t, root, x, ~0ULL);
+		failed += check_walk(t, root, prev + (x - prev) / 2, ~0ULL);
+		failed += check_walk(t, root, prev + 1, x);
+		if (x != 0)
+			failed += check_walk(t, root, prev + 1, x - 1);
+		if (x + 1 != 0)
+			failed += check_walk(t, root, x + 1, ~0ULL);
+	}
+	failed += check_full_walk(t, root, 0);
+
+	/* remove from the bottom, walking what is left each time */
+	for (i = 0; i < tests[t].count; i++) {
+		vm_page_radix_remove(&root, tests[t].index[i], &tests[t].index[i]);
+		failed += check_full_walk(t, root, i + 1);
+	}
+	if (root != NULL || nodes != 0) {
+		printf("FAIL %s: %d nodes left after removing everything\n",
+		       tests[t].name, nodes);
+		failed++;
+	}
+	return (failed);
+}
+
+/*
+ * an allocation failure leaves a tree the caller can still free
+ */
+static int
+run_shortage(void)
+{
+	struct vm_page_radix_node *root = NULL;
+	uint64_t	a = 10, b = 5 * P * P + 3;
+
+	if (vm_page_radix_insert(&root, a, &a) != KERN_SUCCESS)
+		return (1);
+	fail_after = 2;
+	if (vm_page_radix_insert(&root, b, &b) != KERN_RESOURCE_SHORTAGE) {
+		printf("FAIL shortage: insert succeeded\n");
+		return (1);
+	}
+	fail_after = -1;
+	if (vm_page_radix_lookup(root, a) != &a || vm_page_radix_next(root, 11, ~0ULL) != NULL) {
+		printf("FAIL shortage: tree damaged\n");
+		return (1);
+	}
+	vm_page_radix_free_tree(root);
+	if (nodes != 0) {
+		printf("FAIL shortage: %d nodes leaked\n", nodes);
+		return (1);
+	}
+	return (0);
+}
+
+int
+main(void)
+{
+	unsigned int	t;
+	int		failed = 0;
+	int		f;
+
+	for (t = 0; t < sizeof (tests) / sizeof (tests[0]); t++) {
+		f = run(t);
+		printf("%s %s\n", f ? "FAIL" : "PASS", tests[t].name);
+		failed += f;
+	}
+	f = run_shortage();
+	printf("%s allocation failure\n", f ? "FAIL" : "PASS");
+	failed += f;
+
+	return (failed ? 1 : 0);
+}